@@ -17,6 +17,22 @@ function(bin2c_source input_file output_var symbol_name)
     set(${output_var} "${output_file}" PARENT_SCOPE)
 endfunction()
 
+# Packed PS1 game ID table header
+function(game_id_table_header output_var)
+    set(input_file "${CMAKE_SOURCE_DIR}/common/res/game_id_table.txt")
+    set(output_file "${CMAKE_CURRENT_BINARY_DIR}/game_id_table.h")
+
+    add_custom_command(
+        OUTPUT "${output_file}"
+        COMMAND ${CMAKE_COMMAND} -P "${CMAKE_SOURCE_DIR}/cmake/game_id_table.cmake" "${input_file}" "${output_file}"
+        DEPENDS "${input_file}" "${CMAKE_SOURCE_DIR}/cmake/game_id_table.cmake"
+        COMMENT "Generating packed PS1 game ID table"
+        VERBATIM
+    )
+
+    set(${output_var} "${output_file}" PARENT_SCOPE)
+endfunction()
+
 # IRX to C file with custom section
 function(irx_to_source irx_file output_var symbol_name section_name)
     if(DEFINED PATCHER_BINARY_DIR)
@@ -0,0 +1,83 @@
+# Helper script to convert the PS1 game ID table into a sorted packed C header
+# Usage: cmake -P game_id_table.cmake <input_file> <output_file>
+#
+# Timestamps are stored as 64-bit integers sorted in ascending order to allow binary search.
+# Title IDs are stored as 32-bit codes: prefix index in bits 17 and up, title number (XXX.YY -> XXXYY) in bits 0-16.
+
+set(INPUT_FILE "${CMAKE_ARGV3}")
+set(OUTPUT_FILE "${CMAKE_ARGV4}")
+
+if(NOT INPUT_FILE OR NOT OUTPUT_FILE)
+    message(FATAL_ERROR "Usage: cmake -P game_id_table.cmake <input_file> <output_file>")
+endif()
+
+set(ENTRY_REGEX "^{\"([0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9])\", \"([A-Z][A-Z][A-Z][A-Z])_([0-9][0-9][0-9])\\.([0-9][0-9])\"},")
+file(STRINGS "${INPUT_FILE}" LINES REGEX "^{")
+
+# Collect entries as "<timestamp>;<prefix>;<number>" and all distinct prefixes
+set(ENTRIES)
+set(PREFIXES)
+foreach(line IN LISTS LINES)
+    if(NOT line MATCHES "${ENTRY_REGEX}")
+        message(FATAL_ERROR "Invalid game ID table entry: ${line}")
+    endif()
+    list(APPEND ENTRIES "${CMAKE_MATCH_1}|${CMAKE_MATCH_2}|${CMAKE_MATCH_3}${CMAKE_MATCH_4}")
+    list(APPEND PREFIXES "${CMAKE_MATCH_2}")
+endforeach()
+list(REMOVE_DUPLICATES PREFIXES)
+list(SORT PREFIXES)
+
+# Timestamps are fixed-width, so string order matches numeric order
+list(SORT ENTRIES)
+
+set(PREFIX_LIST "")
+foreach(prefix IN LISTS PREFIXES)
+    string(APPEND PREFIX_LIST "\"${prefix}\", ")
+endforeach()
+string(REGEX REPLACE ", $" "" PREFIX_LIST "${PREFIX_LIST}")
+
+set(TIMESTAMPS "")
+set(CODES "")
+set(LAST_TIMESTAMP "")
+list(LENGTH ENTRIES ENTRY_COUNT)
+foreach(entry IN LISTS ENTRIES)
+    string(REPLACE "|" ";" entry "${entry}")
+    list(GET entry 0 timestamp)
+    list(GET entry 1 prefix)
+    list(GET entry 2 number)
+
+    if(timestamp STREQUAL LAST_TIMESTAMP)
+        message(FATAL_ERROR "Duplicate game ID table timestamp: ${timestamp}")
+    endif()
+    set(LAST_TIMESTAMP "${timestamp}")
+
+    list(FIND PREFIXES "${prefix}" prefix_index)
+    # Prepend 1 to avoid parsing the leading zeros
+    math(EXPR number "1${number} - 100000")
+    math(EXPR code "(${prefix_index} << 17) | ${number}" OUTPUT_FORMAT HEXADECIMAL)
+
+    string(APPEND TIMESTAMPS "    ${timestamp}ULL,\n")
+    string(APPEND CODES "    ${code},\n")
+endforeach()
+
+file(WRITE "${OUTPUT_FILE}" "// Generated from game_id_table.txt by cmake/game_id_table.cmake. Do not edit.
+#ifndef _GAME_ID_TABLE_H_
+#define _GAME_ID_TABLE_H_
+
+#include <stdint.h>
+
+#define GAME_ID_TABLE_SIZE ${ENTRY_COUNT}
+
+// Title ID prefixes
+static const char gameIDPrefixes[][5] = {${PREFIX_LIST}};
+
+// Volume creation timestamps, sorted in ascending order
+static const uint64_t gameIDTimestamps[GAME_ID_TABLE_SIZE] = {
+${TIMESTAMPS}};
+
+// Packed title IDs matching gameIDTimestamps
+static const uint32_t gameIDCodes[GAME_ID_TABLE_SIZE] = {
+${CODES}};
+
+#endif
+")
@@ -0,0 +1,75 @@
+#ifndef _BOOTTRACE_H_
+#define _BOOTTRACE_H_
+// Boot phase timing trace.
+// Each phase boundary stores a short tag and the EE COP0 Count value (CPU clock, 294.912 MHz) into a record
+// placed in the unused kernel memory reserved by the btrace region in utils/loader/linkfile (0x84000-0x84400).
+// No program in the chain loads into it and it is not touched by ExecPS2 or the loader memory wipe,
+// so it accumulates the timestamps of the whole patcher -> launcher -> loader chain and can be extracted
+// with an EE memory dump.
+// Use utils/scripts/boottrace.py to convert the dump into a per-phase breakdown.
+//
+// Tracing is compiled in only when ENABLE_BOOT_TRACE is defined.
+
+#include <stdint.h>
+
+#define BOOT_TRACE_ADDR 0x84000 // Must match the btrace region in utils/loader/linkfile
+#define BOOT_TRACE_MAGIC 0x43525442 // "BTRC"
+#define BOOT_TRACE_MAX_ENTRIES 63
+
+typedef struct {
+  char tag[12];   // Phase name, not NULL-terminated if all 12 characters are used
+  uint32_t count; // COP0 Count value at the phase boundary
+} BootTraceEntry;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t entryCount;
+  uint32_t reserved[2];
+  BootTraceEntry entries[BOOT_TRACE_MAX_ENTRIES];
+} BootTrace;
+
+_Static_assert(sizeof(BootTrace) == 0x400, "boot trace record doesn't match the btrace region size");
+
+#ifdef ENABLE_BOOT_TRACE
+// Access the record through the uncached segment so the timestamps don't depend on data cache flushes
+#define BOOT_TRACE_RECORD ((volatile BootTrace *)(BOOT_TRACE_ADDR | 0x20000000))
+
+// Returns the COP0 Count register value
+static inline uint32_t bootTraceCount() {
+  uint32_t count;
+  asm volatile("mfc0 %0, $9" : "=r"(count));
+  return count;
+}
+
+// Appends the phase boundary to the trace record
+static inline void bootTraceMark(const char *tag) {
+  uint32_t count = bootTraceCount();
+  volatile BootTrace *trace = BOOT_TRACE_RECORD;
+  if (trace->magic != BOOT_TRACE_MAGIC || trace->entryCount > BOOT_TRACE_MAX_ENTRIES) {
+    trace->magic = BOOT_TRACE_MAGIC;
+    trace->entryCount = 0;
+  }
+  if (trace->entryCount == BOOT_TRACE_MAX_ENTRIES)
+    return;
+
+  volatile BootTraceEntry *entry = &trace->entries[trace->entryCount];
+  for (unsigned int i = 0; i < sizeof(entry->tag); i++)
+    entry->tag[i] = (*tag) ? *tag++ : '\0';
+  entry->count = count;
+  trace->entryCount++;
+}
+
+// Discards the previous record and starts a new trace. Must be called by the first program in the boot chain
+static inline void bootTraceStart(const char *tag) {
+  BOOT_TRACE_RECORD->magic = 0;
+  bootTraceMark(tag);
+}
+
+#define BOOT_TRACE_START(tag) bootTraceStart(tag)
+#define BOOT_TRACE(tag) bootTraceMark(tag)
+#else
+#define BOOT_TRACE_START(tag)
+#define BOOT_TRACE(tag)
+#endif
+
+#endif
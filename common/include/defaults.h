@@ -24,6 +24,18 @@
 #define XFROM_DKWDRV_PATH "xfrom:/osdmenu/DKWDRV.ELF"
 #endif
 
+// Launch history journal written by the launcher and merged by OSDMenu on the next boot.
+// Path is relative to the memory card root.
+#ifndef HISTORY_JOURNAL_PATH
+#define HISTORY_JOURNAL_PATH "/SYS-CONF/HISTORY.JNL"
+#endif
+
+// Last successful launch paths for entries with multiple candidate paths.
+// Path is relative to the memory card root.
+#ifndef PATH_CACHE_PATH
+#define PATH_CACHE_PATH "/SYS-CONF/LASTPATH.TXT"
+#endif
+
 //
 // HOSDMenu paths
 //
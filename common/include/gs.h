@@ -26,44 +26,61 @@ uint16_t gsGetMaxY();
 // Draws black rectangle
 void gsClearScreen();
 
-// Transfers raw bitmap image to GS' memory and draws it on screen at specified coordinates
-void gsPrintBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint32_t *data);
+// Transfers 8-bit palettized bitmap image and its CLUT to GS' memory and draws it on screen at specified coordinates.
+// Bitmap rows must be padded to 16 pixels, the CLUT must contain 256 entries in CSM1 order.
+// The transfer runs in the background: image data must stay intact until gsWaitTransfer returns
+void gsPrintBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data, uint32_t *clut);
 
 // Draws a simple rectangle sprite
 void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z, uint64_t color);
 
+// Waits for the pending GIF transfer to complete
+void gsWaitTransfer();
+
+// Draws visual game ID barcode for raw game ID data at the bottom of the screen
+void gsDrawBarcode(const uint8_t *data, int len);
+
 //---------------------------------------------------------------------------
-// GS_PACKET macros
-//---------------------------------------------------------------------------
-#define DECLARE_GS_PACKET(NAME, ITEMS)                                                                                                               \
-  uint64_t __attribute__((aligned(64))) NAME[ITEMS * 2 + 2];                                                                                         \
-  int NAME##_cur;                                                                                                                                    \
-  int NAME##_dma_size
+// GIF packet builder
+//---------------------------------------------------------------------------
+// Batches GS register writes, sprites and image transfer tags into a single GIF packet that is sent with one DMA transfer.
+// Consecutive items of the same kind share one GIF tag. The packet is sent early if the buffer runs out of space.
+typedef struct {
+  uint64_t *data;  // Packet buffer, must be aligned to 64 bytes
+  uint32_t size;   // Buffer size in 64-bit words
+  uint32_t cur;    // Current position in 64-bit words
+  uint32_t tag;    // Position of the last GIF tag
+  uint8_t tagType; // Type of the last GIF tag
+} GSPacket;
+
+// Declares a packet buffer for the specified number of qwords
+#define DECLARE_GS_PACKET_BUFFER(NAME, QWORDS) uint64_t __attribute__((aligned(64))) NAME[(QWORDS) * 2]
 
-#define BEGIN_GS_PACKET(NAME) NAME##_cur = 0
+// Initializes the packet with the buffer
+void gsPacketInit(GSPacket *packet, uint64_t *buffer, uint32_t qwords);
 
-#define GIF_TAG(NAME, NLOOP, EOP, PRE, PRIM, FLG, NREG, REGS)                                                                                        \
-  NAME##_dma_size = NLOOP + 1;                                                                                                                       \
-  NAME[NAME##_cur++] = ((uint64_t)(NLOOP) << 0) | ((uint64_t)(EOP) << 15) | ((uint64_t)(PRE) << 46) | ((uint64_t)(PRIM) << 47) |                     \
-                       ((uint64_t)(FLG) << 58) | ((uint64_t)(NREG) << 60);                                                                           \
-  NAME[NAME##_cur++] = (uint64_t)REGS
+// Appends a general purpose register write
+void gsPacketAddAD(GSPacket *packet, uint8_t reg, uint64_t value);
 
-#define GIF_TAG_AD(NAME, NLOOP, EOP, PRE, PRIM, FLG) GIF_TAG(NAME, NLOOP, EOP, PRE, PRIM, FLG, 1, 0x0e)
+// Appends a rectangle sprite
+void gsPacketAddSprite(GSPacket *packet, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z, uint64_t color);
 
-#define GIF_TAG_IMG(NAME, QSIZE)                                                                                                                     \
-  GIF_TAG(NAME, (QSIZE), 1, 0, 0, 2, 0, 0);                                                                                                          \
-  NAME##_dma_size = 1
+// Appends an IMAGE tag for the specified number of qwords. Image data must be sent right after the packet
+void gsPacketAddImageTag(GSPacket *packet, uint32_t qwords);
 
-#define GIF_DATA_AD(NAME, REG, DAT)                                                                                                                  \
-  NAME[NAME##_cur++] = (uint64_t)DAT;                                                                                                                \
-  NAME[NAME##_cur++] = (uint64_t)REG
+// Sends the packet to GS and resets it
+void gsPacketSend(GSPacket *packet);
 
-#define SEND_GS_PACKET(NAME)                                                                                                                         \
-  FlushCache(0);                                                                                                                                     \
-  SET_QWC(GIF_QWC, NAME##_dma_size);                                                                                                                 \
-  SET_MADR(GIF_MADR, NAME, 0);                                                                                                                       \
-  SET_CHCR(GIF_CHCR, 1, 0, 0, 0, 0, 1, 0);                                                                                                           \
-  DMA_WAIT(GIF_CHCR)
+//---------------------------------------------------------------------------
+// GIFtag
+//---------------------------------------------------------------------------
+#define GIF_FLG_PACKED 0
+#define GIF_FLG_REGLIST 1
+#define GIF_FLG_IMAGE 2
+#define GIF_REG_AD 0x0e
+#define GS_GIFTAG(NLOOP, EOP, PRE, PRIM, FLG, NREG)                                                                                                  \
+  (((uint64_t)(NLOOP) << 0) | ((uint64_t)(EOP) << 15) | ((uint64_t)(PRE) << 46) | ((uint64_t)(PRIM) << 47) | ((uint64_t)(FLG) << 58) |               \
+   ((uint64_t)(NREG) << 60))
 
 //---------------------------------------------------------------------------
 // GS Privileged Registers
@@ -111,9 +128,13 @@ void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z
 //---------------------------------------------------------------------------
 #define GS_REG_PRIM 0x00       // Select and configure current drawing primitive
 #define GS_REG_RGBAQ 0x01      // Setup current vertex color
+#define GS_REG_UV 0x03         // Set texel coordinate
 #define GS_REG_XYZ2 0x05       // Set vertex coordinate and 'kick' drawing
+#define GS_REG_TEX0_1 0x06     // Texture information (Context 1)
+#define GS_REG_TEX1_1 0x14     // Texture sampling settings (Context 1)
 #define GS_REG_XYOFFSET_1 0x18 // Mapping from Primitive to Window coordinate system (Context 1)
 #define GS_REG_SCISSOR_1 0x40  // Setup clipping rectangle (Context 1)
+#define GS_REG_TEXFLUSH 0x3f   // Wait for texture to be loaded
 #define GS_REG_FRAME_1 0x4c    // Frame buffer settings (Context 1)
 #define GS_REG_BITBLTBUF 0x50  // Setup Image Transfer Between EE and GS
 #define GS_REG_TRXPOS 0x51     // Setup Image Transfer Coordinates
@@ -142,6 +163,34 @@ void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z
 //---------------------------------------------------------------------------
 #define GS_XYZ2(X, Y, Z) (((uint64_t)(X) << 0) | ((uint64_t)(Y) << 16) | ((uint64_t)(Z) << 32))
 //---------------------------------------------------------------------------
+// UV Register
+//---------------------------------------------------------------------------
+#define GS_UV(U, V) (((uint64_t)(U) << 0) | ((uint64_t)(V) << 16))
+//---------------------------------------------------------------------------
+// TEX0_x Register - Texture information
+//   TBP0 - Texture base pointer (Address/256)
+//   TBW  - Texture buffer width (Texels/64)
+//   PSM  - Texture pixel format
+//   TW   - Texture width (log2)
+//   TH   - Texture height (log2)
+//   TCC  - Color component (0 = RGB, 1 = RGBA)
+//   TFX  - Texture function (0 = MODULATE, 1 = DECAL, 2 = HIGHLIGHT, 3 = HIGHLIGHT2)
+//   CBP  - CLUT base pointer (Address/256)
+//   CPSM - CLUT pixel format
+//   CSM  - CLUT storage mode
+//   CSA  - CLUT entry offset
+//   CLD  - CLUT buffer load control (1 = always load)
+//---------------------------------------------------------------------------
+#define GS_TEX0(TBP0, TBW, PSM, TW, TH, TCC, TFX, CBP, CPSM, CSM, CSA, CLD)                                                                          \
+  (((uint64_t)(TBP0) << 0) | ((uint64_t)(TBW) << 14) | ((uint64_t)(PSM) << 20) | ((uint64_t)(TW) << 26) | ((uint64_t)(TH) << 30) |                   \
+   ((uint64_t)(TCC) << 34) | ((uint64_t)(TFX) << 35) | ((uint64_t)(CBP) << 37) | ((uint64_t)(CPSM) << 51) | ((uint64_t)(CSM) << 55) |               \
+   ((uint64_t)(CSA) << 56) | ((uint64_t)(CLD) << 61))
+//---------------------------------------------------------------------------
+// Pixel storage formats
+//---------------------------------------------------------------------------
+#define GS_PSM_CT32 0x00
+#define GS_PSM_T8 0x13
+//---------------------------------------------------------------------------
 // XYOFFSET_x Register
 //---------------------------------------------------------------------------
 #define GS_XYOFFSET(OFX, OFY) (((uint64_t)(OFX) << 0) | ((uint64_t)(OFY) << 32))
@@ -208,6 +257,7 @@ void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z
 #define GS_REG_GIF_CHCR 0x1000a000 // GIF Channel Control Register
 #define GS_REG_GIF_MADR 0x1000a010 // Transfer Address Register
 #define GS_REG_GIF_QWC 0x1000a020  // Transfer Size Register (in qwords)
+#define GS_REG_GIF_TADR 0x1000a030 // Tag Address Register
 //---------------------------------------------------------------------------
 // CHCR Register - Channel Control Register
 //---------------------------------------------------------------------------
@@ -226,5 +276,20 @@ void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z
 //---------------------------------------------------------------------------
 #define GIF_QWC ((volatile uint32_t *)(GS_REG_GIF_QWC))
 #define SET_QWC(WHICH, SIZE) *WHICH = (uint32_t)(SIZE)
+//---------------------------------------------------------------------------
+// TADR Register - Tag Address Register
+//---------------------------------------------------------------------------
+#define GIF_TADR ((volatile uint32_t *)(GS_REG_GIF_TADR))
+#define SET_TADR(WHICH, ADDR, SPR) *WHICH = ((uint32_t)(ADDR) << 0) | ((uint32_t)(SPR) << 31)
+//---------------------------------------------------------------------------
+// DMAtag - Source Chain Tag
+//   QWC  - Number of qwords to transfer
+//   ID   - Tag ID (CNT = data follows the tag, REF = data at ADDR, END = data follows the tag, end of chain)
+//   ADDR - Data address for REF tags
+//---------------------------------------------------------------------------
+#define DMA_TAG_CNT 1
+#define DMA_TAG_REF 3
+#define DMA_TAG_END 7
+#define DMA_TAG(QWC, ID, ADDR) (((uint64_t)(QWC) << 0) | ((uint64_t)(ID) << 28) | ((uint64_t)(uint32_t)(uintptr_t)(ADDR) << 32))
 
 #endif
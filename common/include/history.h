@@ -6,4 +6,13 @@
 // Requires libcdvd to be initialized first
 int updateHistoryFile(const char *titleID);
 
+// Appends title ID to the launch history journal on the memory card in the specified port.
+// The journal is merged into history files by flushHistoryJournal.
+// Requires libcdvd to be initialized first
+int writeHistoryJournal(int port, const char *titleID);
+
+// Merges launch history journals from mc0 and mc1 into history files on both memory cards and deletes the journals.
+// Uses region letter from ROMVER to determine the system directory.
+int flushHistoryJournal(char romRegion);
+
 #endif
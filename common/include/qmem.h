@@ -0,0 +1,217 @@
+#ifndef _QMEM_H_
+#define _QMEM_H_
+// Quadword memory routines for bulk EE copies and fills.
+// On the EE, the 16-byte aligned part of the buffer is processed with 128-bit lq/sq, four quadwords per iteration.
+// Unaligned heads and tails, buffers with different alignment and non-EE builds use the portable C path (libc memset/memcpy).
+// Large aligned copies can be staged through the scratchpad with DMA (see qmemcpySPR).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MIPS_ARCH_R5900)
+#define QMEM_QWORD
+typedef unsigned int qword_t __attribute__((mode(TI)));
+
+// Fills [d, end) with the 64-bit pattern dw. d must be 16-byte aligned and end - d a multiple of 64
+static inline void qmemsetBlocks(uint8_t *d, uint8_t *end, uint64_t dw) {
+  // The 128-bit value must not leave the asm statement: GCC keeps 128-bit values in register pairs
+  // and would drop the upper half when passing it between statements.
+  // The loop is seven instructions long to stay clear of the R5900 short loop erratum
+  uint64_t q;
+  asm volatile(".set push\n"
+               ".set noreorder\n"
+               "pcpyld %0, %3, %3\n"
+               "1:\n"
+               "sq %0, 0(%1)\n"
+               "sq %0, 16(%1)\n"
+               "sq %0, 32(%1)\n"
+               "sq %0, 48(%1)\n"
+               "addiu %1, %1, 64\n"
+               "bne %1, %2, 1b\n"
+               "nop\n"
+               ".set pop\n"
+               : "=&r"(q), "+r"(d)
+               : "r"(end), "r"(dw)
+               : "memory");
+}
+
+// Copies size bytes from s to d. Both must be 16-byte aligned and size a multiple of 64
+static inline void qmemcpyBlocks(uint8_t *d, const uint8_t *s, size_t size) {
+  qword_t q0, q1, q2, q3;
+  for (; size; size -= 64, d += 64, s += 64)
+    asm volatile("lq %0, 0(%4)\n"
+                 "lq %1, 16(%4)\n"
+                 "lq %2, 32(%4)\n"
+                 "lq %3, 48(%4)\n"
+                 "sq %0, 0(%5)\n"
+                 "sq %1, 16(%5)\n"
+                 "sq %2, 32(%5)\n"
+                 "sq %3, 48(%5)\n"
+                 : "=&r"(q0), "=&r"(q1), "=&r"(q2), "=&r"(q3)
+                 : "r"(s), "r"(d)
+                 : "memory");
+}
+#elif defined(QMEM_HOST_MODEL)
+// Host tests provide the quadword loops to check the head/body/tail split
+#define QMEM_QWORD
+void qmemsetBlocks(uint8_t *d, uint8_t *end, uint64_t dw);
+void qmemcpyBlocks(uint8_t *d, const uint8_t *s, size_t size);
+#endif
+
+// Fills size bytes at dst with value
+static inline void qmemset(void *dst, uint8_t value, size_t size) {
+  uint8_t *d = dst;
+#ifdef QMEM_QWORD
+  size_t head = -(uintptr_t)d & 15;
+  if (size >= head + 64) {
+    memset(d, value, head);
+    d += head;
+    size -= head;
+
+    uint8_t *end = d + (size & ~63);
+    qmemsetBlocks(d, end, value * 0x0101010101010101ULL);
+    d = end;
+    size &= 63;
+  }
+#endif
+  memset(d, value, size);
+}
+
+// Copies size bytes from src to dst. The buffers must not overlap
+static inline void qmemcpy(void *dst, const void *src, size_t size) {
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+#ifdef QMEM_QWORD
+  size_t head = -(uintptr_t)d & 15;
+  // Quadword copy is only possible when both buffers have the same alignment
+  if (!(((uintptr_t)d ^ (uintptr_t)s) & 15) && (size >= head + 64)) {
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    size -= head;
+
+    qmemcpyBlocks(d, s, size & ~63);
+    d += size & ~63;
+    s += size & ~63;
+    size &= 63;
+  }
+#endif
+  memcpy(d, s, size);
+}
+
+// XORs every byte in buf with key and rotates it left by rot bits (0-7).
+// Uses 64-bit words because the EE has no variable-amount shifts for packed bytes
+static inline void qmemXorRotate(void *buf, uint8_t key, int rot, size_t size) {
+  typedef uint64_t __attribute__((may_alias)) u64alias;
+  uint8_t *b = buf;
+  for (; ((uintptr_t)b & 7) && size; size--, b++)
+    *b = ((*b ^ key) << rot) | ((*b ^ key) >> (8 - rot));
+
+  // Shifting the whole word moves bits between neighbouring bytes, mask them out
+  uint64_t k = key * 0x0101010101010101ULL;
+  uint64_t leftMask = (uint8_t)(0xff << rot) * 0x0101010101010101ULL;
+  for (; size >= 8; size -= 8, b += 8) {
+    uint64_t x = *(u64alias *)b ^ k;
+    *(u64alias *)b = ((x << rot) & leftMask) | ((x >> (8 - rot)) & ~leftMask);
+  }
+
+  for (; size; size--, b++)
+    *b = ((*b ^ key) << rot) | ((*b ^ key) >> (8 - rot));
+}
+
+// Minimum copy size for qmemcpySPR to use DMA
+#define QMEM_SPR_MIN_SIZE (16 * 1024)
+// Size of each of the two scratchpad buffers
+#define QMEM_SPR_CHUNK_SIZE (8 * 1024)
+
+#if defined(_MIPS_ARCH_R5900)
+#define QMEM_SPR
+#include <kernel.h>
+
+// fromSPR (channel 8) and toSPR (channel 9) DMA channel registers
+#define QMEM_DMA_FROMSPR 0x1000d000
+#define QMEM_DMA_TOSPR 0x1000d400
+#define QMEM_DMA_CHCR(ch) (*(volatile uint32_t *)((ch) + 0x00))
+#define QMEM_DMA_MADR(ch) (*(volatile uint32_t *)((ch) + 0x10))
+#define QMEM_DMA_QWC(ch) (*(volatile uint32_t *)((ch) + 0x20))
+#define QMEM_DMA_SADR(ch) (*(volatile uint32_t *)((ch) + 0x80))
+#define QMEM_DMA_CHCR_STR 0x100
+
+// Waits for the DMA channel to finish the transfer
+static inline void qmemDMAWait(uint32_t ch) {
+  while (QMEM_DMA_CHCR(ch) & QMEM_DMA_CHCR_STR) {
+  };
+}
+
+// Starts a normal mode transfer of size bytes between main memory and the scratchpad
+static inline void qmemDMAStart(uint32_t ch, const void *mem, uint32_t sprOffset, uint32_t size) {
+  QMEM_DMA_MADR(ch) = (uint32_t)mem & 0x1fffffff;
+  QMEM_DMA_SADR(ch) = sprOffset;
+  QMEM_DMA_QWC(ch) = size >> 4;
+  QMEM_DMA_CHCR(ch) = QMEM_DMA_CHCR_STR;
+}
+#elif defined(QMEM_HOST_MODEL)
+// Host tests provide the DMA channels to check the chunk sequencing
+#define QMEM_SPR
+#define QMEM_DMA_FROMSPR 8
+#define QMEM_DMA_TOSPR 9
+void FlushCache(int operation);
+void qmemDMAWait(uint32_t ch);
+void qmemDMAStart(uint32_t ch, const void *mem, uint32_t sprOffset, uint32_t size);
+#endif
+
+// Part of a scratchpad copy: len bytes at offset in both buffers, staged at sprOffset in the scratchpad
+typedef struct {
+  size_t offset;
+  uint32_t sprOffset;
+  uint32_t len;
+} QMemSPRChunk;
+
+// Returns chunk i of a dmaSize-byte scratchpad copy. Even chunks use the first scratchpad buffer and odd chunks the second one.
+// len is 0 past the end of the copy
+static inline QMemSPRChunk qmemSPRChunk(size_t dmaSize, size_t i) {
+  QMemSPRChunk chunk = {i * QMEM_SPR_CHUNK_SIZE, (i & 1) * QMEM_SPR_CHUNK_SIZE, 0};
+  if (chunk.offset < dmaSize)
+    chunk.len = (dmaSize - chunk.offset < QMEM_SPR_CHUNK_SIZE) ? dmaSize - chunk.offset : QMEM_SPR_CHUNK_SIZE;
+  return chunk;
+}
+
+// Copies size bytes from src to dst. The buffers must not overlap.
+// Copies of at least QMEM_SPR_MIN_SIZE bytes between 16-byte aligned buffers are moved through the scratchpad by the DMA,
+// in QMEM_SPR_CHUNK_SIZE chunks: while fromSPR drains one scratchpad buffer into dst, toSPR fills the other one from src.
+// Uses the whole scratchpad and writes back the data cache
+static inline void qmemcpySPR(void *dst, const void *src, size_t size) {
+  uint8_t *d = dst;
+  const uint8_t *s = src;
+#ifdef QMEM_SPR
+  if ((size >= QMEM_SPR_MIN_SIZE) && !(((uintptr_t)d | (uintptr_t)s) & 15)) {
+    size_t dmaSize = size & ~15;
+    // Make sure the DMA reads the actual source data and no dirty cache lines overwrite the destination later
+    FlushCache(0);
+
+    size_t chunkCount = (dmaSize + QMEM_SPR_CHUNK_SIZE - 1) / QMEM_SPR_CHUNK_SIZE;
+    for (size_t i = 0; i <= chunkCount; i++) {
+      // The buffer for chunk i is free once chunk i - 2 is drained, chunk i - 1 can be drained once it's staged
+      qmemDMAWait(QMEM_DMA_FROMSPR);
+      qmemDMAWait(QMEM_DMA_TOSPR);
+
+      QMemSPRChunk chunk = qmemSPRChunk(dmaSize, i);
+      if (chunk.len)
+        qmemDMAStart(QMEM_DMA_TOSPR, s + chunk.offset, chunk.sprOffset, chunk.len);
+      if (i > 0) {
+        chunk = qmemSPRChunk(dmaSize, i - 1);
+        qmemDMAStart(QMEM_DMA_FROMSPR, d + chunk.offset, chunk.sprOffset, chunk.len);
+      }
+    }
+    qmemDMAWait(QMEM_DMA_FROMSPR);
+
+    d += dmaSize;
+    s += dmaSize;
+    size -= dmaSize;
+  }
+#endif
+  qmemcpy(d, s, size);
+}
+
+#endif
@@ -15,6 +15,8 @@
 
 // Attempts to guess PS1 title ID from volume creation date stored in PVD
 const char *getPS1GenericTitleID();
+// Unpacks the title ID code from the game ID table
+static const char *decodeGameID(uint32_t code);
 
 // Parses the SYSTEM.CNF file with support for OSDMenu PATINFO extensions
 // Returns the executable type or a PIExecType_Error if an error occurs.
@@ -213,15 +215,47 @@ const char *getPS1GenericTitleID() {
     return NULL;
   }
 
-  // Try to match the volume creation date at offset 0x32D against the table
-  for (size_t i = 0; i < sizeof(gameIDTable) / sizeof(gameIDTable[0]); ++i) {
-    if (strncmp(&sectorData[0x32D], gameIDTable[i].volumeTimestamp, 16) == 0) {
-      return gameIDTable[i].gameID;
-    }
+  // Convert the volume creation date at offset 0x32D into an integer
+  uint64_t timestamp = 0;
+  for (int i = 0; i < 16; i++) {
+    char c = sectorData[0x32D + i];
+    if (c < '0' || c > '9')
+      return NULL;
+    timestamp = timestamp * 10 + (c - '0');
+  }
+
+  // Look up the timestamp in the table
+  int low = 0;
+  int high = GAME_ID_TABLE_SIZE - 1;
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    if (gameIDTimestamps[mid] < timestamp)
+      low = mid + 1;
+    else if (gameIDTimestamps[mid] > timestamp)
+      high = mid - 1;
+    else
+      return decodeGameID(gameIDCodes[mid]);
   }
   return NULL;
 }
 
+// Unpacks the title ID code into XXXX_YYY.ZZ format
+static const char *decodeGameID(uint32_t code) {
+  static char gameID[12];
+  uint32_t number = code & 0x1FFFF;
+
+  memcpy(gameID, gameIDPrefixes[code >> 17], 4);
+  gameID[4] = '_';
+  gameID[5] = '0' + (number / 10000) % 10;
+  gameID[6] = '0' + (number / 1000) % 10;
+  gameID[7] = '0' + (number / 100) % 10;
+  gameID[8] = '.';
+  gameID[9] = '0' + (number / 10) % 10;
+  gameID[10] = '0' + number % 10;
+  gameID[11] = '\0';
+  return gameID;
+}
+
 // Attempts to generate a title ID from path
 char *generateTitleID(char *path) {
   if (!path)
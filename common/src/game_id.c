@@ -1,15 +1,20 @@
 #include "dprintf.h"
+#include "gs.h"
 #include "history.h"
-#include <dmaKit.h>
-#include <gsKit.h>
+#include <fcntl.h>
 #include <kernel.h>
 #include <libcdvd.h>
 #include <stdint.h>
+#include <string.h>
+#include <unistd.h>
 
 //
 // GameID code based on https://github.com/CosmicScale/Retro-GEM-PS2-Disc-Launcher
 //
 
+// Max game ID data length: 4 header bytes, up to 11 title ID characters and 3 trailer bytes
+#define GAMEID_MAX_DATA_LEN 18
+
 static uint8_t calculateCRC(const uint8_t *data, int len) {
   uint8_t crc = 0x00;
   for (int i = 0; i < len; i++) {
@@ -18,31 +23,24 @@ static uint8_t calculateCRC(const uint8_t *data, int len) {
   return 0x100 - crc;
 }
 
+// Returns the video mode matching the console region
+static GSVideoMode getVideoMode() {
+  char romver[5] = {0};
+  int fd = open("rom0:ROMVER", O_RDONLY);
+  if (fd >= 0) {
+    read(fd, romver, sizeof(romver));
+    close(fd);
+  }
+  return (romver[4] == 'E') ? GS_MODE_PAL : GS_MODE_NTSC;
+}
+
 // Initializes GS and displays visual game ID
 void gsDisplayGameID(const char *gameID) {
-  GSGLOBAL *gsGlobal = gsKit_init_global();
-  gsGlobal->DoubleBuffering = GS_SETTING_ON;
-
-  dmaKit_init(D_CTRL_RELE_OFF, D_CTRL_MFD_OFF, D_CTRL_STS_UNSPEC, D_CTRL_STD_OFF, D_CTRL_RCYC_8, 1 << DMA_CHANNEL_GIF);
-
-  // Initialize the DMAC
-  int res;
-  if ((res = dmaKit_chan_init(DMA_CHANNEL_GIF)))
-    return;
-
-  // Init screen
-  gsKit_init_screen(gsGlobal);
-  if (!gameID) {
-    // Deinit gsKit and return if there's nothing to draw
-    gsKit_deinit_global(gsGlobal);
+  gsInit(getVideoMode());
+  if (!gameID)
     return;
-  }
 
-  gsKit_display_buffer(gsGlobal); // Switch display buffer to avoid garbage appearing on screen
-  gsKit_mode_switch(gsGlobal, GS_ONESHOT);
-  gsKit_clear(gsGlobal, GS_SETREG_RGBA(0x00, 0x00, 0x00, 0x00));
-
-  uint8_t data[64] = {0};
+  uint8_t data[GAMEID_MAX_DATA_LEN] = {0};
   int gidlen = strnlen(gameID, 11); // Ensure the length does not exceed 11 characters
 
   int dpos = 0;
@@ -61,26 +59,7 @@ void gsDisplayGameID(const char *gameID) {
   int data_len = dpos;
   data[2] = calculateCRC(&data[3], data_len - 3);
 
-  int xstart = (gsGlobal->Width / 2) - (data_len * 8);
-  int ystart = gsGlobal->Height - (((gsGlobal->Height / 8) * 2) + 20);
-  int height = 2;
-
-  for (int i = 0; i < data_len; i++) {
-    for (int j = 7; j >= 0; j--) {
-      int x = xstart + (i * 16 + ((7 - j) * 2));
-      int x1 = x + 1;
-      gsKit_prim_sprite(gsGlobal, x, ystart, x1, ystart + height, 0, GS_SETREG_RGBA(0xFF, 0x00, 0xFF, 0x00));
-
-      uint32_t color = (data[i] >> j) & 1 ? GS_SETREG_RGBA(0x00, 0xFF, 0xFF, 0x00) : GS_SETREG_RGBA(0xFF, 0xFF, 0x00, 0x00);
-      gsKit_prim_sprite(gsGlobal, x1, ystart, x1 + 1, ystart + height, 0, color);
-    }
-  }
-
-  // Execute the queue
-  gsKit_queue_exec(gsGlobal);
-  gsKit_finish();
-  gsKit_sync_flip(gsGlobal);
-  gsKit_deinit_global(gsGlobal);
+  gsDrawBarcode(data, data_len);
 }
 
 // Returns 1 if ID is a valid PS2 title ID
@@ -0,0 +1,347 @@
+// GS functions
+// Based on code by Tony Saveski, t_saveski@yahoo.com
+#include "gs.h"
+#include <dma.h>
+#include <kernel.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+  GSVideoMode mode;
+  uint16_t width;
+  uint16_t height;
+  uint16_t psm;
+  uint16_t bpp;
+  uint16_t magh;
+} vmode_t;
+
+vmode_t vmodes[] = {
+    {GS_MODE_PAL, 640, 512, 0, 32, 4},  // PAL
+    {GS_MODE_NTSC, 640, 448, 0, 32, 4}, // NTSC
+};
+
+// Max coordinates for currently initialized video mode
+static uint16_t gsMaxX = 0;
+static uint16_t gsMaxY = 0;
+
+// GIF tag types used by the packet builder
+enum {
+  GS_TAG_NONE,
+  GS_TAG_AD,
+  GS_TAG_SPRITE,
+  GS_TAG_IMAGE,
+};
+
+// Shared packet buffer, large enough to fit the longest visual game ID barcode
+#define GS_PACKET_QWORDS 224
+DECLARE_GS_PACKET_BUFFER(gsPacketBuf, GS_PACKET_QWORDS);
+static GSPacket gsPacket;
+
+static uint32_t gsPacketClose(GSPacket *packet);
+
+// Resets and initializes GS
+int gsInit(GSVideoMode vmode) {
+  vmode_t *mode;
+
+  if (vmode == GS_MODE_PAL)
+    mode = &vmodes[0];
+  else
+    mode = &vmodes[1];
+
+  // A transfer kicked after the previous gsInit call (e.g. the splash screen) may still be running.
+  // Let it finish instead of aborting it with the DMA reset
+  if (gsMaxX)
+    gsWaitTransfer();
+
+  gsMaxX = mode->width - 1;
+  gsMaxY = mode->height - 1;
+
+  // Reset DMA
+  dma_reset();
+  // Reset GS
+  *(volatile uint64_t *)GS_REG_CSR = 0x200;
+  // Mask interrupts
+  GsPutIMR(0xff00);
+  // Configure GS CRT
+  SetGsCrt(1, mode->mode, 0);
+
+  GS_SET_PMODE(0,   // ReadCircuit1 OFF
+               1,   // ReadCircuit2 ON
+               1,   // Use ALP register for Alpha Blending
+               1,   // Alpha Value of ReadCircuit2 for output selection
+               0,   // Blend Alpha with the output of ReadCircuit2
+               0xFF // Alpha Value = 1.0
+  );
+
+  GS_SET_DISPFB2(0,                // Frame Buffer base pointer = 0 (Address/2048)
+                 mode->width / 64, // Buffer Width (Address/64)
+                 mode->psm,        // Pixel Storage Format
+                 0,                // Upper Left X in Buffer = 0
+                 0                 // Upper Left Y in Buffer = 0
+  );
+
+  GS_SET_DISPLAY2(656,                          // X position in the display area (in VCK units)
+                  36,                           // Y position in the display area (in Raster units)
+                  mode->magh - 1,               // Horizontal Magnification - 1
+                  0,                            // Vertical Magnification = 1x
+                  mode->width * mode->magh - 1, // Display area width  - 1 (in VCK units) (Width*HMag-1)
+                  mode->height - 1              // Display area height - 1 (in pixels)	  (Height-1)
+  );
+
+  GS_SET_BGCOLOR(0, 0, 0);
+
+  gsPacketInit(&gsPacket, gsPacketBuf, GS_PACKET_QWORDS);
+
+  gsPacketAddAD(&gsPacket, GS_REG_FRAME_1,
+                GS_FRAME(0,                // FrameBuffer base pointer = 0 (Address/2048)
+                         mode->width / 64, // Frame buffer width (Pixels/64)
+                         mode->psm,        // Pixel Storage Format
+                         0));
+
+  // No displacement between Primitive and Window coordinate systems.
+  gsPacketAddAD(&gsPacket, GS_REG_XYOFFSET_1, GS_XYOFFSET(0x0, 0x0));
+  // Clip to frame buffer.
+  gsPacketAddAD(&gsPacket, GS_REG_SCISSOR_1, GS_SCISSOR(0, gsMaxX, 0, gsMaxY));
+  // Clear the screen
+  gsPacketAddSprite(&gsPacket, 0, 0, (gsMaxX + 1), (gsMaxY + 1), 0, GS_RGBAQ(0, 0, 0, 0, 0));
+
+  gsPacketSend(&gsPacket);
+
+  return 1;
+}
+
+// Draws a black rectangle over the whole screen
+void gsClearScreen() { gsDrawSprite(0, 0, (gsMaxX + 1), (gsMaxY + 1), 0, GS_RGBAQ(0, 0, 0, 0, 0)); }
+
+// Returns the max X coordinate for currently initialized video mode
+uint16_t gsGetMaxX() { return gsMaxX + 1; }
+// Returns the max Y coordinate for currently initialized video mode
+uint16_t gsGetMaxY() { return gsMaxY + 1; }
+
+// Draws a simple rectangle sprite
+void gsDrawSprite(uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z, uint64_t color) {
+  gsPacketAddSprite(&gsPacket, x1, y1, x2, y2, z, color);
+  gsPacketSend(&gsPacket);
+}
+
+// Draws visual game ID barcode for raw game ID data at the bottom of the screen
+void gsDrawBarcode(const uint8_t *data, int len) {
+  int xstart = (gsGetMaxX() / 2) - (len * 8);
+  int ystart = gsGetMaxY() - (((gsGetMaxY() / 8) * 2) + 20);
+  int height = 2;
+
+  // Every bit is a magenta separator pixel followed by a cyan (1) or yellow (0) pixel.
+  // Draw a single magenta strip and put bit pixels on top of it
+  gsPacketAddSprite(&gsPacket, xstart, ystart, xstart + len * 16, ystart + height, 0, GS_RGBAQ(0xFF, 0x00, 0xFF, 0x00, 0x00));
+  for (int i = 0; i < len; i++) {
+    for (int j = 7; j >= 0; j--) {
+      int x1 = xstart + (i * 16 + ((7 - j) * 2)) + 1;
+      if ((data[i] >> j) & 1)
+        gsPacketAddSprite(&gsPacket, x1, ystart, x1 + 1, ystart + height, 0, GS_RGBAQ(0x00, 0xFF, 0xFF, 0x00, 0x00));
+      else
+        gsPacketAddSprite(&gsPacket, x1, ystart, x1 + 1, ystart + height, 0, GS_RGBAQ(0xFF, 0xFF, 0x00, 0x00, 0x00));
+    }
+  }
+  gsPacketSend(&gsPacket);
+}
+
+// Waits for the pending GIF transfer to complete
+void gsWaitTransfer() { DMA_WAIT(GIF_CHCR); }
+
+#define MAX_TRANSFER 16384
+
+// GS memory layout for bitmaps: the CLUT and the texture are placed right after the largest frame buffer (640x512, 32-bit)
+#define GS_CLUT_BP 5120
+#define GS_TEXTURE_BP (GS_CLUT_BP + 32)
+
+// DMA chain used for bitmap uploads. Only the GIF packets live in the chain, image data is referenced in place
+#define GS_CHAIN_QWORDS 64
+DECLARE_GS_PACKET_BUFFER(gsChainBuf, GS_CHAIN_QWORDS);
+static uint32_t gsChainCur;    // Current chain position in qwords
+static GSPacket gsChainPacket; // Packet following the current CNT/END tag
+
+// Starts a new GIF packet in the chain right after the space reserved for its DMA tag
+static GSPacket *gsChainOpen() {
+  gsPacketInit(&gsChainPacket, &gsChainBuf[(gsChainCur + 1) * 2], GS_CHAIN_QWORDS - gsChainCur - 1);
+  return &gsChainPacket;
+}
+
+// Finishes the GIF packet and writes its DMA tag
+static void gsChainClose(uint8_t id) {
+  uint32_t qwc = gsPacketClose(&gsChainPacket);
+  gsChainBuf[gsChainCur * 2] = DMA_TAG(qwc, id, 0);
+  gsChainBuf[gsChainCur * 2 + 1] = 0;
+  gsChainCur += qwc + 1;
+}
+
+// Appends a tag that transfers the data in place
+static void gsChainAddRef(uint8_t *data, uint32_t qwc) {
+  gsChainBuf[gsChainCur * 2] = DMA_TAG(qwc, DMA_TAG_REF, data);
+  gsChainBuf[gsChainCur * 2 + 1] = 0;
+  gsChainCur++;
+}
+
+// Adds image transfer to GS' memory to the chain
+static void gsChainUploadImage(uint32_t dbp, uint8_t dbw, uint8_t dpsm, uint16_t w, uint16_t h, uint32_t qtotal, uint8_t *data) {
+  uint32_t current; // number of qwords to transfer in current chunk
+
+  GSPacket *packet = gsChainOpen();
+  gsPacketAddAD(packet, GS_REG_BITBLTBUF, GS_BITBLTBUF(0, 0, 0, dbp, dbw, dpsm));
+  gsPacketAddAD(packet, GS_REG_TRXPOS, GS_TRXPOS(0, 0, 0, 0, 0)); // left to right/top to bottom
+  gsPacketAddAD(packet, GS_REG_TRXREG, GS_TRXREG(w, h));
+  gsPacketAddAD(packet, GS_REG_TRXDIR, GS_TRXDIR(XDIR_EE_GS));
+
+  while (qtotal) {
+    current = (qtotal > MAX_TRANSFER) ? MAX_TRANSFER : qtotal;
+    gsPacketAddImageTag(packet, current);
+    gsChainClose(DMA_TAG_CNT);
+    gsChainAddRef(data, current);
+
+    data += current * 16;
+    qtotal -= current;
+    if (qtotal)
+      packet = gsChainOpen();
+  }
+}
+
+// Transfers 8-bit palettized bitmap image and its CLUT to GS' memory and draws it on screen at specified coordinates.
+// Bitmap rows must be padded to 16 pixels, the CLUT must contain 256 entries in CSM1 order.
+// The transfer runs in the background: image data must stay intact until gsWaitTransfer returns
+void gsPrintBitmap(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data, uint32_t *clut) {
+  uint16_t stride = (w + 15) & ~15;
+  uint8_t tbw = ((stride + 127) / 128) * 2; // PSMT8 buffer width must be a multiple of 128 pixels
+
+  // Make sure the previous chain is no longer in use
+  gsWaitTransfer();
+  gsChainCur = 0;
+
+  // 256-entry CLUT is stored as a 16x16 32-bit image
+  gsChainUploadImage(GS_CLUT_BP, 1, GS_PSM_CT32, 16, 16, 64, (uint8_t *)clut);
+  gsChainUploadImage(GS_TEXTURE_BP, tbw, GS_PSM_T8, stride, h, stride * h / 16, data);
+
+  // Texture dimensions must be specified as powers of 2
+  uint8_t tw = 0;
+  uint8_t th = 0;
+  while ((1 << tw) < w)
+    tw++;
+  while ((1 << th) < h)
+    th++;
+
+  // Draw a textured sprite, taking texel colors as is
+  GSPacket *packet = gsChainOpen();
+  gsPacketAddAD(packet, GS_REG_TEXFLUSH, 0);
+  gsPacketAddAD(packet, GS_REG_TEX0_1, GS_TEX0(GS_TEXTURE_BP, tbw, GS_PSM_T8, tw, th, 0, 1, GS_CLUT_BP, GS_PSM_CT32, 0, 0, 1));
+  gsPacketAddAD(packet, GS_REG_TEX1_1, 0); // Nearest neighbor sampling
+  gsPacketAddAD(packet, GS_REG_PRIM, GS_PRIM(PRIM_SPRITE, 0, 1, 0, 0, 0, 1, 0, 0));
+  gsPacketAddAD(packet, GS_REG_UV, GS_UV(0, 0));
+  gsPacketAddAD(packet, GS_REG_XYZ2, GS_XYZ2(x << 4, y << 4, 0));
+  gsPacketAddAD(packet, GS_REG_UV, GS_UV(w << 4, h << 4));
+  gsPacketAddAD(packet, GS_REG_XYZ2, GS_XYZ2((x + w) << 4, (y + h) << 4, 0));
+  gsChainClose(DMA_TAG_END);
+
+  // Kick the whole chain at once without waiting for it to complete
+  FlushCache(0);
+  SET_QWC(GIF_QWC, 0);
+  SET_TADR(GIF_TADR, gsChainBuf, 0);
+  SET_CHCR(GIF_CHCR, 1, 1, 0, 0, 0, 1, 0);
+}
+
+//
+// GIF packet builder
+//
+
+// Initializes the packet with the buffer
+void gsPacketInit(GSPacket *packet, uint64_t *buffer, uint32_t qwords) {
+  packet->data = buffer;
+  packet->size = qwords * 2;
+  packet->cur = 0;
+  packet->tag = 0;
+  packet->tagType = GS_TAG_NONE;
+}
+
+// Pads the register list to the qword boundary
+static inline void gsPacketAlign(GSPacket *packet) {
+  if (packet->cur & 1)
+    packet->data[packet->cur++] = 0;
+}
+
+// Makes sure the packet has enough space for the specified number of 64-bit words plus the alignment padding.
+// Sends the packet if it doesn't
+static inline void gsPacketReserve(GSPacket *packet, uint32_t words) {
+  if (packet->cur + words + 1 > packet->size)
+    gsPacketSend(packet);
+}
+
+// Starts a new GIF tag
+static inline void gsPacketOpenTag(GSPacket *packet, uint8_t type, uint64_t tag, uint64_t regs) {
+  gsPacketAlign(packet);
+  packet->tag = packet->cur;
+  packet->tagType = type;
+  packet->data[packet->cur++] = tag;
+  packet->data[packet->cur++] = regs;
+}
+
+// Appends a general purpose register write
+void gsPacketAddAD(GSPacket *packet, uint8_t reg, uint64_t value) {
+  if (packet->tagType != GS_TAG_AD) {
+    gsPacketReserve(packet, 4);
+    gsPacketOpenTag(packet, GS_TAG_AD, GS_GIFTAG(0, 0, 0, 0, GIF_FLG_PACKED, 1), GIF_REG_AD);
+  } else if (packet->cur + 2 > packet->size) {
+    gsPacketSend(packet);
+    gsPacketOpenTag(packet, GS_TAG_AD, GS_GIFTAG(0, 0, 0, 0, GIF_FLG_PACKED, 1), GIF_REG_AD);
+  }
+
+  packet->data[packet->cur++] = value;
+  packet->data[packet->cur++] = reg;
+  packet->data[packet->tag]++; // Increment NLOOP
+}
+
+// Appends a rectangle sprite
+void gsPacketAddSprite(GSPacket *packet, uint16_t x1, uint16_t y1, uint16_t x2, uint16_t y2, uint16_t z, uint64_t color) {
+  if (packet->tagType != GS_TAG_SPRITE || packet->cur + 3 > packet->size) {
+    // Select the primitive and start a register list with RGBAQ, XYZ2 and XYZ2 for every sprite
+    gsPacketReserve(packet, 9);
+    gsPacketAddAD(packet, GS_REG_PRIM, GS_PRIM(PRIM_SPRITE, 0, 0, 0, 0, 0, 0, 0, 0));
+    gsPacketOpenTag(packet, GS_TAG_SPRITE, GS_GIFTAG(0, 0, 0, 0, GIF_FLG_REGLIST, 3), GS_REG_RGBAQ | (GS_REG_XYZ2 << 4) | (GS_REG_XYZ2 << 8));
+  }
+
+  packet->data[packet->cur++] = color;
+  packet->data[packet->cur++] = GS_XYZ2(x1 << 4, y1 << 4, z);
+  packet->data[packet->cur++] = GS_XYZ2(x2 << 4, y2 << 4, z);
+  packet->data[packet->tag]++; // Increment NLOOP
+}
+
+// Appends an IMAGE tag for the specified number of qwords. Image data must be sent right after the packet
+void gsPacketAddImageTag(GSPacket *packet, uint32_t qwords) {
+  gsPacketReserve(packet, 2);
+  gsPacketOpenTag(packet, GS_TAG_IMAGE, GS_GIFTAG(qwords, 0, 0, 0, GIF_FLG_IMAGE, 0), 0);
+}
+
+// Finishes the packet and returns its size in qwords
+static uint32_t gsPacketClose(GSPacket *packet) {
+  if (!packet->cur)
+    return 0;
+
+  gsPacketAlign(packet);
+  packet->data[packet->tag] |= GS_GIFTAG(0, 1, 0, 0, 0, 0); // Set EOP on the last tag
+  return packet->cur / 2;
+}
+
+// Sends the packet to GS and resets it
+void gsPacketSend(GSPacket *packet) {
+  uint32_t qwc = gsPacketClose(packet);
+  if (!qwc)
+    return;
+
+  // Wait for the pending transfer
+  gsWaitTransfer();
+
+  FlushCache(0);
+  SET_QWC(GIF_QWC, qwc);
+  SET_MADR(GIF_MADR, packet->data, 0);
+  SET_CHCR(GIF_CHCR, 1, 0, 0, 0, 0, 1, 0);
+  DMA_WAIT(GIF_CHCR);
+
+  packet->cur = 0;
+  packet->tagType = GS_TAG_NONE;
+}
@@ -1,8 +1,10 @@
 // This code is a heavily modified version of OPL OSDHistory.c with unneeded bits removed
 #include "history.h"
+#include "defaults.h"
 #include "dprintf.h"
 #include <errno.h>
 #include <fcntl.h>
+#include <io_common.h>
 #include <libcdvd.h>
 #include <libmc.h>
 #include <ps2sdkapi.h>
@@ -14,6 +16,8 @@
 // Target history file size
 #define MAX_HISTORY_ENTRIES 21
 #define HISTORY_FILE_SIZE MAX_HISTORY_ENTRIES * sizeof(struct historyListEntry)
+// History entry offset in the history file
+#define HISTORY_ENTRY_OFFSET(slot) ((slot) * sizeof(struct historyListEntry))
 // Macros for getting the timestamp
 #define OSD_HISTORY_SET_DATE(year, month, date) (((uint16_t)(year)) << 9 | ((uint16_t)(month) & 0xF) << 5 | ((date) & 0x1F))
 
@@ -26,36 +30,107 @@ struct historyListEntry {
   uint16_t timestamp;
 };
 
+// Maximum number of evicted entries kept in history.old
+#ifndef HISTORY_OLD_MAX_ENTRIES
+#define HISTORY_OLD_MAX_ENTRIES 128
+#endif
+// history.old ring buffer header magic.
+// Starts with a null byte so the header looks like a blank entry to anything that reads history.old as an entry list
+#define HISTORY_OLD_MAGIC "\0OSDMHISTRING\0\0"
+// Entry offset in the history.old file
+#define HISTORY_OLD_ENTRY_OFFSET(slot) (sizeof(struct historyOldHeader) + (slot) * sizeof(struct historyListEntry))
+
+// history.old ring buffer header, has the same size as the history entry
+struct historyOldHeader {
+  char magic[16];
+  uint16_t head;     // Index of the entry that will be overwritten next
+  uint16_t capacity; // Maximum number of entries in the ring
+  uint8_t padding[2];
+};
+
+// Maximum number of records in the launch history journal
+#define HISTORY_JOURNAL_MAX_RECORDS 16
+
+// Launch history journal record
+struct historyJournalRecord {
+  char titleID[16];
+  uint16_t timestamp;
+  uint16_t padding;
+};
+
 // Sony OSD has the icon size fixed at 1776 bytes
 // Icons of any other size show up as corrupted data
 #define ICON_SYS_SIZE 1776
 
+// History update steps for a single memory card.
+// Steps between GetInfo and CloseWrite are issued through libmc without waiting
+// for completion, so the commands for both cards can be interleaved
+typedef enum {
+  HistoryStep_GetInfo,
+  HistoryStep_OpenRead,
+  HistoryStep_Read,
+  HistoryStep_CloseRead,
+  HistoryStep_Process,   // EE-side processing, can run while the other card is busy
+  HistoryStep_CreateDir, // Blocking, only issued when no other command is in flight
+  HistoryStep_Evict,     // Blocking, only issued when no other command is in flight
+  HistoryStep_OpenWrite,
+  HistoryStep_Seek, // Only used when updating a single entry in place
+  HistoryStep_Write,
+  HistoryStep_CloseWrite,
+  HistoryStep_Done,
+} HistoryStep;
+
+// History update context for a single memory card
+typedef struct {
+  int port;
+  HistoryStep step;
+  int fd;
+  int mcType;
+  int mcFormat;
+  int createDir;                        // Set when the history file doesn't exist
+  int fullWrite;                        // Set when the whole history file needs to be rewritten
+  int slot;                             // Slot that was updated by processHistoryList
+  struct historyListEntry evictedEntry; // Copy of the evicted entry. Title ID is empty if nothing was evicted
+  struct historyListEntry historyList[MAX_HISTORY_ENTRIES] __attribute__((aligned(64)));
+} historyCardContext;
+
 static inline int initSystemDataDir(void);
-void processHistoryList(const char *titleID, struct historyListEntry *historyList);
-int evictEntry(const struct historyListEntry *evictedhistoryEntry);
+static void setSystemDataDirRegion(char romRegion);
+int processHistoryList(const char *titleID, uint16_t timestamp, struct historyListEntry *historyList, struct historyListEntry *evictedEntry);
+int evictEntry(int port, const struct historyListEntry *evictedhistoryEntry);
 static uint16_t getTimestamp(void);
 
 // The 'X' in "BXDATA-SYSTEM" will be replaced with region-specific letter by initSystemDataDir
-// The 'X' in "mcX" will be replaced with memory card number in updateHistoryFile
-static char historyFilePath[] = "mcX:/BXDATA-SYSTEM/history";
+static char historyFilePath[] = "/BXDATA-SYSTEM/history";
 extern unsigned char icon_J_sys[];
 extern unsigned char icon_C_sys[];
 extern unsigned char icon_A_sys[];
 
-int createSystemDataDir() {
+// Waits for the libmc command to complete and returns its result
+static int mcWaitResult(int ret) {
+  if (ret < 0)
+    return ret; // Command wasn't issued
+
+  mcSync(MC_WAIT, NULL, &ret);
+  return ret;
+}
+
+// Creates the system data directory and icon.sys on the memory card.
+// Blocks until done, must not be called while another libmc command is in flight
+int createSystemDataDir(int port) {
   char iconPath[64];
   int fd, result;
   void *icon;
 
-  // Temporarily end historyFilePath at mcX:/BXDATA-SYSTEM
-  historyFilePath[18] = '\0';
+  // Temporarily end historyFilePath at /BXDATA-SYSTEM
+  historyFilePath[14] = '\0';
   // Open icon.sys
   sprintf(iconPath, "%s/icon.sys", historyFilePath);
-  if ((fd = open(iconPath, O_RDONLY)) < 0) {
+  if ((fd = mcWaitResult(mcOpen(port, 0, iconPath, FIO_O_RDONLY))) < 0) {
     // If icon.sys doesn't exist, create it
-    mkdir(historyFilePath, 0777);
-    if ((fd = open(iconPath, O_CREAT | O_TRUNC | O_WRONLY)) >= 0) {
-      switch (historyFilePath[6]) {
+    mcWaitResult(mcMkDir(port, 0, historyFilePath));
+    if ((fd = mcWaitResult(mcOpen(port, 0, iconPath, FIO_O_CREAT | FIO_O_TRUNC | FIO_O_WRONLY))) >= 0) {
+      switch (historyFilePath[2]) {
       case 'I':
         icon = icon_J_sys;
         break;
@@ -67,20 +142,202 @@ int createSystemDataDir() {
         break;
       }
       // Write past the end of the icon (see the comment for ICON_SYS_SIZE).
-      result = write(fd, icon, ICON_SYS_SIZE) == ICON_SYS_SIZE ? 0 : -EIO;
-      close(fd);
+      result = mcWaitResult(mcWrite(fd, icon, ICON_SYS_SIZE)) == ICON_SYS_SIZE ? 0 : -EIO;
+      mcWaitResult(mcClose(fd));
     } else
       result = fd;
   } else {
-    close(fd);
+    mcWaitResult(mcClose(fd));
     result = 0;
   }
 
   // Restore full historyFilePath
-  historyFilePath[18] = '/';
+  historyFilePath[14] = '/';
   return result;
 }
 
+// Returns 1 if the step requires the card to issue a libmc command
+static inline int isHistoryStepIssuable(historyCardContext *card) { return (card->step != HistoryStep_Done) && (card->step != HistoryStep_Process); }
+
+// Issues the libmc command for the current step.
+// Returns 1 if the command is in flight, 0 if the step was completed without issuing a command
+static int issueHistoryStep(historyCardContext *card) {
+  int res = -1;
+  switch (card->step) {
+  case HistoryStep_GetInfo:
+    res = mcGetInfo(card->port, 0, &card->mcType, NULL, &card->mcFormat);
+    break;
+  case HistoryStep_OpenRead:
+    res = mcOpen(card->port, 0, historyFilePath, FIO_O_RDONLY);
+    break;
+  case HistoryStep_Read:
+    res = mcRead(card->fd, card->historyList, HISTORY_FILE_SIZE);
+    break;
+  case HistoryStep_CloseRead:
+  case HistoryStep_CloseWrite:
+    res = mcClose(card->fd);
+    break;
+  case HistoryStep_CreateDir:
+    DPRINTF("History file at mc%d does not exist, creating system directory\n", card->port);
+    if (createSystemDataDir(card->port)) {
+      DPRINTF("WARN: Failed to create system directory\n");
+      card->step = HistoryStep_Done;
+    } else
+      card->step = (card->evictedEntry.titleID[0] == '\0') ? HistoryStep_OpenWrite : HistoryStep_Evict;
+    return 0;
+  case HistoryStep_Evict:
+    if ((res = evictEntry(card->port, &card->evictedEntry)) < 0)
+      DPRINTF("ERROR: Failed to append to history.old: %d\n", res);
+    card->step = HistoryStep_OpenWrite;
+    return 0;
+  case HistoryStep_OpenWrite:
+    if (card->fullWrite)
+      res = mcOpen(card->port, 0, historyFilePath, FIO_O_WRONLY | FIO_O_CREAT | FIO_O_TRUNC);
+    else
+      res = mcOpen(card->port, 0, historyFilePath, FIO_O_WRONLY);
+    break;
+  case HistoryStep_Seek:
+    res = mcSeek(card->fd, HISTORY_ENTRY_OFFSET(card->slot), SEEK_SET);
+    break;
+  case HistoryStep_Write:
+    if (card->fullWrite)
+      res = mcWrite(card->fd, card->historyList, HISTORY_FILE_SIZE);
+    else
+      res = mcWrite(card->fd, &card->historyList[card->slot], sizeof(struct historyListEntry));
+    break;
+  default:
+    break;
+  }
+
+  if (res) {
+    DPRINTF("ERROR: Failed to issue libmc command for mc%d: %d\n", card->port, res);
+    card->step = HistoryStep_Done;
+    return 0;
+  }
+  return 1;
+}
+
+// Handles the result of the completed libmc command and advances the card to the next step
+static void completeHistoryStep(historyCardContext *card, int result) {
+  switch (card->step) {
+  case HistoryStep_GetInfo:
+    // Check that memory card exists, connected and is a formatted PS2 memory card
+    if ((card->mcType != sceMcTypePS2) || (card->mcFormat != MC_FORMATTED)) {
+      DPRINTF("WARN: Refusing to write to memory card at mc%d\n", card->port);
+      card->step = HistoryStep_Done;
+      return;
+    }
+    card->step = HistoryStep_OpenRead;
+    return;
+  case HistoryStep_OpenRead:
+    if (result < 0) {
+      // File doesn't exist
+      card->createDir = 1;
+      card->fullWrite = 1;
+      memset(card->historyList, 0, HISTORY_FILE_SIZE);
+      card->step = HistoryStep_Process;
+      return;
+    }
+    DPRINTF("Updating history file at mc%d\n", card->port);
+    card->fd = result;
+    card->step = HistoryStep_Read;
+    return;
+  case HistoryStep_Read:
+    if (result != HISTORY_FILE_SIZE) {
+      DPRINTF("Failed to load the history file, reinitializing\n");
+      card->fullWrite = 1;
+      memset(card->historyList, 0, HISTORY_FILE_SIZE);
+    }
+    card->step = HistoryStep_CloseRead;
+    return;
+  case HistoryStep_CloseRead:
+    card->step = HistoryStep_Process;
+    return;
+  case HistoryStep_OpenWrite:
+    if (result < 0) {
+      DPRINTF("ERROR: Failed to open history file for writing: %d\n", result);
+      card->step = HistoryStep_Done;
+      return;
+    }
+    card->fd = result;
+    card->step = (card->fullWrite) ? HistoryStep_Write : HistoryStep_Seek;
+    return;
+  case HistoryStep_Seek:
+    if (result != HISTORY_ENTRY_OFFSET(card->slot)) {
+      DPRINTF("ERROR: Failed to seek to slot %d: %d\n", card->slot, result);
+      card->step = HistoryStep_CloseWrite;
+      return;
+    }
+    card->step = HistoryStep_Write;
+    return;
+  case HistoryStep_Write:
+    if (card->fullWrite && (result != HISTORY_FILE_SIZE))
+      DPRINTF("ERROR: Failed to write: %d/%d bytes written\n", result, HISTORY_FILE_SIZE);
+    else if (!card->fullWrite && (result != sizeof(struct historyListEntry)))
+      DPRINTF("ERROR: Failed to write slot %d: %d bytes written\n", card->slot, result);
+    card->step = HistoryStep_CloseWrite;
+    return;
+  default:
+    card->step = HistoryStep_Done;
+    return;
+  }
+}
+
+// Updates the history list and selects the next step for the card.
+// Only the updated entry is written back unless the history file has to be recreated
+static void processHistoryCard(historyCardContext *card, const char *titleID, uint16_t timestamp) {
+  card->slot = processHistoryList(titleID, timestamp, card->historyList, &card->evictedEntry);
+  if (card->createDir)
+    card->step = HistoryStep_CreateDir;
+  else if (card->evictedEntry.titleID[0] != '\0')
+    card->step = HistoryStep_Evict;
+  else
+    card->step = HistoryStep_OpenWrite;
+}
+
+// Adds title ID with the timestamp to the history file on both mc0 and mc1.
+// Requires libmc to be initialized first
+static int updateHistory(const char *titleID, uint16_t timestamp) {
+  // Refuse to write entry if title ID is less than expected
+  if ((titleID == NULL) || (strnlen(titleID, 16) < 11)) {
+    DPRINTF("WARN: Will not write invalid title ID to history files\n");
+    return 0;
+  }
+
+  static historyCardContext cards[2];
+  for (int i = 0; i < 2; i++) {
+    memset(&cards[i], 0, sizeof(historyCardContext));
+    cards[i].port = i;
+  }
+
+  // libmc can only have one command in flight, so the commands for mc0 and mc1 are issued in turns.
+  // EE-side processing for one card is done while the command for the other card is being executed by the IOP
+  int active, result;
+  int next = 0;
+  while ((cards[0].step != HistoryStep_Done) || (cards[1].step != HistoryStep_Done)) {
+    // Issue the next command, alternating between the cards
+    active = -1;
+    if (isHistoryStepIssuable(&cards[next]) && issueHistoryStep(&cards[next]))
+      active = next;
+    else if (isHistoryStepIssuable(&cards[next ^ 1]) && issueHistoryStep(&cards[next ^ 1]))
+      active = next ^ 1;
+    next ^= 1;
+
+    // Process the list for the card that has finished reading the history file
+    for (int i = 0; i < 2; i++)
+      if (cards[i].step == HistoryStep_Process)
+        processHistoryCard(&cards[i], titleID, timestamp);
+
+    if (active < 0)
+      continue;
+
+    mcSync(MC_WAIT, NULL, &result);
+    completeHistoryStep(&cards[active], result);
+  }
+
+  return 0;
+}
+
 // Adds title ID to the history file on both mc0 and mc1
 // Requires libcdvd to be initialized first
 int updateHistoryFile(const char *titleID) {
@@ -98,62 +355,115 @@ int updateHistoryFile(const char *titleID) {
     return -ENODEV;
   }
 
-  // Try opening history file on mc0 and mc1
-  int histfileFd, count, mcType, format;
-  struct historyListEntry historyList[MAX_HISTORY_ENTRIES];
+  // Both cards use the same timestamp
+  updateHistory(titleID, getTimestamp());
 
-  for (char i = 0; i < 2; i++) {
-    // Check that memory card exists, connected and is a formatted PS2 memory card
-    mcGetInfo(i, 0, &mcType, NULL, &format);
-    mcSync(0, NULL, &histfileFd);
-    if ((mcType != sceMcTypePS2) || (format != MC_FORMATTED)) {
-      DPRINTF("WARN: Refusing to write to memory card at mc%d\n", i);
-      continue;
-    }
+  // Clean up
+  mcReset();
+  return 0;
+}
 
-    historyFilePath[2] = i + '0'; // Skipping int-char conversions thanks to ASCII code ordering
-    // Attempt to open history file
-    histfileFd = open(historyFilePath, O_RDONLY);
-    if (histfileFd < 0) {
-      // File doesn't exist
-      DPRINTF("History file at %s does not exist, creating system directory\n", historyFilePath);
-      if (createSystemDataDir()) {
-        DPRINTF("WARN: Failed to create system directory\n");
-        continue;
-      }
-      memset(historyList, 0, HISTORY_FILE_SIZE);
-    } else {
-      // Read history file
-      DPRINTF("Updating history file at %s\n", historyFilePath);
-      count = read(histfileFd, historyList, HISTORY_FILE_SIZE);
-      if (count != (HISTORY_FILE_SIZE)) {
-        DPRINTF("Failed to load the history file, reinitializing\n");
-        memset(historyList, 0, HISTORY_FILE_SIZE);
-      }
-      close(histfileFd);
-    }
+// Appends title ID to the launch history journal on the memory card in the specified port.
+// Requires libcdvd to be initialized first
+int writeHistoryJournal(int port, const char *titleID) {
+  static struct historyJournalRecord record __attribute__((aligned(64)));
 
-    // Process history file
-    processHistoryList(titleID, historyList);
+  // Refuse to write entry if title ID is less than expected
+  if ((titleID == NULL) || (strlen(titleID) < 11)) {
+    DPRINTF("WARN: Will not write invalid title ID to history journal\n");
+    return 0;
+  }
 
-    // Write history file
-    histfileFd = open(historyFilePath, O_WRONLY | O_CREAT | O_TRUNC);
-    if (histfileFd < 0) {
-      DPRINTF("ERROR: Failed to open history file for writing: %d\n", histfileFd);
+  if (mcInit(MC_TYPE_XMC) && mcInit(MC_TYPE_MC)) {
+    DPRINTF("ERROR: Failed to initialize libmc\n");
+    return -ENODEV;
+  }
+
+  memset(&record, 0, sizeof(record));
+  strncpy(record.titleID, titleID, sizeof(record.titleID) - 1);
+  record.timestamp = getTimestamp();
+
+  int result, fd;
+  if ((fd = mcWaitResult(mcOpen(port, 0, HISTORY_JOURNAL_PATH, FIO_O_WRONLY | FIO_O_CREAT))) < 0) {
+    result = fd;
+    goto out;
+  }
+
+  // Refuse to grow the journal past the limit, the caller is expected to update the history file directly
+  result = mcWaitResult(mcSeek(fd, 0, SEEK_END));
+  if ((result < 0) || (result >= HISTORY_JOURNAL_MAX_RECORDS * sizeof(struct historyJournalRecord)))
+    result = -ENOSPC;
+  else if (mcWaitResult(mcWrite(fd, &record, sizeof(record))) != sizeof(record))
+    result = -EIO;
+  else
+    result = 0;
+  mcWaitResult(mcClose(fd));
+
+  if (!result)
+    DPRINTF("Recorded %s in the history journal on mc%d\n", titleID, port);
+
+out:
+  mcReset();
+  return result;
+}
+
+// Merges launch history journals from mc0 and mc1 into history files on both memory cards and deletes the journals.
+// Uses region letter from ROMVER to determine the system directory.
+int flushHistoryJournal(char romRegion) {
+  static struct historyJournalRecord records[HISTORY_JOURNAL_MAX_RECORDS] __attribute__((aligned(64)));
+  int fd, count;
+
+  setSystemDataDirRegion(romRegion);
+
+  if (mcInit(MC_TYPE_XMC) && mcInit(MC_TYPE_MC)) {
+    DPRINTF("ERROR: Failed to initialize libmc\n");
+    return -ENODEV;
+  }
+
+  for (int port = 0; port < 2; port++) {
+    if ((fd = mcWaitResult(mcOpen(port, 0, HISTORY_JOURNAL_PATH, FIO_O_RDONLY))) < 0)
       continue;
+
+    // The journal is read in chunks, so journals larger than the limit are also merged completely
+    while ((count = mcWaitResult(mcRead(fd, records, sizeof(records)))) > 0) {
+      count /= sizeof(struct historyJournalRecord);
+      DPRINTF("Merging %d history journal records from mc%d\n", count, port);
+      for (int i = 0; i < count; i++) {
+        records[i].titleID[sizeof(records[i].titleID) - 1] = '\0';
+        updateHistory(records[i].titleID, records[i].timestamp);
+      }
     }
-    // Return error if not all bytes were written
-    count = write(histfileFd, historyList, HISTORY_FILE_SIZE);
-    if (count != HISTORY_FILE_SIZE) {
-      DPRINTF("ERROR: Failed to write: %d/%d bytes written\n", count, HISTORY_FILE_SIZE);
-    }
-    close(histfileFd);
+    mcWaitResult(mcClose(fd));
+
+    // The journal is deleted only after the merge, so no launches are lost if the merge is interrupted.
+    // The trade-off is that a power-off between the merge and the deletion merges the records again on the next boot,
+    // counting these launches twice
+    mcWaitResult(mcDelete(port, 0, HISTORY_JOURNAL_PATH));
   }
+
   // Clean up
   mcReset();
   return 0;
 }
 
+// Initializes historyFilePath with region-specific letter using ROMVER region
+static void setSystemDataDirRegion(char romRegion) {
+  switch (romRegion) {
+  case 'C': // China
+    historyFilePath[2] = 'C';
+    break;
+  case 'E': // Europe
+    historyFilePath[2] = 'E';
+    break;
+  case 'H': // Asia
+  case 'A': // USA
+    historyFilePath[2] = 'A';
+    break;
+  default: // Japan
+    historyFilePath[2] = 'I';
+  }
+}
+
 // Reads ROM version from rom0:ROMVER and initializes historyFilePath with region-specific letter
 static inline int initSystemDataDir(void) {
   int romverFd = open("rom0:ROMVER", O_RDONLY);
@@ -165,27 +475,15 @@ static inline int initSystemDataDir(void) {
   read(romverFd, romverStr, 5);
   close(romverFd);
 
-  switch (romverStr[4]) {
-  case 'C': // China
-    historyFilePath[6] = 'C';
-    break;
-  case 'E': // Europe
-    historyFilePath[6] = 'E';
-    break;
-  case 'H': // Asia
-  case 'A': // USA
-    historyFilePath[6] = 'A';
-    break;
-  default: // Japan
-    historyFilePath[6] = 'I';
-  }
-
+  setSystemDataDirRegion(romverStr[4]);
   return 0;
 }
 
 // Processes history record list, updating title entry if it already exists in the list
-// or adding it to the list, evicting the least used title along the way
-void processHistoryList(const char *titleID, struct historyListEntry *historyList) {
+// or adding it to the list, evicting the least used title along the way.
+// Returns the index of the updated slot. The evicted entry is copied into evictedEntry,
+// evictedEntry title ID is left empty if nothing was evicted
+int processHistoryList(const char *titleID, uint16_t timestamp, struct historyListEntry *historyList, struct historyListEntry *evictedEntry) {
   // Used to find least used record
   int leastUsedRecordIdx = 0;
   int leastUsedRecordTimestamp = INT_MAX;
@@ -195,6 +493,7 @@ void processHistoryList(const char *titleID, struct historyListEntry *historyLis
   uint8_t blankSlots[MAX_HISTORY_ENTRIES];
   int blankSlotCount = 0;
   int i;
+  evictedEntry->titleID[0] = '\0';
   // Loop over all histrory entries, trying to find the target title and least used entry
   for (i = 0; i < MAX_HISTORY_ENTRIES; i++) {
     // Check if this slot is used
@@ -221,7 +520,7 @@ void processHistoryList(const char *titleID, struct historyListEntry *historyLis
     if (!strncmp(historyList[i].titleID, titleID, sizeof(historyList[i].titleID))) {
       DPRINTF("Updating entry at slot %d\n", i);
       // Update timestamp
-      historyList[i].timestamp = getTimestamp();
+      historyList[i].timestamp = timestamp;
 
       // Update launch count
       if ((historyList[i].bitmask & 0x3F) != 0x3F) {
@@ -247,7 +546,7 @@ void processHistoryList(const char *titleID, struct historyListEntry *historyLis
           historyList[i].shiftAmount = 7;
         }
       }
-      return;
+      return i;
     }
   }
 
@@ -256,15 +555,11 @@ void processHistoryList(const char *titleID, struct historyListEntry *historyLis
   int slot = 0;
   if (blankSlotCount > 0) {
     // Use random unused slot
-    newEntry = &historyList[blankSlots[slot = rand() % blankSlotCount]];
+    newEntry = &historyList[slot = blankSlots[rand() % blankSlotCount]];
   } else {
-    // Copy out the victim record and evict it into history.old
-    struct historyListEntry evictedhistoryEntry;
+    // Copy out the victim record, it will be evicted into history.old by the caller
     newEntry = &historyList[slot = leastUsedRecordIdx];
-    memcpy(&evictedhistoryEntry, newEntry, sizeof(evictedhistoryEntry));
-    i = evictEntry(&evictedhistoryEntry);
-    if (i < 0) // Will reuse i here for result
-      DPRINTF("ERROR: Failed to append to history.old: %d\n", i);
+    memcpy(evictedEntry, newEntry, sizeof(struct historyListEntry));
   }
 
   DPRINTF("Inserting entry to slot %d\n", slot);
@@ -273,24 +568,136 @@ void processHistoryList(const char *titleID, struct historyListEntry *historyLis
   newEntry->launchCount = 1;
   newEntry->bitmask = 1;
   newEntry->shiftAmount = 0;
-  newEntry->timestamp = getTimestamp();
+  newEntry->timestamp = timestamp;
+  return slot;
+}
+
+// Reads up to count entries at the entry index into the buffer.
+// Returns the number of entries read
+static int readHistoryOldEntries(int fd, int offset, int index, struct historyListEntry *buffer, int count) {
+  int size = count * sizeof(struct historyListEntry);
+  if (!count)
+    return 0;
+  if (mcWaitResult(mcSeek(fd, offset + index * sizeof(struct historyListEntry), SEEK_SET)) != offset + index * sizeof(struct historyListEntry))
+    return 0;
+  if ((size = mcWaitResult(mcRead(fd, buffer, size))) < 0)
+    return 0;
+  return size / sizeof(struct historyListEntry);
 }
 
-// Appends evicted history entry to history.old file
-int evictEntry(const struct historyListEntry *evictedhistoryEntry) {
+// Converts history.old into a ring buffer, keeping up to HISTORY_OLD_MAX_ENTRIES most recent entries.
+// Handles append-only history.old files and rings with different capacity.
+// Returns the new file descriptor on success
+static int migrateHistoryOld(int port, const char *path, int fd, struct historyOldHeader *header) {
+  // Entries in chronological order and the raw file contents
+  static struct historyListEntry entries[HISTORY_OLD_MAX_ENTRIES] __attribute__((aligned(64)));
+  static struct historyListEntry fileEntries[HISTORY_OLD_MAX_ENTRIES] __attribute__((aligned(64)));
+  int entryCount, ringStart, ringCapacity, offset;
+
+  int fileSize = mcWaitResult(mcSeek(fd, 0, SEEK_END));
+  if (fileSize < 0)
+    fileSize = 0;
+
+  if ((fileSize >= sizeof(struct historyOldHeader)) && !memcmp(header->magic, HISTORY_OLD_MAGIC, sizeof(header->magic)) &&
+      header->capacity) {
+    // Ring buffer with different capacity, entries start after the header
+    DPRINTF("Resizing history.old ring from %d to %d entries\n", header->capacity, HISTORY_OLD_MAX_ENTRIES);
+    ringCapacity = header->capacity;
+    entryCount = (fileSize - sizeof(struct historyOldHeader)) / sizeof(struct historyListEntry);
+    if (entryCount > ringCapacity)
+      entryCount = ringCapacity;
+    // The oldest entry is at the head when the ring is full
+    ringStart = (entryCount < ringCapacity) ? 0 : (header->head % ringCapacity);
+    offset = sizeof(struct historyOldHeader);
+  } else {
+    // Append-only file, the oldest entry is the first one
+    if (fileSize)
+      DPRINTF("Converting history.old into the ring buffer\n");
+    ringCapacity = entryCount = fileSize / sizeof(struct historyListEntry);
+    ringStart = 0;
+    offset = 0;
+  }
+
+  int count = 0;
+  if (entryCount <= HISTORY_OLD_MAX_ENTRIES) {
+    // All entries fit: read them at once and put them in chronological order
+    int read = readHistoryOldEntries(fd, offset, 0, fileEntries, entryCount);
+    for (int i = 0; i < entryCount; i++) {
+      int slot = (ringStart + i) % ringCapacity;
+      if (slot >= read)
+        break;
+      memcpy(&entries[count++], &fileEntries[slot], sizeof(struct historyListEntry));
+    }
+  } else {
+    // Keep the newest entries. They are contiguous in the file unless they wrap around the end of a larger ring
+    int first = (ringStart + entryCount - HISTORY_OLD_MAX_ENTRIES) % ringCapacity;
+    int tail = ringCapacity - first;
+    if (tail > HISTORY_OLD_MAX_ENTRIES)
+      tail = HISTORY_OLD_MAX_ENTRIES;
+    count = readHistoryOldEntries(fd, offset, first, entries, tail);
+    if ((count == tail) && (tail < HISTORY_OLD_MAX_ENTRIES)) {
+      int read = readHistoryOldEntries(fd, offset, 0, fileEntries, HISTORY_OLD_MAX_ENTRIES - tail);
+      memcpy(&entries[count], fileEntries, read * sizeof(struct historyListEntry));
+      count += read;
+    }
+  }
+  mcWaitResult(mcClose(fd));
+
+  // Recreate the file
+  if ((fd = mcWaitResult(mcOpen(port, 0, path, FIO_O_RDWR | FIO_O_CREAT | FIO_O_TRUNC))) < 0)
+    return fd;
+
+  memcpy(header->magic, HISTORY_OLD_MAGIC, sizeof(header->magic));
+  header->capacity = HISTORY_OLD_MAX_ENTRIES;
+  header->head = count % HISTORY_OLD_MAX_ENTRIES;
+  if (mcWaitResult(mcWrite(fd, header, sizeof(struct historyOldHeader))) != sizeof(struct historyOldHeader))
+    goto fail;
+  if (count && (mcWaitResult(mcWrite(fd, entries, count * sizeof(struct historyListEntry))) != count * sizeof(struct historyListEntry)))
+    goto fail;
+
+  return fd;
+
+fail:
+  mcWaitResult(mcClose(fd));
+  return -EIO;
+}
+
+// Writes evicted history entry into the history.old ring buffer, overwriting the oldest entry when the ring is full.
+// Blocks until done, must not be called while another libmc command is in flight
+int evictEntry(int port, const struct historyListEntry *evictedhistoryEntry) {
   DPRINTF("Evicting %s into history.old\n", evictedhistoryEntry->titleID);
+  static struct historyOldHeader header __attribute__((aligned(64)));
   char fullpath[64];
   int fd, result;
 
   strcpy(fullpath, historyFilePath);
   strcat(fullpath, ".old");
-  if ((fd = open(fullpath, O_WRONLY | O_CREAT | O_APPEND)) >= 0) {
-    lseek(fd, 0, SEEK_END);
-    result = write(fd, evictedhistoryEntry, sizeof(struct historyListEntry)) == sizeof(struct historyListEntry) ? 0 : -EIO;
-    close(fd);
-  } else {
-    result = fd;
+  if ((fd = mcWaitResult(mcOpen(port, 0, fullpath, FIO_O_RDWR | FIO_O_CREAT))) < 0)
+    return fd;
+
+  // Read the ring header and convert the file if the header is missing or the capacity doesn't match
+  memset(&header, 0, sizeof(header));
+  if ((mcWaitResult(mcRead(fd, &header, sizeof(header))) != sizeof(header)) || memcmp(header.magic, HISTORY_OLD_MAGIC, sizeof(header.magic)) ||
+      (header.capacity != HISTORY_OLD_MAX_ENTRIES) || (header.head >= HISTORY_OLD_MAX_ENTRIES)) {
+    if ((fd = migrateHistoryOld(port, fullpath, fd, &header)) < 0)
+      return fd;
   }
+
+  // Overwrite the entry at the head and advance the head
+  result = -EIO;
+  if (mcWaitResult(mcSeek(fd, HISTORY_OLD_ENTRY_OFFSET(header.head), SEEK_SET)) != HISTORY_OLD_ENTRY_OFFSET(header.head))
+    goto out;
+  if (mcWaitResult(mcWrite(fd, (void *)evictedhistoryEntry, sizeof(struct historyListEntry))) != sizeof(struct historyListEntry))
+    goto out;
+
+  header.head = (header.head + 1) % HISTORY_OLD_MAX_ENTRIES;
+  if (mcWaitResult(mcSeek(fd, 0, SEEK_SET)) != 0)
+    goto out;
+  if (mcWaitResult(mcWrite(fd, &header, sizeof(header))) == sizeof(header))
+    result = 0;
+
+out:
+  mcWaitResult(mcClose(fd));
   return result;
 }
 
@@ -1,5 +1,6 @@
 #include "loader.h"
 #include "dprintf.h"
+#include "qmem.h"
 #include <elf.h>
 #include <errno.h>
 #include <iopcontrol.h>
@@ -43,7 +44,7 @@ int executeLoader(int argc, char *argv[]) {
       continue;
 
     pdata = (void *)(loader_elf + eph[i].p_offset);
-    memcpy((void *)eph[i].p_vaddr, pdata, eph[i].p_filesz);
+    qmemcpySPR((void *)eph[i].p_vaddr, pdata, eph[i].p_filesz);
   }
 
   FlushCache(0);
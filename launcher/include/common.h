@@ -4,10 +4,14 @@
 #include "loader.h"
 #include <debug.h>
 #include <stdint.h>
+#include <time.h>
 
 #define USB_MOUNTPOINT "mass0:"
 #define PFS_MOUNTPOINT "pfs0:"
+// Device readiness timeout in seconds
 #define DELAY_ATTEMPTS 20
+// Interval between device readiness checks in milliseconds
+#define POLL_INTERVAL_MS 50
 
 // Enum for supported devices
 typedef enum {
@@ -63,6 +67,17 @@ void fail(const char *str, ...);
 // Tests if file exists by opening it
 int tryFile(char *filepath);
 
+// Returns the device readiness deadline, DELAY_ATTEMPTS seconds from now.
+// The deadline can be shared between several waitForPath calls
+clock_t getPollDeadline();
+
+// Returns 1 if the deadline returned by getPollDeadline has passed
+int pollDeadlinePassed(clock_t deadline);
+
+// Waits for the path to become available by trying to open it every POLL_INTERVAL_MS milliseconds.
+// Returns 0 if the path was opened before the deadline
+int waitForPath(char *path, int flags, clock_t deadline);
+
 // Attempts to guess device type from path
 DeviceType guessDeviceType(char *path);
 
@@ -74,12 +89,19 @@ int launchPath(int argc, char *argv[]);
 // Initializes APA-formatted HDD and mounts the partition
 int initPFS(char *path, DeviceType additionalDevices);
 
-// Mounts the partition specified in path
+// Mounts the partition specified in path. Does nothing if the partition is already mounted
 int mountPFS(char *path);
 
-// Unmounts the partition
+// Closes all files on the partition, but keeps the partition mounted for reuse
 void deinitPFS();
 
+// Unmounts the partition. Must be called before handing off to the loader
+void releasePFS();
+
+// Adds title ID to the history file or to the history journal when the launcher was started by OSDMenu.
+// Requires libcdvd to be initialized first
+void recordLaunchHistory(char *titleID);
+
 // Puts HDD in idle mode and powers off the dev9 device
 void shutdownDEV9();
 
@@ -15,4 +15,12 @@ void applyXPARAM(char *gameID);
 // Initializes IOP modules for given device type
 int initModules(DeviceType device);
 
+// Initializes IOP modules for given device type together with the modules for the optional device types.
+// Optional device types whose modules fail to load (e.g. because the hardware is missing) are skipped,
+// use getLoadedDevices to check which device types were loaded
+int initModulesOptional(DeviceType device, DeviceType optional);
+
+// Returns the device types the resident IOP modules were loaded for
+DeviceType getLoadedDevices();
+
 #endif
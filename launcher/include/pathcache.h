@@ -0,0 +1,17 @@
+#ifndef _PATHCACHE_H_
+#define _PATHCACHE_H_
+
+#include "cnf.h"
+
+// Looks up the path that succeeded last time for the list of candidate paths and moves it to the front of the list.
+// The rest of the candidates are kept as a fallback. Returns the new list head
+linkedStr *pathCacheApply(linkedStr *paths);
+
+// Sets the candidate path that is about to be tried
+void pathCacheSelect(char *candidate);
+
+// Records the path passed to the loader as the last successful path for the current entry.
+// Does nothing if pathCacheApply() wasn't called or the path is already cached
+void pathCacheUpdate(char *path);
+
+#endif
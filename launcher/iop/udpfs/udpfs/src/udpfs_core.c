@@ -19,6 +19,12 @@
 /* State */
 static udprdma_socket_t *g_socket = NULL;
 
+/* Number of read requests kept in flight. Values above 1 require a server that
+ * accepts requests while it's still sending a reply */
+#ifndef UDPFS_READ_DEPTH
+#define UDPFS_READ_DEPTH 1
+#endif
+
 /* Shared buffer for write completion replies (BD and FHI) */
 static uint8_t g_write_rx_buf[sizeof(udpfs_msg_write_done_t)] __attribute__((aligned(4)));
 
@@ -82,39 +88,81 @@ static int _request(const void *req, uint32_t req_size, void *reply, uint32_t re
 #endif /* FEATURE_UDPFS_IOMAN */
 
 /*
- * Helper: send request, receive RESULT_REPLY app header + DMA data.
+ * Read pipeline: up to UDPFS_READ_DEPTH read requests are kept in flight, so the
+ * server can start sending the next reply right after the previous one.
+ * Replies arrive in request order, each into its own part of the caller's buffer.
+ */
+typedef struct {
+    udpfs_msg_result_reply_t result;  /* RESULT_REPLY app header */
+#if UDPFS_READ_DEPTH > 1
+    int transfer;                     /* UDPRDMA receive transfer number */
+#else
+    void *buffer;                     /* Reply data buffer */
+#endif
+    uint32_t size;                    /* Requested size in bytes */
+} udpfs_read_slot_t;
+
+static udpfs_read_slot_t g_read_slots[UDPFS_READ_DEPTH] __attribute__((aligned(4)));
+
+/*
+ * Helper: queue the reply buffers and send the read request.
  * Unified protocol for file read and block read.
- * Returns bytes received on success, 0 for EOF, negative on error.
+ * Returns 0 on success, negative on error.
  */
-static int _recv_with_result(udprdma_socket_t *socket, const void *req, uint32_t req_size, void *buffer, uint32_t size, uint32_t timeout_ms)
+static int _read_issue(udpfs_read_slot_t *slot, const void *req, uint32_t req_size, void *buffer, uint32_t size)
 {
-    udpfs_msg_result_reply_t result __attribute__((aligned(4)));
     int ret;
 
-    udprdma_set_rx_app_header(socket, &result, sizeof(result));
-    udprdma_set_rx_buffer(socket, buffer, size);
+    slot->result.msg_type = 0;
+    slot->size = size;
 
-    ret = udprdma_send(socket, req, req_size);
+#if UDPFS_READ_DEPTH > 1
+    /* Reply buffers must be queued before the request is sent */
+    slot->transfer = udprdma_queue_rx(g_socket, &slot->result, sizeof(slot->result), buffer, size);
+    if (slot->transfer < 0) {
+        M_DEBUG("udpfs: queue rx failed: %d\n", slot->transfer);
+        return -EIO;
+    }
+#else
+    /* One request at a time: receive straight into the buffers without the UDPRDMA receive queue */
+    slot->buffer = buffer;
+    udprdma_set_rx_app_header(g_socket, &slot->result, sizeof(slot->result));
+    udprdma_set_rx_buffer(g_socket, buffer, size);
+#endif
+
+    ret = udprdma_send(g_socket, req, req_size);
     if (ret != UDPRDMA_OK) {
         M_DEBUG("udpfs: send failed: %d\n", ret);
         return -EIO;
     }
 
-    ret = udprdma_recv(socket, buffer, size, timeout_ms);
+    return 0;
+}
+
+/*
+ * Helper: wait for the reply to the oldest read request in flight.
+ * Returns bytes received on success, 0 for EOF, negative on error.
+ */
+static int _read_complete(udpfs_read_slot_t *slot, uint32_t timeout_ms)
+{
+    int ret;
+
+#if UDPFS_READ_DEPTH > 1
+    ret = udprdma_wait_rx(g_socket, slot->transfer, timeout_ms);
+#else
+    ret = udprdma_recv(g_socket, slot->buffer, slot->size, timeout_ms);
+#endif
     if (ret < 0) {
         M_DEBUG("udpfs: recv failed: %d\n", ret);
         return -EIO;
     }
 
-    if (result.msg_type != UDPFS_MSG_RESULT_REPLY) {
-        M_DEBUG("udpfs: unexpected reply type 0x%02x\n", result.msg_type);
+    if (slot->result.msg_type != UDPFS_MSG_RESULT_REPLY) {
+        M_DEBUG("udpfs: unexpected reply type 0x%02x\n", slot->result.msg_type);
         return -EIO;
     }
 
-    if (result.result <= 0)
-        return result.result;  /* 0 = EOF, negative = error */
-
-    return result.result;  /* logical bytes read (not DMA-padded count) */
+    return slot->result.result;  /* logical bytes read (not DMA-padded count), 0 = EOF, negative = error */
 }
 
 /*
@@ -382,7 +430,13 @@ int udpfs_core_close(int32_t handle)
  */
 int udpfs_core_read(int32_t handle, void *buffer, int size)
 {
+    uint8_t *next_buffer = buffer;
+    int next_size = size;
+    int issued = 0, completed = 0;
     int total_read = 0;
+    int unread = 0;   /* Bytes the server read past a short or failed read */
+    int done = 0;
+    int failed = 0;
     int ret;
 
     if (!udprdma_is_connected(g_socket))
@@ -393,34 +447,61 @@ int udpfs_core_read(int32_t handle, void *buffer, int size)
 
     M_DEBUG("udpfs_core_read(handle=%d, %d bytes)\n", handle, size);
 
-    while (size > 0) {
-        udpfs_msg_read_req_t req;
-        int chunk_size = size > UDPFS_MAX_READ ? UDPFS_MAX_READ : size;
+    while (1) {
+        /* Keep the pipeline full */
+        while (!done && next_size > 0 && issued - completed < UDPFS_READ_DEPTH) {
+            udpfs_msg_read_req_t req;
+            int chunk_size = next_size > UDPFS_MAX_READ ? UDPFS_MAX_READ : next_size;
+
+            req.msg_type = UDPFS_MSG_READ_REQ;
+            req.reserved[0] = 0;
+            req.reserved[1] = 0;
+            req.reserved[2] = 0;
+            req.handle = handle;
+            req.size = chunk_size;
+
+            if (_read_issue(&g_read_slots[issued % UDPFS_READ_DEPTH], &req, sizeof(req), next_buffer, chunk_size) < 0) {
+                done = failed = 1;
+                break;
+            }
+
+            issued++;
+            next_buffer += chunk_size;
+            next_size -= chunk_size;
+        }
 
-        req.msg_type = UDPFS_MSG_READ_REQ;
-        req.reserved[0] = 0;
-        req.reserved[1] = 0;
-        req.reserved[2] = 0;
-        req.handle = handle;
-        req.size = chunk_size;
+        if (completed == issued)
+            break;
 
-        ret = _recv_with_result(g_socket, &req, sizeof(req), buffer, chunk_size, 30000);
+        /* Replies to all requests in flight must be received even after an error */
+        udpfs_read_slot_t *slot = &g_read_slots[completed % UDPFS_READ_DEPTH];
+        completed++;
+        ret = _read_complete(slot, 30000);
 
-        if (ret < 0) {
-            return total_read > 0 ? total_read : -EIO;
+        if (done) {
+            if (ret > 0)
+                unread += ret;
+            continue;
         }
 
-        if (ret == 0)
-            break;  /* EOF */
+        if (ret < 0) {
+            done = failed = 1;
+            continue;
+        }
 
         total_read += ret;
-        buffer = (uint8_t *)buffer + ret;
-        size -= ret;
 
-        if (ret < chunk_size)
-            break;  /* Short read = EOF */
+        if ((uint32_t)ret < slot->size)
+            done = 1;  /* Short read = EOF */
     }
 
+    /* Move the file position back to the end of the data returned to the caller */
+    if (unread > 0 && udprdma_is_connected(g_socket))
+        udpfs_core_lseek(handle, -unread, SEEK_CUR);
+
+    if (failed && total_read == 0)
+        return -EIO;
+
     return total_read;
 }
 
@@ -647,6 +728,8 @@ int udpfs_core_rmdir(const char *path)
 int udpfs_core_bread(int32_t handle, uint64_t sector, void *buffer, uint32_t count, uint32_t sector_size)
 {
     uint32_t sectors_left = count;
+    int issued = 0, completed = 0;
+    int failed = 0;
 
     M_DEBUG("udpfs_core_bread(handle=%d, sector=%u, count=%u)\n",
         handle, (unsigned int)sector, count);
@@ -657,29 +740,42 @@ int udpfs_core_bread(int32_t handle, uint64_t sector, void *buffer, uint32_t cou
     if (handle < 0)
         return -EBADF;
 
-    while (sectors_left > 0) {
-        udpfs_msg_bread_req_t req;
-        uint16_t chunk = sectors_left > UDPFS_MAX_SECTOR_READ ?
-            UDPFS_MAX_SECTOR_READ : (uint16_t)sectors_left;
-        int ret;
-
-        req.msg_type = UDPFS_MSG_BREAD_REQ;
-        req.reserved = 0;
-        req.sector_count = chunk;
-        req.handle = handle;
-        req.sector_nr_lo = (uint32_t)(sector & 0xFFFFFFFF);
-        req.sector_nr_hi = (uint32_t)(sector >> 32);
+    while (1) {
+        /* Keep the pipeline full */
+        while (!failed && sectors_left > 0 && issued - completed < UDPFS_READ_DEPTH) {
+            udpfs_msg_bread_req_t req;
+            uint16_t chunk = sectors_left > UDPFS_MAX_SECTOR_READ ?
+                UDPFS_MAX_SECTOR_READ : (uint16_t)sectors_left;
+
+            req.msg_type = UDPFS_MSG_BREAD_REQ;
+            req.reserved = 0;
+            req.sector_count = chunk;
+            req.handle = handle;
+            req.sector_nr_lo = (uint32_t)(sector & 0xFFFFFFFF);
+            req.sector_nr_hi = (uint32_t)(sector >> 32);
+
+            if (_read_issue(&g_read_slots[issued % UDPFS_READ_DEPTH], &req, sizeof(req), buffer, chunk * sector_size) < 0) {
+                failed = 1;
+                break;
+            }
+
+            issued++;
+            sectors_left -= chunk;
+            sector += chunk;
+            buffer = (uint8_t *)buffer + chunk * sector_size;
+        }
 
-        ret = _recv_with_result(g_socket, &req, sizeof(req), buffer, chunk * sector_size, 30000);
+        if (completed == issued)
+            break;
 
-        if (ret < 0) {
-            M_DEBUG("udpfs: bread failed\n");
-            return -EIO;
-        }
+        /* Replies to all requests in flight must be received even after an error */
+        if (_read_complete(&g_read_slots[completed++ % UDPFS_READ_DEPTH], 30000) < 0)
+            failed = 1;
+    }
 
-        sectors_left -= chunk;
-        sector += chunk;
-        buffer = (uint8_t *)buffer + chunk * sector_size;
+    if (failed) {
+        M_DEBUG("udpfs: bread failed\n");
+        return -EIO;
     }
 
     return count;
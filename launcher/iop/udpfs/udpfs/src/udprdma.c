@@ -1,7 +1,8 @@
 /*
  * UDPRDMA - Reliable RDMA over UDP for PS2
  *
- * Implementation of reliable data transfer using Go-Back-N ARQ.
+ * Implementation of reliable data transfer using Go-Back-N ARQ,
+ * with optional selective repeat for incoming data when the peer supports it.
  */
 
 #include <errno.h>
@@ -27,8 +28,22 @@
 #define EF_RX_WINDOW (1<<7)  /* Window ACK needed (every N packets) */
 
 /* Flow control: PS2 ACKs every RX_ACK_WINDOW packets,
- * server sends at most SEND_WINDOW packets ahead */
+ * server sends at most SEND_WINDOW packets ahead.
+ * With selective repeat, ACK every half window, so one lost ACK doesn't stall the server */
 #define UDPRDMA_RX_ACK_WINDOW 6
+#define UDPRDMA_RX_ACK_WINDOW_SR 4
+
+/* UDPRDMA_RX_QUEUE_SIZE enables the receive queue: the number of transfers that can be
+ * queued with udprdma_queue_rx(). Without it, one transfer is received at a time */
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+/* Peer send window: the peer has at most this many unacknowledged packets in flight */
+#define UDPRDMA_PEER_SEND_WINDOW 8
+
+/* Stale ACKs accepted while queued transfers are received before a request is resent.
+ * Packets the peer sent before it got the request carry the old ACK; there are at most
+ * a window of them, twice that if the peer resent them */
+#define UDPRDMA_STALE_ACK_LIMIT (2 * UDPRDMA_PEER_SEND_WINDOW)
+#endif
 
 /* Socket states */
 typedef enum {
@@ -38,6 +53,17 @@ typedef enum {
     STATE_DISCONNECTED
 } udprdma_state_t;
 
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+/* Queued receive transfer */
+typedef struct {
+    void *buffer;               /* Buffer for receiving data */
+    uint32_t size;              /* Size of receive buffer */
+    void *hdr_buffer;           /* App header receive buffer */
+    uint32_t hdr_size;          /* Expected header size in bytes */
+    uint32_t received;          /* Bytes received, valid once the transfer is complete */
+} udprdma_rx_desc_t;
+#endif
+
 /* Socket structure */
 struct udprdma_socket {
     /* UDP layer */
@@ -50,6 +76,8 @@ struct udprdma_socket {
     /* Connection state */
     udprdma_state_t state;
     uint32_t peer_ip;
+    uint16_t peer_flags;        /* Capability flags from INFORM */
+    uint8_t selective_repeat;   /* Selective repeat negotiated during discovery */
 
     /* TX state */
     uint16_t tx_seq_nr;         /* Next sequence number to send */
@@ -62,12 +90,38 @@ struct udprdma_socket {
     uint32_t rx_received;       /* Bytes received so far */
     uint16_t rx_seq_nr_expected; /* Next expected sequence number */
     uint8_t rx_window_count;    /* Packets received since last window ACK */
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+    uint32_t rx_ack_count;      /* Number of packets received with the ACK flag */
+#endif
+
+    /* RX selective repeat state */
+    uint32_t rx_sr_bitmap;      /* Bit n set: packet rx_seq_nr_expected + n is already in the buffer */
+    uint32_t rx_sr_stride;      /* Data size of the packets kept out of order, 0 = none kept */
+    uint16_t rx_sr_fin_seq;     /* Sequence number of the FIN packet kept out of order */
+    uint16_t rx_sr_fin_size;    /* Data size of the FIN packet kept out of order */
+    uint8_t rx_sr_fin;          /* FIN packet is kept out of order */
+    uint8_t rx_sr_next;         /* First packet of the next transfer was seen out of order */
+    uint16_t rx_sr_next_seq;    /* Sequence number of the first packet of the next transfer */
+
+    /* Receive retry state */
+    iop_sys_clock_t rx_retry_clock; /* Retry timer period */
+    uint16_t rx_retry_seq;      /* rx_seq_nr_expected at the last retry timer tick */
+    uint8_t rx_retry_count;     /* NACKs sent by the retry timer without progress */
+    uint8_t rx_out_of_order;    /* Out-of-order packet received since the last packet in order */
 
     /* RX app header state */
     void *rx_hdr_buffer;        /* App header receive buffer (NULL = not configured) */
     uint32_t rx_hdr_size;       /* Expected header size in bytes */
     uint32_t rx_hdr_received;   /* Header bytes received so far */
 
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+    /* RX queue state. Transfer n uses rx_queue[n % UDPRDMA_RX_QUEUE_SIZE] */
+    udprdma_rx_desc_t rx_queue[UDPRDMA_RX_QUEUE_SIZE];
+    uint32_t rx_queued;         /* Number of transfers queued */
+    uint32_t rx_completed;      /* Number of queued transfers completed by the IST */
+    uint32_t rx_consumed;       /* Number of completed transfers returned by udprdma_wait_rx */
+#endif
+
     /* Pre-built packet headers */
     udprdma_pkt_disc_t pkt_disc;
     udprdma_pkt_data_t pkt_data;
@@ -83,6 +137,183 @@ struct udprdma_socket {
 static struct udprdma_socket sockets[UDPRDMA_MAX_SOCKETS];
 
 
+/*
+ * Drop all packets kept out of order
+ */
+static void _sr_reset(struct udprdma_socket *s)
+{
+    s->rx_sr_bitmap = 0;
+    s->rx_sr_stride = 0;
+    s->rx_sr_fin = 0;
+    s->rx_sr_next = 0;
+}
+
+/*
+ * Selective repeat: try to keep an out-of-order DATA packet.
+ * Packets are placed assuming every packet between the expected and this one has the same data size.
+ * The assumption is checked when the missing packets arrive (see _sr_check_in_order).
+ * Packets that can't be kept are dropped as with Go-Back-N
+ */
+static void _sr_keep(struct udprdma_socket *s, uint16_t seq_nr, const udprdma_hdr_data_t *data_hdr)
+{
+    uint32_t distance = (seq_nr - s->rx_seq_nr_expected) & 0xFFF;
+    uint32_t size = data_hdr->data_byte_count;
+    int is_fin = (data_hdr->flags & UDPRDMA_DF_FIN) != 0;
+    uint32_t offset;
+
+    /* Late duplicate, too far ahead or already kept */
+    if (distance == 0 || distance >= UDPRDMA_SR_WINDOW || (s->rx_sr_bitmap & (1u << distance)))
+        return;
+    /* Packets from the next transfer on belong to another buffer */
+    if (s->rx_sr_next && distance >= ((s->rx_sr_next_seq - s->rx_seq_nr_expected) & 0xFFF))
+        return;
+
+    /* Only the first packet of a transfer carries the app header,
+     * so an app header out of order starts the next transfer and nothing after it can be kept */
+    if (data_hdr->hdr_word_count != 0 && s->rx_hdr_buffer != NULL) {
+        /* The NACK for this packet tells the peer to resend the packets that were kept past it */
+        s->rx_sr_bitmap &= (1u << distance) - 1;
+        s->rx_sr_next = 1;
+        s->rx_sr_next_seq = seq_nr;
+        return;
+    }
+
+    /* Only plain data packets of the current transfer can be placed out of order:
+     * the first packet carries the app header and its data size can differ */
+    if (data_hdr->hdr_word_count != 0 || size == 0 ||
+        (s->rx_hdr_buffer != NULL && s->rx_hdr_received == 0))
+        return;
+    /* Packets past the FIN belong to the next transfer */
+    if (s->rx_sr_fin && distance > ((s->rx_sr_fin_seq - s->rx_seq_nr_expected) & 0xFFF))
+        return;
+
+    if (s->rx_sr_stride == 0) {
+        /* The FIN packet can be shorter, so it can't define the packet size */
+        if (is_fin)
+            return;
+        s->rx_sr_stride = size;
+    } else if (!is_fin && size != s->rx_sr_stride) {
+        return;
+    }
+
+    offset = s->rx_received + distance * s->rx_sr_stride;
+    if (offset + size > s->rx_buffer_size)
+        return;
+
+    smap_fifo_read(0x30, (uint8_t *)s->rx_buffer + offset, size);
+
+    if (is_fin) {
+        /* Everything kept past the FIN belongs to the next transfer.
+         * The NACK for this packet tells the peer to resend it */
+        s->rx_sr_bitmap &= (2u << distance) - 1;
+        s->rx_sr_fin = 1;
+        s->rx_sr_fin_seq = seq_nr;
+        s->rx_sr_fin_size = size;
+    }
+    s->rx_sr_bitmap |= 1u << distance;
+}
+
+/*
+ * Selective repeat: called for the expected packet before it's processed.
+ * Drops the packets kept out of order if they were placed at the wrong offsets.
+ * Returns 1 if packets were dropped: the peer was told they arrived and has to be told to resend them
+ */
+static int _sr_check_in_order(struct udprdma_socket *s, const udprdma_hdr_data_t *data_hdr)
+{
+    if (s->rx_sr_bitmap == 0)
+        return 0;
+
+    /* Kept packets are past the FIN or were placed with the wrong packet size */
+    if ((data_hdr->flags & UDPRDMA_DF_FIN) || data_hdr->hdr_word_count != 0 ||
+        data_hdr->data_byte_count != s->rx_sr_stride) {
+        _sr_reset(s);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Selective repeat: advance past the packets kept out of order that follow the expected packet.
+ * Returns 1 if the FIN packet was reached
+ */
+static int _sr_advance(struct udprdma_socket *s)
+{
+    /* Bit 0 is the packet that was just received */
+    s->rx_sr_bitmap >>= 1;
+
+    while (s->rx_sr_bitmap & 1) {
+        uint16_t seq_nr = s->rx_seq_nr_expected;
+
+        s->rx_sr_bitmap >>= 1;
+        s->rx_seq_nr_expected = (seq_nr + 1) & 0xFFF;
+        s->rx_window_count++;
+
+        if (s->rx_sr_fin && seq_nr == s->rx_sr_fin_seq) {
+            s->rx_received += s->rx_sr_fin_size;
+            _sr_reset(s);
+            return 1;
+        }
+        s->rx_received += s->rx_sr_stride;
+    }
+
+    if (s->rx_sr_bitmap == 0)
+        _sr_reset(s);
+
+    return 0;
+}
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+/*
+ * Make queued transfer n the active receive transfer
+ */
+static void _rx_queue_activate(struct udprdma_socket *s, uint32_t n)
+{
+    udprdma_rx_desc_t *desc = &s->rx_queue[n % UDPRDMA_RX_QUEUE_SIZE];
+
+    s->rx_buffer = desc->buffer;
+    s->rx_buffer_size = desc->size;
+    s->rx_received = 0;
+    s->rx_window_count = 0;
+    s->rx_hdr_buffer = desc->hdr_buffer;
+    s->rx_hdr_size = desc->hdr_size;
+    s->rx_hdr_received = 0;
+    _sr_reset(s);
+}
+
+/*
+ * Returns 1 if queued transfers are still being received
+ */
+static int _rx_queue_busy(struct udprdma_socket *s)
+{
+    return s->rx_completed != s->rx_queued;
+}
+
+/*
+ * Drop all queued transfers
+ */
+static void _rx_queue_reset(struct udprdma_socket *s)
+{
+    if (_rx_queue_busy(s)) {
+        s->rx_buffer = NULL;
+        s->rx_hdr_buffer = NULL;
+    }
+    s->rx_queued = 0;
+    s->rx_completed = 0;
+    s->rx_consumed = 0;
+}
+#endif
+
+/*
+ * Mark the connection as lost
+ */
+static void _disconnect(struct udprdma_socket *s)
+{
+    s->state = STATE_DISCONNECTED;
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+    _rx_queue_reset(s);
+#endif
+}
+
 /*
  * Timeout callback
  */
@@ -93,6 +324,49 @@ static unsigned int _timeout_cb(void *arg)
     return 0;  /* Don't repeat */
 }
 
+/*
+ * Receive retry callback, runs every UDPRDMA_RX_RETRY_US while waiting for a transfer
+ * A transfer that has started but makes no progress lost packets the peer doesn't know about:
+ * the last packets, the ACK that opens the peer's send window, a NACK or the packets resent for it.
+ * NACK is repeated up to UDPRDMA_MAX_RETRIES times, then the peer's retransmit timeout takes over
+ */
+static unsigned int _rx_retry_cb(void *arg)
+{
+    struct udprdma_socket *s = (struct udprdma_socket *)arg;
+
+    if (s->rx_seq_nr_expected != s->rx_retry_seq) {
+        s->rx_retry_seq = s->rx_seq_nr_expected;
+        s->rx_retry_count = 0;
+    } else if (s->rx_buffer != NULL && s->rx_retry_count < UDPRDMA_MAX_RETRIES &&
+               (s->rx_received != 0 || s->rx_hdr_received != 0 || s->rx_out_of_order || s->rx_sr_bitmap != 0)) {
+        s->rx_retry_count++;
+        iSetEventFlag(s->event_flag, EF_RX_NACK);
+    }
+    return s->rx_retry_clock.lo;  /* Repeat */
+}
+
+/*
+ * Start/stop the receive retry timer, only used with selective repeat
+ */
+static void _rx_retry_start(struct udprdma_socket *s)
+{
+    if (!s->selective_repeat)
+        return;
+
+    s->rx_retry_seq = s->rx_seq_nr_expected;
+    s->rx_retry_count = 0;
+    USec2SysClock(UDPRDMA_RX_RETRY_US, &s->rx_retry_clock);
+    SetAlarm(&s->rx_retry_clock, _rx_retry_cb, s);
+}
+
+static void _rx_retry_stop(struct udprdma_socket *s)
+{
+    if (!s->selective_repeat)
+        return;
+
+    CancelAlarm(_rx_retry_cb, s);
+}
+
 /*
  * Interrupt service thread callback
  *
@@ -141,6 +415,7 @@ static int _ist(udp_socket_t *udp_socket, void *arg, const uint8_t *hdr, uint16_
                                      disc_pkt->ip.addr_src.addr[2],
                                      disc_pkt->ip.addr_src.addr[3]);
                 s->port = ntohs(disc_pkt->udp.port_src);
+                s->peer_flags = disc.flags;
                 SetEventFlag(s->event_flag, EF_RX_INFO);
             }
             break;
@@ -155,6 +430,9 @@ static int _ist(udp_socket_t *udp_socket, void *arg, const uint8_t *hdr, uint16_
             /* Update TX ACK state only from ACK packets */
             if (data_hdr.flags & UDPRDMA_DF_ACK) {
                 s->tx_seq_nr_acked = data_hdr.seq_nr_ack;
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+                s->rx_ack_count++;
+#endif
                 SetEventFlag(s->event_flag, EF_RX_ACK);
             }
 
@@ -165,6 +443,14 @@ static int _ist(udp_socket_t *udp_socket, void *arg, const uint8_t *hdr, uint16_
 
                 if (payload_size > 0 && s->rx_buffer != NULL) {
                     if (base_hdr.seq_nr == s->rx_seq_nr_expected) {
+                        int fin = (data_hdr.flags & UDPRDMA_DF_FIN) != 0;
+
+                        s->rx_out_of_order = 0;
+
+                        /* A NACK without the dropped packets makes the peer resend them */
+                        if (s->selective_repeat && _sr_check_in_order(s, &data_hdr))
+                            SetEventFlag(s->event_flag, EF_RX_NACK);
+
                         /* Extract app header via smap_fifo_read PIO (first packet only) */
                         if (hdr_size > 0) {
                             if (s->rx_hdr_buffer != NULL && s->rx_hdr_received == 0) {
@@ -191,17 +477,40 @@ static int _ist(udp_socket_t *udp_socket, void *arg, const uint8_t *hdr, uint16_
 
                         s->rx_seq_nr_expected = (base_hdr.seq_nr + 1) & 0xFFF;
 
+                        /* Take the packets that were received out of order and are now in order */
+                        if (s->rx_sr_bitmap != 0)
+                            fin |= _sr_advance(s);
+
                         /* Complete when FIN received or buffer full */
-                        if ((data_hdr.flags & UDPRDMA_DF_FIN) ||
-                            s->rx_received >= s->rx_buffer_size) {
+                        if (fin || s->rx_received >= s->rx_buffer_size) {
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+                            if (_rx_queue_busy(s)) {
+                                /* Switch to the next queued transfer right away, its packets may follow immediately */
+                                s->rx_queue[s->rx_completed % UDPRDMA_RX_QUEUE_SIZE].received = s->rx_received;
+                                s->rx_completed++;
+                                if (_rx_queue_busy(s)) {
+                                    _rx_queue_activate(s, s->rx_completed);
+                                } else {
+                                    s->rx_buffer = NULL;
+                                    s->rx_hdr_buffer = NULL;
+                                }
+                            }
+#endif
+                            _sr_reset(s);
                             SetEventFlag(s->event_flag, EF_RX_FIN);
-                        } else if (++s->rx_window_count >= UDPRDMA_RX_ACK_WINDOW) {
+                        } else if (++s->rx_window_count >=
+                                   (s->selective_repeat ? UDPRDMA_RX_ACK_WINDOW_SR : UDPRDMA_RX_ACK_WINDOW)) {
                             /* Flow control: signal recv to send cumulative ACK */
                             s->rx_window_count = 0;
                             SetEventFlag(s->event_flag, EF_RX_WINDOW);
                         }
                     } else {
-                        /* Out of order - signal NACK needed */
+                        /* Out of order - signal NACK needed.
+                         * Every out-of-order packet is answered, so a resent packet that gets lost again is asked for again */
+                        if (s->selective_repeat)
+                            _sr_keep(s, base_hdr.seq_nr, &data_hdr);
+                        if (((base_hdr.seq_nr - s->rx_seq_nr_expected) & 0xFFF) < 0x800)
+                            s->rx_out_of_order = 1;  /* Packets are missing, not a late duplicate */
                         SetEventFlag(s->event_flag, EF_RX_NACK);
                     }
                 }
@@ -220,11 +529,11 @@ static int _ist(udp_socket_t *udp_socket, void *arg, const uint8_t *hdr, uint16_
 /*
  * Send DISCOVERY packet
  */
-static void _send_discovery(struct udprdma_socket *s)
+static void _send_discovery(struct udprdma_socket *s, uint16_t flags)
 {
     s->pkt_disc.hdr.packet_type = UDPRDMA_PT_DISCOVERY;
     s->pkt_disc.hdr.seq_nr = 0;
-    s->pkt_disc.disc.reserved = 0;
+    s->pkt_disc.disc.flags = flags;
     s->pkt_disc.disc.service_id = s->service_id;
 
     udp_packet_send(s->udp_socket, (udp_packet_t *)&s->pkt_disc,
@@ -238,7 +547,7 @@ static void _send_inform(struct udprdma_socket *s)
 {
     s->pkt_disc.hdr.packet_type = UDPRDMA_PT_INFORM;
     s->pkt_disc.hdr.seq_nr = 1;
-    s->pkt_disc.disc.reserved = 0;
+    s->pkt_disc.disc.flags = 0;
     s->pkt_disc.disc.service_id = s->service_id;
 
     udp_packet_send(s->udp_socket, (udp_packet_t *)&s->pkt_disc,
@@ -247,24 +556,122 @@ static void _send_inform(struct udprdma_socket *s)
 
 /*
  * Send ACK packet (DATA with no payload)
+ * With selective repeat, NACK carries the receive bitmap as a 4-byte app header
  */
 static void _send_ack(struct udprdma_socket *s, int is_ack)
 {
+    uint32_t hdr_size = 0;
+
     s->pkt_data.hdr.packet_type = UDPRDMA_PT_DATA;
     s->pkt_data.hdr.seq_nr = s->tx_seq_nr;
     s->pkt_data.data.seq_nr_ack = is_ack ?
         ((s->rx_seq_nr_expected - 1) & 0xFFF) :  /* ACK: last received */
         s->rx_seq_nr_expected;                    /* NACK: expected */
     s->pkt_data.data.flags = is_ack ? UDPRDMA_DF_ACK : 0;
-    s->pkt_data.data.hdr_word_count = 0;
     s->pkt_data.data.data_byte_count = 0;
 
+    if (!is_ack && s->selective_repeat) {
+        /* Bit n set: packet seq_nr_ack + n doesn't need to be resent */
+        uint32_t bitmap = s->rx_sr_bitmap;
+        memcpy(s->pkt_data.extra, &bitmap, sizeof(bitmap));
+        hdr_size = sizeof(bitmap);
+    }
+    s->pkt_data.data.hdr_word_count = hdr_size / 4;
+
     udp_packet_send(s->udp_socket, (udp_packet_t *)&s->pkt_data,
-        sizeof(udprdma_hdr_t) + sizeof(udprdma_hdr_data_t));
+        sizeof(udprdma_hdr_t) + sizeof(udprdma_hdr_data_t) + hdr_size);
 
     /* ACK-only packets don't consume sequence numbers */
 }
 
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+/*
+ * Answer receive events: ACK on FIN or flow control window, NACK on out-of-order packet
+ */
+static void _handle_rx_events(struct udprdma_socket *s, uint32_t evf_bits)
+{
+    if (evf_bits & EF_RX_NACK)
+        _send_ack(s, 0);
+    else if (evf_bits & (EF_RX_FIN | EF_RX_WINDOW))
+        _send_ack(s, 1);
+}
+#endif
+
+/*
+ * Wait for ACK of the packet with sent_seq_nr, retry is only used for logging
+ * With the receive queue, keeps answering incoming data while waiting, so queued transfers can be received during the send.
+ * Returns 1 if ACK was received, 0 on timeout or stale ACK
+ */
+static int _wait_ack(struct udprdma_socket *s, uint16_t sent_seq_nr, const char *name, int retry)
+{
+    iop_sys_clock_t clock;
+    uint32_t evf_bits;
+    int acked = 0;
+
+    USec2SysClock(UDPRDMA_RETX_TIMEOUT_US, &clock);
+    SetAlarm(&clock, _timeout_cb, s);
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+    uint32_t rx_bits;
+    uint32_t ack_count = s->rx_ack_count;
+
+    while (1) {
+        /* FIN is only handled here for queued transfers, otherwise it's kept for udprdma_recv */
+        rx_bits = EF_RX_NACK | EF_RX_WINDOW;
+        if (_rx_queue_busy(s))
+            rx_bits |= EF_RX_FIN;
+
+        /* Wait for ACK or timeout - no WEF_CLEAR to preserve EF_RX_FIN */
+        WaitEventFlag(s->event_flag, EF_RX_ACK | EF_TIMEOUT | rx_bits,
+            WEF_OR, &evf_bits);
+
+        if (evf_bits & rx_bits) {
+            ClearEventFlag(s->event_flag, ~(evf_bits & rx_bits));
+            _handle_rx_events(s, evf_bits & rx_bits);
+        }
+
+        if (evf_bits & EF_RX_ACK) {
+            ClearEventFlag(s->event_flag, ~EF_RX_ACK);
+            /* 12-bit sequence numbers: ACKs up to half the sequence space before the packet are stale */
+            if (((s->tx_seq_nr_acked - sent_seq_nr) & 0xFFF) < 2048) {
+                acked = 1;
+                break;
+            }
+            /* Replies to earlier requests that were sent before the peer got this packet
+             * carry ACKs for those requests, keep waiting for a window of them */
+            if (_rx_queue_busy(s) && (s->rx_ack_count - ack_count) <= UDPRDMA_STALE_ACK_LIMIT)
+                continue;
+            M_PRINTF("%s: stale ACK acked=%d sent=%d, retry %d\n", name, s->tx_seq_nr_acked, sent_seq_nr, retry);
+            break;
+        }
+
+        if (evf_bits & EF_TIMEOUT) {
+            M_PRINTF("%s: timeout seq=%d, retry %d\n", name, sent_seq_nr, retry);
+            break;
+        }
+    }
+#else
+    /* Wait for ACK or timeout - no WEF_CLEAR to preserve EF_RX_FIN */
+    WaitEventFlag(s->event_flag, EF_RX_ACK | EF_TIMEOUT,
+        WEF_OR, &evf_bits);
+
+    if (evf_bits & EF_RX_ACK) {
+        int16_t diff = (int16_t)((s->tx_seq_nr_acked - sent_seq_nr) & 0xFFF);
+        if (diff >= 0 || diff < -2048)
+            acked = 1;
+        else
+            M_PRINTF("%s: stale ACK acked=%d sent=%d, retry %d\n", name, s->tx_seq_nr_acked, sent_seq_nr, retry);
+    }
+
+    if (evf_bits & EF_TIMEOUT)
+        M_PRINTF("%s: timeout seq=%d, retry %d\n", name, sent_seq_nr, retry);
+#endif
+
+    CancelAlarm(_timeout_cb, s);
+    ClearEventFlag(s->event_flag, ~(EF_RX_ACK | EF_TIMEOUT));
+    return acked;
+}
+
 /*
  * Send DATA packet with payload
  * Single-packet sends always set FIN (complete transfer in one packet)
@@ -403,10 +810,13 @@ int udprdma_discover(udprdma_socket_t *socket, uint32_t timeout_ms)
     if (timeout_ms == 0) timeout_ms = UDPRDMA_DISC_TIMEOUT_US / 1000;
 
     socket->state = STATE_DISCOVERING;
+    socket->peer_flags = 0;
 
     for (retries = 0; retries < UDPRDMA_MAX_RETRIES; retries++) {
-        /* Send discovery broadcast */
-        _send_discovery(socket);
+        /* Send discovery broadcast.
+         * Offer selective repeat in the first half of the attempts. Peers that don't support it
+         * ignore the flag, but older servers may drop a DISCOVERY with non-zero flags, so the rest goes without it */
+        _send_discovery(socket, retries < UDPRDMA_MAX_RETRIES / 2 ? UDPRDMA_CF_SR : 0);
 
         /* Set timeout */
         USec2SysClock(timeout_ms * 1000 / UDPRDMA_MAX_RETRIES, &clock);
@@ -422,12 +832,18 @@ int udprdma_discover(udprdma_socket_t *socket, uint32_t timeout_ms)
         if (evf_bits & EF_RX_INFO) {
             /* Got INFORM response */
             socket->state = STATE_CONNECTED;
-            M_DEBUG("udprdma_discover: connected to %d.%d.%d.%d:%d\n",
+            socket->selective_repeat = (socket->peer_flags & UDPRDMA_CF_SR) != 0;
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+            _rx_queue_reset(socket);
+#endif
+            _sr_reset(socket);
+            M_DEBUG("udprdma_discover: connected to %d.%d.%d.%d:%d%s\n",
                 (socket->peer_ip >> 24) & 0xFF,
                 (socket->peer_ip >> 16) & 0xFF,
                 (socket->peer_ip >>  8) & 0xFF,
                 (socket->peer_ip >>  0) & 0xFF,
-                socket->port);
+                socket->port,
+                socket->selective_repeat ? " (selective repeat)" : "");
                 
             /* Update packet destination to peer */
             udp_packet_init((udp_packet_t *)&socket->pkt_data, socket->peer_ip, socket->port);
@@ -450,8 +866,6 @@ void udprdma_inform(udprdma_socket_t *socket)
 
 int udprdma_send(udprdma_socket_t *socket, const void *data, uint32_t size)
 {
-    iop_sys_clock_t clock;
-    uint32_t evf_bits;
     uint16_t sent_seq_nr;
     int retries;
 
@@ -471,36 +885,15 @@ int udprdma_send(udprdma_socket_t *socket, const void *data, uint32_t size)
         sent_seq_nr = socket->tx_seq_nr;
         _send_data(socket, data, size);
 
-        /* Set timeout */
-        USec2SysClock(UDPRDMA_RETX_TIMEOUT_US, &clock);
-        SetAlarm(&clock, _timeout_cb, socket);
-
-        /* Wait for ACK or timeout - no WEF_CLEAR to preserve EF_RX_FIN */
-        WaitEventFlag(socket->event_flag, EF_RX_ACK | EF_TIMEOUT,
-            WEF_OR, &evf_bits);
-
-        CancelAlarm(_timeout_cb, socket);
-        ClearEventFlag(socket->event_flag, ~(EF_RX_ACK | EF_TIMEOUT));
-
-        if (evf_bits & EF_RX_ACK) {
-            int16_t diff = (int16_t)((socket->tx_seq_nr_acked - sent_seq_nr) & 0xFFF);
-            if (diff >= 0 || diff < -2048) {
-                return UDPRDMA_OK;
-            }
-            M_PRINTF("send: stale ACK acked=%d sent=%d, retry %d\n",
-                socket->tx_seq_nr_acked, sent_seq_nr, retries + 1);
-        }
-
-        if (evf_bits & EF_TIMEOUT) {
-            M_PRINTF("send: timeout seq=%d, retry %d\n", sent_seq_nr, retries + 1);
-        }
+        if (_wait_ack(socket, sent_seq_nr, "send", retries + 1))
+            return UDPRDMA_OK;
 
         /* Restore sequence number for retransmit */
         socket->tx_seq_nr = sent_seq_nr;
     }
 
     M_PRINTF("send: max retries exceeded, disconnecting\n");
-    socket->state = STATE_DISCONNECTED;
+    _disconnect(socket);
     return UDPRDMA_ERR_NACK;
 }
 
@@ -508,8 +901,6 @@ int udprdma_send_ll(udprdma_socket_t *socket,
                     const void *app_hdr, uint32_t app_hdr_size,
                     const void *data, uint32_t data_size)
 {
-    iop_sys_clock_t clock;
-    uint32_t evf_bits;
     uint16_t sent_seq_nr;
     int retries;
 
@@ -528,34 +919,14 @@ int udprdma_send_ll(udprdma_socket_t *socket,
         sent_seq_nr = socket->tx_seq_nr;
         _send_data_ll(socket, app_hdr, app_hdr_size, data, data_size);
 
-        USec2SysClock(UDPRDMA_RETX_TIMEOUT_US, &clock);
-        SetAlarm(&clock, _timeout_cb, socket);
-
-        /* Wait for ACK or timeout - no WEF_CLEAR to preserve EF_RX_FIN */
-        WaitEventFlag(socket->event_flag, EF_RX_ACK | EF_TIMEOUT,
-            WEF_OR, &evf_bits);
-
-        CancelAlarm(_timeout_cb, socket);
-        ClearEventFlag(socket->event_flag, ~(EF_RX_ACK | EF_TIMEOUT));
-
-        if (evf_bits & EF_RX_ACK) {
-            int16_t diff = (int16_t)((socket->tx_seq_nr_acked - sent_seq_nr) & 0xFFF);
-            if (diff >= 0 || diff < -2048) {
-                return UDPRDMA_OK;
-            }
-            M_PRINTF("send_ll: stale ACK acked=%d sent=%d, retry %d\n",
-                socket->tx_seq_nr_acked, sent_seq_nr, retries + 1);
-        }
-
-        if (evf_bits & EF_TIMEOUT) {
-            M_PRINTF("send_ll: timeout seq=%d, retry %d\n", sent_seq_nr, retries + 1);
-        }
+        if (_wait_ack(socket, sent_seq_nr, "send_ll", retries + 1))
+            return UDPRDMA_OK;
 
         socket->tx_seq_nr = sent_seq_nr;
     }
 
     M_PRINTF("send_ll: max retries exceeded, disconnecting\n");
-    socket->state = STATE_DISCONNECTED;
+    _disconnect(socket);
     return UDPRDMA_ERR_NACK;
 }
 
@@ -578,9 +949,11 @@ int udprdma_recv(udprdma_socket_t *socket, void *buffer, uint32_t size, uint32_t
         socket->rx_buffer = buffer;
         socket->rx_buffer_size = size;
         socket->rx_received = 0;
+        _sr_reset(socket);
     }
 
     /* Wait for FIN/buffer full, NACK (out-of-order), or timeout */
+    _rx_retry_start(socket);
     while (1) {
         USec2SysClock(timeout_ms * 1000, &clock);
         SetAlarm(&clock, _timeout_cb, socket);
@@ -592,6 +965,7 @@ int udprdma_recv(udprdma_socket_t *socket, void *buffer, uint32_t size, uint32_t
         CancelAlarm(_timeout_cb, socket);
 
         if (evf_bits & EF_RX_FIN) {
+            _rx_retry_stop(socket);
             _send_ack(socket, 1);
             int result = socket->rx_received;
             socket->rx_buffer = NULL;
@@ -610,11 +984,12 @@ int udprdma_recv(udprdma_socket_t *socket, void *buffer, uint32_t size, uint32_t
         }
 
         if (evf_bits & EF_TIMEOUT) {
+            _rx_retry_stop(socket);
             M_PRINTF("recv: timeout, received=%d/%d\n",
                 socket->rx_received, socket->rx_buffer_size);
             socket->rx_buffer = NULL;
             socket->rx_hdr_buffer = NULL;
-            socket->state = STATE_DISCONNECTED;
+            _disconnect(socket);
             return UDPRDMA_ERR_TIMEOUT;
         }
     }
@@ -639,6 +1014,7 @@ void udprdma_set_rx_buffer(udprdma_socket_t *socket, void *buffer, uint32_t size
     socket->rx_buffer_size = size;
     socket->rx_received = 0;
     socket->rx_window_count = 0;
+    _sr_reset(socket);
 }
 
 void udprdma_set_rx_app_header(udprdma_socket_t *socket, void *hdr_buf, uint32_t hdr_size)
@@ -648,3 +1024,90 @@ void udprdma_set_rx_app_header(udprdma_socket_t *socket, void *hdr_buf, uint32_t
     socket->rx_hdr_size = hdr_size;
     socket->rx_hdr_received = 0;
 }
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+int udprdma_queue_rx(udprdma_socket_t *socket, void *hdr_buf, uint32_t hdr_size, void *buffer, uint32_t size)
+{
+    udprdma_rx_desc_t *desc;
+    uint32_t n;
+
+    if (socket == NULL || buffer == NULL) return UDPRDMA_ERR_INVAL;
+    if (hdr_buf != NULL && hdr_size > UDPRDMA_MAX_APP_HDR) return UDPRDMA_ERR_INVAL;
+
+    if (socket->state != STATE_CONNECTED) {
+        return UDPRDMA_ERR_NOTCONN;
+    }
+
+    n = socket->rx_queued;
+    if (n - socket->rx_consumed >= UDPRDMA_RX_QUEUE_SIZE) {
+        return UDPRDMA_ERR_NOBUF;
+    }
+
+    desc = &socket->rx_queue[n % UDPRDMA_RX_QUEUE_SIZE];
+    desc->buffer = buffer;
+    desc->size = size;
+    desc->hdr_buffer = hdr_buf;
+    desc->hdr_size = hdr_size;
+    desc->received = 0;
+
+    /* The descriptor must be complete before the IST can see it */
+    __asm__ __volatile__("" ::: "memory");
+    socket->rx_queued = n + 1;
+    __asm__ __volatile__("" ::: "memory");
+
+    /*
+     * If all previous transfers are complete, nothing will activate this one.
+     * The IST may have activated it already, but no data can arrive before the request is sent,
+     * so activating it twice is harmless.
+     */
+    if (socket->rx_completed == n)
+        _rx_queue_activate(socket, n);
+
+    return (int)(n & 0x7FFFFFFF);
+}
+
+int udprdma_wait_rx(udprdma_socket_t *socket, int transfer, uint32_t timeout_ms)
+{
+    iop_sys_clock_t clock;
+    uint32_t evf_bits;
+    uint32_t n = (uint32_t)transfer;
+
+    if (socket == NULL) return UDPRDMA_ERR_INVAL;
+
+    if (timeout_ms == 0) timeout_ms = 5000;
+
+    /* Transfer numbers are handed out in order and must be waited for in order */
+    if ((socket->rx_consumed & 0x7FFFFFFF) != n) return UDPRDMA_ERR_INVAL;
+
+    _rx_retry_start(socket);
+    while ((int32_t)(socket->rx_completed - socket->rx_consumed) <= 0) {
+        if (socket->state != STATE_CONNECTED) {
+            _rx_retry_stop(socket);
+            return UDPRDMA_ERR_NOTCONN;
+        }
+
+        USec2SysClock(timeout_ms * 1000, &clock);
+        SetAlarm(&clock, _timeout_cb, socket);
+
+        WaitEventFlag(socket->event_flag,
+            EF_RX_FIN | EF_RX_NACK | EF_RX_WINDOW | EF_TIMEOUT,
+            WEF_OR | WEF_CLEAR, &evf_bits);
+
+        CancelAlarm(_timeout_cb, socket);
+
+        _handle_rx_events(socket, evf_bits);
+
+        if ((evf_bits & EF_TIMEOUT) && (int32_t)(socket->rx_completed - socket->rx_consumed) <= 0) {
+            _rx_retry_stop(socket);
+            M_PRINTF("wait_rx: timeout, received=%d/%d\n",
+                socket->rx_received, socket->rx_buffer_size);
+            _disconnect(socket);
+            return UDPRDMA_ERR_TIMEOUT;
+        }
+    }
+    _rx_retry_stop(socket);
+
+    socket->rx_consumed++;
+    return socket->rx_queue[n % UDPRDMA_RX_QUEUE_SIZE].received;
+}
+#endif
@@ -148,5 +148,38 @@ void udprdma_set_rx_buffer(udprdma_socket_t *socket, void *buffer, uint32_t size
  */
 void udprdma_set_rx_app_header(udprdma_socket_t *socket, void *hdr_buf, uint32_t hdr_size);
 
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+/**
+ * Queue receive transfer
+ *
+ * Adds app header and data buffers for an incoming transfer to the receive queue.
+ * Transfers are received in the order they were queued. The IST switches to the
+ * next queued buffers as soon as the previous transfer completes, so the peer
+ * can send several replies back to back.
+ * Must be called before sending the request the transfer replies to.
+ *
+ * @param socket   Socket handle
+ * @param hdr_buf  Buffer for app header (must be 4-byte aligned), or NULL
+ * @param hdr_size Expected header size in bytes (must be multiple of 4)
+ * @param buffer   Buffer for receiving data (must be 4-byte aligned)
+ * @param size     Buffer size in bytes
+ * @return Transfer number for udprdma_wait_rx(), or negative error code
+ */
+int udprdma_queue_rx(udprdma_socket_t *socket, void *hdr_buf, uint32_t hdr_size, void *buffer, uint32_t size);
+
+/**
+ * Wait for queued receive transfer
+ *
+ * Blocks until the transfer is complete. Transfers must be waited for
+ * in the order they were queued.
+ *
+ * @param socket     Socket handle
+ * @param transfer   Transfer number returned by udprdma_queue_rx()
+ * @param timeout_ms Timeout in milliseconds (0 for default 5000ms)
+ * @return Number of bytes received, or negative error code
+ */
+int udprdma_wait_rx(udprdma_socket_t *socket, int transfer, uint32_t timeout_ms);
+#endif
+
 
 #endif /* UDPRDMA_H */
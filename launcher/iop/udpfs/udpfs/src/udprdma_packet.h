@@ -5,7 +5,8 @@
  * UDPRDMA - Reliable RDMA over UDP for PS2
  *
  * This protocol provides reliable bidirectional data transfer over UDP.
- * It uses Go-Back-N ARQ for reliability with 12-bit sequence numbers.
+ * It uses Go-Back-N ARQ for reliability with 12-bit sequence numbers,
+ * with optional selective repeat negotiated during discovery.
  *
  * Key features:
  * - Service discovery via DISCOVERY/INFORM packets
@@ -32,6 +33,12 @@
 #define UDPRDMA_DF_ACK   (1<<0)  /* 1=ACK (seq_nr_ack is last received), 0=NACK (seq_nr_ack is expected) */
 #define UDPRDMA_DF_FIN   (1<<1)  /* Final packet of transfer */
 
+/* Discovery/Inform capability flags */
+#define UDPRDMA_CF_SR    (1<<0)  /* Selective repeat: receiver keeps out-of-order packets and sends selective NACKs */
+
+/* Selective repeat window: out-of-order packets are kept up to this distance from the expected seq_nr */
+#define UDPRDMA_SR_WINDOW  32
+
 /* Service ID - unified protocol (UDPBD is a subset of UDPFS) */
 #define UDPRDMA_SVC_UDPFS  0xF5F5
 
@@ -42,6 +49,7 @@
 #define UDPRDMA_ACK_TIMEOUT_US     (100 * 1000)   /* 100ms ACK coalescing */
 #define UDPRDMA_RETX_TIMEOUT_US    (500 * 1000)   /* 500ms retransmit timeout */
 #define UDPRDMA_DISC_TIMEOUT_US    (2000 * 1000)  /* 2s discovery timeout */
+#define UDPRDMA_RX_RETRY_US        (10 * 1000)    /* 10ms NACK retry when a transfer stalls */
 
 /* Retry limits */
 #define UDPRDMA_MAX_RETRIES  4
@@ -65,7 +73,7 @@ typedef union {
  */
 typedef struct {
     uint16_t service_id;       /* Service identifier */
-    uint16_t reserved;         /* Reserved (must be 0) */
+    uint16_t flags;            /* Capability flags (UDPRDMA_CF_*), 0 = Go-Back-N only */
 } __attribute__((packed)) udprdma_hdr_disc_t;
 
 /*
@@ -3,8 +3,10 @@
 #include "dprintf.h"
 #include "game_id.h"
 #include "handlers.h"
+#include "history.h"
 #include "init.h"
 #include "loader.h"
+#include "pathcache.h"
 #include <ctype.h>
 #include <debug.h>
 #include <fcntl.h>
@@ -15,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #define NEWLIB_PORT_AWARE
 #include <fileXio_rpc.h>
 #include <hdd-ioctl.h>
@@ -72,6 +75,27 @@ int tryFile(char *filepath) {
   return 0;
 }
 
+// Returns the device readiness deadline, DELAY_ATTEMPTS seconds from now
+clock_t getPollDeadline() { return clock() + (clock_t)DELAY_ATTEMPTS * CLOCKS_PER_SEC; }
+
+// Returns 1 if the deadline returned by getPollDeadline has passed
+int pollDeadlinePassed(clock_t deadline) { return (long)(clock() - deadline) >= 0; }
+
+// Waits for the path to become available by trying to open it every POLL_INTERVAL_MS milliseconds.
+// Returns 0 if the path was opened before the deadline.
+// Failed open calls can take a long time on network and missing devices, so the wait is limited by elapsed time, not by the number of checks
+int waitForPath(char *path, int flags, clock_t deadline) {
+  int fd;
+  while ((fd = open(path, flags)) < 0) {
+    if (pollDeadlinePassed(deadline))
+      return -ENODEV;
+
+    usleep(POLL_INTERVAL_MS * 1000);
+  }
+  close(fd);
+  return 0;
+}
+
 // Launches ELF from any generic device without path normalization and delays
 int handleGenericPath(DeviceType device, int argc, char *argv[]) {
   if ((argv[0] == 0) || (strlen(argv[0]) < 5)) {
@@ -265,7 +289,14 @@ char *normalizePath(char *path, DeviceType type) {
   return pathbuffer;
 }
 
-// Mounts the partition specified in path
+#ifdef APA
+// Partition currently mounted to PFS_MOUNTPOINT. deinitPFS keeps the partition mounted
+// so handlers that need the same partition again don't have to remount it
+static int pfsMounted = 0;
+static char mountedPartition[64] = {0};
+#endif
+
+// Mounts the partition specified in path. Reuses the mountpoint if the partition is already mounted
 int mountPFS(char *path) {
 #ifndef APA
   return -ENODEV;
@@ -279,15 +310,28 @@ int mountPFS(char *path) {
     filePath[0] = '\0';
   }
 
+  int res = 0;
+  if (pfsMounted && !strcmp(mountedPartition, path)) {
+    DPRINTF("%s is already mounted to %s\n", path, PFS_MOUNTPOINT);
+    goto out;
+  }
+
+  // Unmount the previous partition
+  releasePFS();
+
   // Mount the partition
   DPRINTF("Mounting %s to %s\n", path, PFS_MOUNTPOINT);
-  int res = fileXioMount(PFS_MOUNTPOINT, path, FIO_MT_RDONLY);
+  if ((res = fileXioMount(PFS_MOUNTPOINT, path, FIO_MT_RDONLY)))
+    res = -ENODEV;
+  else {
+    pfsMounted = 1;
+    strncpy(mountedPartition, path, sizeof(mountedPartition) - 1);
+  }
+
+out:
   if (pathSeparator != '\0')
     filePath[0] = pathSeparator; // Restore the path
-  if (res)
-    return -ENODEV;
-
-  return 0;
+  return res;
 #endif
 }
 
@@ -303,15 +347,7 @@ int initPFS(char *path, DeviceType additionalDevices) {
 
   // Wait for IOP to initialize device driver
   DPRINTF("Waiting for HDD to become available\n");
-  for (int attempts = 0; attempts < DELAY_ATTEMPTS; attempts++) {
-    res = open("hdd0:", O_DIRECTORY | O_RDONLY);
-    if (res >= 0) {
-      close(res);
-      break;
-    }
-    sleep(1);
-  }
-  if (res < 0)
+  if (waitForPath("hdd0:", O_DIRECTORY | O_RDONLY, getPollDeadline()))
     return -ENODEV;
 
   if (!path)
@@ -320,19 +356,46 @@ int initPFS(char *path, DeviceType additionalDevices) {
 #endif
 }
 
-// Unmounts the partition
+// Closes all files on the partition. The partition stays mounted until releasePFS is called
 void deinitPFS() {
 #ifdef APA
+  if (pfsMounted)
+    fileXioDevctl(PFS_MOUNTPOINT, PDIOC_CLOSEALL, NULL, 0, NULL, 0);
+#endif
+}
+
+// Unmounts the partition
+void releasePFS() {
+#ifdef APA
+  if (!pfsMounted)
+    return;
+
+  DPRINTF("Unmounting %s\n", mountedPartition);
   fileXioDevctl(PFS_MOUNTPOINT, PDIOC_CLOSEALL, NULL, 0, NULL, 0);
   fileXioSync(PFS_MOUNTPOINT, FXIO_WAIT);
   fileXioUmount(PFS_MOUNTPOINT);
+  pfsMounted = 0;
 #endif
 }
 
+// Adds title ID to the history file.
+// When the launcher was started by OSDMenu, the title ID is written to the history journal instead
+// and the history files are updated by OSDMenu on the next boot.
+// Requires libcdvd to be initialized first
+void recordLaunchHistory(char *titleID) {
+  if ((settings.flags & FLAG_BOOT_OSD) && !(settings.flags & FLAG_BOOT_HOSD) && (settings.deviceHint != Device_APA)) {
+    if (!writeHistoryJournal(settings.mcHint, titleID) || !writeHistoryJournal(settings.mcHint ^ 1, titleID))
+      return;
+    DPRINTF("Failed to write the history journal, updating the history file\n");
+  }
+  updateHistoryFile(titleID);
+}
+
 // Puts HDD in idle mode and powers off the dev9 device
 void shutdownDEV9() {
 #if defined(APA) || defined(ATA)
   // Unmount the partition (if mounted)
+  releasePFS();
   fileXioUmount("pfs0:");
   // Immediately put HDDs into idle mode
   fileXioDevctl("hdd0:", HDIOC_IDLEIMM, NULL, 0, NULL, 0);
@@ -410,6 +473,10 @@ int parseGlobalFlags(int argc, char *argv[]) {
 }
 
 int LoadELFFromFile(int argc, char *argv[]) {
+  // Remember the path for entries with multiple candidate paths
+  pathCacheUpdate(argv[0]);
+  releasePFS();
+
   if (settings.titleID || (settings.flags & FLAG_APP_GAMEID)) {
     char *titleID = settings.titleID;
     if (!titleID)
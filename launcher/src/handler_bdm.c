@@ -1,4 +1,5 @@
 #include "common.h"
+#include "dprintf.h"
 #include "errno.h"
 #include "init.h"
 #include "loader.h"
@@ -6,9 +7,60 @@
 #include <ps2sdkapi.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #define BDM_MAX_DEVICES 2
 
+#ifdef MASS_ALL_BDM
+// BDM drivers loaded together with USB for mass?: paths. Drivers for the missing hardware fail to load and are skipped.
+// MX4SIO is not loaded because its driver takes over the memory card slot
+static const DeviceType massOptionalDevices[] = {
+#ifdef ATA
+    Device_ATA,
+#endif
+#ifdef ILINK
+    Device_iLink,
+#endif
+};
+#define MASS_OPTIONAL_COUNT (sizeof(massOptionalDevices) / sizeof(massOptionalDevices[0]))
+#endif
+
+// Waits for the massN mountpoints and returns 0 if one of them has the file.
+// All mountpoints are polled at once, the first mountpoint that has the file wins.
+// Every mountpoint is checked for the file only once after it becomes available
+static int probeBDM(char *elfPath, char *wildcard, int mountpointLen, int deviceCount, clock_t deadline) {
+  char probeMountpoint[10] = {0};
+  uint32_t pendingMask = (1 << deviceCount) - 1;
+  while (1) {
+    for (int i = 0; i < deviceCount; i++) {
+      if (!(pendingMask & (1 << i)))
+        continue;
+
+      // Build mountpoint path
+      if (wildcard)
+        *wildcard = i + '0';
+      strncpy(probeMountpoint, elfPath, mountpointLen);
+
+      int fd = open(probeMountpoint, O_DIRECTORY | O_RDONLY);
+      if (fd < 0)
+        // Not available yet
+        continue;
+      close(fd);
+
+      // Done if file exists
+      if (!tryFile(elfPath))
+        return 0;
+      // Else, keep waiting for other devices
+      pendingMask &= ~(1 << i);
+    }
+
+    if (!pendingMask || pollDeadlinePassed(deadline))
+      // No more mountpoints available
+      return -ENODEV;
+    usleep(POLL_INTERVAL_MS * 1000);
+  }
+}
+
 // Launches ELF from BDM device
 int handleBDM(DeviceType device, int argc, char *argv[]) {
   printf("path: %s\n", argv[0]);
@@ -22,56 +74,38 @@ int handleBDM(DeviceType device, int argc, char *argv[]) {
   if (!elfPath)
     return -ENODEV;
 
-  // Initialize device modules
-  int res = initModules(device);
-  if (res)
-    return res;
-
   // Extract mountpoint for probing
   char *mountpoint = strchr(elfPath, ':');
-  char probeMountpoint[10] = {0};
   if (!mountpoint)
     return -EINVAL;
   int mountpointLen = mountpoint - elfPath + 1;
 
   // Check for wildcard
-  mountpoint = strrchr(elfPath, '?');
+  char *wildcard = strrchr(elfPath, '?');
+  int deviceCount = wildcard ? BDM_MAX_DEVICES : 1;
 
-  // Try all possible mountpoints while decreasing the number of wait
-  // attempts for each consecutive device to reduce init times
-  int delayAttempts = DELAY_ATTEMPTS; // Max number of attempts
-  for (int i = 0; i < BDM_MAX_DEVICES; i++) {
-    // Build mountpoint path
-    if (mountpoint) { // Handle wildcard paths
-      *mountpoint = i + '0';
-    } else if (i != 0)
-      break; // Break early if the path is not a wildcard path
+  // Initialize device modules
+  DeviceType optional = Device_None;
+#ifdef MASS_ALL_BDM
+  if (wildcard && (device == Device_USB) && !strncmp(argv[0], "mass", 4))
+    // mass?: can be backed by any BDM driver, so load all of them in one IOP configuration
+    for (int i = 0; i < MASS_OPTIONAL_COUNT; i++)
+      optional |= massOptionalDevices[i];
+#endif
+  int res = initModulesOptional(device, optional);
+  if (res)
+    return res;
 
-    strncpy(probeMountpoint, elfPath, mountpointLen);
-    while (delayAttempts != 0) {
-      // Try to open the file to make sure it exists
-      res = open(probeMountpoint, O_DIRECTORY | O_RDONLY);
-      if (res >= 0) {
-        // If mountpoint is available
-        close(res);
+#ifdef MASS_ALL_BDM
+  // Every loaded driver can add its own devices
+  for (int i = 0; i < MASS_OPTIONAL_COUNT; i++)
+    if (getLoadedDevices() & optional & massOptionalDevices[i])
+      deviceCount += BDM_MAX_DEVICES;
+#endif
 
-        // Jump to launch if file exists
-        if (!(res = tryFile(elfPath)))
-          goto found;
-        // Else, try next device
-        break;
-      }
-      // If the mountpoint is unavailable, delay and decrement the number of wait attempts
-      sleep(1);
-      delayAttempts--;
-    }
-    // No more mountpoints available
-    if (res < 0)
-      break;
-  }
-  return -ENODEV;
+  if (probeBDM(elfPath, wildcard, mountpointLen, deviceCount, getPollDeadline()))
+    return -ENODEV;
 
-found:
   argv[0] = elfPath;
   return LoadELFFromFile(argc, argv);
 }
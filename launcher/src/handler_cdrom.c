@@ -4,7 +4,6 @@
 #include "dprintf.h"
 #include "game_id.h"
 #include "handlers.h"
-#include "history.h"
 #include "init.h"
 #include "libcdvd-common.h"
 #include "loader.h"
@@ -216,7 +215,7 @@ int startCDROM(int displayGameID, int skipPS2LOGO, int ps1drvFlags, int useDKWDR
 
     // Update history file and display game ID
     settings.flags &= ~(FLAG_APP_GAMEID); // Remove the global flag
-    updateHistoryFile(titleID);
+    recordLaunchHistory(titleID);
     if (displayGameID)
       gsDisplayGameID(titleID);
   } else
@@ -224,7 +223,7 @@ int startCDROM(int displayGameID, int skipPS2LOGO, int ps1drvFlags, int useDKWDR
 
   sceCdInit(SCECdEXIT);
   if (settings.deviceHint == Device_APA)
-    deinitPFS();
+    releasePFS();
 
   switch (discType) {
   case ExecType_PS1:
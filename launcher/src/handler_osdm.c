@@ -3,6 +3,7 @@
 #include "defaults.h"
 #include "dprintf.h"
 #include "handlers.h"
+#include "pathcache.h"
 #include <ctype.h>
 #include <init.h>
 #include <kernel.h>
@@ -278,12 +279,14 @@ int handleOSDM(int argc, char *argv[]) {
   if (settings.dkwdrvPath)
     free(settings.dkwdrvPath);
 
-  // Try every path
+  // Try the last successful path first, then every path
+  targetPaths = pathCacheApply(targetPaths);
   tlstr = targetPaths;
   while (tlstr) {
     targetArgv[0] = tlstr->str;
     // If target path is valid, it'll never return from launchPath
     DPRINTF("Trying to launch %s\n", targetArgv[0]);
+    pathCacheSelect(tlstr->str);
     launchPath(targetArgc, targetArgv);
     free(tlstr->str);
     tlstr = tlstr->next;
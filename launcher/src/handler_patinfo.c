@@ -58,5 +58,6 @@ int handlePATINFO(int argc, char *argv[]) {
     return launchPath(lopts->argc, lopts->argv);
   }
 
+  releasePFS();
   return loadELF(lopts);
 }
@@ -1,7 +1,9 @@
 #include "cnf.h"
 #include "common.h"
 #include "dprintf.h"
+#include "pathcache.h"
 #include <ctype.h>
+#include <fcntl.h>
 #include <init.h>
 #include <ps2sdkapi.h>
 #include <stdio.h>
@@ -51,16 +53,12 @@ int handleQuickboot(char *cnfPath) {
   }
 
   DPRINTF("Opening %s\n", cnfPath);
-  FILE *file = fopen(cnfPath, "r");
-  int delayAttempts = DELAY_ATTEMPTS; // Max number of attempts
-  while (!file) {
-    sleep(1);
-    delayAttempts--;
-    if (delayAttempts < 0) {
-      msg("Quickboot: Failed to open %s\n", cnfPath);
-      return -ENODEV;
-    }
+  FILE *file = NULL;
+  if (!waitForPath(cnfPath, O_RDONLY, getPollDeadline()))
     file = fopen(cnfPath, "r");
+  if (!file) {
+    msg("Quickboot: Failed to open %s\n", cnfPath);
+    return -ENODEV;
   }
 
   // Temporary path and argument lists
@@ -131,11 +129,13 @@ int handleQuickboot(char *cnfPath) {
   // Parse arguments for global flags
   targetArgc = parseGlobalFlags(targetArgc, targetArgv);
 
-  // Try every path
+  // Try the last successful path first, then every path
+  targetPaths = pathCacheApply(targetPaths);
   tlstr = targetPaths;
   while (tlstr) {
     targetArgv[0] = tlstr->str;
     DPRINTF("Attempting to launch %s\n", tlstr->str);
+    pathCacheSelect(tlstr->str);
     // If target path is valid, it'll never return from launchPath
     launchPath(targetArgc, targetArgv);
     free(tlstr->str);
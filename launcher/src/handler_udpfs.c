@@ -16,13 +16,9 @@ int handleUDPFS(int argc, char *argv[]) {
   if (res)
     return res;
 
-  int delayAttempts = DELAY_ATTEMPTS; // Max number of attempts
-  while (delayAttempts != 0) {
-    // Try to open the file to make sure the device exists
-    if (!(res = tryFile(argv[0])))
-      return LoadELFFromFile(argc, argv);
-    sleep(1);
-    delayAttempts--;
-  }
-  return -ENODEV;
+  // Try to open the file to make sure the device exists
+  if ((res = waitForPath(argv[0], O_RDONLY, getPollDeadline())))
+    return res;
+
+  return LoadELFFromFile(argc, argv);
 }
@@ -1,9 +1,12 @@
 
 #include "init.h"
+#include "boottrace.h"
 #include "common.h"
+#include "dprintf.h"
 #include <ctype.h>
 #include <fcntl.h>
 #include <iopcontrol.h>
+#include <iopheap.h>
 #include <kernel.h>
 #include <libcdvd.h>
 #include <libpwroff.h>
@@ -126,6 +129,7 @@ typedef struct ModuleListEntry {
   char *argStr;                   // Module arguments
   DeviceType type;                // Target device
   moduleArgFunc argumentFunction; // Function used to initialize module arguments
+  int loaded;                     // Set when the module is resident on the IOP
 } ModuleListEntry;
 
 // Argument functions
@@ -189,40 +193,104 @@ static ModuleListEntry moduleList[] = {
 };
 #define MODULE_COUNT sizeof(moduleList) / sizeof(ModuleListEntry)
 
+// Device types that can't share the IOP. Switching between them requires a full IOP reset
+static const DeviceType conflictingDevices[][2] = {
+    // Both MX4SIO and MMCE drivers take over the memory card slot
+    {Device_MX4SIO, Device_MMCE},
+};
+#define CONFLICT_COUNT sizeof(conflictingDevices) / sizeof(conflictingDevices[0])
+
+// Device types that add BDM block devices, grouped by driver.
+// BDM mounts block devices as massN in the order they appear, so loading another block device driver
+// on top of a resident one can change which device a massN mountpoint refers to
+static const DeviceType bdmDriverGroups[] = {
+    Device_USB,
+    Device_ATA | Device_APA, // Both use ata_bd
+    Device_MX4SIO,
+    Device_iLink,
+    Device_UDPBD,
+};
+#define BDM_DRIVER_GROUP_COUNT sizeof(bdmDriverGroups) / sizeof(bdmDriverGroups[0])
+
+// Device types the resident modules were loaded for
 static DeviceType currentDevice = Device_None;
-// Initializes IOP modules for given device type
-int initModules(DeviceType device) {
-  if ((currentDevice)&device)
+// Optional device types that failed to load. The hardware doesn't change, so they are not retried
+static DeviceType failedDevices = Device_None;
+
+// Marks all modules as not loaded
+static void clearModuleState() {
+  for (int i = 0; i < MODULE_COUNT; i++)
+    moduleList[i].loaded = 0;
+  currentDevice = Device_None;
+}
+
+// Returns 1 if modules for the device type can't be loaded on top of the resident modules
+static int needsIOPReset(DeviceType device) {
+  if (currentDevice == Device_None)
+    // IOP state is unknown
+    return 1;
+
+  for (int i = 0; i < CONFLICT_COUNT; i++) {
+    if (((currentDevice & conflictingDevices[i][0]) && (device & conflictingDevices[i][1])) ||
+        ((currentDevice & conflictingDevices[i][1]) && (device & conflictingDevices[i][0])))
+      return 1;
+  }
+
+  // Adding a BDM block device driver while a different one is resident would renumber the massN mountpoints
+  for (int i = 0; i < BDM_DRIVER_GROUP_COUNT; i++) {
+    if ((device & bdmDriverGroups[i]) && !(currentDevice & bdmDriverGroups[i]) && (currentDevice & (Device_BDM | Device_APA) & ~bdmDriverGroups[i]))
+      return 1;
+  }
+  return 0;
+}
+
+// Initializes IOP modules for given device type and, if possible, for the optional device types.
+// Only the missing modules are loaded unless the device types conflict with the resident modules
+int initModulesOptional(DeviceType device, DeviceType optional) {
+  // Basic modules are always loaded
+  device |= Device_Basic;
+  // Don't retry optional device types that already failed to load
+  optional &= ~(device | failedDevices);
+  if (!((device | optional) & ~currentDevice))
     // Do nothing if the drivers are already loaded
     return 0;
 
-  if (currentDevice && !(currentDevice & (Device_APA | Device_ATA)) && !(currentDevice & (Device_APA | Device_ATA)))
-    shutdownDEV9();
-
   int ret = 0;
   int iopret = 0;
 
-  // Initialize the RPC manager and reboot the IOP
-  sceSifInitRpc(0);
-  while (!SifIopReset("", 0)) {
-  };
-  while (!SifIopSync()) {
-  };
-
-  // Initialize the RPC manager
-  sceSifInitRpc(0);
-
-  // Apply patches required to load modules from EE RAM
-  sbv_patch_enable_lmb();
-  sbv_patch_disable_prefix_check();
-  if (currentDevice == Device_None)
-    sbv_patch_fileio(); // Patch fileio only once
+  if (needsIOPReset(device | optional)) {
+    if (currentDevice && !(currentDevice & (Device_APA | Device_ATA)))
+      shutdownDEV9();
+
+    DPRINTF("Resetting IOP to load modules for device type %x\n", device | optional);
+    // Unmount the partition kept mounted by the previous handler
+    releasePFS();
+    // Patch fileio only once
+    int patchFileio = (currentDevice == Device_None);
+    clearModuleState();
+
+    // Initialize the RPC manager and reboot the IOP
+    sceSifInitRpc(0);
+    while (!SifIopReset("", 0)) {
+    };
+    while (!SifIopSync()) {
+    };
+
+    // Initialize the RPC manager
+    sceSifInitRpc(0);
+
+    // Apply patches required to load modules from EE RAM
+    sbv_patch_enable_lmb();
+    sbv_patch_disable_prefix_check();
+    if (patchFileio)
+      sbv_patch_fileio();
+  }
 
   // Load modules
   for (int i = 0; i < MODULE_COUNT; i++) {
     ret = 0;
     iopret = 0;
-    if (!(device & moduleList[i].type) && !(moduleList[i].type & Device_Basic))
+    if (moduleList[i].loaded || (!((device | optional) & moduleList[i].type) && !(moduleList[i].type & Device_Basic)))
       continue;
 
     // If module has an arugment function, execute it
@@ -254,19 +322,36 @@ int initModules(DeviceType device) {
     if (moduleList[i].argStr != NULL)
       free(moduleList[i].argStr);
 
+    if (ret && !(moduleList[i].type & (device | Device_Basic))) {
+      // The module is needed only by optional device types, most likely because the hardware is missing.
+      // Skip the remaining modules for these device types
+      DPRINTF("Failed to initialize module %s: %d, skipping device type %x\n", moduleList[i].name, ret, optional & moduleList[i].type);
+      failedDevices |= optional & moduleList[i].type;
+      optional &= ~moduleList[i].type;
+      continue;
+    }
     if (ret) {
       msg("ERROR: Failed to initialize module %s: %d\n", moduleList[i].name, ret);
       return ret;
     }
+    moduleList[i].loaded = 1;
   }
 
   fileXioInit();
-  currentDevice = device;
+  currentDevice |= device | optional;
+  BOOT_TRACE("launcher:iop");
   return 0;
 }
 
+// Initializes IOP modules for given device type
+int initModules(DeviceType device) { return initModulesOptional(device, Device_None); }
+
+// Returns the device types the resident IOP modules were loaded for
+DeviceType getLoadedDevices() { return currentDevice; }
+
 // Reboots the IOP and executes a path from ROM via LoadExecPS2
 int execROMPath(int argc, char *argv[]) {
+  clearModuleState();
   sceSifInitRpc(0);
   while (!SifIopReset("", 0)) {
   };
@@ -353,37 +438,66 @@ char *initSMAPArguments(uint32_t *argLength) {
 #endif
 
 #ifdef APA
-// up to 4 descriptors, 20 buffers
-static char ps2hddArguments[] = "-o"
-                                "\0"
-                                "4"
-                                "\0"
-                                "-n"
-                                "\0"
-                                "20";
-// Sets arguments for PS2HDD modules
-char *initPS2HDDArguments(uint32_t *argLength) {
-  *argLength = sizeof(ps2hddArguments);
+// HDD cache buffers are sized from the free IOP memory left after all other drivers are loaded.
+// Both ps2hdd and ps2fs allocate 1 KiB per cache buffer
+#define HDD_CACHE_BUFFER_SIZE 1024
+// IOP memory that is never used for HDD caches
+#define HDD_CACHE_IOP_RESERVE (256 * 1024)
+// ps2hdd takes up to 1/4 of the free memory above the reserve, up to 4 descriptors and 20-64 buffers
+#define PS2HDD_DESCRIPTORS 4
+#define PS2HDD_MEM_SHARE 4
+#define PS2HDD_MIN_BUFFERS 20
+#define PS2HDD_MAX_BUFFERS 64
+// ps2fs takes up to 1/2 of the free memory above the reserve that is left after ps2hdd, up to 10 descriptors and 40-127 buffers
+#define PS2FS_DESCRIPTORS 10
+#define PS2FS_MEM_SHARE 2
+#define PS2FS_MIN_BUFFERS 40
+#define PS2FS_MAX_BUFFERS 127
+
+// Returns the number of cache buffers that fit into the 1/share of free IOP memory above the reserve,
+// clamped to [minBuffers, maxBuffers]
+static int calcHDDCacheBuffers(int freeMem, int share, int minBuffers, int maxBuffers) {
+  int buffers = (freeMem - HDD_CACHE_IOP_RESERVE) / share / HDD_CACHE_BUFFER_SIZE;
+  if (buffers < minBuffers)
+    return minBuffers;
+  if (buffers > maxBuffers)
+    return maxBuffers;
+  return buffers;
+}
 
-  char *argStr = malloc(sizeof(ps2hddArguments));
-  memcpy(argStr, ps2hddArguments, sizeof(ps2hddArguments));
+// Returns the number of cache buffers for the currently free IOP memory
+static int getHDDCacheBuffers(int share, int minBuffers, int maxBuffers) {
+  int freeMem = 0;
+  if (!SifInitIopHeap()) {
+    // The cache is allocated as a single block
+    freeMem = SifQueryTotalFreeMemSize();
+    int maxBlock = SifQueryMaxFreeMemSize();
+    if (maxBlock < freeMem)
+      freeMem = maxBlock;
+  }
+
+  int buffers = calcHDDCacheBuffers(freeMem, share, minBuffers, maxBuffers);
+  DPRINTF("%d bytes of IOP memory available, using %d HDD cache buffers\n", freeMem, buffers);
+  return buffers;
+}
+
+// Builds "-o <descriptors> -n <buffers>" argument list
+static char *buildHDDArguments(int descriptors, int buffers, uint32_t *argLength) {
+  char *argStr = malloc(16);
+  if (!argStr)
+    return NULL;
+
+  *argLength = sprintf(argStr, "-o%c%d%c-n%c%d", '\0', descriptors, '\0', '\0', buffers) + 1;
   return argStr;
 }
 
-// up to 10 descriptors, 40 buffers
-char ps2fsArguments[] = "-o"
-                        "\0"
-                        "10"
-                        "\0"
-                        "-n"
-                        "\0"
-                        "40";
 // Sets arguments for PS2HDD modules
-char *initPS2FSArguments(uint32_t *argLength) {
-  *argLength = sizeof(ps2fsArguments);
+char *initPS2HDDArguments(uint32_t *argLength) {
+  return buildHDDArguments(PS2HDD_DESCRIPTORS, getHDDCacheBuffers(PS2HDD_MEM_SHARE, PS2HDD_MIN_BUFFERS, PS2HDD_MAX_BUFFERS), argLength);
+}
 
-  char *argStr = malloc(sizeof(ps2fsArguments));
-  memcpy(argStr, ps2fsArguments, sizeof(ps2fsArguments));
-  return argStr;
+// Sets arguments for PS2FS modules
+char *initPS2FSArguments(uint32_t *argLength) {
+  return buildHDDArguments(PS2FS_DESCRIPTORS, getHDDCacheBuffers(PS2FS_MEM_SHARE, PS2FS_MIN_BUFFERS, PS2FS_MAX_BUFFERS), argLength);
 }
 #endif
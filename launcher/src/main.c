@@ -1,3 +1,4 @@
+#include "boottrace.h"
 #include "common.h"
 #include "handlers.h"
 #include "loader.h"
@@ -16,6 +17,8 @@ PS2_DISABLE_AUTOSTART_PTHREAD();
 launcherOptions settings;
 
 int main(int argc, char *argv[]) {
+  BOOT_TRACE("launcher");
+
   // Initialize settings
   settings.flags = 0;
   settings.deviceHint = Device_MemoryCard;
@@ -0,0 +1,165 @@
+#include "pathcache.h"
+#include "common.h"
+#include "defaults.h"
+#include "dprintf.h"
+#include "init.h"
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cache file format: one "<8-char entry key in HEX> <path>" line per entry, most recently updated entry first.
+// The entry key is a hash of all candidate paths, so editing the entry paths invalidates the cached path
+
+// Maximum number of entries kept in the cache file
+#define PATH_CACHE_MAX_ENTRIES 16
+
+// Key of the current entry, 0 if the cache is not used
+static uint32_t cacheKey = 0;
+// Path cached for the current entry
+static char cachedPath[PATH_MAX];
+// Candidate path that is being tried
+static char candidatePath[PATH_MAX];
+
+// Returns the path to the cache file on the memory card the launcher was started from
+static char *getCacheFilePath() {
+  static char path[sizeof(PATH_CACHE_PATH) + 4];
+  snprintf(path, sizeof(path), "mc%d:" PATH_CACHE_PATH, settings.mcHint);
+  return path;
+}
+
+// Calculates FNV-1a hash of all candidate paths
+static uint32_t hashPaths(linkedStr *paths) {
+  uint32_t hash = 0x811c9dc5;
+  for (; paths; paths = paths->next) {
+    for (char *c = paths->str; *c; c++) {
+      hash ^= (uint8_t)*c;
+      hash *= 0x01000193;
+    }
+    // Path separator
+    hash ^= '\n';
+    hash *= 0x01000193;
+  }
+  // 0 is reserved for "no entry"
+  return hash ? hash : 1;
+}
+
+// Looks up the path that succeeded last time for the list of candidate paths and moves it to the front of the list.
+// The rest of the candidates are kept as a fallback. Returns the new list head
+linkedStr *pathCacheApply(linkedStr *paths) {
+  cacheKey = 0;
+  cachedPath[0] = '\0';
+  candidatePath[0] = '\0';
+
+  // Nothing to cache for a single non-wildcard path
+  if (!paths || (!paths->next && !strchr(paths->str, '?')))
+    return paths;
+
+  cacheKey = hashPaths(paths);
+  FILE *file = fopen(getCacheFilePath(), "r");
+  if (!file)
+    return paths;
+
+  char lineBuffer[PATH_MAX + 10];
+  char *pathPtr;
+  while (fgets(lineBuffer, sizeof(lineBuffer), file)) {
+    if ((strtoul(lineBuffer, &pathPtr, 16) != cacheKey) || (*pathPtr != ' '))
+      continue;
+
+    pathPtr++;
+    pathPtr[strcspn(pathPtr, "\r\n")] = '\0';
+    strncpy(cachedPath, pathPtr, PATH_MAX - 1);
+    break;
+  }
+  fclose(file);
+
+  if (cachedPath[0] == '\0')
+    return paths;
+
+  DPRINTF("Path cache: trying %s first\n", cachedPath);
+  // If the cached path is one of the candidates, move it to the front
+  linkedStr *prev = NULL;
+  for (linkedStr *lstr = paths; lstr; prev = lstr, lstr = lstr->next) {
+    if (strcmp(lstr->str, cachedPath))
+      continue;
+
+    if (prev) {
+      prev->next = lstr->next;
+      lstr->next = paths;
+    }
+    return lstr;
+  }
+
+  // Else, the cached path is a resolved wildcard path. Add it before the candidates
+  linkedStr *lstr = malloc(sizeof(linkedStr));
+  if (!lstr)
+    return paths;
+
+  lstr->str = strdup(cachedPath);
+  lstr->next = paths;
+  return lstr;
+}
+
+// Sets the candidate path that is about to be tried
+void pathCacheSelect(char *candidate) {
+  if (!cacheKey)
+    return;
+
+  strncpy(candidatePath, candidate, PATH_MAX - 1);
+  candidatePath[PATH_MAX - 1] = '\0';
+}
+
+// Records the path passed to the loader as the last successful path for the current entry.
+// Does nothing if pathCacheApply() wasn't called or the path is already cached
+void pathCacheUpdate(char *path) {
+  if (!cacheKey || (candidatePath[0] == '\0'))
+    return;
+
+  // Handlers may pass the device path instead of the launcher path (e.g. pfs0: instead of hdd0:).
+  // Only store the resolved path if it can be launched as is
+  DeviceType device = guessDeviceType(path);
+  if (device != guessDeviceType(candidatePath))
+    path = candidatePath;
+  else if ((device & Device_BDM) && ((getLoadedDevices() & Device_BDM) != device))
+    // massN: is replayed with the driver the path maps to, but the device may have come from another BDM driver
+    // (e.g. a mass?: fallback device). Keep the candidate path unless only that driver is resident
+    path = candidatePath;
+
+  if (!strcmp(path, cachedPath)) {
+    cacheKey = 0;
+    return;
+  }
+
+  DPRINTF("Path cache: storing %s\n", path);
+  char *cacheFilePath = getCacheFilePath();
+
+  // Keep other entries
+  linkedStr *entries = NULL;
+  int entryCount = 0;
+  FILE *file = fopen(cacheFilePath, "r");
+  if (file) {
+    char lineBuffer[PATH_MAX + 10];
+    while ((entryCount < PATH_CACHE_MAX_ENTRIES - 1) && fgets(lineBuffer, sizeof(lineBuffer), file)) {
+      // Skip the current entry and incomplete lines
+      if ((strtoul(lineBuffer, NULL, 16) == cacheKey) || !strchr(lineBuffer, '\n'))
+        continue;
+
+      entries = addStr(entries, lineBuffer);
+      entryCount++;
+    }
+    fclose(file);
+  }
+
+  // Write the current entry first, followed by other entries
+  file = fopen(cacheFilePath, "w");
+  if (file) {
+    fprintf(file, "%08lX %s\n", cacheKey, path);
+    for (linkedStr *lstr = entries; lstr; lstr = lstr->next)
+      fputs(lstr->str, file);
+    fclose(file);
+  }
+
+  freeLinkedStr(entries);
+  cacheKey = 0;
+}
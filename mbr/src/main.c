@@ -1,3 +1,4 @@
+#include "boottrace.h"
 #include "common.h"
 #include "config.h"
 #include "crypto.h"
@@ -36,6 +37,9 @@ PS2_DISABLE_AUTOSTART_PTHREAD();
 TriggerType readPad();
 
 int main(int argc, char *argv[]) {
+  // MBR is the first program in the HDD boot chain
+  BOOT_TRACE_START("mbr");
+
   // Initialize IOP modules
   int res = 0;
   if ((res = initModules(Target_Default))) {
@@ -44,6 +48,7 @@ int main(int argc, char *argv[]) {
     ExecOSD(1, args);
     return res;
   }
+  BOOT_TRACE("mbr:iop");
 
   if (argc > 1) {
     if (!strcmp(argv[0], "rom0:MBRBOOT")) {
@@ -78,6 +83,7 @@ int main(int argc, char *argv[]) {
     DPRINTF("WARN: Failed to load the config file: %d, will use defaults\n", res);
 
   initializeOSDConfig();
+  BOOT_TRACE("mbr:cnf");
 
   // Handle OSD arguments when there are any additional arguments when running
   // as rom0:MBRBOOT or rom0:HDDBOOT
@@ -8,7 +8,10 @@
 #define EXTRA_SECTION_END 0x200000
 #define EXTRA_RELOC_ADDR 0x1200000
 
-// Loads IOP modules
+// Starts the IOP reboot without waiting for it to complete
+void startIOPReset();
+
+// Waits for the IOP reboot and loads IOP modules
 int initModules();
 
 // Resets IOP before loading OSDSYS
@@ -80,5 +80,7 @@ extern PatcherSettings settings;
 
 int loadConfig(void);
 void initConfig(void);
+// Reads ROMVER through the IOP if it couldn't be read from the boot ROM
+void initROMVERFallback(void);
 
 #endif
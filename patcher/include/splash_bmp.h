@@ -1,16717 +1,1200 @@
-// File Generated by BMP2C from splash.bmp
+// File Generated by splash2clut.py from splash.bmp
 #include <stdint.h>
 
 uint32_t splashWidth = 216;
 uint32_t splashHeight = 77;
 
-uint32_t __attribute__((aligned(16))) splash[] = {
+// Palette in GS CLUT order (CSM1)
+uint32_t __attribute__((aligned(16))) splashCLUT[] = {
+    0x00000000, 0x00f5f5f5, 0x00ccffff, 0x00b7b7b7, 0x0099bfbf, 0x00ae8b8b, 0x00b28e8e, 0x009ac0c0,
+    0x00a98787, 0x00e8baba, 0x00a28282, 0x00fefbf9, 0x00ffffff, 0x001e120c, 0x00585351, 0x00655151,
+    0x00bfbfbf, 0x006f6d6b, 0x00668080, 0x007f7f7f, 0x00bfefef, 0x00d6abab, 0x00c6c0bd, 0x000f1010,
+    0x00323f3f, 0x003d4040, 0x00080503, 0x00402c19, 0x00262f2f, 0x000b0704, 0x00bc9696, 0x00c09a9a,
+    0x00cfcfce, 0x00010100, 0x0062605f, 0x00372c2c, 0x004a3c3b, 0x00d0c5c1, 0x0044413f, 0x00c8a0a0,
+    0x0093908e, 0x008cafaf, 0x008c4c37, 0x009b503d, 0x004c4643, 0x00130b07, 0x00140d08, 0x00846a6a,
+    0x00cea5a5, 0x00524a45, 0x00594b48, 0x00573522, 0x00ddb1b1, 0x00e1b4b4, 0x00513320, 0x00513820,
+    0x008a6e6e, 0x00403f3e, 0x003f3f3f, 0x00311c13, 0x00371d15, 0x0049271d, 0x00482c1c, 0x00583922,
+    0x00573e22, 0x00e2e1e1, 0x00eeebe9, 0x0043241a, 0x0044281b, 0x00947676, 0x0025140f, 0x0027160f,
+    0x009f9e9d, 0x003d3d3d, 0x004c361e, 0x00958b84, 0x009a8e86, 0x007b4330, 0x00854434, 0x004d2b1e,
+    0x00271b0f, 0x00613926, 0x00614426, 0x00363331, 0x003c3c3c, 0x00fcf9f8, 0x00fdfaf8, 0x001e120c,
+    0x00512c20, 0x00f7f6f6, 0x00f8f7f6, 0x00f9f8f7, 0x00faf8f7, 0x0020120c, 0x0020160d, 0x005f4c4c,
+    0x00615a54, 0x00808080, 0x0087827f, 0x00b69292, 0x00b69897, 0x008f8682, 0x009e7e7e, 0x000c0a0a,
+    0x00201f1f, 0x00432c1a, 0x0044301b, 0x00474341, 0x004a4542, 0x00728f8f, 0x007f9f9f, 0x009d6c65,
+    0x00100a06, 0x00181413, 0x001d1716, 0x002e1a12, 0x002e1d12, 0x00776e66, 0x00806767, 0x00221b19,
+    0x00917474, 0x00a6cfcf, 0x00b2dfdf, 0x00805a32, 0x00895f36, 0x00617979, 0x00667f7f, 0x00312826,
+    0x003a271d, 0x002f2113, 0x00322214, 0x00e2ccc9, 0x00ddd8d6, 0x00824b33, 0x00835233, 0x00352015,
+    0x00be894a, 0x00927575, 0x00b8b8b8, 0x00c0b7b1, 0x00aa5643, 0x00a67041, 0x00040302, 0x00060402,
+    0x00362415, 0x00755e5e, 0x007b6262, 0x00382716, 0x003c2a18, 0x005f3c26, 0x007e7672, 0x008e7272,
+    0x00291710, 0x002b1911, 0x004d6060, 0x00596f6f, 0x00292121, 0x002d2424, 0x006b5655, 0x00705a5a,
+    0x003a2117, 0x003b2417, 0x001c130f, 0x0025180e, 0x001a2020, 0x00261e1e, 0x00763e2e, 0x0074442e,
+    0x0072492d, 0x00704f2c, 0x007b7a7a, 0x00897d76, 0x006e392b, 0x006f3e2c, 0x00c0c0c0, 0x00cbc3bf,
+    0x000c0705, 0x000c0805, 0x005c3224, 0x005c3724, 0x000d0905, 0x000f0906, 0x00b6aca4, 0x00b6b6b6,
+    0x00bcbab9, 0x00c2bebb, 0x00c8c7c7, 0x00d2c6c2, 0x005d3d24, 0x005d4224, 0x0022120d, 0x0022150d,
+    0x00d8d5d4, 0x00d1dddc, 0x0077512f, 0x007b5630, 0x002a1c10, 0x002b1f11, 0x00110907, 0x00110c07,
+    0x00674929, 0x006b4a2a, 0x00653f28, 0x006a3f2a, 0x00180e09, 0x001a0e0a, 0x001b100b, 0x001d0f0b,
+    0x00090503, 0x000a0604, 0x00905638, 0x009c5d3d, 0x003f4f4f, 0x00504f4f, 0x00402219, 0x003f2719,
+    0x009b9490, 0x00a49a94, 0x00643727, 0x00683729, 0x00623c27, 0x00683c29, 0x0077492e, 0x007b4a30,
+    0x001b100b, 0x001b130b, 0x00342a29, 0x002f2f2f, 0x00906339, 0x00996c3c, 0x004e3b32, 0x005f3425,
+    0x00030201, 0x00040201, 0x006d462b, 0x0071432c, 0x00504040, 0x00574545, 0x00644627, 0x00694329,
+    0x00977979, 0x009a7c7c, 0x00160d09, 0x00160f08, 0x00552e21, 0x00573122, 0x00171009, 0x0019100a,
+    0x0048331c, 0x004c301e, 0x00403433, 0x00453937, 0x00a9a6a4, 0x00aeadac, 0x0024150e, 0x0023190e,
+};
+
+// 8-bit palette indices, rows are padded to 224 pixels
+uint8_t __attribute__((aligned(16))) splash[] = {
     // row 0
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 1
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 2
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030101,
-    0x00130908,
-    0x0024120e,
-    0x0024110e,
-    0x00120907,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xf0, 0x35, 0xbe, 0xbe, 0xc6, 0x96, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 3
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00080503,
-    0x00140f08,
-    0x00130e08,
-    0x00090703,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00130907,
-    0x00412019,
-    0x00763a2e,
-    0x00773b2f,
-    0x0042211a,
-    0x00140908,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0x36, 0x36, 0xc9, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x35, 0xce, 0xa6, 0xa6, 0xce, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 4
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070403,
-    0x001b0d0b,
-    0x002e1711,
-    0x002d1712,
-    0x00190d0a,
-    0x00070302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00080603,
-    0x002e2112,
-    0x005f4426,
-    0x005f4526,
-    0x002d2012,
-    0x00090603,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x00080603,
-    0x00080603,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x00110c07,
-    0x0021180d,
-    0x0021180d,
-    0x00110d07,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0021100d,
-    0x0071372d,
-    0x00a45141,
-    0x009d4e3d,
-    0x0073392d,
-    0x0023110d,
-    0x00010000,
-    0x00040101,
-    0x00040101,
-    0x00010000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00080403,
-    0x00080403,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xd5, 0x6b, 0x99,
+    0xd5, 0x97, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x81, 0x4a, 0x4a, 0x81, 0xc8, 0x00, 0x00, 0xf0, 0x1a, 0x1a,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xf0, 0xc7, 0x5e, 0x5e, 0xc7, 0x96, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xbe, 0xb4, 0x94, 0x33, 0xb4, 0xbe, 0x00, 0xf1, 0xf1, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x21, 0x1a, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 5
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001a0e0a,
-    0x0050281f,
-    0x008a4636,
-    0x00874435,
-    0x004a261e,
-    0x00170c09,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x000f0906,
-    0x001c100b,
-    0x001d100c,
-    0x00100906,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00120d07,
-    0x005d4325,
-    0x00c18b4c,
-    0x00be894a,
-    0x005d4325,
-    0x00140e08,
-    0x00000000,
-    0x00020101,
-    0x001a130a,
-    0x00412f1a,
-    0x00422f19,
-    0x001b140b,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00100b06,
-    0x003d2b18,
-    0x0070512c,
-    0x0074542e,
-    0x00412f19,
-    0x00130e08,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00200f0d,
-    0x006d362a,
-    0x00954a3b,
-    0x008c4537,
-    0x006e362b,
-    0x00281510,
-    0x0024140e,
-    0x00522c20,
-    0x00562e21,
-    0x002c1811,
-    0x000a0504,
-    0x00020101,
-    0x00070503,
-    0x000b0705,
-    0x0020100c,
-    0x0042201a,
-    0x0042211a,
-    0x001b0d0a,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd5, 0x58, 0x56, 0x56,
+    0x3d, 0xea, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xad, 0xd6, 0xd7, 0x68, 0xf0, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xc7, 0xbd, 0x90, 0x90, 0xbd, 0x36, 0x00, 0x21, 0xe1, 0x1b, 0x72,
+    0xe1, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x68, 0x8c, 0xb1, 0xc2, 0x1b, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x5d, 0xb4, 0x33, 0x32, 0xb4, 0x47, 0xfe, 0x58, 0xec, 0x99, 0xc9, 0x21, 0x1a, 0x1d,
+    0x5d, 0xce, 0xce, 0xd5, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 6
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070403,
-    0x0042211a,
-    0x00a35240,
-    0x002a1511,
-    0x00371c15,
-    0x00804132,
-    0x0027130f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000e0806,
-    0x00321c13,
-    0x005d3424,
-    0x005f3625,
-    0x00361f15,
-    0x00100907,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00120d07,
-    0x005a4123,
-    0x00ba8749,
-    0x00ab7b42,
-    0x0072522c,
-    0x00302213,
-    0x000f0b06,
-    0x000c0805,
-    0x003e2d18,
-    0x00946b3a,
-    0x00986d3c,
-    0x0042301a,
-    0x00090603,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00070503,
-    0x00070503,
-    0x00020101,
-    0x0020170c,
-    0x0075532d,
-    0x00563e22,
-    0x004f381f,
-    0x00855f35,
-    0x002b1f11,
-    0x00010101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00040201,
-    0x00130a08,
-    0x003a1d17,
-    0x00673328,
-    0x00673328,
-    0x003a1c16,
-    0x002a1710,
-    0x00673928,
-    0x003e2018,
-    0x001f100c,
-    0x008e4b38,
-    0x00331c14,
-    0x001f120c,
-    0x0048291c,
-    0x00583223,
-    0x00723d2d,
-    0x008e4838,
-    0x009a4d3c,
-    0x0042201a,
-    0x00080403,
-    0x00020101,
-    0x00070403,
-    0x00070403,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00040201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x00150e09,
-    0x0026180f,
-    0x00291a10,
-    0x001e120c,
-    0x000e0805,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xce, 0x94, 0x98, 0x3c,
+    0x55, 0x46, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xad, 0x3b, 0xaa, 0xe7, 0x87, 0xc6, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xc7, 0xbd, 0x90, 0x95, 0xb1, 0x81, 0x68, 0xa9, 0x1b, 0xe5, 0xe5,
+    0x72, 0xc8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x21, 0x1a, 0x1a, 0x21, 0x5e, 0xc2, 0x40, 0x2f, 0x7c, 0xc5, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x21, 0xf1, 0x35, 0x3c, 0xdb, 0xdb, 0x3c, 0x98, 0xdb, 0xce, 0x15, 0x32, 0x3b, 0x15, 0x3d, 0xed,
+    0xb5, 0x32, 0x33, 0xce, 0x1a, 0x21, 0x1a, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xf1, 0xf0, 0x21, 0x00, 0x00,
+    0x97, 0xea, 0xa3, 0xc4, 0x15, 0xac, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 7
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00190d0a,
-    0x006d382b,
-    0x00673428,
-    0x00150a08,
-    0x000d0605,
-    0x00904838,
-    0x0040211a,
-    0x001f100c,
-    0x00180c09,
-    0x00140b08,
-    0x00190e0a,
-    0x00190e0a,
-    0x000d0805,
-    0x00030201,
-    0x00190e0a,
-    0x005b3323,
-    0x006d3d2b,
-    0x00593123,
-    0x0076402e,
-    0x002e1812,
-    0x00060302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00110c07,
-    0x001f160d,
-    0x0021170d,
-    0x00120c07,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00080503,
-    0x00291d10,
-    0x00644827,
-    0x00805c33,
-    0x00815b33,
-    0x00694a2a,
-    0x00372716,
-    0x00171109,
-    0x003c2b18,
-    0x00906838,
-    0x00906839,
-    0x003f2e19,
-    0x000d0905,
-    0x00050402,
-    0x00080503,
-    0x00070502,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00050402,
-    0x00140e08,
-    0x0022180d,
-    0x00281c10,
-    0x00352615,
-    0x00543b20,
-    0x00563d22,
-    0x00382816,
-    0x004a351c,
-    0x009e713e,
-    0x000a0704,
-    0x001c140b,
-    0x0071512c,
-    0x006b4d29,
-    0x0022180d,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000d0905,
-    0x002a1911,
-    0x002e1b12,
-    0x001d0f0b,
-    0x001e0f0c,
-    0x001d0e0b,
-    0x00110807,
-    0x002c1911,
-    0x00925239,
-    0x003f2118,
-    0x005c3024,
-    0x000d0705,
-    0x00633527,
-    0x005c3324,
-    0x005c3424,
-    0x00372016,
-    0x00351e14,
-    0x0020100c,
-    0x00733a2d,
-    0x004b251d,
-    0x00150b09,
-    0x00190f0a,
-    0x00392217,
-    0x003e2519,
-    0x0021130c,
-    0x000a0604,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000e0705,
-    0x002a1711,
-    0x002b1711,
-    0x000f0806,
-    0x00010100,
-    0x00000000,
-    0x00140d08,
-    0x003f2819,
-    0x0071472c,
-    0x00804f32,
-    0x006e412b,
-    0x004f2c1f,
-    0x001b0e0a,
-    0x00090503,
-    0x00100906,
-    0x00100906,
-    0x00080403,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd5, 0xb4, 0xdb, 0x35, 0xa8,
+    0x32, 0xce, 0x15, 0xd4, 0x35, 0xd5, 0xd5, 0xa9, 0xf0, 0xd5, 0xaa, 0xb5, 0xed, 0xa6, 0x6b, 0x97,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xc7, 0x5e, 0x5e, 0xc7, 0x96, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xc4, 0xf6, 0x7b, 0x7b, 0xd1, 0x8b, 0xee, 0x8c, 0xe4, 0xe4,
+    0x1b, 0xac, 0x97, 0x1a, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0x36, 0xff, 0x48,
+    0x88, 0x2f, 0x40, 0x8b, 0xf8, 0xe5, 0x1d, 0xe1, 0xb1, 0xd1, 0xff, 0xf0, 0x00, 0x00, 0x00, 0x21,
+    0xac, 0x99, 0x6b, 0xd7, 0xd7, 0xd7, 0xc6, 0x99, 0xca, 0xce, 0xaa, 0xa8, 0xda, 0xaa, 0xaa, 0x87,
+    0x87, 0x5d, 0xa6, 0x3d, 0xea, 0xef, 0xa0, 0xcf, 0x5d, 0xc9, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xa8, 0x98, 0x99, 0xad, 0x21, 0x00,
+    0x36, 0xcf, 0xb0, 0x86, 0xb5, 0x58, 0xd5, 0xc8, 0x68, 0x68, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 8
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002b1511,
-    0x00914938,
-    0x00120907,
-    0x001c0e0b,
-    0x0027140f,
-    0x00824433,
-    0x00864535,
-    0x00834233,
-    0x00673528,
-    0x004b291d,
-    0x00522e20,
-    0x00543021,
-    0x00391f16,
-    0x0024140e,
-    0x00371f15,
-    0x007a4330,
-    0x0020110c,
-    0x00040201,
-    0x0049261d,
-    0x005d3024,
-    0x00190c0a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030301,
-    0x00030301,
-    0x00110c07,
-    0x00372616,
-    0x00684828,
-    0x006c4b2a,
-    0x003d2a18,
-    0x00120d07,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070402,
-    0x00190e0a,
-    0x002c1a11,
-    0x002c1a11,
-    0x00190e0a,
-    0x00070402,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00070502,
-    0x00120c07,
-    0x00110c07,
-    0x00080603,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00080603,
-    0x002d2112,
-    0x006d4e2b,
-    0x00855e34,
-    0x007b5730,
-    0x00805a32,
-    0x00684a29,
-    0x00684b29,
-    0x006f4f2c,
-    0x005b4123,
-    0x00382816,
-    0x00412f1a,
-    0x004d371e,
-    0x004d371e,
-    0x003b2a17,
-    0x00161009,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00090603,
-    0x001f160c,
-    0x00422f1a,
-    0x006b4c2b,
-    0x007c5831,
-    0x008b6236,
-    0x003a2917,
-    0x00372715,
-    0x008b6337,
-    0x00876134,
-    0x00684b29,
-    0x00100b07,
-    0x00040302,
-    0x000e0a06,
-    0x004f381f,
-    0x005d4324,
-    0x00100b06,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x00281810,
-    0x0077482f,
-    0x0078492f,
-    0x002a1910,
-    0x000e0805,
-    0x001a0f0b,
-    0x001f110c,
-    0x0043271a,
-    0x00663a28,
-    0x0048271d,
-    0x00603326,
-    0x00030202,
-    0x0078402f,
-    0x0079422f,
-    0x00150c08,
-    0x001a0f0a,
-    0x001c0f0b,
-    0x00321c14,
-    0x006d3a2b,
-    0x007e3f32,
-    0x00542b21,
-    0x004a2a1d,
-    0x00854e34,
-    0x0093573a,
-    0x006b3f2a,
-    0x0044281b,
-    0x0020120c,
-    0x000a0503,
-    0x00020101,
-    0x00000000,
-    0x00020101,
-    0x00080503,
-    0x000b0604,
-    0x000b0704,
-    0x00080503,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00100a06,
-    0x001e120c,
-    0x001e120c,
-    0x00100906,
-    0x00030201,
-    0x00030101,
-    0x00281610,
-    0x0077412f,
-    0x0079422f,
-    0x00281610,
-    0x00030101,
-    0x00000000,
-    0x0021150d,
-    0x00684229,
-    0x00362315,
-    0x000d0805,
-    0x0020120c,
-    0x004e2c1f,
-    0x007a462f,
-    0x005b3324,
-    0x00603626,
-    0x00552f21,
-    0x00281610,
-    0x00080403,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x98, 0x32, 0xc6, 0xd7, 0x46,
+    0x56, 0x56, 0x56, 0xdb, 0x3d, 0x58, 0xec, 0xa0, 0xfe, 0x3c, 0x55, 0x5d, 0xf1, 0x3d, 0xaa, 0xd5,
+    0x00, 0x00, 0x00, 0x00, 0x21, 0xf0, 0xf0, 0xc7, 0x8b, 0xd0, 0xd1, 0x8c, 0xc7, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0xd5, 0x99, 0x99, 0xd5, 0x97, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0xc7, 0xc7, 0x1a, 0x21, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0x81, 0xb1, 0x7c, 0xc3, 0x7b, 0xd0, 0xd0, 0xb1, 0xbd,
+    0x8b, 0x1b, 0x52, 0x52, 0x8c, 0xee, 0x21, 0x00, 0x00, 0x00, 0x21, 0xc8, 0x5e, 0x72, 0xd1, 0xc3,
+    0x7c, 0x8c, 0x8b, 0x7c, 0x7c, 0xd0, 0x68, 0x96, 0xad, 0x2f, 0xbd, 0x68, 0x00, 0x00, 0x00, 0xf0,
+    0x98, 0xde, 0xde, 0x99, 0xac, 0xd5, 0x15, 0x44, 0xdd, 0x3d, 0xe7, 0xf0, 0xa6, 0x55, 0x36, 0xd5,
+    0xd7, 0x3b, 0xb4, 0x55, 0xec, 0x3e, 0x85, 0xca, 0xd3, 0x44, 0x5d, 0xc8, 0x21, 0x00, 0x21, 0x1a,
+    0x1d, 0x1d, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x21, 0x68, 0x15, 0x15, 0x68, 0xf0, 0xf0, 0x47, 0xa6, 0x55, 0x47, 0xf0, 0x00,
+    0xbf, 0xf7, 0x88, 0xa9, 0x5d, 0x57, 0x55, 0xaa, 0xe7, 0xec, 0x47, 0x1a, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 9
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000d0705,
-    0x00532b21,
-    0x009a503d,
-    0x00010101,
-    0x0024120e,
-    0x00281510,
-    0x0026140f,
-    0x001b0e0a,
-    0x00170c09,
-    0x0021110d,
-    0x006b3a2a,
-    0x0045271c,
-    0x003b2117,
-    0x00643627,
-    0x00673928,
-    0x00573022,
-    0x002f1913,
-    0x00040202,
-    0x00402119,
-    0x0025130f,
-    0x00793e2f,
-    0x00301813,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000c0805,
-    0x00281c0f,
-    0x002d1f12,
-    0x002d1f11,
-    0x00624426,
-    0x008f6438,
-    0x008c6137,
-    0x00694929,
-    0x0020160c,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00170e09,
-    0x00492a1d,
-    0x00834b33,
-    0x00834b33,
-    0x004a2b1d,
-    0x00190e0a,
-    0x00060403,
-    0x00110b06,
-    0x00160e09,
-    0x00170e09,
-    0x00110a06,
-    0x00080403,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060503,
-    0x00271b0f,
-    0x00523a20,
-    0x00543b20,
-    0x00281c10,
-    0x00070503,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001c130b,
-    0x005e4325,
-    0x007f5a32,
-    0x004b351d,
-    0x004b351e,
-    0x00040302,
-    0x00020101,
-    0x003d2b18,
-    0x00845f33,
-    0x007e5a31,
-    0x00171009,
-    0x00110c06,
-    0x00171109,
-    0x0075542e,
-    0x00372816,
-    0x00070503,
-    0x00000000,
-    0x00000000,
-    0x00010101,
-    0x0018120a,
-    0x004b361d,
-    0x007e5931,
-    0x005b4023,
-    0x00060402,
-    0x000c0905,
-    0x00000000,
-    0x00291e10,
-    0x001d150b,
-    0x00322414,
-    0x001a130a,
-    0x0021170d,
-    0x00614526,
-    0x004e381f,
-    0x00060402,
-    0x00040302,
-    0x0075532e,
-    0x001a120a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x00281810,
-    0x0075472e,
-    0x0074462e,
-    0x00311c13,
-    0x003c2118,
-    0x00713e2c,
-    0x007d4531,
-    0x007b4630,
-    0x002c1911,
-    0x00331d14,
-    0x003d2118,
-    0x00050302,
-    0x0047271c,
-    0x00040202,
-    0x002d1911,
-    0x000a0504,
-    0x0022130d,
-    0x00120a07,
-    0x00090504,
-    0x00100806,
-    0x0047241c,
-    0x006f3c2c,
-    0x007c4831,
-    0x00573423,
-    0x00673d28,
-    0x00894f35,
-    0x00693929,
-    0x0041211a,
-    0x00180c09,
-    0x00030201,
-    0x00171009,
-    0x00412b19,
-    0x00543721,
-    0x00553521,
-    0x00442a1b,
-    0x001b110a,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000f0906,
-    0x00352015,
-    0x00613b26,
-    0x00623c27,
-    0x00352115,
-    0x00100906,
-    0x00030101,
-    0x0028170f,
-    0x0075412e,
-    0x0074402d,
-    0x00281710,
-    0x00030101,
-    0x00070403,
-    0x003d2517,
-    0x00865434,
-    0x00040202,
-    0x00170e09,
-    0x00291710,
-    0x00361f15,
-    0x000a0604,
-    0x001c100b,
-    0x002e1a12,
-    0x007e4731,
-    0x00573022,
-    0x00160c08,
-    0x00070403,
-    0x00080503,
-    0x00020201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa8, 0x58, 0x33, 0x21, 0xbe, 0x47,
+    0x46, 0xd5, 0xea, 0xbe, 0xb4, 0x44, 0xa0, 0xda, 0xdb, 0xed, 0x6b, 0x96, 0xce, 0x46, 0xa6, 0x6b,
+    0x00, 0x00, 0x00, 0x21, 0xa9, 0x48, 0x6c, 0xc5, 0x4a, 0xe4, 0x7c, 0xd0, 0x5e, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xd4, 0x3e, 0x85, 0x85, 0x3e, 0xd5, 0x97, 0x68, 0xea,
+    0xd4, 0x68, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0x48, 0x2f, 0x2f, 0x48, 0x1a, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe1, 0xbd, 0x7b, 0x52, 0x52, 0x96, 0x21, 0x8c, 0x7c,
+    0x7b, 0xee, 0xc7, 0xee, 0xc2, 0x8b, 0x1a, 0x00, 0x00, 0x21, 0xef, 0x52, 0x7b, 0xbd, 0x97, 0xa9,
+    0x00, 0xc4, 0xe1, 0x82, 0xe1, 0x5e, 0x4a, 0x52, 0x97, 0x96, 0xc2, 0xe1, 0x00, 0x00, 0x00, 0xf0,
+    0x98, 0xde, 0xa7, 0x3b, 0xa0, 0xb5, 0x55, 0x55, 0x99, 0x3b, 0xa0, 0x96, 0x3d, 0x96, 0x6b, 0xc9,
+    0xbe, 0x35, 0xc8, 0xad, 0x3d, 0xb5, 0xdf, 0x2b, 0xdd, 0x32, 0xdb, 0xce, 0xd4, 0xf0, 0xee, 0x1b,
+    0x2f, 0x2b, 0x44, 0xd6, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xad, 0x87, 0xdc, 0xdc, 0x87, 0x68, 0xf0, 0x47, 0xa6, 0xa6, 0x98, 0xf0, 0x1a,
+    0xa1, 0x86, 0x96, 0xd4, 0x98, 0x87, 0xc9, 0xd6, 0x6b, 0xdf, 0xed, 0xea, 0x1a, 0x1a, 0xf0, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 10
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00351d15,
-    0x009d543e,
-    0x00120907,
-    0x0021110d,
-    0x0027150f,
-    0x00643527,
-    0x00733e2d,
-    0x00613326,
-    0x0043231a,
-    0x00120907,
-    0x00190d09,
-    0x00090503,
-    0x001c0f0b,
-    0x00321a13,
-    0x00522c20,
-    0x00583023,
-    0x004a281d,
-    0x00391e16,
-    0x00552b21,
-    0x0047241c,
-    0x0045231b,
-    0x00391d16,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x0025190f,
-    0x0076522e,
-    0x008a6036,
-    0x005f4225,
-    0x00684828,
-    0x00815933,
-    0x007c5631,
-    0x00644527,
-    0x001e150c,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00060302,
-    0x000f0906,
-    0x000f0906,
-    0x002d1a12,
-    0x007a4730,
-    0x00402519,
-    0x00341e14,
-    0x0095573a,
-    0x00593422,
-    0x00492c1d,
-    0x00603c26,
-    0x00663f28,
-    0x00623b26,
-    0x00523020,
-    0x0026160f,
-    0x00070403,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000f0b06,
-    0x004d361e,
-    0x00a37340,
-    0x00a57440,
-    0x00513920,
-    0x00120d07,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x000e0a05,
-    0x00312313,
-    0x00583e22,
-    0x008a6236,
-    0x00000000,
-    0x0071502c,
-    0x007b5730,
-    0x00593f23,
-    0x0023190e,
-    0x00100b06,
-    0x005d4325,
-    0x006c4e2b,
-    0x0049341c,
-    0x002b1f11,
-    0x003d2c18,
-    0x00080603,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x003e2c18,
-    0x003d2c18,
-    0x0023190e,
-    0x002b1f11,
-    0x003c2b17,
-    0x004e381f,
-    0x003f2d19,
-    0x00332514,
-    0x00140e08,
-    0x00281d10,
-    0x00140f08,
-    0x00312413,
-    0x006e4f2b,
-    0x006b4c2a,
-    0x0050381f,
-    0x00513920,
-    0x00563d22,
-    0x00120d07,
-    0x00000000,
-    0x00020101,
-    0x000d0805,
-    0x001a110a,
-    0x002d1d12,
-    0x004d311f,
-    0x004c301e,
-    0x00392216,
-    0x0072402d,
-    0x0024160e,
-    0x0021130d,
-    0x001b100b,
-    0x00311c13,
-    0x004b2b1d,
-    0x00412319,
-    0x00351d15,
-    0x0020120d,
-    0x002f1b12,
-    0x00291810,
-    0x00000000,
-    0x00301c12,
-    0x00583323,
-    0x00532e21,
-    0x00351b15,
-    0x00140a08,
-    0x00572e22,
-    0x004a281d,
-    0x00653828,
-    0x00673d29,
-    0x00633927,
-    0x006c392b,
-    0x00864334,
-    0x003e1f18,
-    0x0021150d,
-    0x00563921,
-    0x008b5c37,
-    0x00634027,
-    0x0071482c,
-    0x009d623d,
-    0x00492d1c,
-    0x000b0705,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001b110b,
-    0x005c3824,
-    0x00875235,
-    0x007f4d32,
-    0x005b3724,
-    0x001b100b,
-    0x00010101,
-    0x00190f0a,
-    0x00472a1c,
-    0x00482b1c,
-    0x00190f0a,
-    0x00020101,
-    0x001c110b,
-    0x00694029,
-    0x00120b07,
-    0x0021150d,
-    0x002a1910,
-    0x004f2d1f,
-    0x0072402c,
-    0x0079462f,
-    0x006a3f2a,
-    0x003e2518,
-    0x002b1911,
-    0x00653a28,
-    0x002a1910,
-    0x00412919,
-    0x00452b1b,
-    0x001e130c,
-    0x00020201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x33, 0xc6, 0xbe, 0x47, 0xda,
+    0xa6, 0xe7, 0x43, 0xc6, 0xd4, 0xc8, 0xd7, 0x3b, 0x58, 0xed, 0x3d, 0x3c, 0xec, 0x3d, 0x43, 0x3c,
+    0x00, 0x00, 0x00, 0xf0, 0xa3, 0xc2, 0x7c, 0xbd, 0xd0, 0x7b, 0xc3, 0xf6, 0x5e, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x21, 0x97, 0xad, 0xad, 0x6b, 0xdf, 0xcf, 0x87, 0xca, 0x2b, 0x3e, 0x8d, 0xd2,
+    0xdc, 0x2e, 0x47, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0x52, 0x95, 0x95, 0x2f, 0xc7, 0x00,
+    0x00, 0x00, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0xac, 0x82, 0x40, 0x7c, 0x00, 0xb1, 0xc3, 0x40, 0xff,
+    0x68, 0xbd, 0xb1, 0xf8, 0xc5, 0x8c, 0x1a, 0x00, 0x00, 0x97, 0x1b, 0x8c, 0xff, 0xc5, 0x8c, 0x52,
+    0x1b, 0x82, 0x36, 0xc4, 0x36, 0x82, 0xb1, 0xd1, 0x2f, 0x2f, 0x40, 0xc7, 0x00, 0x21, 0xa9, 0xef,
+    0x6c, 0xf9, 0xf9, 0xa0, 0xf3, 0xfe, 0xbe, 0xd6, 0x3b, 0x57, 0xce, 0x3c, 0x5d, 0x6b, 0x98, 0x00,
+    0x3b, 0x2b, 0xec, 0x3c, 0x35, 0xec, 0x3d, 0xda, 0xdd, 0x49, 0xb4, 0x56, 0xce, 0xbf, 0x3f, 0x7c,
+    0xd2, 0xb0, 0xcb, 0x3e, 0x1d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xd6, 0xab, 0x86, 0x85, 0xab, 0xd6, 0x21, 0xef, 0x3e, 0x3e, 0xef, 0x21, 0xd6,
+    0xd3, 0x35, 0xbf, 0x99, 0x58, 0xf3, 0x55, 0xd3, 0xcf, 0x99, 0xda, 0x99, 0xcf, 0x71, 0x15, 0xf0,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 11
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00613526,
-    0x0024130e,
-    0x00753d2e,
-    0x007b4031,
-    0x005c3124,
-    0x006c3a2a,
-    0x00573022,
-    0x00391f16,
-    0x001f110c,
-    0x000b0604,
-    0x000f0806,
-    0x0020110d,
-    0x0022120d,
-    0x002d1812,
-    0x003b2117,
-    0x003b2117,
-    0x00371e16,
-    0x002c1811,
-    0x002a1611,
-    0x00190d0a,
-    0x001e0f0c,
-    0x00130a08,
-    0x00000000,
-    0x00000000,
-    0x00070503,
-    0x00160f09,
-    0x00412d1a,
-    0x0072502d,
-    0x00322314,
-    0x00825b33,
-    0x00543a20,
-    0x005b3f24,
-    0x005c4024,
-    0x003f2b18,
-    0x00281910,
-    0x0024150e,
-    0x0023150d,
-    0x00140c08,
-    0x00070402,
-    0x00030201,
-    0x00030201,
-    0x00070402,
-    0x0022130d,
-    0x00482a1c,
-    0x00492a1d,
-    0x0046281c,
-    0x0077452e,
-    0x00301c13,
-    0x000e0806,
-    0x004d2d1e,
-    0x007c4930,
-    0x009a5c3d,
-    0x008f5638,
-    0x009e5f3f,
-    0x009e5c3e,
-    0x009b5a3d,
-    0x004b2c1e,
-    0x00110a06,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000e0a06,
-    0x0049341d,
-    0x009a6d3c,
-    0x009c6e3d,
-    0x004e371e,
-    0x00110c07,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000d0905,
-    0x00261a0f,
-    0x00271c0f,
-    0x000d0905,
-    0x00030202,
-    0x000d0905,
-    0x001b130a,
-    0x00614526,
-    0x00020101,
-    0x00614426,
-    0x00533b21,
-    0x00040302,
-    0x00090604,
-    0x000d0905,
-    0x00040302,
-    0x00030201,
-    0x003b2a17,
-    0x001b130a,
-    0x003e2c18,
-    0x00090603,
-    0x000b0804,
-    0x00140e08,
-    0x00191209,
-    0x004a361d,
-    0x00140f08,
-    0x0043301a,
-    0x0043301a,
-    0x00352615,
-    0x00030201,
-    0x00070503,
-    0x000e0a05,
-    0x00140e08,
-    0x00241a0e,
-    0x00322413,
-    0x00604626,
-    0x0044301b,
-    0x003d2a18,
-    0x004f361f,
-    0x004c351e,
-    0x0023190e,
-    0x00060402,
-    0x00000000,
-    0x000c0705,
-    0x002a1b10,
-    0x004e331f,
-    0x00664328,
-    0x007f5332,
-    0x00784d30,
-    0x005e3925,
-    0x00673928,
-    0x00462a1b,
-    0x001e120c,
-    0x0026150f,
-    0x00170d09,
-    0x00110a07,
-    0x00130a07,
-    0x000b0604,
-    0x000c0605,
-    0x001a0f0a,
-    0x002c1a11,
-    0x002a1911,
-    0x00090503,
-    0x00030101,
-    0x000c0705,
-    0x0026140f,
-    0x00060302,
-    0x001a0e0a,
-    0x00301a13,
-    0x0023150d,
-    0x0076472f,
-    0x0070442c,
-    0x00814533,
-    0x007f4032,
-    0x0042241a,
-    0x00462d1b,
-    0x008c5d37,
-    0x002c1e11,
-    0x00301f13,
-    0x0041291a,
-    0x00613e26,
-    0x006c462b,
-    0x001f150c,
-    0x00010101,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00050302,
-    0x000e0906,
-    0x000e0906,
-    0x00070403,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0019100a,
-    0x00583623,
-    0x00794930,
-    0x0070452c,
-    0x00583622,
-    0x001a100a,
-    0x00030202,
-    0x002d1b11,
-    0x007b4b31,
-    0x00794a30,
-    0x0041261a,
-    0x001f110c,
-    0x0022140d,
-    0x000d0805,
-    0x0023160e,
-    0x00291a10,
-    0x002c1b12,
-    0x00351e15,
-    0x00542f21,
-    0x0074452e,
-    0x00815033,
-    0x00623d26,
-    0x001d120c,
-    0x0073462d,
-    0x00603d26,
-    0x00a36840,
-    0x00a66a41,
-    0x004b301e,
-    0x000a0604,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe7, 0x46, 0xa6, 0x55, 0xaa, 0xb4,
+    0xed, 0xa0, 0x15, 0x1d, 0xad, 0x5d, 0xbe, 0x6b, 0xa0, 0xa0, 0x3c, 0x99, 0x98, 0xd5, 0xd7, 0x35,
+    0x00, 0x00, 0x1a, 0xeb, 0x1b, 0xb1, 0x82, 0x7b, 0x2f, 0xbc, 0xbd, 0x1b, 0x98, 0xfe, 0xbf, 0x36,
+    0x97, 0xf0, 0xf0, 0x97, 0xbe, 0x3e, 0x3e, 0x44, 0xa7, 0x3b, 0xad, 0x57, 0xdf, 0xcb, 0xca, 0xcb,
+    0xcb, 0xcb, 0x57, 0x68, 0x00, 0x00, 0x00, 0x00, 0x00, 0xad, 0xf8, 0xe5, 0xe5, 0x52, 0xc7, 0x00,
+    0x00, 0x00, 0x21, 0xac, 0x48, 0x48, 0xac, 0xf0, 0xac, 0xe1, 0x4a, 0x21, 0x4a, 0x2f, 0x96, 0xc9,
+    0xac, 0x96, 0xf0, 0x8c, 0xe1, 0x1b, 0xc8, 0x1d, 0x36, 0xef, 0x52, 0x36, 0x72, 0x72, 0x88, 0xf0,
+    0x1a, 0xac, 0x36, 0xff, 0x82, 0x4a, 0x72, 0x8c, 0x2f, 0x52, 0xff, 0x97, 0x00, 0xa8, 0xc4, 0x2e,
+    0xf7, 0x86, 0xc2, 0xab, 0xdb, 0x44, 0x15, 0x46, 0xea, 0xc6, 0x35, 0x1d, 0xa8, 0xd5, 0x99, 0x99,
+    0xc8, 0xf0, 0xa8, 0x46, 0x97, 0xd5, 0x3b, 0xbf, 0xde, 0xf3, 0x56, 0x55, 0x43, 0x3e, 0x7c, 0xc5,
+    0x81, 0xcf, 0xdc, 0xf2, 0x5e, 0x21, 0x00, 0x00, 0x21, 0x96, 0xad, 0xad, 0x1a, 0x21, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xef, 0x2b, 0xdf, 0xf3, 0x2b, 0xef, 0xf0, 0x6b, 0xdf, 0xdf, 0xcf, 0x15, 0xbf,
+    0xa9, 0xfe, 0xc4, 0x6b, 0x87, 0xec, 0xa7, 0x86, 0xdc, 0x15, 0xa7, 0x8d, 0x95, 0x95, 0xf9, 0xc9,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 12
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x006a392a,
-    0x00000000,
-    0x008c4936,
-    0x008b4937,
-    0x006f3b2b,
-    0x00593123,
-    0x000f0f0f,
-    0x003e3e3e,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x00504845,
-    0x00282322,
-    0x00000000,
-    0x00060302,
-    0x002b1911,
-    0x0049301d,
-    0x006f4d2b,
-    0x00624426,
-    0x004c341e,
-    0x007c5630,
-    0x00332314,
-    0x001f150c,
-    0x002e2012,
-    0x0050351f,
-    0x00603c26,
-    0x006e412b,
-    0x00683d29,
-    0x003d2318,
-    0x001e130c,
-    0x0025180f,
-    0x0026180f,
-    0x001a100a,
-    0x0043271a,
-    0x008d5238,
-    0x008f5338,
-    0x00563222,
-    0x00482a1c,
-    0x00814b32,
-    0x00502e20,
-    0x00170d09,
-    0x005d3725,
-    0x008e5238,
-    0x008f5338,
-    0x00905538,
-    0x00925539,
-    0x0093553a,
-    0x005e3725,
-    0x0021140d,
-    0x00020201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x000f0906,
-    0x002d1e11,
-    0x00553a21,
-    0x00563b22,
-    0x00342214,
-    0x00150e08,
-    0x00060402,
-    0x00010100,
-    0x00000000,
-    0x00040302,
-    0x00291c10,
-    0x0074512e,
-    0x0075512e,
-    0x002b1d10,
-    0x00040302,
-    0x00000000,
-    0x000c0905,
-    0x004b361d,
-    0x001e150c,
-    0x002f2213,
-    0x00161009,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x00070503,
-    0x00171009,
-    0x006e4e2b,
-    0x00332514,
-    0x00312313,
-    0x0045311b,
-    0x0044301b,
-    0x0048331c,
-    0x004e381f,
-    0x00181209,
-    0x0022190d,
-    0x000f0b06,
-    0x00373532,
-    0x00444240,
-    0x00444240,
-    0x00403f3e,
-    0x003f3e3e,
-    0x001c1814,
-    0x00372716,
-    0x00523820,
-    0x005d3d24,
-    0x00583923,
-    0x00362415,
-    0x00120c07,
-    0x00000000,
-    0x00000000,
-    0x00191009,
-    0x004f331f,
-    0x006e462b,
-    0x00523420,
-    0x00543621,
-    0x006d442b,
-    0x00613a26,
-    0x00301a13,
-    0x000c0705,
-    0x00493d39,
-    0x004c4643,
-    0x003e3e3d,
-    0x0041403e,
-    0x00484441,
-    0x00484441,
-    0x0042413f,
-    0x003e3e3e,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x003d3d3d,
-    0x001f1f1f,
-    0x00020101,
-    0x00170d09,
-    0x001f140c,
-    0x00664328,
-    0x00784f2f,
-    0x005a3724,
-    0x003e2119,
-    0x00382216,
-    0x007a4f30,
-    0x00030202,
-    0x000a0704,
-    0x00462d1c,
-    0x00573923,
-    0x00312013,
-    0x005c3c24,
-    0x005e3e25,
-    0x002e1e12,
-    0x001f140c,
-    0x00130c08,
-    0x000c0805,
-    0x0021160d,
-    0x00442d1a,
-    0x00452d1b,
-    0x0021160d,
-    0x00060402,
-    0x00000000,
-    0x00010101,
-    0x00060502,
-    0x00090603,
-    0x00050202,
-    0x000e0806,
-    0x002f1c12,
-    0x00543321,
-    0x00533321,
-    0x002e1c12,
-    0x000e0806,
-    0x00050302,
-    0x003e2518,
-    0x0026160f,
-    0x00030201,
-    0x000c0705,
-    0x00020101,
-    0x00201f1f,
-    0x00584d48,
-    0x004f4845,
-    0x00504945,
-    0x00484441,
-    0x00403f3e,
-    0x00000000,
-    0x00050302,
-    0x0076482e,
-    0x00653f27,
-    0x000a0704,
-    0x007a4d2f,
-    0x0099613c,
-    0x00734a2e,
-    0x00a96c42,
-    0x00492e1c,
-    0x000b0705,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xdb, 0x00, 0x32, 0x32, 0xb4, 0xed,
+    0x0f, 0x3a, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x51, 0x29, 0x9c,
+    0x00, 0x97, 0x99, 0xf9, 0xb1, 0x4a, 0x52, 0xc3, 0x82, 0x5e, 0x81, 0x2e, 0x8d, 0xb5, 0xdd, 0xa1,
+    0x15, 0xa3, 0xa3, 0xef, 0x44, 0xca, 0xca, 0xed, 0x3e, 0x85, 0x58, 0xea, 0xab, 0xca, 0xca, 0xca,
+    0xca, 0xca, 0xab, 0xbf, 0xf0, 0x00, 0x00, 0x00, 0x21, 0xad, 0x6c, 0x3f, 0x3f, 0x82, 0x36, 0x97,
+    0x21, 0x00, 0x96, 0xc4, 0xc2, 0xc2, 0xc4, 0x96, 0x00, 0xa9, 0x52, 0x5e, 0x81, 0xee, 0x51, 0x51,
+    0x51, 0x51, 0x51, 0x1a, 0xee, 0xb1, 0x82, 0x82, 0x72, 0x72, 0xf8, 0x52, 0xee, 0xff, 0x68, 0x4b,
+    0x26, 0x26, 0x39, 0x39, 0x6a, 0x8b, 0x2f, 0xbc, 0x3f, 0x88, 0xc7, 0x00, 0x00, 0xef, 0x2e, 0xf2,
+    0x2e, 0x2b, 0xf2, 0x49, 0x3b, 0xa8, 0x24, 0x34, 0x51, 0x39, 0x73, 0x73, 0x26, 0x3a, 0x51, 0x51,
+    0x51, 0x51, 0x51, 0x51, 0x70, 0x21, 0xea, 0x15, 0xf7, 0xc2, 0xab, 0xce, 0xa0, 0xc2, 0xf0, 0x1d,
+    0x3e, 0x3f, 0x81, 0xbc, 0xbc, 0x6c, 0x15, 0x35, 0xa9, 0x5e, 0x71, 0x71, 0x5e, 0x97, 0x00, 0x21,
+    0x97, 0xc8, 0x96, 0xad, 0x6c, 0x2e, 0x2e, 0x6c, 0xad, 0x96, 0xcf, 0x47, 0xf0, 0xa8, 0x21, 0x70,
+    0x2a, 0x29, 0x29, 0x73, 0x39, 0x00, 0x96, 0xde, 0xd2, 0x1d, 0xdf, 0xcb, 0xb0, 0x95, 0x3e, 0x1d,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 13
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00562f22,
-    0x00371e15,
-    0x006c3a2a,
-    0x00814532,
-    0x007a4130,
-    0x0042241a,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fdf9f8,
-    0x00928783,
-    0x00030101,
-    0x00120a07,
-    0x00643927,
-    0x00734e2d,
-    0x0025140f,
-    0x00120c07,
-    0x00583d23,
-    0x00593e23,
-    0x00402d19,
-    0x0046311b,
-    0x00634527,
-    0x005e3e25,
-    0x007b4b31,
-    0x00613e26,
-    0x003a2217,
-    0x006a3e2a,
-    0x00442a1b,
-    0x006b442a,
-    0x006f462c,
-    0x003b2517,
-    0x004d2d1e,
-    0x00884f35,
-    0x00884f35,
-    0x00482a1d,
-    0x0028170f,
-    0x00523020,
-    0x006b3d2a,
-    0x0025160e,
-    0x00633a27,
-    0x00874f35,
-    0x008a5036,
-    0x008a5136,
-    0x00824c33,
-    0x007f4b32,
-    0x00845034,
-    0x00523320,
-    0x00261a0f,
-    0x0024190e,
-    0x00392516,
-    0x00442b1a,
-    0x0044291a,
-    0x004d2e1e,
-    0x00593423,
-    0x00623b26,
-    0x00673d28,
-    0x005b3624,
-    0x0046281b,
-    0x001f120c,
-    0x00060302,
-    0x00000000,
-    0x00080503,
-    0x003e2818,
-    0x00724b2d,
-    0x006c472b,
-    0x003e2818,
-    0x00090604,
-    0x00000000,
-    0x00150f08,
-    0x00543d21,
-    0x00030201,
-    0x0022180d,
-    0x000b0804,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00665e56,
-    0x001c140b,
-    0x00150f08,
-    0x005c4224,
-    0x00664928,
-    0x00352514,
-    0x0049341c,
-    0x005e4325,
-    0x00563e22,
-    0x000c0805,
-    0x000d0905,
-    0x00060402,
-    0x00eae8e6,
-    0x00fcfaf8,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f6f6f5,
-    0x00494541,
-    0x00100b06,
-    0x00704a2c,
-    0x00674628,
-    0x003b2717,
-    0x00694329,
-    0x00332014,
-    0x00160e08,
-    0x000c0705,
-    0x00291910,
-    0x00653e28,
-    0x00653d28,
-    0x00603926,
-    0x0071442d,
-    0x00643928,
-    0x005f3525,
-    0x0025140e,
-    0x000a0604,
-    0x00d2c5c1,
-    0x00fcf9f8,
-    0x00f7f6f6,
-    0x00f9f7f6,
-    0x00fefbf8,
-    0x00fefbf9,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00d6d6d5,
-    0x0043413f,
-    0x00130c08,
-    0x003c2518,
-    0x00724a2d,
-    0x00603d26,
-    0x0041281a,
-    0x004c301e,
-    0x002d1d12,
-    0x002e1d12,
-    0x0023160e,
-    0x001e130b,
-    0x00120c07,
-    0x001e140c,
-    0x00080503,
-    0x00372416,
-    0x006b462a,
-    0x007d4f31,
-    0x005a3923,
-    0x00301e13,
-    0x00472f1c,
-    0x00895b36,
-    0x00825633,
-    0x004c321e,
-    0x001a100a,
-    0x000f0906,
-    0x0021150d,
-    0x00402819,
-    0x004f2e1f,
-    0x0042251a,
-    0x0020120d,
-    0x00160d09,
-    0x00190f0a,
-    0x00180e09,
-    0x000d0805,
-    0x00030201,
-    0x00030201,
-    0x00341f14,
-    0x00311c13,
-    0x002d1911,
-    0x0027160f,
-    0x000c0705,
-    0x00998b86,
-    0x00fffaf9,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00fbf9f7,
-    0x00f7f6f6,
-    0x00000000,
-    0x00070403,
-    0x00653a28,
-    0x004a2e1d,
-    0x00000000,
-    0x00060402,
-    0x00100a07,
-    0x00905b38,
-    0x00684229,
-    0x002c1c11,
-    0x00150d08,
-    0x00080503,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xec, 0x3c, 0xb4, 0x56, 0x55, 0x43,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x65,
+    0xf0, 0x35, 0xda, 0xb1, 0x46, 0xc7, 0x40, 0x40, 0x1b, 0x72, 0xf6, 0xbc, 0xdf, 0xdc, 0xa0, 0xd3,
+    0x44, 0xf7, 0xf2, 0xa1, 0x57, 0x32, 0x32, 0x3e, 0x47, 0x2e, 0xd3, 0xfe, 0xdc, 0x86, 0x32, 0x32,
+    0x85, 0x85, 0x86, 0x2e, 0x48, 0xff, 0x8b, 0x71, 0x44, 0xf9, 0x2b, 0xdc, 0xdd, 0xab, 0x44, 0x15,
+    0x97, 0x00, 0x1a, 0xcf, 0xb0, 0xf2, 0xcf, 0xc9, 0x00, 0xeb, 0x40, 0xf0, 0xff, 0x1d, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x60, 0xe1, 0xeb, 0xbd, 0xd0, 0x88, 0xf8, 0xbd, 0x40, 0xa9, 0xac, 0x97, 0x42,
+    0x4d, 0x4d, 0x5b, 0x01, 0x74, 0x68, 0xb0, 0xd0, 0xa1, 0xf7, 0x82, 0xeb, 0xa8, 0x98, 0xd2, 0xd2,
+    0x49, 0xf3, 0xda, 0xe7, 0x46, 0xc9, 0xbb, 0x4d, 0x59, 0x5a, 0x13, 0x13, 0x5b, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0xc0, 0x26, 0x35, 0xa1, 0xb0, 0x8d, 0xcf, 0xf9, 0x6c, 0x6c, 0xfe,
+    0x15, 0xc7, 0x15, 0x1a, 0x88, 0xf2, 0xdf, 0x3f, 0x3b, 0x3e, 0x7c, 0x86, 0xf9, 0xef, 0xad, 0xbf,
+    0xcf, 0x58, 0x43, 0x5d, 0xea, 0xef, 0xd4, 0xa9, 0xf0, 0xf0, 0x87, 0x3b, 0x6b, 0x47, 0xa8, 0x54,
+    0x13, 0x4e, 0x4e, 0x4d, 0x59, 0x00, 0x1a, 0xda, 0x3e, 0x00, 0x97, 0x68, 0xca, 0xf7, 0xc4, 0x36,
+    0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 14
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x0049291d,
-    0x00633627,
-    0x0042231a,
-    0x006c3a2a,
-    0x00703b2c,
-    0x00371d16,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fefaf8,
-    0x009c8d87,
-    0x00070403,
-    0x001d100b,
-    0x006c3f2a,
-    0x006a4429,
-    0x004e341f,
-    0x0048321c,
-    0x000e0a06,
-    0x00322314,
-    0x00150e08,
-    0x000b0704,
-    0x00110b07,
-    0x002f1d12,
-    0x00643b27,
-    0x006a4529,
-    0x002e1c12,
-    0x0078482f,
-    0x0072472c,
-    0x00764b2e,
-    0x00794c30,
-    0x00683e29,
-    0x00663c28,
-    0x00673d29,
-    0x00563222,
-    0x00362015,
-    0x003f2719,
-    0x0074442d,
-    0x0028170f,
-    0x00281710,
-    0x003e2418,
-    0x0042271a,
-    0x00693d29,
-    0x006a3e29,
-    0x0046291b,
-    0x0076482e,
-    0x00784d2f,
-    0x00815533,
-    0x00714d2c,
-    0x007b5530,
-    0x00402b19,
-    0x0020140c,
-    0x00321e14,
-    0x001c110b,
-    0x00000000,
-    0x00000000,
-    0x00140c08,
-    0x002b1911,
-    0x00653c28,
-    0x0044291b,
-    0x00100a06,
-    0x00010100,
-    0x000c0705,
-    0x0042281a,
-    0x00613926,
-    0x005b3624,
-    0x0043281b,
-    0x000e0805,
-    0x00000000,
-    0x00140e08,
-    0x004f391f,
-    0x00080603,
-    0x0019120a,
-    0x00090704,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00aeacaa,
-    0x00090603,
-    0x00160f08,
-    0x00110c07,
-    0x00050302,
-    0x00100b06,
-    0x00171109,
-    0x00594023,
-    0x0022180e,
-    0x001a130a,
-    0x00070503,
-    0x00706963,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00f9f7f6,
-    0x00534c45,
-    0x0024170e,
-    0x005b3d23,
-    0x006a4829,
-    0x00553921,
-    0x000d0a05,
-    0x00412819,
-    0x00653d27,
-    0x003a2317,
-    0x00523220,
-    0x00663d28,
-    0x00311e13,
-    0x002d1b11,
-    0x00563121,
-    0x006c3d2a,
-    0x006a372a,
-    0x0024130e,
-    0x00090504,
-    0x00d2c5c2,
-    0x00fbf9f8,
-    0x00f7f6f6,
-    0x00f9f7f6,
-    0x00fefbf9,
-    0x00fefbf9,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f6,
-    0x00f9f8f6,
-    0x00edeae8,
-    0x00362e28,
-    0x001e130c,
-    0x004a2f1d,
-    0x003f2919,
-    0x006f462c,
-    0x00603d26,
-    0x00030201,
-    0x001f130c,
-    0x0024160e,
-    0x00110b07,
-    0x00110b07,
-    0x00402a19,
-    0x004c321e,
-    0x005a3b23,
-    0x00543721,
-    0x003b2617,
-    0x00120b07,
-    0x00603c26,
-    0x00503320,
-    0x006a4529,
-    0x00432b1a,
-    0x006f462b,
-    0x003d2518,
-    0x0043291a,
-    0x005d3925,
-    0x007c4830,
-    0x007c4631,
-    0x004e2e1f,
-    0x00703d2c,
-    0x004b281d,
-    0x0026130f,
-    0x00110807,
-    0x00050202,
-    0x000b0504,
-    0x00190e0a,
-    0x0042261a,
-    0x005e3724,
-    0x00523021,
-    0x002b1811,
-    0x000d0705,
-    0x009c8c87,
-    0x00fffaf9,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00fbf9f7,
-    0x00f7f6f6,
-    0x00000000,
-    0x00060302,
-    0x00502d1f,
-    0x00281810,
-    0x000c0805,
-    0x00332014,
-    0x001a110a,
-    0x00955e3b,
-    0x005d3925,
-    0x005c3924,
-    0x005b3924,
-    0x002c1c11,
-    0x00090603,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0x3d, 0xda, 0x43, 0xb4, 0xb4, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4e, 0x54,
+    0x1a, 0xd7, 0xd3, 0xf7, 0x52, 0xf8, 0xad, 0x82, 0x36, 0x1d, 0xc7, 0x6c, 0xdc, 0xf7, 0x6c, 0xde,
+    0xb0, 0xde, 0xdf, 0xdd, 0xdd, 0xdd, 0xed, 0x87, 0xcf, 0xa7, 0x47, 0x98, 0xce, 0x44, 0xdd, 0xd3,
+    0x44, 0xde, 0xc2, 0x86, 0xb1, 0xc3, 0x1b, 0x5d, 0x3b, 0xd6, 0x00, 0x00, 0x36, 0x99, 0xd2, 0x44,
+    0x68, 0x21, 0xa8, 0x44, 0x49, 0xab, 0x44, 0xac, 0x00, 0x36, 0x2f, 0x1a, 0xef, 0xc9, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0xfd, 0xc8, 0xeb, 0xc7, 0x96, 0x68, 0xee, 0x40, 0xff, 0xe1, 0x1a, 0x09, 0x4d,
+    0x5b, 0x5b, 0x4d, 0x5a, 0x29, 0xa3, 0xbc, 0xd1, 0x3f, 0xac, 0xcf, 0xd2, 0xa1, 0x2e, 0xd2, 0x3b,
+    0x6b, 0xed, 0xd3, 0xdb, 0x46, 0xc8, 0xbb, 0x4d, 0x59, 0x5a, 0x13, 0x13, 0x5b, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x59, 0x5b, 0x42, 0x23, 0x15, 0xf9, 0xcf, 0xf2, 0x8d, 0xf0, 0x15, 0xfe,
+    0xc7, 0xc7, 0x1b, 0xf9, 0x3f, 0x2f, 0xa1, 0x35, 0x8d, 0x2e, 0xf7, 0x71, 0xf2, 0xa1, 0x44, 0xab,
+    0xdf, 0x55, 0xf9, 0xb5, 0x3d, 0x46, 0xc6, 0x96, 0xc9, 0xd5, 0x43, 0xab, 0x2e, 0x99, 0xa8, 0x54,
+    0x13, 0x4e, 0x4e, 0x4d, 0x59, 0x00, 0x97, 0x58, 0x98, 0xa9, 0x82, 0xef, 0xcb, 0xab, 0xab, 0xab,
+    0xc4, 0xc8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 15
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000f0906,
-    0x005b3324,
-    0x003a2016,
-    0x00361c15,
-    0x004a271d,
-    0x004f291f,
-    0x00321a13,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fefaf8,
-    0x008a8380,
-    0x00090503,
-    0x00190e0a,
-    0x005a3623,
-    0x00684829,
-    0x0023170e,
-    0x002c1f11,
-    0x001d140c,
-    0x0050361f,
-    0x006d492b,
-    0x006d492b,
-    0x004f351f,
-    0x003c2718,
-    0x00653e28,
-    0x0074482d,
-    0x005b3824,
-    0x00281910,
-    0x00070403,
-    0x001e130c,
-    0x002f1c12,
-    0x0020120d,
-    0x0022140d,
-    0x005b3624,
-    0x006a402a,
-    0x00623d27,
-    0x00482c1c,
-    0x00120b07,
-    0x004a2b1d,
-    0x00653b28,
-    0x005e3725,
-    0x0042261a,
-    0x00100906,
-    0x0044271b,
-    0x005b3623,
-    0x003a2317,
-    0x00422b1a,
-    0x006a452a,
-    0x001d120b,
-    0x00181109,
-    0x00563822,
-    0x00684229,
-    0x00553421,
-    0x004e2f1f,
-    0x00623a26,
-    0x005c3824,
-    0x003b2417,
-    0x000b0704,
-    0x00301d12,
-    0x00654028,
-    0x00352315,
-    0x00110b07,
-    0x000d0805,
-    0x00382116,
-    0x0074442e,
-    0x0072432c,
-    0x003a2217,
-    0x000c0705,
-    0x00040301,
-    0x00171109,
-    0x004a351d,
-    0x00261c0f,
-    0x00130e08,
-    0x00060402,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x002e2a24,
-    0x00171009,
-    0x00312313,
-    0x0048331c,
-    0x0046321b,
-    0x00010100,
-    0x00372715,
-    0x00080503,
-    0x00181109,
-    0x00010101,
-    0x00bfbcba,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f9f8f7,
-    0x00fdfaf8,
-    0x00fbf9f8,
-    0x005a4f48,
-    0x00261b0f,
-    0x00664628,
-    0x005f3e25,
-    0x006b452a,
-    0x00593823,
-    0x00462b1b,
-    0x001b100a,
-    0x00513220,
-    0x00311d13,
-    0x005e3825,
-    0x00613e26,
-    0x00664128,
-    0x004b301d,
-    0x00120a07,
-    0x0043271a,
-    0x00160c09,
-    0x00060302,
-    0x00d2c5c2,
-    0x00f8f7f6,
-    0x00f6f5f5,
-    0x00f7f6f6,
-    0x00f9f8f7,
-    0x00f9f8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00fefbf8,
-    0x00fdfaf8,
-    0x00988d86,
-    0x00150d08,
-    0x0026180f,
-    0x00613d26,
-    0x00362115,
-    0x005e3c25,
-    0x00472e1c,
-    0x001b110a,
-    0x00110b07,
-    0x00030201,
-    0x00000000,
-    0x00432b1a,
-    0x00684429,
-    0x00764e2e,
-    0x00764e2e,
-    0x0070482c,
-    0x003d2718,
-    0x0073472d,
-    0x00452c1b,
-    0x00694329,
-    0x003f2819,
-    0x00633d27,
-    0x00633b27,
-    0x004b2c1d,
-    0x00382416,
-    0x006e482b,
-    0x0072462d,
-    0x005f3525,
-    0x0044241b,
-    0x00050202,
-    0x003e2218,
-    0x006f3f2b,
-    0x005f3626,
-    0x00522e20,
-    0x005f3325,
-    0x005b3524,
-    0x00573622,
-    0x004b2e1e,
-    0x0024150e,
-    0x000d0705,
-    0x009b8c86,
-    0x00fffaf9,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00000000,
-    0x00090504,
-    0x00321c13,
-    0x00050302,
-    0x00010100,
-    0x00060402,
-    0x0025170e,
-    0x00835134,
-    0x008e5437,
-    0x005b3724,
-    0x008c5637,
-    0x00623d26,
-    0x00150d09,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xad, 0xaa, 0xa0, 0x3c, 0x3d, 0x57, 0x3b,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4e, 0x62,
+    0xc8, 0xd5, 0xab, 0xd0, 0xff, 0xc5, 0x15, 0x2f, 0xd1, 0xd1, 0x2e, 0x8c, 0xd2, 0xb0, 0xab, 0x98,
+    0x1a, 0x15, 0x6c, 0x5d, 0xbf, 0xab, 0xd3, 0xdc, 0x3e, 0x35, 0x3e, 0xdc, 0xab, 0x43, 0x68, 0x44,
+    0xab, 0xa1, 0x71, 0xf7, 0x15, 0xee, 0x3f, 0xf7, 0x2b, 0xf9, 0x49, 0xab, 0xa1, 0x1d, 0x3b, 0xd2,
+    0x88, 0xc7, 0xa9, 0xa0, 0xa7, 0xf3, 0xa0, 0xa8, 0x96, 0xee, 0x52, 0x48, 0x36, 0x97, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x7f, 0xee, 0x82, 0xf8, 0xf8, 0x21, 0x8b, 0x1a, 0xee, 0x21, 0xb8, 0x4d,
+    0x5b, 0x5b, 0x4e, 0x4d, 0x2a, 0x48, 0xf6, 0x8d, 0xf2, 0x3f, 0x3e, 0xd6, 0x2e, 0x3b, 0xab, 0xdc,
+    0xd2, 0xf9, 0x35, 0x44, 0xea, 0x97, 0xbb, 0x5a, 0x01, 0x59, 0x5b, 0x5b, 0x59, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x5a, 0x13, 0x4e, 0x54, 0x36, 0xa3, 0xdc, 0x87, 0x8d, 0x3e, 0xd6, 0xc7,
+    0xf0, 0x00, 0x71, 0xf7, 0xc2, 0xc2, 0xb0, 0xcf, 0xb0, 0x71, 0xf7, 0xcf, 0xdc, 0xdc, 0x57, 0x88,
+    0xf2, 0xa7, 0xe7, 0x43, 0x96, 0xce, 0xb5, 0xe7, 0x58, 0xe7, 0xab, 0x2b, 0xf9, 0xfe, 0xa8, 0x54,
+    0x13, 0x4d, 0x4d, 0x5a, 0x01, 0x00, 0xc8, 0x3b, 0x96, 0x21, 0x97, 0xa3, 0x86, 0xca, 0xab, 0xca,
+    0xdc, 0xea, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 16
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00100906,
-    0x005d3524,
-    0x00331d14,
-    0x002b1811,
-    0x0044251b,
-    0x005a2f23,
-    0x00321a14,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fefaf8,
-    0x0087827e,
-    0x00060402,
-    0x001a100a,
-    0x004b2f1d,
-    0x002e1f12,
-    0x00352515,
-    0x0024190e,
-    0x00120b07,
-    0x00352215,
-    0x003a2517,
-    0x003c2618,
-    0x00312013,
-    0x00291a10,
-    0x00281a10,
-    0x0050371f,
-    0x004a301d,
-    0x0019110a,
-    0x002c1c11,
-    0x00281910,
-    0x001f130c,
-    0x001a100a,
-    0x00170d09,
-    0x00090604,
-    0x00060302,
-    0x00070503,
-    0x00110a07,
-    0x002b1a11,
-    0x00331e14,
-    0x00372115,
-    0x00352115,
-    0x003e2718,
-    0x0025170e,
-    0x00553221,
-    0x0073442d,
-    0x00563422,
-    0x004f341f,
-    0x00392616,
-    0x001e130c,
-    0x0020150c,
-    0x00372416,
-    0x003b2617,
-    0x00372216,
-    0x00352115,
-    0x003c2418,
-    0x003a2417,
-    0x00291b10,
-    0x00110b06,
-    0x00100a06,
-    0x00150e08,
-    0x002e1f12,
-    0x00452c1b,
-    0x0024160e,
-    0x0024150e,
-    0x00382016,
-    0x00372015,
-    0x00190e0a,
-    0x00050302,
-    0x000e0a05,
-    0x002d2012,
-    0x00654727,
-    0x000b0804,
-    0x00171009,
-    0x00070503,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00918a83,
-    0x00100b06,
-    0x00291d10,
-    0x00543d21,
-    0x00543d21,
-    0x001c150b,
-    0x002c2011,
-    0x00000000,
-    0x000b0804,
-    0x00312c25,
-    0x00f6f6f5,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00fcfaf8,
-    0x00fbf9f7,
-    0x00fefbf9,
-    0x004c4742,
-    0x00291a10,
-    0x005a3923,
-    0x00422a1a,
-    0x00342114,
-    0x00311f13,
-    0x00301e13,
-    0x001b110b,
-    0x000e0905,
-    0x00130c07,
-    0x00311e13,
-    0x00372116,
-    0x00372215,
-    0x00342114,
-    0x0024170e,
-    0x000d0805,
-    0x00130b07,
-    0x000c0705,
-    0x00d1c5c1,
-    0x00f8f7f6,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00f6f6f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00fefbf9,
-    0x00fffbf9,
-    0x00aca5a0,
-    0x000e0806,
-    0x0020140d,
-    0x0026180f,
-    0x00332114,
-    0x00332114,
-    0x00312014,
-    0x001a110a,
-    0x00080503,
-    0x000b0704,
-    0x00030201,
-    0x0026180f,
-    0x00362315,
-    0x003a2617,
-    0x003c2718,
-    0x00382416,
-    0x001b110b,
-    0x003e2618,
-    0x004b2e1d,
-    0x005b3924,
-    0x005d3924,
-    0x005a3723,
-    0x00402519,
-    0x001b0f0a,
-    0x002b1911,
-    0x002a1911,
-    0x0027160f,
-    0x002f1912,
-    0x00311913,
-    0x00281510,
-    0x00281610,
-    0x0024150e,
-    0x0020120d,
-    0x000c0705,
-    0x00040202,
-    0x0020130c,
-    0x00482d1c,
-    0x0045281b,
-    0x001a100a,
-    0x000b0604,
-    0x00958984,
-    0x00fefaf9,
-    0x00f9f7f6,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00f6f5f5,
-    0x00000000,
-    0x00040302,
-    0x001b100b,
-    0x00030201,
-    0x00010100,
-    0x00010000,
-    0x004b2d1d,
-    0x00864e34,
-    0x00321d14,
-    0x00010101,
-    0x00513120,
-    0x00694229,
-    0x00140d08,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0xab, 0x3b, 0x99, 0x43, 0xaa, 0x3b,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4e, 0x62,
+    0x97, 0xef, 0xf9, 0x6c, 0x88, 0xff, 0x35, 0x87, 0xa1, 0xa1, 0x81, 0xc4, 0x48, 0x2f, 0xf9, 0xef,
+    0xc4, 0x98, 0x15, 0xef, 0xea, 0xc9, 0x97, 0x1a, 0xc6, 0x99, 0x3b, 0x87, 0x87, 0xcf, 0xa3, 0xed,
+    0xa7, 0x2b, 0x2e, 0x8b, 0x15, 0x5e, 0x88, 0xa1, 0x88, 0x87, 0xa1, 0xa1, 0xc4, 0x68, 0x68, 0x36,
+    0x6c, 0x71, 0xfe, 0xfe, 0xa0, 0x87, 0xd5, 0x96, 0xac, 0x81, 0xf6, 0x1d, 0xee, 0x1a, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x53, 0x68, 0xc4, 0x40, 0x40, 0xe1, 0xc5, 0x00, 0x1d, 0x7f, 0x01, 0x5b,
+    0x4d, 0x4d, 0x4d, 0x13, 0x34, 0xc4, 0x3f, 0x71, 0x87, 0x81, 0x3b, 0xd6, 0xac, 0x35, 0x3b, 0x87,
+    0x88, 0x87, 0xa3, 0xa9, 0x35, 0xa8, 0x25, 0x5a, 0x5a, 0x59, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x5a, 0x13, 0x13, 0xfc, 0xad, 0x5e, 0xa3, 0x82, 0x82, 0x82, 0xef, 0x1a,
+    0x1d, 0xf0, 0xa3, 0x88, 0xa1, 0x8c, 0x88, 0xd6, 0xcf, 0xf9, 0xab, 0xab, 0xab, 0xcf, 0xd5, 0x99,
+    0x99, 0x47, 0x6b, 0x3b, 0x47, 0x47, 0xfe, 0x5d, 0xa8, 0x96, 0x5d, 0x3e, 0x44, 0xef, 0x1d, 0x53,
+    0x13, 0x5a, 0x5a, 0x59, 0x01, 0x00, 0x96, 0xd6, 0xf0, 0x21, 0x00, 0x57, 0x85, 0x3b, 0x21, 0x2e,
+    0xf7, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 17
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00070402,
-    0x00190d09,
-    0x005c3324,
-    0x003a2017,
-    0x004c2a1e,
-    0x006c3b2a,
-    0x00743f2e,
-    0x00351c15,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00faf8f7,
-    0x00f9f7f7,
-    0x00faf7f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00fbf8f7,
-    0x00fefbf9,
-    0x00948c84,
-    0x000c0805,
-    0x0024160e,
-    0x00362515,
-    0x000c0705,
-    0x00050302,
-    0x00353231,
-    0x00504945,
-    0x00584d48,
-    0x004e4844,
-    0x00574d47,
-    0x00534b45,
-    0x005c514a,
-    0x00232120,
-    0x00362315,
-    0x00312213,
-    0x00180f0a,
-    0x000d0805,
-    0x002f2925,
-    0x004d4744,
-    0x004a4543,
-    0x004b4543,
-    0x004b4643,
-    0x004b4643,
-    0x004b4643,
-    0x004b4643,
-    0x004c4643,
-    0x004e4744,
-    0x00524b45,
-    0x00221c16,
-    0x00160f08,
-    0x0025180e,
-    0x00553321,
-    0x00693f29,
-    0x002a1a10,
-    0x00090503,
-    0x000a0704,
-    0x00292523,
-    0x004b4643,
-    0x004c4743,
-    0x004c4743,
-    0x004b4643,
-    0x004c4643,
-    0x004c4743,
-    0x004c4743,
-    0x004b4643,
-    0x004a4542,
-    0x00484442,
-    0x001b1714,
-    0x00010100,
-    0x00040201,
-    0x00583823,
-    0x00352015,
-    0x00160d09,
-    0x000c0704,
-    0x00050302,
-    0x00000000,
-    0x00171109,
-    0x004a341d,
-    0x00110c07,
-    0x001f160c,
-    0x00160f08,
-    0x00090603,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00d5d5d5,
-    0x00090604,
-    0x0021180d,
-    0x004e381f,
-    0x00584023,
-    0x00332514,
-    0x002d2011,
-    0x0020170d,
-    0x00030201,
-    0x0095918d,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00f8f7f6,
-    0x00faf8f7,
-    0x00fffbf9,
-    0x00494541,
-    0x00281a0f,
-    0x00382416,
-    0x00140e08,
-    0x000e0905,
-    0x00504a45,
-    0x004a4542,
-    0x00484441,
-    0x00474341,
-    0x00494542,
-    0x004c4743,
-    0x00504944,
-    0x00544b46,
-    0x00584d48,
-    0x00534a46,
-    0x003d3734,
-    0x00080503,
-    0x000a0604,
-    0x00d0c6c1,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00fcf9f8,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00faf7f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00f9f8f7,
-    0x00f9f8f7,
-    0x00bdbbba,
-    0x000c0705,
-    0x00170f09,
-    0x00130b07,
-    0x000f0906,
-    0x00352d27,
-    0x00504944,
-    0x004b4642,
-    0x00484441,
-    0x004a4542,
-    0x004a4642,
-    0x004b4643,
-    0x004b4643,
-    0x004b4643,
-    0x004c4643,
-    0x004b4643,
-    0x00060402,
-    0x000c0805,
-    0x002c1c11,
-    0x00442a1a,
-    0x00513220,
-    0x002e1b12,
-    0x00080503,
-    0x000a0604,
-    0x00362c28,
-    0x004c4543,
-    0x004a4442,
-    0x004b4442,
-    0x004b4442,
-    0x004c4543,
-    0x004c4643,
-    0x004c4643,
-    0x004c4644,
-    0x004c4643,
-    0x004b4543,
-    0x00191413,
-    0x00110a07,
-    0x0026180f,
-    0x00281810,
-    0x000b0704,
-    0x00908682,
-    0x00fefaf9,
-    0x00fbf8f8,
-    0x00fbf8f7,
-    0x00f8f7f6,
-    0x00f6f5f5,
-    0x003d3d3d,
-    0x00474341,
-    0x004a4542,
-    0x004a4542,
-    0x001b1614,
-    0x004f301f,
-    0x00140c08,
-    0x00160d08,
-    0x00000000,
-    0x001b0f0b,
-    0x009c5c3e,
-    0x003b2417,
-    0x00080503,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x97, 0xd4, 0xaa, 0xa0, 0x57, 0xb4, 0xa6, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x5b, 0x5c, 0x5c, 0x5c, 0x5c, 0x5c, 0x5c, 0x5c, 0x13, 0x53,
+    0xa9, 0xfe, 0x88, 0xa8, 0x96, 0x4b, 0x29, 0x2a, 0x34, 0x2a, 0x29, 0x5f, 0x70, 0x88, 0x82, 0xd4,
+    0xa9, 0x7f, 0x34, 0x74, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x29, 0x6f, 0xeb, 0xa3, 0x2b,
+    0xd3, 0x99, 0xc8, 0x1d, 0x9d, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x74, 0x73, 0x6a,
+    0x21, 0xf1, 0x3f, 0x87, 0xea, 0x1d, 0x96, 0x00, 0xee, 0xf8, 0xc7, 0x5e, 0xeb, 0xc8, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0xc0, 0xc9, 0x5e, 0x52, 0x40, 0x82, 0xc5, 0x5e, 0xf0, 0x30, 0x01, 0x01,
+    0x5a, 0x5a, 0x5c, 0x13, 0x74, 0x48, 0x88, 0x36, 0xac, 0x29, 0x74, 0x73, 0x73, 0x74, 0x34, 0x29,
+    0x29, 0x2a, 0x29, 0xfa, 0x1a, 0xc9, 0x25, 0x4e, 0x4e, 0x4d, 0x5a, 0x01, 0x5c, 0x5c, 0x5c, 0x5c,
+    0x5c, 0x5c, 0x01, 0x01, 0x59, 0x5b, 0x5b, 0xb8, 0xa8, 0xee, 0x35, 0xad, 0xe2, 0x29, 0x34, 0x73,
+    0x74, 0x74, 0x34, 0x34, 0x34, 0x34, 0x34, 0x97, 0xa9, 0xc4, 0x44, 0x2e, 0x6b, 0x1a, 0xc9, 0xe2,
+    0x34, 0x74, 0x74, 0x74, 0x34, 0x34, 0x34, 0x34, 0x34, 0x34, 0x69, 0xc6, 0xa3, 0x98, 0x1d, 0x65,
+    0x13, 0x4d, 0x5c, 0x5a, 0x01, 0x51, 0x73, 0x74, 0x74, 0x6a, 0xf9, 0x36, 0xea, 0x00, 0xd6, 0xcb,
+    0xa1, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 18
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070302,
-    0x0026130f,
-    0x00522a20,
-    0x00884a36,
-    0x000f0806,
-    0x005e3425,
-    0x0078422f,
-    0x00773f2e,
-    0x00371d15,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00faf8f7,
-    0x007c7471,
-    0x00554946,
-    0x00584b47,
-    0x00584b47,
-    0x00584b47,
-    0x00564b47,
-    0x00534945,
-    0x004a4642,
-    0x00574e46,
-    0x00302824,
-    0x00110a06,
-    0x001a100a,
-    0x000c0805,
-    0x00645956,
-    0x00e4dddb,
-    0x00f8f7f6,
-    0x00f9f7f7,
-    0x00fffbf9,
-    0x00fcf9f8,
-    0x00fcf9f8,
-    0x00f8f7f6,
-    0x00fefbf9,
-    0x0086827f,
-    0x0021150d,
-    0x00140d08,
-    0x00484541,
-    0x00dddbd8,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00fdfbf8,
-    0x00b7aea5,
-    0x00231c17,
-    0x0020140d,
-    0x0025160e,
-    0x001a100a,
-    0x002e2e2e,
-    0x00c6c6c6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00bab9b8,
-    0x0010100f,
-    0x00100a06,
-    0x00432a1a,
-    0x00160d09,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001a120a,
-    0x00523a20,
-    0x00030201,
-    0x00261b0f,
-    0x00150f08,
-    0x000a0704,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00595551,
-    0x00120d07,
-    0x003c2b17,
-    0x00513a20,
-    0x002b1f11,
-    0x00342615,
-    0x001b130b,
-    0x00010100,
-    0x00d5d5d5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f7f7,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00474341,
-    0x000b0804,
-    0x00150f08,
-    0x009a9590,
-    0x00e8e7e5,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f7f6,
-    0x00fdfaf8,
-    0x00c4bfbc,
-    0x00020101,
-    0x000a0604,
-    0x00d0c5c1,
-    0x00f8f7f6,
-    0x00f8f7f6,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00cac9c8,
-    0x00524744,
-    0x00534845,
-    0x00514845,
-    0x004e4743,
-    0x00524945,
-    0x008a7c77,
-    0x00fcf9f8,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f6f5f5,
-    0x00bab9b8,
-    0x000b0704,
-    0x000c0805,
-    0x006a5e58,
-    0x00e1dbda,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x009e9c9b,
-    0x00181412,
-    0x00130c08,
-    0x0023150e,
-    0x00140c08,
-    0x00454240,
-    0x00dcd9d8,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00adabab,
-    0x00151311,
-    0x00110a07,
-    0x000b0604,
-    0x0087817e,
-    0x00fffaf9,
-    0x00fcf9f8,
-    0x00fdf9f8,
-    0x00fbf8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x003d2618,
-    0x00573522,
-    0x004b2e1e,
-    0x00301c13,
-    0x006a3d29,
-    0x00553121,
-    0x00100906,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0x46, 0x58, 0x32, 0xad, 0xe7, 0x55, 0xa6, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x8e, 0x29, 0x2a, 0x2a, 0x2a, 0x2a, 0x29, 0x74, 0x2a, 0x7f,
+    0x68, 0xef, 0xa9, 0x60, 0x41, 0x5a, 0x5b, 0x13, 0x4d, 0x4d, 0x5a, 0x13, 0x62, 0xbf, 0x36, 0x73,
+    0x84, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x4e, 0xae, 0x6f, 0x5e,
+    0xfe, 0xef, 0xe3, 0xba, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x92, 0x0f, 0x68, 0x71, 0xea, 0x00, 0x00, 0x00, 0xe1, 0x2f, 0xf0, 0x48, 0xeb, 0x1d, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x16, 0xc7, 0x8c, 0x2f, 0xc5, 0x88, 0xe1, 0x21, 0xc0, 0x01, 0x01,
+    0x01, 0x5b, 0x4e, 0x4e, 0x73, 0x1d, 0xeb, 0xd8, 0x42, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x5a, 0x4e, 0x0e, 0x21, 0xc9, 0x25, 0x5a, 0x5a, 0x4d, 0x4d, 0xba, 0x29, 0x29, 0x29, 0x34,
+    0x29, 0xb3, 0x4d, 0x01, 0x01, 0x01, 0x01, 0x92, 0x1d, 0xa9, 0x9f, 0x84, 0x5a, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x50, 0x69, 0x35, 0xfe, 0x36, 0x26, 0x84, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xfd, 0x69, 0xc6, 0x1d, 0x62,
+    0x13, 0x4d, 0x4d, 0x5c, 0x59, 0x01, 0x01, 0x01, 0x01, 0x4c, 0xcf, 0x2b, 0xf9, 0x3b, 0xd3, 0xed,
+    0x68, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 19
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00110907,
-    0x00532a20,
-    0x00a45340,
-    0x00603226,
-    0x0022130d,
-    0x00321b14,
-    0x00653628,
-    0x00773e2e,
-    0x00371c15,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fdf9f8,
-    0x003e3d3d,
-    0x00130a08,
-    0x001b0e0b,
-    0x001b0e0b,
-    0x00140b08,
-    0x000f0806,
-    0x000c0805,
-    0x00160f09,
-    0x00130c08,
-    0x00180f09,
-    0x0024180e,
-    0x00110b07,
-    0x00565150,
-    0x00fdf9f8,
-    0x00fdf9f8,
-    0x00f8f6f6,
-    0x00f7f6f6,
-    0x00f9f7f7,
-    0x00f9f8f7,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00fefbf9,
-    0x008c8681,
-    0x000d0905,
-    0x002f2a25,
-    0x00f9f8f7,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00fdfbf8,
-    0x00fdfaf8,
-    0x00b5aca3,
-    0x00080503,
-    0x00170e09,
-    0x00161312,
-    0x00e4e4e4,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00cac4bf,
-    0x00090603,
-    0x0022160e,
-    0x00190f0a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0019120a,
-    0x004b361d,
-    0x00181109,
-    0x001e160c,
-    0x001b130b,
-    0x000c0805,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00a39f9c,
-    0x000d0a05,
-    0x00281d10,
-    0x00322414,
-    0x00010100,
-    0x001b130a,
-    0x00070503,
-    0x00635c55,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fdfaf8,
-    0x00f6f6f5,
-    0x00f7f6f6,
-    0x0041403e,
-    0x00040302,
-    0x00978d85,
-    0x00f7f6f6,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00faf7f7,
-    0x00d0c4c1,
-    0x00050302,
-    0x000a0604,
-    0x00d0c5c1,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00bdbbba,
-    0x000c0605,
-    0x00110907,
-    0x00140b08,
-    0x00140b08,
-    0x00130b07,
-    0x000c0705,
-    0x00c7c6c6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b9b8b8,
-    0x000a0604,
-    0x004b4643,
-    0x00fefaf9,
-    0x00f9f7f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00b7aba4,
-    0x000a0604,
-    0x000c0705,
-    0x00322b26,
-    0x00f2ece9,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00c6c0bd,
-    0x00090504,
-    0x00060302,
-    0x0088827f,
-    0x00fffaf9,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00fdf9f8,
-    0x00f8f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x00362115,
-    0x00593623,
-    0x004d2f1e,
-    0x001f120c,
-    0x00894f36,
-    0x00291710,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc6, 0x58, 0x94, 0xe7, 0xbe, 0x3b, 0xda, 0xa6, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x51, 0x35, 0xd5, 0xd5, 0x35, 0xad, 0xa9, 0xeb, 0x35, 0xd4,
+    0xa3, 0xc7, 0x16, 0x4d, 0x4d, 0x59, 0x59, 0x5b, 0x5b, 0x59, 0x59, 0x13, 0x65, 0xac, 0x7f, 0x5b,
+    0x5b, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x4e, 0x4e, 0xae, 0x1a,
+    0xd4, 0x69, 0x41, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0xb7, 0xc8, 0xbf, 0xef, 0x00, 0x00, 0x00, 0xef, 0x52, 0xee, 0x5e, 0xe1, 0xa9, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x50, 0xac, 0xc4, 0x82, 0x21, 0xe1, 0x1a, 0x60, 0x01, 0x01, 0x01,
+    0x5a, 0x4e, 0x01, 0x59, 0x39, 0x96, 0x53, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59,
+    0x59, 0x59, 0x5c, 0x25, 0x96, 0xc9, 0x25, 0x59, 0x59, 0x4d, 0x4d, 0xb8, 0xa8, 0xc6, 0x35, 0x35,
+    0x35, 0xa8, 0xba, 0x01, 0x01, 0x01, 0x01, 0x92, 0xc9, 0x34, 0x13, 0x5b, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0xae, 0xc9, 0xa8, 0x7f, 0x42, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x0e, 0xc8, 0x97, 0x62,
+    0x13, 0x5c, 0x5c, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x4c, 0x87, 0x2b, 0xf9, 0x15, 0x32, 0x98,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 20
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00110907,
-    0x00542a21,
-    0x00a45340,
-    0x008a4636,
-    0x008d4b38,
-    0x0024130e,
-    0x00532b21,
-    0x00713a2c,
-    0x00351b15,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fdf9f8,
-    0x00494341,
-    0x00010000,
-    0x00000000,
-    0x00000000,
-    0x00010000,
-    0x00070503,
-    0x000b0804,
-    0x00130b08,
-    0x001b100a,
-    0x00160e08,
-    0x0024190e,
-    0x00010000,
-    0x00d7d6d6,
-    0x00f8f6f6,
-    0x00f8f6f6,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f8f6f6,
-    0x00fffbf9,
-    0x00898480,
-    0x000d0705,
-    0x0096928e,
-    0x00fcfaf8,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00fbf9f7,
-    0x00fbf9f8,
-    0x00fffbf9,
-    0x00181412,
-    0x00080503,
-    0x007d7672,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x002d2724,
-    0x00130c07,
-    0x0025180e,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x001a120a,
-    0x00543c21,
-    0x00080603,
-    0x003b2a17,
-    0x00271c0f,
-    0x000d0905,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00171512,
-    0x0021180d,
-    0x00241a0e,
-    0x00281c0f,
-    0x00261b0f,
-    0x000a0704,
-    0x00adacaa,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f7f6f6,
-    0x00fbf8f7,
-    0x00fefaf9,
-    0x00f8f7f6,
-    0x00faf8f7,
-    0x004a4541,
-    0x00060402,
-    0x00f0ece8,
-    0x00faf9f7,
-    0x00f9f8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f8f7f6,
-    0x00fbf8f7,
-    0x00fbf8f7,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00c2bdbb,
-    0x000b0604,
-    0x00080503,
-    0x00d0c6c1,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00fcf9f8,
-    0x00f8f7f6,
-    0x00bbbab9,
-    0x00000000,
-    0x00000000,
-    0x00010101,
-    0x00010000,
-    0x00000000,
-    0x00000000,
-    0x00e2dddb,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00a9a8a8,
-    0x00070403,
-    0x009a938f,
-    0x00f9f7f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00fdfaf8,
-    0x00030201,
-    0x00070503,
-    0x009a8e86,
-    0x00faf8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f7f6,
-    0x00fdfaf8,
-    0x00fbf9f7,
-    0x001e1e1e,
-    0x00060302,
-    0x00918783,
-    0x00fefaf8,
-    0x00faf8f7,
-    0x00f9f7f6,
-    0x00fefaf9,
-    0x00f9f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x00361f15,
-    0x005b3424,
-    0x00170d09,
-    0x0072432c,
-    0x0042261a,
-    0x00130a08,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc6, 0x58, 0x94, 0x56, 0x32, 0x46, 0x58, 0xb4, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x73, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x1d, 0x35, 0xd6, 0xeb,
+    0xff, 0x00, 0xc0, 0x59, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x13, 0x62, 0xa8, 0x30, 0x4d,
+    0x4d, 0x5b, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x4d, 0x4d, 0x13, 0x69,
+    0x1a, 0x8e, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x9d, 0x35, 0xa3, 0xf1, 0x00, 0x00, 0xe1, 0x40, 0x1a, 0x8c, 0x48, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x69, 0x5e, 0xff, 0x48, 0x48, 0x1d, 0xfd, 0x01, 0x01, 0x59,
+    0x5c, 0x13, 0x5a, 0x5c, 0x74, 0x97, 0x42, 0x5c, 0x5b, 0x59, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x5c,
+    0x5c, 0x5a, 0x59, 0xb9, 0x1d, 0x1a, 0x25, 0x4e, 0x4e, 0x4d, 0x5a, 0xb8, 0x00, 0x00, 0x21, 0x00,
+    0x00, 0x00, 0x41, 0x01, 0x01, 0x01, 0x01, 0xfc, 0x1a, 0xd8, 0x5b, 0x59, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x4e, 0xf0, 0x1a, 0x54, 0x5c, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4e, 0x4d, 0x70, 0x97, 0x65,
+    0x4e, 0x5c, 0x5a, 0x13, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x4c, 0x87, 0xaa, 0xea, 0xf3, 0x43, 0x35,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 21
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00080503,
-    0x00281410,
-    0x00512920,
-    0x004f281f,
-    0x004e281f,
-    0x00753c2e,
-    0x0024120e,
-    0x0043231a,
-    0x00301913,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00c6c6c6,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b9b9b9,
-    0x00cbc4c0,
-    0x00a29993,
-    0x000c0605,
-    0x000d0705,
-    0x00020201,
-    0x001c130b,
-    0x00020101,
-    0x00f7f6f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00faf8f7,
-    0x00fefbf9,
-    0x008d8581,
-    0x000c0705,
-    0x00bcbab9,
-    0x00f7f7f6,
-    0x00f7f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f7f6f6,
-    0x00f8f7f6,
-    0x00fffbf9,
-    0x004c4542,
-    0x00040202,
-    0x00958a84,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00554b46,
-    0x00130c07,
-    0x005b3c24,
-    0x001c130b,
-    0x00030201,
-    0x00000000,
-    0x00161008,
-    0x004b361d,
-    0x00030201,
-    0x00382816,
-    0x002b1e11,
-    0x000d0a05,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00857e75,
-    0x00150f08,
-    0x00332414,
-    0x0046321c,
-    0x002a1e11,
-    0x00111110,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00fffbf9,
-    0x00fcf9f8,
-    0x00f9f7f6,
-    0x00fcfaf8,
-    0x004c4642,
-    0x000a0604,
-    0x00f8f7f6,
-    0x00faf9f7,
-    0x00fffcf9,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf8f7,
-    0x00fdf9f8,
-    0x00fdf9f8,
-    0x00fbf8f7,
-    0x00f7f6f6,
-    0x00bcbab9,
-    0x000b0704,
-    0x00050302,
-    0x00cfc5c0,
-    0x00f8f7f6,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00f6f6f5,
-    0x00e5e5e5,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00d6d6d6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x007f7d7c,
-    0x000a0604,
-    0x00c9c2be,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf8f7,
-    0x004c4542,
-    0x00070403,
-    0x00b3a9a3,
-    0x00faf8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fefaf8,
-    0x00f9f8f7,
-    0x003f3e3d,
-    0x00050302,
-    0x00918683,
-    0x00fefaf8,
-    0x00f6f5f5,
-    0x00faf8f7,
-    0x00fefaf9,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x00371f15,
-    0x00593223,
-    0x00180e0a,
-    0x00673b29,
-    0x00281610,
-    0x000f0806,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x47, 0x58, 0x57, 0x57, 0xa6, 0xbe, 0x43, 0x6b,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0xba, 0x92, 0x92, 0x92, 0x92, 0xb7, 0xd9, 0xa8, 0xa8, 0xf0,
+    0xe1, 0x21, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x13, 0x65, 0xa8, 0xb8, 0x59,
+    0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5a, 0x13, 0x34,
+    0x96, 0x53, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x29, 0x35, 0xbc, 0xe1, 0xf0, 0x00, 0xeb, 0x52, 0xf0, 0x8b, 0xc5, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xb3, 0xeb, 0x82, 0xf8, 0xc5, 0x0f, 0x01, 0x01, 0x59, 0x4e,
+    0x13, 0x4d, 0x5a, 0x4d, 0x34, 0xc9, 0x5a, 0x5c, 0x13, 0x5b, 0x01, 0x01, 0x01, 0x59, 0x5c, 0x4d,
+    0x4d, 0x5c, 0x59, 0xb8, 0x1d, 0x96, 0x25, 0x5a, 0x5a, 0x59, 0x01, 0x41, 0x92, 0x92, 0x92, 0x92,
+    0x92, 0xc0, 0x01, 0x01, 0x01, 0x01, 0x01, 0x0b, 0xc9, 0xb7, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5c, 0x34, 0x1a, 0xae, 0x5c, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x4e, 0x5b, 0x39, 0x96, 0x65,
+    0x4e, 0x01, 0x5c, 0x13, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x4c, 0x3c, 0xed, 0xd4, 0xdd, 0x47, 0xad,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 22
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00080403,
-    0x00120907,
-    0x001a0d0a,
-    0x00542d21,
-    0x003a1f17,
-    0x00160b09,
-    0x0022120d,
-    0x002a1610,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fbf9f7,
-    0x00cec7c0,
-    0x000d0805,
-    0x00170d09,
-    0x0022160e,
-    0x00150d08,
-    0x00080503,
-    0x00fbf8f7,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00fffcf9,
-    0x00dcd5cf,
-    0x00d0c8c1,
-    0x00d1c7c1,
-    0x00c6c0bd,
-    0x006f6663,
-    0x000b0604,
-    0x00bdbbb9,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fcf9f8,
-    0x00b8b7b7,
-    0x00b8b7b7,
-    0x00b8b7b7,
-    0x00bebbba,
-    0x00d0c7c1,
-    0x00d5d5d5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f6f6f5,
-    0x00f7f6f6,
-    0x00fffbf9,
-    0x00484341,
-    0x00050302,
-    0x00908883,
-    0x00fbf9f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fbf9f7,
-    0x00b8b8b8,
-    0x00b8b7b7,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00b8b8b8,
-    0x00cfccca,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00584e47,
-    0x002d1c11,
-    0x00080603,
-    0x00422d1a,
-    0x000d0905,
-    0x00000000,
-    0x000d0905,
-    0x002b1f11,
-    0x00563e22,
-    0x00140e08,
-    0x001e150c,
-    0x000d0905,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00dad8d7,
-    0x000e0a05,
-    0x002b1f11,
-    0x00392816,
-    0x00150f08,
-    0x00817a73,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fdfaf8,
-    0x00fefbf9,
-    0x00fffbf9,
-    0x00f6f6f5,
-    0x00fcf9f8,
-    0x004c4642,
-    0x000a0604,
-    0x00fbf9f7,
-    0x00f5f5f5,
-    0x00fdfaf8,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00dad3ce,
-    0x00d1c7c1,
-    0x00d1c5c1,
-    0x00d1c5c1,
-    0x00d0c5c1,
-    0x00cfc3c0,
-    0x00c4bebc,
-    0x0098928f,
-    0x000b0604,
-    0x00080503,
-    0x00cfc4c1,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00e5e4e4,
-    0x00282422,
-    0x000b0704,
-    0x00cdc4c0,
-    0x00f7f6f6,
-    0x00f6f5f5,
-    0x00f6f6f5,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00e6e5e4,
-    0x00cdc5c0,
-    0x00c7c1be,
-    0x00c7c1bd,
-    0x00e6e0dc,
-    0x00fdfaf8,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00464140,
-    0x000b0604,
-    0x00d0c6c1,
-    0x00fbf8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00e4e4e4,
-    0x00c9c2be,
-    0x00d0c6c1,
-    0x00cfc5c1,
-    0x00dbd2ce,
-    0x00fefaf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00faf8f7,
-    0x00fefaf8,
-    0x00413f3e,
-    0x00060402,
-    0x008f8682,
-    0x00fefaf8,
-    0x00f8f6f6,
-    0x00fdf9f8,
-    0x00f9f7f6,
-    0x00f6f6f5,
-    0x00b7b7b7,
-    0x00c6c0bd,
-    0x00cdc4c0,
-    0x00cec5c0,
-    0x00423935,
-    0x00190e0a,
-    0x002b1811,
-    0x002e1912,
-    0x00834934,
-    0x005b3524,
-    0x003e2618,
-    0x000f0a06,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0xc6, 0xd5, 0xec, 0xa0, 0xea, 0xbe, 0x98,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x25, 0xa9, 0xea, 0xbf,
+    0x36, 0x1a, 0x5c, 0x5a, 0x01, 0x01, 0x01, 0x13, 0xc0, 0x25, 0xbb, 0x0e, 0x09, 0x1d, 0xb8, 0x01,
+    0x01, 0x01, 0x01, 0x4d, 0x03, 0x03, 0x03, 0xb8, 0x25, 0xc0, 0x01, 0x01, 0x01, 0x59, 0x13, 0x73,
+    0x96, 0x65, 0x4d, 0x59, 0x01, 0x01, 0x4d, 0x92, 0x03, 0x92, 0x92, 0x92, 0x20, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x2a, 0x6c, 0x1a, 0x71, 0xac, 0x00, 0xac, 0xc5, 0x40, 0x36, 0x5e, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x84, 0xac, 0xc5, 0x8b, 0xeb, 0x8e, 0x01, 0x01, 0x5a, 0x4e,
+    0x13, 0x13, 0x01, 0x4d, 0x34, 0xc9, 0x4d, 0x01, 0x4e, 0x5b, 0x01, 0x01, 0xc0, 0xbb, 0x25, 0x25,
+    0x25, 0x25, 0xb9, 0xd8, 0x1d, 0x1a, 0x25, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x41, 0x9c, 0x1d, 0xb7, 0x59, 0x01, 0x01, 0x01, 0x01, 0x41,
+    0xb7, 0x0e, 0x0e, 0x41, 0x4e, 0x01, 0x01, 0x01, 0x01, 0x59, 0x26, 0x1d, 0x25, 0x5c, 0x01, 0x01,
+    0x01, 0x01, 0x41, 0xb7, 0x25, 0x25, 0xc0, 0x4e, 0x59, 0x01, 0x01, 0x5c, 0x4e, 0x39, 0x97, 0x65,
+    0x4e, 0x59, 0x4d, 0x5a, 0x01, 0x03, 0x0e, 0xb7, 0x25, 0xfb, 0xd5, 0x99, 0x6b, 0x85, 0xab, 0xcf,
+    0x68, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 23
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x0023130e,
-    0x00884b35,
-    0x0024140e,
-    0x004b291d,
-    0x00522b20,
-    0x00311a13,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f7,
-    0x00c1bebb,
-    0x000c0805,
-    0x00322014,
-    0x0046291b,
-    0x0024140e,
-    0x000c0705,
-    0x00fdfaf8,
-    0x00fbf8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00fefbf8,
-    0x00a39a93,
-    0x00060402,
-    0x00020201,
-    0x00080503,
-    0x00030201,
-    0x000a0604,
-    0x000c0705,
-    0x00c6c2bd,
-    0x00f8f7f6,
-    0x00f7f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00c9c2bf,
-    0x000a0604,
-    0x000a0604,
-    0x000a0604,
-    0x00080503,
-    0x00070403,
-    0x003e3e3d,
-    0x00f7f6f6,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00f9f8f6,
-    0x00fffbf9,
-    0x0044413f,
-    0x00060403,
-    0x007b7a7a,
-    0x00fbf9f7,
-    0x00faf8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00fffbf9,
-    0x000a0604,
-    0x000a0604,
-    0x000a0604,
-    0x000a0604,
-    0x000a0604,
-    0x00534b46,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00584e47,
-    0x002e1e12,
-    0x00422b1a,
-    0x00382516,
-    0x00342314,
-    0x0019110a,
-    0x00100b06,
-    0x00100b06,
-    0x001c140b,
-    0x0048341d,
-    0x000a0704,
-    0x00090603,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00484541,
-    0x00150f08,
-    0x001e150c,
-    0x000d0905,
-    0x00d7d7d6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00f9f7f7,
-    0x00faf8f7,
-    0x00fdfaf8,
-    0x00f6f5f5,
-    0x00484340,
-    0x000a0704,
-    0x00fbf9f7,
-    0x00f9f8f6,
-    0x00fcfaf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00a6a19d,
-    0x000b0704,
-    0x000c0705,
-    0x000c0705,
-    0x000d0705,
-    0x000e0705,
-    0x000c0605,
-    0x000d0705,
-    0x000b0604,
-    0x00080503,
-    0x00080403,
-    0x00d1c5c1,
-    0x00f9f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00aeacaa,
-    0x00363330,
-    0x000c0705,
-    0x00020101,
-    0x00d0c6c1,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00fbf8f7,
-    0x00faf8f7,
-    0x00dad8d7,
-    0x001e1915,
-    0x00090603,
-    0x00000000,
-    0x00050302,
-    0x00020201,
-    0x00948b84,
-    0x00fdfaf8,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x004c4542,
-    0x00070403,
-    0x00cac2bf,
-    0x00fcf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00141211,
-    0x00030201,
-    0x00050302,
-    0x00060302,
-    0x00040202,
-    0x006d6663,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fdf9f8,
-    0x003d3d3c,
-    0x000a0504,
-    0x008e8582,
-    0x00fffbf9,
-    0x00fdf9f8,
-    0x00f8f7f6,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x00060302,
-    0x00040202,
-    0x00060403,
-    0x000d0705,
-    0x002b1911,
-    0x002d1911,
-    0x00140b08,
-    0x000c0705,
-    0x00502e1f,
-    0x00945b3b,
-    0x002e1d12,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xbe, 0x32, 0xfe, 0x3d, 0x58, 0x3b,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5b, 0xb9, 0xa9, 0x82, 0x44,
+    0xfe, 0xa8, 0x4e, 0x5c, 0x59, 0x01, 0x13, 0xd9, 0x97, 0xf0, 0x1a, 0xf0, 0xc9, 0xa8, 0x0e, 0x5a,
+    0x59, 0x01, 0x01, 0xb7, 0xc9, 0xc9, 0xc9, 0x1a, 0x1a, 0x51, 0x59, 0x5c, 0x5c, 0x5b, 0x13, 0x26,
+    0x97, 0xb2, 0x4d, 0x5c, 0x01, 0x01, 0x13, 0xc9, 0xc9, 0xc9, 0xc9, 0xc9, 0x29, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x2a, 0x6c, 0x71, 0x8b, 0x82, 0xef, 0x68, 0x68, 0xe1, 0xf8, 0x1d, 0xc8, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x73, 0xeb, 0x5e, 0xac, 0xc0, 0x01, 0x01, 0x01, 0x5a,
+    0x5b, 0x5c, 0x4e, 0x01, 0x73, 0x1d, 0x4d, 0x5b, 0x4d, 0x59, 0x01, 0x50, 0x1d, 0xa8, 0xa8, 0xa8,
+    0xa8, 0xa8, 0xa8, 0x1d, 0x1a, 0x1a, 0x25, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0xfd, 0x4b, 0xa8, 0x21, 0x25, 0x5c, 0x5c, 0x5c, 0x5c, 0x84, 0x6a,
+    0xc8, 0x00, 0x96, 0xf0, 0x53, 0x4e, 0x01, 0x01, 0x01, 0x5a, 0x34, 0x1a, 0xb7, 0x4d, 0x01, 0x01,
+    0x01, 0x01, 0x69, 0xf0, 0x96, 0x97, 0x96, 0x09, 0x5a, 0x01, 0x01, 0x59, 0x4d, 0x51, 0xc9, 0x65,
+    0x13, 0x4d, 0x5a, 0x01, 0x01, 0x00, 0x97, 0x96, 0x97, 0xa8, 0x99, 0x6b, 0x35, 0xa8, 0x58, 0xca,
+    0x6c, 0xf1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 24
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070403,
-    0x004e2c1f,
-    0x00392016,
-    0x004b291d,
-    0x006b3b2a,
-    0x0077412f,
-    0x003c2118,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f7,
-    0x00c4bfbc,
-    0x000a0704,
-    0x00271b0f,
-    0x00382116,
-    0x00301b13,
-    0x000b0604,
-    0x00fdf9f8,
-    0x00fbf9f7,
-    0x00f8f7f6,
-    0x00f7f7f6,
-    0x00fffbf9,
-    0x00968c85,
-    0x001e130c,
-    0x0024180e,
-    0x00281a10,
-    0x0027180f,
-    0x00030201,
-    0x000c0705,
-    0x00d0c8c1,
-    0x00fefbf8,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x009a9a9a,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x00d8d7d7,
-    0x00faf8f7,
-    0x00fefcf9,
-    0x00fffcf9,
-    0x00fcfaf8,
-    0x00fffbf9,
-    0x0043403f,
-    0x00090604,
-    0x0084807e,
-    0x00f8f7f6,
-    0x00fbf8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00a9a9a9,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x007a7a7a,
-    0x00c7c7c7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00584e47,
-    0x002e1c12,
-    0x00442b1b,
-    0x00010100,
-    0x0049301d,
-    0x004d351e,
-    0x00261b0f,
-    0x000c0905,
-    0x00080603,
-    0x00322414,
-    0x002a1f11,
-    0x00030201,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00aba59f,
-    0x00040302,
-    0x00060402,
-    0x00504a44,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00f5f5f5,
-    0x00484441,
-    0x00090603,
-    0x00f8f7f6,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x0087827f,
-    0x000c0805,
-    0x00150d08,
-    0x00170d09,
-    0x0021110d,
-    0x0025130f,
-    0x0023110e,
-    0x00291610,
-    0x0027140f,
-    0x00100906,
-    0x00070403,
-    0x00d0c4c1,
-    0x00f9f8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00a49a94,
-    0x000c0705,
-    0x00060302,
-    0x00c1bebb,
-    0x00fefaf9,
-    0x00fdfaf8,
-    0x00f9f7f6,
-    0x00fcf9f8,
-    0x00c6c1be,
-    0x000c0805,
-    0x00110b07,
-    0x00180f09,
-    0x00140d08,
-    0x000a0704,
-    0x004b4642,
-    0x00fefbf9,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f7f6,
-    0x00fefaf9,
-    0x003c3c3c,
-    0x000a0604,
-    0x00cbc2bf,
-    0x00fefaf9,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x00060402,
-    0x00060402,
-    0x00120a07,
-    0x001f110c,
-    0x000b0604,
-    0x0042403f,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00faf8f7,
-    0x004d4643,
-    0x00060302,
-    0x008e8582,
-    0x00fefaf8,
-    0x00f7f6f6,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x000c0705,
-    0x00130b07,
-    0x00190f0a,
-    0x00352015,
-    0x005a3623,
-    0x00512e20,
-    0x0027160f,
-    0x00080403,
-    0x004c2d1e,
-    0x00965b3b,
-    0x00301e12,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x57, 0xa0, 0x3d, 0xdd, 0xa6, 0xa0,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5b, 0x0e, 0x1d, 0x48, 0xa0,
+    0x3b, 0x1d, 0x4d, 0x4d, 0x5a, 0x59, 0x13, 0x53, 0x15, 0xa3, 0x48, 0x47, 0xf0, 0xa8, 0x25, 0x13,
+    0x4d, 0x5b, 0x01, 0x01, 0x50, 0xb2, 0xb2, 0xb2, 0xb2, 0xc0, 0x5c, 0x13, 0x13, 0x4d, 0x13, 0x26,
+    0xc9, 0x62, 0x5a, 0x5c, 0x01, 0x01, 0x01, 0xfc, 0xb2, 0xb2, 0xb2, 0xb2, 0xba, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x2a, 0x6c, 0x71, 0x21, 0xf9, 0x52, 0x48, 0xa9, 0x1a, 0x82, 0xc5, 0xf0, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xfc, 0x96, 0x97, 0x29, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x59, 0x4e, 0x01, 0x73, 0xc8, 0x5a, 0x4d, 0x59, 0x01, 0x01, 0x62, 0xa9, 0x36, 0xea, 0xbe,
+    0x46, 0xbe, 0x98, 0x46, 0x68, 0x1a, 0x25, 0x5b, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0xd9, 0xa8, 0x97, 0xb9, 0x13, 0x4e, 0x5a, 0x4d, 0x0e, 0xa9,
+    0xc7, 0xd4, 0x36, 0x1d, 0x34, 0x13, 0x01, 0x01, 0x5a, 0x13, 0x4c, 0xc9, 0xb7, 0x13, 0x59, 0x01,
+    0x01, 0x92, 0x97, 0x97, 0x35, 0x15, 0x1d, 0x26, 0x5a, 0x01, 0x01, 0x01, 0x5c, 0x34, 0x97, 0x65,
+    0x4e, 0x59, 0x01, 0x01, 0x01, 0x00, 0xa8, 0x35, 0xef, 0x87, 0xab, 0x58, 0x47, 0x1a, 0x57, 0xcb,
+    0x6c, 0xf1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 25
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070403,
-    0x00553021,
-    0x00351e15,
-    0x00512e20,
-    0x007a4430,
-    0x0078422f,
-    0x003b2017,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00faf8f7,
-    0x00cbc3bf,
-    0x000d0905,
-    0x00120c07,
-    0x003d2318,
-    0x002d1c11,
-    0x00090504,
-    0x00fbf8f7,
-    0x00f9f8f7,
-    0x00faf8f7,
-    0x00fcfaf8,
-    0x00fffbf9,
-    0x00978d85,
-    0x002c1c11,
-    0x0024170e,
-    0x00342214,
-    0x005a3a23,
-    0x00110c07,
-    0x000a0704,
-    0x00c6c1bd,
-    0x00f7f7f6,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00faf8f7,
-    0x00fffcf9,
-    0x00fdfaf8,
-    0x00fffbf9,
-    0x00fffbf9,
-    0x00020101,
-    0x00090604,
-    0x007c7b7b,
-    0x00fffbf9,
-    0x00f9f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fbf9f7,
-    0x002f2824,
-    0x001e130c,
-    0x00341f14,
-    0x0023160e,
-    0x00100b06,
-    0x00150f08,
-    0x0044301b,
-    0x001a120a,
-    0x00281d10,
-    0x00422f1a,
-    0x00030201,
-    0x00010100,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00e4e4e4,
-    0x00131210,
-    0x00030201,
-    0x00a8a39e,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00f6f6f5,
-    0x004e4843,
-    0x000c0705,
-    0x00fbf9f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x0087827f,
-    0x00100a06,
-    0x00110b07,
-    0x00402619,
-    0x005d3325,
-    0x00542a21,
-    0x004f281f,
-    0x004d281e,
-    0x00542d21,
-    0x000a0604,
-    0x00090503,
-    0x00d1c5c1,
-    0x00f9f8f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00fbf9f8,
-    0x00f6f5f5,
-    0x00615e5d,
-    0x00070403,
-    0x00c1bcba,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f7f6,
-    0x00c8c2be,
-    0x000d0805,
-    0x0021160d,
-    0x005c3b24,
-    0x005a3b23,
-    0x001c130b,
-    0x004c4743,
-    0x00fdfaf8,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00f8f7f6,
-    0x00464240,
-    0x000c0605,
-    0x00cfc4c1,
-    0x00fffbf9,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x00070403,
-    0x00160c08,
-    0x002f1a12,
-    0x0044251b,
-    0x0020110d,
-    0x003d3d3d,
-    0x00f9f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00464240,
-    0x00090604,
-    0x008a8480,
-    0x00fdfaf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x00040201,
-    0x0043251b,
-    0x002f1b12,
-    0x004f2f1f,
-    0x005f3925,
-    0x003e2418,
-    0x002c1911,
-    0x00824833,
-    0x005d3625,
-    0x00412719,
-    0x00100a06,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xec, 0x87, 0x58, 0x55, 0x55, 0xa0,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0xb7, 0xac, 0xc7, 0xa1,
+    0x6c, 0xc8, 0x5c, 0x5b, 0x5c, 0x4d, 0x13, 0x53, 0xc4, 0xa3, 0x82, 0x3f, 0xc7, 0x1d, 0x0e, 0x59,
+    0x5b, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x13, 0x4e, 0x13, 0x13, 0x21,
+    0xc9, 0xb2, 0x13, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x4d, 0x7f, 0x15, 0x87, 0xfe, 0x68, 0xeb, 0x72, 0xe1, 0xc4, 0x72, 0xf0, 0x21, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x41, 0x0f, 0xf0, 0xfc, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x59, 0x4e, 0x01, 0x34, 0xa8, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x62, 0x68, 0xc7, 0xcf, 0xaa,
+    0x58, 0x57, 0x57, 0xec, 0xc9, 0xc8, 0x25, 0x5b, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x01, 0x22, 0x1a, 0xb9, 0x01, 0x01, 0x01, 0x5a, 0x0e, 0xa9,
+    0x5e, 0xbc, 0x3f, 0xe1, 0x34, 0x4e, 0x01, 0x59, 0x4d, 0x5a, 0x73, 0xa8, 0x25, 0x13, 0x5a, 0x01,
+    0x01, 0x92, 0x1a, 0xea, 0x6b, 0x43, 0x5d, 0x51, 0x5a, 0x01, 0x01, 0x01, 0x59, 0x73, 0xc9, 0x62,
+    0x4e, 0x59, 0x01, 0x01, 0x01, 0x00, 0xf1, 0x43, 0x6b, 0xf9, 0x49, 0xce, 0x99, 0x85, 0xab, 0xcf,
+    0x68, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 26
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00301c13,
-    0x00874c35,
-    0x001b0f0a,
-    0x006a3b29,
-    0x0078412f,
-    0x003c2017,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00faf8f7,
-    0x0074706e,
-    0x00413f3e,
-    0x00403e3e,
-    0x00474241,
-    0x004f4744,
-    0x00544b46,
-    0x00453e37,
-    0x00090604,
-    0x00402319,
-    0x003d2318,
-    0x00322314,
-    0x00030201,
-    0x00f7f6f6,
-    0x00f8f7f6,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00fdfbf8,
-    0x00998e86,
-    0x0022160d,
-    0x001d130b,
-    0x00382416,
-    0x004a2f1d,
-    0x00261a0f,
-    0x000d0905,
-    0x00d0c9c1,
-    0x00f8f7f6,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f7f6,
-    0x00fbf9f7,
-    0x00fdfaf8,
-    0x00fcfaf8,
-    0x009d9b9a,
-    0x00050302,
-    0x000b0704,
-    0x00958b85,
-    0x00faf8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00bebcba,
-    0x00010100,
-    0x000d0805,
-    0x00040302,
-    0x00130b07,
-    0x000d0805,
-    0x00150f08,
-    0x0044301b,
-    0x0021170d,
-    0x0048341c,
-    0x00110d07,
-    0x00271c0f,
-    0x00090704,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00d7d7d6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00706a63,
-    0x000f0f0f,
-    0x00e4e4e4,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00f6f6f5,
-    0x004d4743,
-    0x000c0805,
-    0x00faf8f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x0087827f,
-    0x00130d08,
-    0x00070503,
-    0x005a3823,
-    0x004c2c1e,
-    0x00562e22,
-    0x004a271d,
-    0x0045251b,
-    0x004f2b1f,
-    0x002e1b12,
-    0x000e0705,
-    0x00d1c5c1,
-    0x00fcfaf8,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00c6c6c6,
-    0x004b4441,
-    0x004f4743,
-    0x00504844,
-    0x00514845,
-    0x00544946,
-    0x007a7270,
-    0x00fbf8f7,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00fbf9f8,
-    0x00f6f6f5,
-    0x00aaa9a8,
-    0x00020101,
-    0x00c3bebb,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fefbf9,
-    0x00c2bebc,
-    0x000d0805,
-    0x0021150d,
-    0x005d3d25,
-    0x005d3d25,
-    0x001d130b,
-    0x00504944,
-    0x00fdfaf8,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00f7f6f6,
-    0x0045413f,
-    0x000c0605,
-    0x00d0c5c1,
-    0x00fefbf9,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x00070403,
-    0x001e120c,
-    0x0025140e,
-    0x00321a14,
-    0x000d0605,
-    0x00464240,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f6,
-    0x0043413f,
-    0x000a0604,
-    0x009b8f87,
-    0x00fffbf9,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x00000000,
-    0x00522d20,
-    0x00150c08,
-    0x00030201,
-    0x00050302,
-    0x00492a1d,
-    0x005f3525,
-    0x00321b13,
-    0x00170d09,
-    0x000a0604,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x3b, 0x32, 0xd5, 0xdd, 0x55, 0xa0,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x09, 0x39, 0x39, 0x73, 0x34, 0x29, 0xfb, 0xc9, 0xce, 0xa1,
+    0x82, 0xf0, 0x59, 0x5a, 0x4d, 0x5b, 0x4e, 0x54, 0xbf, 0x15, 0x88, 0xf9, 0x48, 0xac, 0xbb, 0x5a,
+    0x5b, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x4e, 0x4d, 0x50, 0x96,
+    0x1d, 0x53, 0x5c, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0xb8, 0x21, 0xa9, 0x96, 0x35, 0xa9, 0xeb, 0x72, 0x5e, 0xf8, 0xc7, 0x48, 0xc9, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0xc0, 0x01, 0x01, 0x01, 0x01, 0x09, 0x0f, 0x41, 0x01, 0x01, 0x01, 0x5a, 0x01,
+    0x01, 0x59, 0x4e, 0x01, 0x34, 0xa9, 0x5c, 0x01, 0x01, 0x01, 0x01, 0x62, 0x36, 0x1a, 0x3f, 0x57,
+    0xec, 0x3d, 0x43, 0x57, 0x6b, 0xa8, 0x25, 0x4d, 0x5a, 0x01, 0x01, 0xba, 0x74, 0x34, 0x29, 0x29,
+    0x29, 0x8e, 0x5c, 0x01, 0x01, 0x4d, 0x01, 0xfc, 0x21, 0xb9, 0x5a, 0x01, 0x59, 0x13, 0xb9, 0xa9,
+    0xbf, 0xbc, 0xbc, 0x15, 0x29, 0x4e, 0x01, 0x59, 0x4e, 0x59, 0x26, 0xa8, 0x25, 0x13, 0x5a, 0x01,
+    0x01, 0x92, 0x1a, 0x15, 0x46, 0x3b, 0xa8, 0x73, 0x5a, 0x01, 0x01, 0x01, 0x59, 0x26, 0xc9, 0x54,
+    0x13, 0x5b, 0x01, 0x01, 0x01, 0x00, 0x00, 0x58, 0x36, 0xf0, 0x96, 0x3e, 0xe7, 0x3b, 0xea, 0xc9,
+    0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 27
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00110906,
-    0x00402419,
-    0x00512c20,
-    0x00412319,
-    0x005c3124,
-    0x00351c15,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fcf9f8,
-    0x004c4542,
-    0x000c0705,
-    0x00040202,
-    0x00150b08,
-    0x000b0704,
-    0x002d1f12,
-    0x001a100a,
-    0x00362415,
-    0x00462d1b,
-    0x000b0604,
-    0x00332314,
-    0x00010100,
-    0x00f6f5f5,
-    0x00f8f7f6,
-    0x00fcfaf8,
-    0x00f9f7f6,
-    0x00fefbf8,
-    0x00988d85,
-    0x002e1d12,
-    0x00442b1b,
-    0x00563722,
-    0x00372315,
-    0x00110b07,
-    0x000a0604,
-    0x00c5c0bc,
-    0x00fcfaf8,
-    0x00fcfaf8,
-    0x00f9f8f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fefaf9,
-    0x009e9b9a,
-    0x0012100f,
-    0x00030201,
-    0x000b0704,
-    0x008a8480,
-    0x00f7f6f6,
-    0x00f6f6f6,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f7f6,
-    0x00c2bfbc,
-    0x0011100f,
-    0x000e0906,
-    0x002b1b11,
-    0x00523220,
-    0x005d3925,
-    0x005d3d25,
-    0x004d351e,
-    0x002c1f11,
-    0x002d2011,
-    0x00503920,
-    0x00382816,
-    0x00322313,
-    0x000d0905,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x009f9991,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00ceccc9,
-    0x00766e65,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00bbb5af,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f8,
-    0x00f9f7f6,
-    0x0045423f,
-    0x00030201,
-    0x00fefbf8,
-    0x00faf9f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x0087827f,
-    0x00120b07,
-    0x0024170e,
-    0x000b0705,
-    0x004f2f1f,
-    0x00583422,
-    0x00321d14,
-    0x002e1912,
-    0x00381e16,
-    0x002c1811,
-    0x000d0705,
-    0x00cec3c0,
-    0x00f8f7f6,
-    0x00fcfaf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x00090503,
-    0x00080503,
-    0x000b0604,
-    0x000c0605,
-    0x000c0605,
-    0x000b0604,
-    0x00c7c6c6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f8f7,
-    0x00fdfaf8,
-    0x00c1bdba,
-    0x00090604,
-    0x00c8c2be,
-    0x00f9f7f7,
-    0x00f9f7f7,
-    0x00fdfaf8,
-    0x00f9f8f7,
-    0x00bcbaba,
-    0x000c0805,
-    0x0021150d,
-    0x005d3c25,
-    0x00593a23,
-    0x001a110a,
-    0x00514944,
-    0x00fefaf8,
-    0x00f6f5f5,
-    0x00faf8f7,
-    0x00fdf9f8,
-    0x00f8f7f6,
-    0x003d3d3c,
-    0x000b0604,
-    0x00d1c5c1,
-    0x00fefbf9,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x00070403,
-    0x00281710,
-    0x00502c20,
-    0x0026140f,
-    0x00110907,
-    0x00534846,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f8f7,
-    0x00494441,
-    0x000c0705,
-    0x00998e86,
-    0x00fdfaf8,
-    0x00fcf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x00010000,
-    0x00522e20,
-    0x001a0e0a,
-    0x00150c08,
-    0x004b2a1d,
-    0x00593324,
-    0x001e110c,
-    0x00050302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc6, 0xce, 0x58, 0xce, 0xaa, 0x3c,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x34, 0xa8, 0x96, 0x35, 0x1d, 0x6c, 0xef, 0x88, 0x3e, 0x1d,
+    0x82, 0x21, 0x01, 0x5a, 0x4d, 0x5a, 0x13, 0x54, 0x6c, 0x71, 0x2b, 0x88, 0xc7, 0xc9, 0x0e, 0x4d,
+    0x4d, 0x5b, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x13, 0x50, 0x0f, 0xf0,
+    0x1d, 0x62, 0x59, 0x59, 0x59, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59,
+    0xb9, 0x0f, 0xad, 0xc4, 0x2e, 0xab, 0xbc, 0x52, 0xc5, 0xc5, 0x2f, 0x8b, 0x82, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0xd9, 0x01, 0x01, 0x01, 0x01, 0x20, 0x6d, 0x01, 0x01, 0x01, 0x01, 0x93, 0x01,
+    0x01, 0x59, 0x4d, 0x5a, 0x26, 0xf0, 0x13, 0x5c, 0x59, 0x01, 0x01, 0x62, 0x35, 0xa3, 0x1d, 0xf9,
+    0x2b, 0x3b, 0x6b, 0x3c, 0x99, 0xa8, 0x25, 0x5a, 0x4d, 0x59, 0x01, 0x92, 0xc8, 0x1a, 0x1d, 0xa8,
+    0xa8, 0x1d, 0xba, 0x01, 0x01, 0x5b, 0x4e, 0xb9, 0xc9, 0x0e, 0x5b, 0x5b, 0x4e, 0x5b, 0xb8, 0xa9,
+    0xbf, 0xbc, 0x3f, 0xef, 0x29, 0x4e, 0x01, 0x5c, 0x4d, 0x5a, 0x51, 0x1d, 0x25, 0x13, 0x5a, 0x01,
+    0x01, 0x92, 0x1a, 0x98, 0x58, 0x46, 0xc6, 0x29, 0x01, 0x01, 0x01, 0x01, 0x5b, 0x74, 0xa8, 0x54,
+    0x4e, 0x4d, 0x01, 0x01, 0x01, 0x00, 0x00, 0x58, 0xd5, 0x36, 0x57, 0xaa, 0x15, 0x96, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 28
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00060302,
-    0x00120a07,
-    0x00291610,
-    0x007e4231,
-    0x001e100b,
-    0x00391e16,
-    0x00291510,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fdf9f8,
-    0x004d4543,
-    0x00160c09,
-    0x00070403,
-    0x00573022,
-    0x00422a1a,
-    0x0021150d,
-    0x00422d1a,
-    0x005d3f25,
-    0x00573c22,
-    0x00422d1a,
-    0x00110a07,
-    0x00060302,
-    0x00faf7f7,
-    0x00f8f7f6,
-    0x00f9f8f7,
-    0x00fcfaf8,
-    0x00fffbf9,
-    0x00978b85,
-    0x0022140d,
-    0x005b3a23,
-    0x00140d08,
-    0x00170f09,
-    0x00040302,
-    0x00090503,
-    0x00bbbab8,
-    0x00f7f7f6,
-    0x00f7f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00c9c8c7,
-    0x00403e3e,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x00564b46,
-    0x001f1815,
-    0x000b0604,
-    0x00060402,
-    0x00080503,
-    0x000c0704,
-    0x00968b85,
-    0x00fbf9f7,
-    0x00faf8f7,
-    0x00fbf8f7,
-    0x00fbf8f7,
-    0x00fdfbf8,
-    0x003f3e3d,
-    0x003d3c3c,
-    0x003c3c3c,
-    0x003d3c3c,
-    0x003d3c3c,
-    0x003c3c3c,
-    0x003c3c3c,
-    0x004a4541,
-    0x00312a25,
-    0x000c0705,
-    0x00090604,
-    0x000c0805,
-    0x00402a19,
-    0x00291a10,
-    0x0022150d,
-    0x0021160d,
-    0x001f150c,
-    0x00261b0f,
-    0x0047331c,
-    0x002b1e11,
-    0x00372715,
-    0x002f2213,
-    0x000d0905,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00999086,
-    0x00aaa49f,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00e6e6e5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x006a6560,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f9f7f6,
-    0x00fdfaf8,
-    0x004c4642,
-    0x00090603,
-    0x00f8f7f6,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x0087827f,
-    0x000a0604,
-    0x00140c08,
-    0x001a100a,
-    0x000d0805,
-    0x00070403,
-    0x000c0705,
-    0x0021130d,
-    0x00321a13,
-    0x00120a07,
-    0x000b0604,
-    0x00d0c4c1,
-    0x00f7f7f6,
-    0x00fffbf9,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00b8b8b8,
-    0x000a0604,
-    0x00090504,
-    0x000a0504,
-    0x00090504,
-    0x00090503,
-    0x00090504,
-    0x00f2ecea,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fdfaf8,
-    0x00c8c2be,
-    0x00080503,
-    0x00c5bfbc,
-    0x00f7f6f6,
-    0x00fefaf9,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00b9b9b8,
-    0x000c0805,
-    0x00130c08,
-    0x001b110b,
-    0x00140d08,
-    0x000c0705,
-    0x00514a45,
-    0x00fcf9f8,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00f9f7f7,
-    0x00f8f6f6,
-    0x00413e3d,
-    0x000a0604,
-    0x00d0c4c1,
-    0x00fcf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00d6d6d6,
-    0x00070403,
-    0x00150c08,
-    0x001c0f0b,
-    0x00140a08,
-    0x000d0705,
-    0x00584c48,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f7f6,
-    0x00fdfaf8,
-    0x00403f3d,
-    0x00050302,
-    0x00958a84,
-    0x00fefbf9,
-    0x00fdf9f8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00000000,
-    0x00000000,
-    0x0025150e,
-    0x001d100b,
-    0x0025150f,
-    0x000c0705,
-    0x006f402b,
-    0x001a0f0b,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x97, 0x35, 0x98, 0x55, 0xd7, 0x3c, 0x98,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x34, 0xea, 0x1a, 0xed, 0x71, 0xbf, 0x71, 0xbc, 0x40, 0x71,
+    0xc6, 0x97, 0x5c, 0x5a, 0x5b, 0x4d, 0x13, 0x53, 0xbf, 0x3f, 0x36, 0xee, 0x96, 0xc8, 0xb8, 0x59,
+    0x59, 0x01, 0x01, 0xba, 0x39, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c, 0x2a, 0x6a, 0x1d, 0x97, 0x1a,
+    0x1d, 0x53, 0x4d, 0x5c, 0x5c, 0x5c, 0x4e, 0x39, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c, 0x4c, 0x74, 0x7f,
+    0xa8, 0xc9, 0xa9, 0x1b, 0xc4, 0xbf, 0x5e, 0x5e, 0x48, 0xf8, 0xc5, 0x8b, 0x81, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0xfc, 0x01, 0x01, 0x01, 0x01, 0x41, 0x01, 0x01, 0x01, 0x01, 0x22, 0x01,
+    0x01, 0x01, 0x5a, 0x4e, 0x34, 0xc8, 0x5a, 0x4d, 0x4d, 0x01, 0x01, 0x62, 0xc9, 0x36, 0xef, 0xa9,
+    0x1a, 0xa8, 0xbe, 0x3b, 0x35, 0x1d, 0x25, 0x59, 0x13, 0x59, 0x01, 0x92, 0xc9, 0xc8, 0xc9, 0xc8,
+    0xc8, 0xc8, 0x42, 0x01, 0x01, 0x5a, 0x4e, 0x0e, 0x1a, 0x0e, 0x59, 0x13, 0x5a, 0x01, 0x92, 0xa9,
+    0x35, 0xd6, 0x36, 0xa8, 0x29, 0x4d, 0x59, 0x4d, 0x5b, 0x59, 0x39, 0xc9, 0x25, 0x4d, 0x01, 0x01,
+    0x01, 0xc0, 0x1a, 0x36, 0xd7, 0x35, 0xa8, 0x2a, 0x01, 0x01, 0x01, 0x59, 0x4e, 0x39, 0x96, 0x53,
+    0x13, 0x4d, 0x59, 0x01, 0x01, 0x00, 0x00, 0xfe, 0xd7, 0x46, 0xa8, 0xb5, 0xd5, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 29
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060403,
-    0x002b1811,
-    0x005d3425,
-    0x006f3d2c,
-    0x00844534,
-    0x00100806,
-    0x001a0d0a,
-    0x0025130f,
-    0x003d3d3d,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fcf9f8,
-    0x00464140,
-    0x000b0604,
-    0x00070403,
-    0x005d3424,
-    0x005b3824,
-    0x00533421,
-    0x00573622,
-    0x00563a21,
-    0x005e4225,
-    0x005e4225,
-    0x002a1b11,
-    0x000d0705,
-    0x00fffaf9,
-    0x00faf8f7,
-    0x00f7f6f6,
-    0x00f8f7f6,
-    0x00fffbf9,
-    0x009a8c86,
-    0x0024160e,
-    0x005f3d26,
-    0x0025180e,
-    0x00382316,
-    0x00120b07,
-    0x00090504,
-    0x00b7b7b7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00d8d7d6,
-    0x001d1815,
-    0x000b0704,
-    0x000b0704,
-    0x000b0704,
-    0x000a0604,
-    0x000a0604,
-    0x000b0604,
-    0x000b0604,
-    0x000b0604,
-    0x000b0604,
-    0x000e0805,
-    0x000b0704,
-    0x00040302,
-    0x007e7c7b,
-    0x00f9f8f7,
-    0x00fefaf9,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x00fefbf8,
-    0x00302a25,
-    0x00070503,
-    0x00090603,
-    0x00090604,
-    0x00080603,
-    0x00080503,
-    0x000a0704,
-    0x000b0704,
-    0x000b0704,
-    0x00090604,
-    0x000b0704,
-    0x000c0705,
-    0x00392317,
-    0x0024160e,
-    0x00020101,
-    0x00000000,
-    0x00100b06,
-    0x00382716,
-    0x0047321b,
-    0x000f0a06,
-    0x0022190e,
-    0x002b1e11,
-    0x000e0a05,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00999086,
-    0x005a5651,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00b6b2ae,
-    0x00554e46,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f8f7f6,
-    0x00fdfaf8,
-    0x00474340,
-    0x00090603,
-    0x00fcfaf8,
-    0x00f6f6f5,
-    0x00fdfbf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00c9c8c7,
-    0x00464240,
-    0x003e3e3e,
-    0x003e3e3d,
-    0x00444140,
-    0x00494441,
-    0x00464240,
-    0x00474240,
-    0x00433936,
-    0x00090604,
-    0x000a0604,
-    0x00d0c5c1,
-    0x00f6f5f5,
-    0x00fdfaf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00e5e5e5,
-    0x00c4bfbd,
-    0x00c5bfbd,
-    0x00c4bebd,
-    0x00c4bebd,
-    0x00c4bebd,
-    0x00dedad9,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00fbf8f7,
-    0x00faf8f7,
-    0x00b7b7b7,
-    0x00040201,
-    0x00c5c0bc,
-    0x00f6f5f5,
-    0x00fcf9f8,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00565250,
-    0x00403f3e,
-    0x00413f3f,
-    0x0042403f,
-    0x00434140,
-    0x00c7c2be,
-    0x00f6f5f5,
-    0x00f7f6f6,
-    0x00fdfaf8,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00474240,
-    0x00060402,
-    0x00cbc3bf,
-    0x00fbf9f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x006c6c6c,
-    0x004a4543,
-    0x003e3e3e,
-    0x003f3e3e,
-    0x00413f3f,
-    0x00aaaaa9,
-    0x00faf8f7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fefbf9,
-    0x003b3b3b,
-    0x00040201,
-    0x00958984,
-    0x00fefbf9,
-    0x00fdf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x004c4c4c,
-    0x00584e48,
-    0x003e3e3d,
-    0x003f3e3e,
-    0x00121010,
-    0x00030201,
-    0x00613926,
-    0x0025170f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0x99, 0xe7, 0xb5, 0x56, 0xad, 0xd5, 0x46,
+    0x51, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x26, 0x1d, 0x1a, 0xaa, 0xab, 0x2e, 0x2b, 0x3f, 0xbd, 0xbd,
+    0xc4, 0xa8, 0x13, 0x5c, 0x59, 0x5a, 0x13, 0x54, 0xfe, 0x8d, 0xa3, 0x88, 0x35, 0xc8, 0x03, 0x01,
+    0x01, 0x01, 0x01, 0xc0, 0x6a, 0x1d, 0x1d, 0x1d, 0xc9, 0xc9, 0x1d, 0x1d, 0x1d, 0x1d, 0xac, 0x1d,
+    0x96, 0xb2, 0x5b, 0x13, 0x4e, 0x4e, 0x13, 0x7f, 0x1a, 0xc8, 0xc9, 0x1a, 0x1a, 0x1d, 0x1d, 0x1d,
+    0xc9, 0x1d, 0xa8, 0xa0, 0xfe, 0x21, 0x00, 0x68, 0x8b, 0xf8, 0x68, 0xff, 0xc5, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0x16, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xaf, 0x29, 0x01,
+    0x01, 0x01, 0x5a, 0x4e, 0x73, 0xc8, 0x4d, 0x01, 0x4e, 0x59, 0x01, 0xba, 0x73, 0x3a, 0x51, 0x26,
+    0x74, 0x73, 0x73, 0xfb, 0xc9, 0xc9, 0x25, 0x01, 0x4e, 0x59, 0x01, 0x41, 0x0e, 0x0e, 0x0e, 0x0e,
+    0x0e, 0x84, 0x01, 0x01, 0x01, 0x5c, 0x5c, 0x03, 0xf1, 0x0e, 0x01, 0x4d, 0x01, 0x01, 0x01, 0x16,
+    0x39, 0x39, 0x26, 0x26, 0x0e, 0x01, 0x59, 0x4e, 0x59, 0x59, 0x73, 0x97, 0xb7, 0x4d, 0x01, 0x01,
+    0x01, 0x01, 0x09, 0x74, 0x3a, 0x39, 0x39, 0xfd, 0x5c, 0x01, 0x01, 0x5a, 0x13, 0x4c, 0xf1, 0x53,
+    0x13, 0x4d, 0x01, 0x01, 0x01, 0xcd, 0x2a, 0x51, 0x39, 0x0f, 0xf0, 0x49, 0xa3, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 30
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00110907,
-    0x00643727,
-    0x0043251b,
-    0x00040202,
-    0x0020110c,
-    0x00402119,
-    0x0020100d,
-    0x001d0f0b,
-    0x003d3d3d,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fcf9f8,
-    0x00413f3e,
-    0x00090503,
-    0x000b0605,
-    0x005d3424,
-    0x003b2317,
-    0x004b321d,
-    0x00301f13,
-    0x003e2b18,
-    0x005e4225,
-    0x005f4125,
-    0x00312113,
-    0x000b0604,
-    0x00fffaf9,
-    0x00faf7f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00fefbf9,
-    0x00948a84,
-    0x00160e09,
-    0x005e3c25,
-    0x00302013,
-    0x00281910,
-    0x00180f09,
-    0x000c0705,
-    0x00b7b7b7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00fbf8f7,
-    0x00fdf9f8,
-    0x008d8581,
-    0x00070403,
-    0x00090503,
-    0x0087827f,
-    0x00f7f6f6,
-    0x00fffbf9,
-    0x00fdf9f8,
-    0x00fdf9f8,
-    0x00fbf9f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x007c7b7a,
-    0x000a0604,
-    0x0022140d,
-    0x0022150d,
-    0x00020101,
-    0x00000000,
-    0x00100b06,
-    0x00392816,
-    0x004b341d,
-    0x0019110a,
-    0x0022190e,
-    0x002b1f11,
-    0x000e0a05,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00989085,
-    0x00080503,
-    0x00e4e4e4,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00686460,
-    0x00544d45,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x0044413f,
-    0x000a0704,
-    0x00fcfaf8,
-    0x00f6f6f6,
-    0x00fefbf8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00faf7f7,
-    0x00faf7f7,
-    0x00f9f7f7,
-    0x00fbf8f7,
-    0x00cdc3c0,
-    0x00070403,
-    0x00090503,
-    0x00d0c4c1,
-    0x00fdfaf8,
-    0x00faf8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00fbf9f8,
-    0x00f6f6f5,
-    0x00c2bebb,
-    0x00080503,
-    0x00c0bdba,
-    0x00f6f6f5,
-    0x00fcf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fcfaf8,
-    0x00f8f7f6,
-    0x00f8f7f6,
-    0x004c4542,
-    0x00090504,
-    0x00b9b8b8,
-    0x00fcf9f8,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f8f7f6,
-    0x00fefaf8,
-    0x003e3d3d,
-    0x00040302,
-    0x00938884,
-    0x00fefbf9,
-    0x00faf7f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003d3d3d,
-    0x0026170f,
-    0x006b402a,
-    0x002b1a11,
-    0x00060302,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc6, 0xda, 0x43, 0x96, 0x5d, 0xce, 0x5d, 0xd7,
+    0x51, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x39, 0xc8, 0x1d, 0xaa, 0xa1, 0xf9, 0x81, 0x8c, 0xbd, 0xbd,
+    0x82, 0x1d, 0x13, 0x5c, 0x01, 0x01, 0x13, 0x53, 0xea, 0x8d, 0x81, 0x98, 0xd4, 0xa8, 0x03, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x4d, 0x65, 0x1a,
+    0xc8, 0x62, 0x59, 0x13, 0x4d, 0x4d, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0xb2, 0xc9, 0xbf, 0xbf, 0x21, 0x00, 0x68, 0x8b, 0x52, 0xef, 0xff, 0xc5, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0x1a, 0x41, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x22, 0x29, 0x01,
+    0x01, 0x5a, 0x4d, 0x4d, 0x26, 0x1d, 0x4d, 0x59, 0x13, 0x59, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5c,
+    0x5c, 0x5b, 0x5c, 0xb7, 0x1a, 0xc8, 0x25, 0x4e, 0x5c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x01, 0xb9, 0x1a, 0xb9, 0x01, 0x4d, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x5a, 0x5a, 0x34, 0xc8, 0x92, 0x4d, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x4e, 0x51, 0x96, 0x53,
+    0x13, 0x5c, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x51, 0x47, 0xd3, 0x99, 0x97, 0x21, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 31
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00110907,
-    0x0079432f,
-    0x00010101,
-    0x00623627,
-    0x004d2b1e,
-    0x00000000,
-    0x00090503,
-    0x001d0f0b,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fbf8f8,
-    0x003d3d3d,
-    0x00000000,
-    0x00070403,
-    0x00532f21,
-    0x001a0f0a,
-    0x0021160d,
-    0x005a3f23,
-    0x00342415,
-    0x005e4124,
-    0x00634427,
-    0x002a1c11,
-    0x000a0504,
-    0x00faf8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fffcf9,
-    0x00958c84,
-    0x00060402,
-    0x00523720,
-    0x004f321f,
-    0x0024170e,
-    0x002f1d12,
-    0x00130b07,
-    0x00a7a7a7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00faf8f7,
-    0x00fdfaf8,
-    0x008e8681,
-    0x000a0604,
-    0x000b0704,
-    0x007e7c7b,
-    0x00fdfaf8,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00fbf9f7,
-    0x00f8f7f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x007b7a7a,
-    0x00050302,
-    0x0024170e,
-    0x00150d08,
-    0x00000000,
-    0x00000000,
-    0x00090603,
-    0x0020170d,
-    0x003d2b18,
-    0x005a4023,
-    0x00010100,
-    0x00241a0e,
-    0x000d0905,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00989085,
-    0x000a0704,
-    0x009c9690,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x001a1613,
-    0x00544d45,
-    0x00f7f6f6,
-    0x00faf8f7,
-    0x00fdfaf8,
-    0x00fefaf8,
-    0x00f8f7f6,
-    0x0042403e,
-    0x000a0704,
-    0x00faf8f7,
-    0x00faf8f7,
-    0x00fbf9f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00faf7f7,
-    0x00fefaf9,
-    0x00fefaf9,
-    0x00fdf9f8,
-    0x00fcf9f8,
-    0x00b8b7b7,
-    0x00080403,
-    0x000b0604,
-    0x00d1c5c1,
-    0x00faf8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f8f7,
-    0x00fbf9f7,
-    0x0084807d,
-    0x00090604,
-    0x00c2bdbb,
-    0x00f8f6f6,
-    0x00fcf9f8,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf8f7,
-    0x00fefbf9,
-    0x00fefaf8,
-    0x002c2523,
-    0x00090604,
-    0x0099928f,
-    0x00fffbf9,
-    0x00f9f8f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f7f6f6,
-    0x00f9f7f6,
-    0x00fcfaf8,
-    0x00454240,
-    0x00040202,
-    0x008e8682,
-    0x00fffbf9,
-    0x00f8f6f6,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x0021130d,
-    0x0045281b,
-    0x00553122,
-    0x0021120d,
-    0x00070402,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc6, 0x55, 0x21, 0xda, 0x57, 0x00, 0xc8, 0xd7,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x51, 0x00, 0x1a, 0xec, 0xd5, 0x5e, 0x40, 0x88, 0xbd, 0x4a,
+    0xc4, 0xc9, 0x5c, 0x59, 0x01, 0x01, 0x13, 0x53, 0x97, 0x2f, 0x2e, 0xa3, 0x6c, 0x35, 0xfc, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x4e, 0x65, 0xc9,
+    0x1d, 0xb2, 0x4e, 0x4d, 0x4d, 0x4d, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0xb2, 0x96, 0xa3, 0x36, 0x00, 0x00, 0xc8, 0x5e, 0x8c, 0x40, 0x21, 0xff, 0xac, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0x1d, 0xd8, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x69, 0x29, 0x59,
+    0x5c, 0x4e, 0x4e, 0x5a, 0x39, 0x1d, 0x5c, 0x5c, 0x4d, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x13,
+    0x13, 0x4d, 0x4d, 0x03, 0x1a, 0x1d, 0x25, 0x5c, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x5b, 0x4d, 0x62, 0xc9, 0xb9, 0x59, 0x4d, 0x59, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5c, 0x13, 0x4e, 0x9d, 0xc9, 0xd8, 0x13, 0x5b, 0x59,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5a, 0x4d, 0x26, 0x96, 0x65,
+    0x13, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x4c, 0xbe, 0x44, 0xed, 0xbe, 0x97, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 32
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00080403,
-    0x00593023,
-    0x0047261c,
-    0x004d2a1e,
-    0x00542e21,
-    0x004c2a1e,
-    0x00633627,
-    0x0026140f,
-    0x003c3c3c,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fbf8f7,
-    0x00413f3e,
-    0x00010100,
-    0x00190d0a,
-    0x004c2b1e,
-    0x00150c08,
-    0x00171009,
-    0x00543a21,
-    0x00110b07,
-    0x004e341e,
-    0x00634126,
-    0x0022160d,
-    0x00060302,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fffcf9,
-    0x009a9086,
-    0x00080503,
-    0x004a321d,
-    0x00543520,
-    0x00352115,
-    0x004a2d1d,
-    0x000a0604,
-    0x006a6a6a,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f7f6,
-    0x00fefbf8,
-    0x00968c84,
-    0x00180f09,
-    0x001b110b,
-    0x00585351,
-    0x00fcfaf8,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00f7f6f6,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x007f7d7b,
-    0x00010000,
-    0x001b120b,
-    0x00140d08,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x000a0704,
-    0x00130d08,
-    0x002b1e11,
-    0x0050391f,
-    0x00120d07,
-    0x000b0804,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00999085,
-    0x000b0804,
-    0x0032302e,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00aaa59f,
-    0x000b0804,
-    0x00554d46,
-    0x00fbf9f7,
-    0x00fefbf9,
-    0x00f7f6f6,
-    0x00f6f6f5,
-    0x00f9f7f6,
-    0x003d3d3c,
-    0x000b0704,
-    0x00d5cfcc,
-    0x00fcfaf8,
-    0x00f7f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f5f5,
-    0x00faf7f7,
-    0x00fffaf9,
-    0x00fefaf9,
-    0x00fdfaf8,
-    0x00fcf9f8,
-    0x00b9b8b8,
-    0x00090503,
-    0x000b0604,
-    0x00d2c6c2,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x0063605e,
-    0x000a0604,
-    0x007f7772,
-    0x00faf8f7,
-    0x00fefaf9,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00fbf8f7,
-    0x00fdfaf8,
-    0x00f0ebe9,
-    0x000b0604,
-    0x000b0604,
-    0x005f5d5c,
-    0x00fefaf8,
-    0x00fefbf9,
-    0x00f9f7f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00f8f7f6,
-    0x00fbf9f7,
-    0x00fbf9f8,
-    0x00edeae8,
-    0x000b0704,
-    0x000d0805,
-    0x0053504e,
-    0x00fefaf8,
-    0x00f8f7f6,
-    0x00f7f6f6,
-    0x00faf7f7,
-    0x00faf7f7,
-    0x00f7f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x0022140e,
-    0x00130b08,
-    0x00573122,
-    0x004a291d,
-    0x00110907,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xed, 0x3d, 0x57, 0xec, 0x57, 0xda, 0x46,
+    0x4c, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x39, 0x21, 0xd5, 0x57, 0x36, 0xee, 0x2f, 0xc7, 0x52, 0xd2,
+    0xbf, 0x97, 0x59, 0x01, 0x01, 0x01, 0x13, 0x54, 0x1a, 0xf8, 0x2b, 0x87, 0x3e, 0xc9, 0x09, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x13, 0x53, 0xd4,
+    0xd6, 0x16, 0x4d, 0x5a, 0x59, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x0b, 0x00, 0xe1, 0x36, 0x00, 0x00, 0x21, 0x1d, 0x36, 0xc5, 0x2f, 0xc7, 0x1d, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0x1d, 0xe3, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xfc, 0x1d, 0x29, 0x4d,
+    0x13, 0x59, 0x01, 0x5a, 0x51, 0x1d, 0x20, 0x4d, 0x59, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x13,
+    0x13, 0x4e, 0x4d, 0x92, 0xc8, 0x1d, 0xbb, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x22, 0xc9, 0x8e, 0x5c, 0x13, 0x5a, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x4e, 0x42, 0x1d, 0x1d, 0x22, 0x4e, 0x13, 0x5b,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5a, 0x4d, 0x4d, 0x42, 0x1d, 0xa9, 0xcd,
+    0x4e, 0x5a, 0x59, 0x5c, 0x5c, 0x59, 0x01, 0x01, 0x01, 0x4c, 0xbf, 0x35, 0xed, 0x3d, 0xc6, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 33
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x0026140f,
-    0x006e3b2b,
-    0x006b3a2a,
-    0x00060302,
-    0x00583023,
-    0x007a4230,
-    0x0023120e,
-    0x003d3d3d,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fdf9f8,
-    0x004e4643,
-    0x00080403,
-    0x0025150e,
-    0x0041251a,
-    0x00130b07,
-    0x000d0905,
-    0x00312213,
-    0x00644627,
-    0x0020140d,
-    0x00462c1b,
-    0x0021160d,
-    0x00020101,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00fffcf9,
-    0x00998f86,
-    0x00010100,
-    0x00432d1b,
-    0x00633f27,
-    0x002d1c12,
-    0x00533321,
-    0x00382216,
-    0x00161311,
-    0x00c6c6c6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f9f8f6,
-    0x00fefbf8,
-    0x009b8e86,
-    0x0020150d,
-    0x001c130b,
-    0x00150d08,
-    0x00c1bdbb,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x0084807d,
-    0x00030201,
-    0x001a120a,
-    0x00130e07,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001a120a,
-    0x00654828,
-    0x00120d07,
-    0x000c0805,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x009a9186,
-    0x000b0804,
-    0x000a0804,
-    0x00c9c8c7,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x005e5953,
-    0x000c0805,
-    0x00544d46,
-    0x00fdfaf8,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x0043403f,
-    0x000e0905,
-    0x005f5953,
-    0x00f8f7f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00faf7f7,
-    0x00faf8f7,
-    0x00f9f7f7,
-    0x00fbf8f7,
-    0x00cbc2bf,
-    0x00080503,
-    0x000b0604,
-    0x00d1c6c2,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00cbc9c8,
-    0x000d0805,
-    0x000f0806,
-    0x001d1714,
-    0x00ded5d0,
-    0x00fdf9f8,
-    0x00f8f6f6,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f6f6f5,
-    0x00faf8f7,
-    0x00fffbf9,
-    0x007a6e67,
-    0x000d0805,
-    0x00130b08,
-    0x000d0705,
-    0x00ddd3cf,
-    0x00fffbf9,
-    0x00f9f8f7,
-    0x00f6f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x00f7f6f6,
-    0x00fbf9f7,
-    0x00fdfaf8,
-    0x00fdfaf8,
-    0x008f8782,
-    0x000c0705,
-    0x0020140d,
-    0x000b0704,
-    0x00ded4d0,
-    0x00fdf9f8,
-    0x00fbf8f7,
-    0x00fffaf9,
-    0x00fffaf9,
-    0x00faf7f7,
-    0x00f6f6f5,
-    0x00f5f5f5,
-    0x00f5f5f5,
-    0x003c3c3c,
-    0x001c110b,
-    0x00120a07,
-    0x00341e14,
-    0x005b3424,
-    0x00130b07,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x46, 0xb4, 0xb4, 0x97, 0xed, 0x55, 0xbe,
+    0x51, 0x01, 0x01, 0x01, 0x01, 0x4d, 0x34, 0x1a, 0xfe, 0x43, 0x35, 0xac, 0x82, 0xf6, 0x5e, 0x3e,
+    0x5e, 0x21, 0x01, 0x01, 0x01, 0x01, 0x13, 0x54, 0x21, 0x71, 0xd2, 0x6c, 0x2e, 0xa0, 0x69, 0xba,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5b, 0x13, 0x54, 0x5e,
+    0xe1, 0x36, 0xb9, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x62, 0xf0, 0xe1, 0x36, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe1, 0xd0, 0xc7, 0xa9, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x54, 0x1d, 0x1d, 0xba, 0x01, 0x01, 0x01, 0x01, 0x01, 0x60, 0xa9, 0x29, 0x4e,
+    0x5a, 0x01, 0x01, 0x01, 0x26, 0xac, 0x60, 0x5a, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x5c,
+    0x5c, 0x5b, 0x5c, 0xb7, 0x1a, 0x1d, 0xbb, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0xba, 0xa9, 0xad, 0x6a, 0x84, 0x4d, 0x59, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x5c, 0x13, 0x6d, 0xa9, 0x35, 0xa8, 0xc0, 0x13, 0x5b,
+    0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x59, 0x4d, 0x4e, 0x4e, 0x65, 0xa8, 0x5e, 0x1d,
+    0x84, 0x4d, 0x5c, 0x13, 0x13, 0x5c, 0x01, 0x01, 0x01, 0x4c, 0xd6, 0x35, 0x87, 0xaa, 0x35, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 34
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070403,
-    0x001e0f0b,
-    0x0044241b,
-    0x008f4f38,
-    0x0025150f,
-    0x006b3b2a,
-    0x0025140e,
-    0x002d2d2d,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00d1c5c1,
-    0x00423935,
-    0x00080403,
-    0x00673828,
-    0x0026150f,
-    0x000c0604,
-    0x00040301,
-    0x001c130b,
-    0x00432f1a,
-    0x003b2918,
-    0x002f2012,
-    0x00291d10,
-    0x00000000,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00d2c9c2,
-    0x00726b64,
-    0x00150e08,
-    0x00392616,
-    0x00513320,
-    0x00150e08,
-    0x002c1b11,
-    0x00462b1b,
-    0x0022150e,
-    0x00221a16,
-    0x006e6d6c,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00c3c0bc,
-    0x00c7c3be,
-    0x007c7168,
-    0x002e1e12,
-    0x00170e09,
-    0x001c110b,
-    0x00130b08,
-    0x0065615e,
-    0x00a8a8a8,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x0067635f,
-    0x00060402,
-    0x001e160c,
-    0x000d0905,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00181209,
-    0x005d4324,
-    0x000f0a06,
-    0x000b0804,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x007c7368,
-    0x00110c07,
-    0x000c0905,
-    0x00726b64,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00070503,
-    0x00120d07,
-    0x00423c35,
-    0x00d0c7c1,
-    0x00c7c1be,
-    0x00cdc5c0,
-    0x00c7c1be,
-    0x00bab9b8,
-    0x003c3633,
-    0x00160e09,
-    0x00110b07,
-    0x00232120,
-    0x0095908d,
-    0x00b8b7b7,
-    0x00b7b7b7,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b7b6b6,
-    0x00b9b8b8,
-    0x00bbb9b9,
-    0x00bbb9b9,
-    0x00bbb9b9,
-    0x00bcbab9,
-    0x009b9290,
-    0x00070403,
-    0x000b0604,
-    0x00a99a95,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00716e6d,
-    0x000b0604,
-    0x00100906,
-    0x003b2417,
-    0x00281610,
-    0x00231b16,
-    0x00827974,
-    0x00c2bebc,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b9b8b8,
-    0x00a09d9b,
-    0x004c4642,
-    0x000c0705,
-    0x000f0a06,
-    0x00190f0a,
-    0x00301e13,
-    0x00150c08,
-    0x008b7d77,
-    0x00c9c2bf,
-    0x00b8b8b8,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b6b6b6,
-    0x00b7b7b7,
-    0x00bcbab9,
-    0x00c8c2be,
-    0x00c1b8b2,
-    0x00524a44,
-    0x000a0604,
-    0x001b100b,
-    0x003c2317,
-    0x00170e09,
-    0x000d0805,
-    0x00786d66,
-    0x00c4b8b3,
-    0x00d2c5c2,
-    0x00d2c5c2,
-    0x00c4bebc,
-    0x00bab8b8,
-    0x00b7b7b7,
-    0x00b7b7b7,
-    0x002d2d2d,
-    0x001e120c,
-    0x00342014,
-    0x004c2f1e,
-    0x00593623,
-    0x00100a06,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0xd7, 0x43, 0x32, 0x46, 0xdd, 0x46,
+    0xe3, 0x03, 0x03, 0x03, 0x03, 0x25, 0xfb, 0x1a, 0xdb, 0x46, 0x1d, 0x96, 0xe1, 0x72, 0x8c, 0x81,
+    0xc4, 0x00, 0x03, 0x03, 0x03, 0x03, 0xbb, 0x6d, 0x36, 0x8b, 0x2e, 0x36, 0x99, 0x3e, 0xbf, 0x6f,
+    0x09, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0xb9, 0x0e, 0x6d, 0x6c,
+    0xd4, 0xd6, 0x35, 0x22, 0xfc, 0xaf, 0xaf, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03,
+    0x03, 0x22, 0x97, 0x5e, 0xac, 0x00, 0x00, 0x00, 0x00, 0x00, 0xee, 0xbd, 0x68, 0x1d, 0x03, 0x03,
+    0x03, 0xaf, 0xaf, 0x6d, 0xc7, 0xa9, 0x6d, 0x03, 0x03, 0x03, 0x03, 0x03, 0x1a, 0xc7, 0xfb, 0x25,
+    0x0e, 0xb7, 0x0e, 0x92, 0xfa, 0xea, 0xc7, 0x70, 0x30, 0x03, 0x03, 0xaf, 0xaf, 0xaf, 0x92, 0xb8,
+    0xb8, 0xb8, 0xb8, 0xd8, 0x1a, 0x1d, 0xd9, 0x03, 0x03, 0x03, 0x03, 0xaf, 0xaf, 0xaf, 0xaf, 0x03,
+    0x03, 0x03, 0x03, 0x03, 0x03, 0x09, 0x1d, 0x68, 0xa1, 0x47, 0x6f, 0x8e, 0xb9, 0x03, 0x03, 0xaf,
+    0xaf, 0xaf, 0xaf, 0x03, 0x03, 0x03, 0x92, 0x50, 0x34, 0xa8, 0x68, 0xef, 0x3b, 0x36, 0xb3, 0xb7,
+    0x92, 0x03, 0x03, 0xaf, 0xaf, 0xaf, 0xaf, 0x03, 0xb8, 0x0e, 0x93, 0x29, 0xc9, 0xd6, 0xa1, 0xd4,
+    0xa9, 0x6d, 0x93, 0xbb, 0xbb, 0xb9, 0x92, 0x03, 0x03, 0xe3, 0x15, 0x87, 0xf9, 0x2b, 0x68, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 35
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x00080403,
-    0x00070403,
-    0x00010101,
-    0x00070403,
-    0x0048281c,
-    0x005b3323,
-    0x00361e15,
-    0x0020120d,
-    0x00030101,
-    0x00020101,
-    0x000a0504,
-    0x000d0605,
-    0x000b0604,
-    0x000a0604,
-    0x000f0806,
-    0x00120a07,
-    0x0048271c,
-    0x000d0705,
-    0x00050302,
-    0x00020101,
-    0x001b120a,
-    0x00523920,
-    0x00100b06,
-    0x002f2112,
-    0x003c2a18,
-    0x00171009,
-    0x000e0a05,
-    0x00070503,
-    0x00020201,
-    0x00060402,
-    0x00070503,
-    0x00040201,
-    0x00412a1a,
-    0x0042291a,
-    0x00362215,
-    0x0050331f,
-    0x00664028,
-    0x00110a07,
-    0x001d120b,
-    0x00120b07,
-    0x00120b07,
-    0x00130b07,
-    0x000f0a06,
-    0x000e0906,
-    0x000b0704,
-    0x00040201,
-    0x00010101,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00010000,
-    0x00070403,
-    0x000d0805,
-    0x000f0b06,
-    0x0019100a,
-    0x00402819,
-    0x005e3f25,
-    0x00573722,
-    0x00382316,
-    0x00382616,
-    0x00070503,
-    0x00000000,
-    0x00010000,
-    0x00070503,
-    0x000c0805,
-    0x000d0805,
-    0x000a0604,
-    0x000b0704,
-    0x000e0805,
-    0x000e0805,
-    0x000d0805,
-    0x000c0805,
-    0x00090603,
-    0x00060402,
-    0x00070503,
-    0x00342514,
-    0x00090704,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000f0b06,
-    0x00372816,
-    0x003e2d19,
-    0x00050302,
-    0x00050402,
-    0x00070503,
-    0x00090704,
-    0x000c0905,
-    0x00100b06,
-    0x0018110a,
-    0x00392816,
-    0x00322314,
-    0x00120d07,
-    0x000d0905,
-    0x000d0905,
-    0x000c0805,
-    0x000b0804,
-    0x000d0905,
-    0x00171009,
-    0x00312213,
-    0x00100b06,
-    0x000b0704,
-    0x000c0805,
-    0x000b0805,
-    0x000e0906,
-    0x000c0905,
-    0x00140d08,
-    0x00150d08,
-    0x002a1e11,
-    0x00110b07,
-    0x00120b07,
-    0x000e0906,
-    0x00030201,
-    0x00010000,
-    0x000a0704,
-    0x000e0906,
-    0x000f0906,
-    0x000e0905,
-    0x000d0805,
-    0x000b0704,
-    0x000a0604,
-    0x000b0604,
-    0x0027150f,
-    0x000f0906,
-    0x00090504,
-    0x00080503,
-    0x00030201,
-    0x00040201,
-    0x000b0604,
-    0x00040201,
-    0x000b0604,
-    0x00090503,
-    0x00000000,
-    0x00040202,
-    0x00020101,
-    0x00020101,
-    0x00060302,
-    0x000a0604,
-    0x000c0605,
-    0x000c0605,
-    0x000f0806,
-    0x00090504,
-    0x00563321,
-    0x004a2a1d,
-    0x00362215,
-    0x00180f09,
-    0x000d0805,
-    0x00080503,
-    0x00090603,
-    0x000d0805,
-    0x000e0906,
-    0x000d0805,
-    0x00090604,
-    0x00040302,
-    0x00030201,
-    0x00010000,
-    0x000c0805,
-    0x00060402,
-    0x000a0604,
-    0x0022160d,
-    0x00533620,
-    0x00694629,
-    0x003c2818,
-    0x00362315,
-    0x00160d09,
-    0x000d0805,
-    0x00030201,
-    0x00080503,
-    0x00040201,
-    0x00040201,
-    0x00060402,
-    0x000e0805,
-    0x000e0806,
-    0x000e0806,
-    0x000d0705,
-    0x000b0604,
-    0x000b0704,
-    0x000d0805,
-    0x002a1810,
-    0x003f2419,
-    0x00563121,
-    0x004d2c1f,
-    0x00381f16,
-    0x00170d09,
-    0x000b0604,
-    0x000d0705,
-    0x000e0805,
-    0x000e0805,
-    0x000b0604,
-    0x00080503,
-    0x00040201,
-    0x000e0806,
-    0x00321e14,
-    0x00885635,
-    0x008f5b38,
-    0x00442a1a,
-    0x000b0705,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x1a, 0x1a, 0x21, 0x1a, 0x3d, 0xaa, 0x3c, 0x5d,
+    0xf0, 0x21, 0xc9, 0xa8, 0x1d, 0xc9, 0xad, 0x35, 0x3d, 0xa8, 0x96, 0x21, 0xe1, 0x2f, 0x68, 0x81,
+    0x8c, 0xee, 0xac, 0x1a, 0xf0, 0x97, 0x1a, 0xf1, 0x1b, 0x44, 0x88, 0x2e, 0xd2, 0xc6, 0x15, 0x35,
+    0x35, 0x35, 0x68, 0xad, 0x1d, 0xf1, 0x21, 0x21, 0x00, 0x00, 0x00, 0x1a, 0xa9, 0x68, 0xef, 0xcf,
+    0xbc, 0x2b, 0x88, 0x8b, 0x1a, 0x00, 0x00, 0x1a, 0xa9, 0xa9, 0xc9, 0x1d, 0xac, 0xac, 0xa9, 0xa9,
+    0xc8, 0x97, 0x1a, 0x88, 0xc9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x68, 0x8b, 0x1b, 0x96, 0x97, 0x1a,
+    0xc9, 0xa9, 0x68, 0xef, 0x8b, 0x82, 0xc7, 0xac, 0xac, 0xa9, 0x1d, 0xac, 0xee, 0x82, 0x68, 0x1d,
+    0xa9, 0xa9, 0xad, 0xa9, 0x36, 0x36, 0xc5, 0xc7, 0x35, 0xad, 0xf0, 0x00, 0x1d, 0xad, 0xad, 0xac,
+    0xa9, 0x1d, 0xc9, 0x1d, 0x47, 0xad, 0xc8, 0x1a, 0xf0, 0xf1, 0x1d, 0xf1, 0x1d, 0xc8, 0x00, 0x96,
+    0x21, 0x21, 0x97, 0xc9, 0xa8, 0xa8, 0xad, 0xc8, 0x2b, 0x3e, 0x88, 0xd4, 0xa9, 0x1a, 0xc8, 0xa9,
+    0xad, 0xa9, 0xc9, 0x96, 0xf0, 0x00, 0xa9, 0x97, 0xc9, 0xbf, 0x2f, 0xf7, 0x8c, 0x88, 0xea, 0xa9,
+    0xf0, 0x1a, 0xf1, 0xf1, 0x97, 0xac, 0xad, 0xad, 0xa8, 0x1d, 0x1d, 0xa9, 0x98, 0xce, 0xed, 0x57,
+    0x3c, 0xea, 0x1d, 0xa8, 0xac, 0xac, 0x1d, 0x1a, 0xf1, 0xad, 0x3b, 0x86, 0xca, 0x44, 0x1d, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 36
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x001e0f0c,
-    0x0047241c,
-    0x0045231b,
-    0x001b0d0b,
-    0x00030201,
-    0x0022130d,
-    0x0076432e,
-    0x000f0906,
-    0x00170c09,
-    0x00110906,
-    0x00070403,
-    0x00000000,
-    0x000e0706,
-    0x00030201,
-    0x000a0504,
-    0x002c1711,
-    0x00542d21,
-    0x001f110c,
-    0x000a0704,
-    0x001e150c,
-    0x001f150c,
-    0x00251a0f,
-    0x00573d22,
-    0x0020170d,
-    0x00000000,
-    0x00010100,
-    0x00130d07,
-    0x00040302,
-    0x0022180d,
-    0x00352515,
-    0x00110c07,
-    0x0019110a,
-    0x00513520,
-    0x00663c28,
-    0x006e402b,
-    0x00392116,
-    0x001c110b,
-    0x0027180f,
-    0x0044291b,
-    0x00633b27,
-    0x00683f29,
-    0x00080503,
-    0x00301e13,
-    0x00332014,
-    0x002d1c12,
-    0x0020130c,
-    0x00100a06,
-    0x00080503,
-    0x00060402,
-    0x002f1d12,
-    0x00321f13,
-    0x003c2518,
-    0x00090504,
-    0x002a1b11,
-    0x00412b1a,
-    0x00553b21,
-    0x00624326,
-    0x00724d2d,
-    0x00553a22,
-    0x00442f1b,
-    0x003a2916,
-    0x003a2917,
-    0x00362615,
-    0x003e2a18,
-    0x000c0805,
-    0x0026170f,
-    0x002e1c12,
-    0x00160e09,
-    0x00030201,
-    0x000f0906,
-    0x00160e09,
-    0x00040202,
-    0x00271a10,
-    0x0023190e,
-    0x000b0804,
-    0x002b1e11,
-    0x003d2b18,
-    0x00080603,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00040301,
-    0x00110c07,
-    0x002a1e10,
-    0x00342514,
-    0x00382816,
-    0x00090603,
-    0x00090704,
-    0x001f160c,
-    0x00312313,
-    0x003f2d19,
-    0x00523a20,
-    0x004f381f,
-    0x003b2a17,
-    0x00322414,
-    0x00271c0f,
-    0x00100b06,
-    0x0022180d,
-    0x003f2d19,
-    0x004d371e,
-    0x003a2a17,
-    0x00161009,
-    0x001b130b,
-    0x0021170d,
-    0x0024190e,
-    0x003c2a18,
-    0x00452d1b,
-    0x00332414,
-    0x00302113,
-    0x00432d1a,
-    0x00271b0f,
-    0x003e2c19,
-    0x003e2b18,
-    0x0021170d,
-    0x00060402,
-    0x0020150c,
-    0x00281910,
-    0x002d1d12,
-    0x003b2517,
-    0x003b2417,
-    0x00311e13,
-    0x0022150d,
-    0x00060303,
-    0x005f3a25,
-    0x004a2a1d,
-    0x00100906,
-    0x00080403,
-    0x002c1911,
-    0x001f100c,
-    0x00190d0a,
-    0x003a1f17,
-    0x00090504,
-    0x00110907,
-    0x00130a07,
-    0x000f0806,
-    0x000d0705,
-    0x000e0705,
-    0x00130a07,
-    0x00190d0a,
-    0x00281510,
-    0x0024130e,
-    0x00060303,
-    0x00683529,
-    0x004c2a1e,
-    0x0073492d,
-    0x00332014,
-    0x00382316,
-    0x0028190f,
-    0x000e0906,
-    0x00040201,
-    0x001d120b,
-    0x0023160e,
-    0x000b0704,
-    0x00110b06,
-    0x00090604,
-    0x00030201,
-    0x0020150d,
-    0x0022160d,
-    0x00070503,
-    0x00030201,
-    0x000a0604,
-    0x0023170d,
-    0x00573922,
-    0x003e2919,
-    0x00372416,
-    0x00352315,
-    0x001b110b,
-    0x001e120c,
-    0x00110a07,
-    0x00100a06,
-    0x00190f0a,
-    0x00110a07,
-    0x001f120c,
-    0x00301b13,
-    0x00381e16,
-    0x00361d15,
-    0x0025140f,
-    0x000f0a06,
-    0x00361f15,
-    0x0044251b,
-    0x00633427,
-    0x00693a29,
-    0x00723f2d,
-    0x005e3425,
-    0x00502e1f,
-    0x00150c08,
-    0x0024140e,
-    0x002c1911,
-    0x0023140e,
-    0x001c110b,
-    0x00130c08,
-    0x00140c08,
-    0x00351f15,
-    0x0026170f,
-    0x003c2617,
-    0x00432a1b,
-    0x0021140d,
-    0x00060302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xd7, 0x3d, 0x43, 0xd5, 0xf0, 0xbe, 0xa7, 0xad, 0xea,
+    0xc6, 0x1a, 0x00, 0xa8, 0xf0, 0xc9, 0x99, 0xec, 0x15, 0x1d, 0x5e, 0x5e, 0x48, 0x40, 0x5e, 0x00,
+    0x21, 0x36, 0x96, 0xff, 0x88, 0xc7, 0xef, 0x2e, 0xdd, 0xb5, 0xa0, 0xd6, 0x47, 0x44, 0xdc, 0xd3,
+    0x1a, 0x3b, 0x82, 0x6c, 0x5d, 0x68, 0x1a, 0x97, 0x6c, 0x3b, 0xa1, 0xc8, 0xc4, 0x1b, 0x3f, 0x4a,
+    0xb1, 0x3f, 0x72, 0x8b, 0x8c, 0x88, 0x8c, 0xa9, 0x47, 0x6c, 0xea, 0xf0, 0xad, 0xea, 0x96, 0x48,
+    0xff, 0x1d, 0xc5, 0x8c, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x96, 0xc7, 0xc5, 0x88, 0x8b, 0xc8,
+    0xc9, 0x5e, 0x82, 0x1b, 0x2f, 0x2f, 0x8c, 0x82, 0x48, 0x68, 0xff, 0x1b, 0x52, 0x8c, 0xee, 0xe1,
+    0x5e, 0xff, 0x8c, 0x71, 0x82, 0x81, 0x71, 0x48, 0x1b, 0x8c, 0x5e, 0x97, 0x5e, 0x98, 0x6c, 0xa1,
+    0xa1, 0x3b, 0xbf, 0x97, 0x8d, 0x3e, 0x68, 0x1a, 0x99, 0x15, 0xd5, 0xa0, 0xc8, 0xc6, 0x35, 0xad,
+    0xa8, 0xa8, 0x35, 0xd5, 0x47, 0x46, 0x97, 0xdb, 0x57, 0xb0, 0x82, 0x88, 0x48, 0xad, 0xf1, 0x15,
+    0xfe, 0x1d, 0x68, 0xc9, 0xf0, 0x5e, 0xbf, 0x1a, 0xf0, 0xc9, 0xbf, 0x3f, 0xcf, 0x88, 0x88, 0xd6,
+    0x15, 0xc6, 0x68, 0xef, 0xc6, 0x15, 0x3b, 0x3c, 0x3c, 0x46, 0x68, 0x87, 0x43, 0xda, 0xdd, 0xb5,
+    0xe7, 0x58, 0x36, 0xfe, 0x99, 0xfe, 0xd6, 0x35, 0x36, 0x87, 0x47, 0xa1, 0x44, 0xbf, 0x97, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 37
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00090403,
-    0x004c271e,
-    0x00b05945,
-    0x00ae5844,
-    0x0049251c,
-    0x00090403,
-    0x00100907,
-    0x00532f20,
-    0x005b3224,
-    0x00160c09,
-    0x00020101,
-    0x001c0f0b,
-    0x00824333,
-    0x006c3a2b,
-    0x00583022,
-    0x0048271d,
-    0x00351c15,
-    0x001d0f0b,
-    0x000b0604,
-    0x0020160d,
-    0x00604226,
-    0x00624427,
-    0x00322314,
-    0x00362515,
-    0x005e4125,
-    0x006b4a2a,
-    0x00664728,
-    0x00724f2d,
-    0x006a4a2a,
-    0x0048321c,
-    0x00372616,
-    0x00442f1a,
-    0x0045301b,
-    0x00462b1b,
-    0x0073432d,
-    0x0074442e,
-    0x00321d14,
-    0x00070403,
-    0x00020101,
-    0x000e0805,
-    0x0021130d,
-    0x00392316,
-    0x0069422a,
-    0x0024170e,
-    0x00150d08,
-    0x003e2719,
-    0x005d3b24,
-    0x00533421,
-    0x0020140c,
-    0x002e1d12,
-    0x00523420,
-    0x003a2317,
-    0x0070422c,
-    0x00352015,
-    0x000a0604,
-    0x00332014,
-    0x003c2617,
-    0x007c4c31,
-    0x00674228,
-    0x005c4024,
-    0x007a5630,
-    0x0045311b,
-    0x0024190e,
-    0x001b130b,
-    0x00372315,
-    0x0070442c,
-    0x00050302,
-    0x000b0604,
-    0x004c2f1e,
-    0x005a3823,
-    0x00472d1c,
-    0x00462c1b,
-    0x00321f14,
-    0x0021160d,
-    0x0046321b,
-    0x005d4225,
-    0x00654728,
-    0x00382816,
-    0x00050402,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000c0805,
-    0x002a1d10,
-    0x003d2b18,
-    0x004f381f,
-    0x00674a29,
-    0x00684b29,
-    0x00241a0e,
-    0x0018120a,
-    0x002c1f11,
-    0x0024190e,
-    0x00372816,
-    0x002e2112,
-    0x001e150c,
-    0x00573f23,
-    0x00030201,
-    0x0047331c,
-    0x0044311b,
-    0x00010100,
-    0x00070503,
-    0x00332414,
-    0x003e2c19,
-    0x00302213,
-    0x005d4225,
-    0x00644527,
-    0x006d462a,
-    0x006f4c2c,
-    0x00543721,
-    0x0073482d,
-    0x00794c2f,
-    0x00794b30,
-    0x00623e27,
-    0x003f2819,
-    0x00281a0f,
-    0x00492f1d,
-    0x00442b1b,
-    0x001f120c,
-    0x00673d29,
-    0x00613926,
-    0x00523320,
-    0x00664128,
-    0x003b2517,
-    0x00472a1c,
-    0x0070432c,
-    0x0074442d,
-    0x003d2318,
-    0x00150b08,
-    0x00080403,
-    0x00281510,
-    0x00683629,
-    0x00030101,
-    0x00381e16,
-    0x0047261c,
-    0x001e100c,
-    0x00753d2e,
-    0x00502a1f,
-    0x006d392b,
-    0x002c1711,
-    0x00050202,
-    0x0024120e,
-    0x005b2e24,
-    0x002b1811,
-    0x003d2618,
-    0x00633f27,
-    0x00170e09,
-    0x000f0906,
-    0x00301e12,
-    0x006d452b,
-    0x006b432a,
-    0x00774a2e,
-    0x00593823,
-    0x004e321f,
-    0x00774e2e,
-    0x00624126,
-    0x00503520,
-    0x00171009,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x000e0905,
-    0x00442c1a,
-    0x00553722,
-    0x004e321f,
-    0x00472e1c,
-    0x0022150d,
-    0x00643d27,
-    0x00000000,
-    0x00050302,
-    0x00683e29,
-    0x0079472f,
-    0x00351f15,
-    0x00010000,
-    0x002c1812,
-    0x0022120d,
-    0x002e1912,
-    0x00703c2c,
-    0x005f3225,
-    0x006b372a,
-    0x00723a2d,
-    0x00603426,
-    0x007a4530,
-    0x0073432d,
-    0x003e2418,
-    0x00080403,
-    0x002b1811,
-    0x001f110c,
-    0x00030201,
-    0x002c1a11,
-    0x00331f14,
-    0x00331f14,
-    0x00533220,
-    0x001c110b,
-    0x001d110b,
-    0x0043261a,
-    0x0040231a,
-    0x001b0e0a,
-    0x00020101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc8, 0x3d, 0x94, 0x94, 0x3d, 0xc8, 0xc6, 0xec, 0xaa, 0xea,
+    0x21, 0xd7, 0x56, 0xb4, 0xed, 0x3d, 0x3c, 0xd7, 0x1d, 0x5e, 0x4a, 0x4a, 0x82, 0x88, 0xbd, 0xd1,
+    0xd0, 0xb1, 0xd1, 0xf8, 0x8b, 0x72, 0x72, 0x3e, 0xa7, 0xa7, 0x3b, 0x1a, 0x21, 0xac, 0xbe, 0xa0,
+    0xf7, 0xa3, 0x36, 0xcf, 0xbc, 0x2e, 0x5d, 0x6c, 0x2e, 0xa1, 0xf3, 0x87, 0xc9, 0x82, 0xa1, 0xdf,
+    0xf7, 0xbd, 0xc3, 0x72, 0xff, 0xe1, 0x88, 0xf3, 0x96, 0x1d, 0xf9, 0x3f, 0x3e, 0x3e, 0x82, 0x5e,
+    0xf8, 0xbd, 0xf6, 0x8b, 0x97, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa9, 0xc4, 0x8c, 0x2f,
+    0xd0, 0xd0, 0xff, 0xef, 0xc5, 0xff, 0x8b, 0x81, 0x5e, 0x40, 0xf0, 0xf8, 0x72, 0x21, 0x1a, 0x82,
+    0x1b, 0x81, 0xbd, 0xf6, 0xf2, 0xb1, 0x2f, 0xb0, 0xdf, 0xdf, 0xdc, 0xcf, 0x48, 0x3e, 0x71, 0x15,
+    0xdd, 0x49, 0x2e, 0xd2, 0xa1, 0x3e, 0xf3, 0xa7, 0xa1, 0x35, 0x1a, 0x47, 0xdb, 0xf0, 0x3c, 0x3d,
+    0xd7, 0xa6, 0x58, 0xb4, 0x99, 0x96, 0xbe, 0xaa, 0x99, 0xcf, 0xd2, 0xd4, 0xad, 0x6c, 0xf2, 0xf7,
+    0xde, 0x3f, 0xf9, 0xc2, 0x4a, 0x2e, 0xee, 0x21, 0x00, 0x00, 0xac, 0x71, 0x2b, 0xf9, 0x3e, 0xbf,
+    0xdc, 0x00, 0x96, 0xdd, 0xde, 0x87, 0x00, 0x99, 0xbe, 0x6b, 0xb5, 0xe7, 0xdb, 0xb4, 0xe7, 0x55,
+    0xa7, 0xce, 0x1a, 0x99, 0x15, 0xf0, 0x99, 0x87, 0x87, 0x2e, 0xd6, 0x15, 0x43, 0xce, 0xd5, 0x21,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 38
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000a0503,
-    0x004e281e,
-    0x00ba5d49,
-    0x00b45c47,
-    0x004b261e,
-    0x000d0606,
-    0x001c0e0b,
-    0x00512a20,
-    0x007e4332,
-    0x007f4432,
-    0x007c4030,
-    0x006a352a,
-    0x003b1e17,
-    0x001a0d0a,
-    0x00080403,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x0023180e,
-    0x006a4929,
-    0x006a4a2a,
-    0x00291d11,
-    0x00140f08,
-    0x001f150c,
-    0x002b1d11,
-    0x004b341d,
-    0x00845c34,
-    0x00825a33,
-    0x0045301b,
-    0x00160f08,
-    0x00040302,
-    0x00040302,
-    0x00150c08,
-    0x00351f15,
-    0x00351f15,
-    0x00160d09,
-    0x00020201,
-    0x00020101,
-    0x00140c07,
-    0x00312014,
-    0x00392316,
-    0x002d1c12,
-    0x00412919,
-    0x00805132,
-    0x0020140d,
-    0x00694229,
-    0x00613e26,
-    0x00040202,
-    0x00744a2e,
-    0x00301e13,
-    0x002f1b12,
-    0x006a3d2a,
-    0x007c4831,
-    0x006c402a,
-    0x00653d28,
-    0x00583523,
-    0x0072442d,
-    0x006f462b,
-    0x005c4024,
-    0x006f4f2c,
-    0x00573e22,
-    0x002a1e11,
-    0x00110c07,
-    0x00160d09,
-    0x00382116,
-    0x006f432b,
-    0x007a4d30,
-    0x00654328,
-    0x00291b10,
-    0x00020201,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x00251a0e,
-    0x006c4c2a,
-    0x006e4e2b,
-    0x00281c10,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x0022180d,
-    0x00654728,
-    0x00684a29,
-    0x002b1e11,
-    0x00171109,
-    0x00281d10,
-    0x00583f22,
-    0x005c4224,
-    0x00342515,
-    0x0045311b,
-    0x000c0805,
-    0x00161009,
-    0x0076542e,
-    0x00614526,
-    0x00322414,
-    0x00110d07,
-    0x000b0805,
-    0x00322414,
-    0x00261b0f,
-    0x00000000,
-    0x00000000,
-    0x00342615,
-    0x0020170d,
-    0x00402d19,
-    0x0078522f,
-    0x007b5030,
-    0x007a5030,
-    0x0051351f,
-    0x004c321e,
-    0x00553621,
-    0x004b2f1e,
-    0x00422a1a,
-    0x003c2718,
-    0x0025180e,
-    0x00332014,
-    0x006e462b,
-    0x004c2f1e,
-    0x00513220,
-    0x006a442a,
-    0x003a2417,
-    0x0044291b,
-    0x00613a26,
-    0x00693f2a,
-    0x004a2c1d,
-    0x00180e09,
-    0x00010100,
-    0x00000000,
-    0x00110807,
-    0x003a1d17,
-    0x007f4332,
-    0x00080403,
-    0x001a0e0a,
-    0x00311b13,
-    0x0043251a,
-    0x00160b09,
-    0x00331a14,
-    0x005b2f24,
-    0x007c4131,
-    0x00763d2e,
-    0x0044231b,
-    0x001a0e0a,
-    0x00130c07,
-    0x003d2618,
-    0x00734b2e,
-    0x00412a1a,
-    0x00452e1b,
-    0x00684428,
-    0x00392516,
-    0x001e130b,
-    0x00120b07,
-    0x00110b07,
-    0x0025180e,
-    0x002a1c11,
-    0x00140d08,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00050402,
-    0x002e1d12,
-    0x00764b2e,
-    0x00774a2e,
-    0x00301f13,
-    0x000e0905,
-    0x00301d13,
-    0x00663f28,
-    0x006f442b,
-    0x00653d28,
-    0x006c412a,
-    0x0043281a,
-    0x00512e20,
-    0x00512e20,
-    0x007f4732,
-    0x004c2a1e,
-    0x0024140e,
-    0x0022110d,
-    0x00402019,
-    0x0041211a,
-    0x00371d15,
-    0x006e3d2b,
-    0x002d1b12,
-    0x000e0805,
-    0x005e3526,
-    0x0079452f,
-    0x00653828,
-    0x007f4a32,
-    0x00000000,
-    0x003c2518,
-    0x00000000,
-    0x0072482d,
-    0x00281910,
-    0x00392016,
-    0x00914f39,
-    0x009b553d,
-    0x0048271c,
-    0x000a0504,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xc8, 0x57, 0x94, 0x94, 0x3d, 0xa8, 0xd7, 0x58, 0x55, 0x55,
+    0x55, 0xdb, 0xa0, 0xd5, 0x1a, 0xf0, 0x00, 0x00, 0xf0, 0xff, 0xd1, 0xd1, 0xc4, 0x36, 0x5e, 0xc4,
+    0x52, 0x7b, 0x7b, 0x72, 0xeb, 0x96, 0x96, 0x36, 0x87, 0x87, 0xea, 0xf0, 0x21, 0x35, 0x82, 0xa0,
+    0x6c, 0xcf, 0x86, 0x5e, 0xf7, 0xdc, 0x96, 0xb0, 0x3b, 0x6b, 0xd3, 0xdf, 0xd3, 0xd2, 0x2b, 0xf3,
+    0xf2, 0xbd, 0xb1, 0x40, 0xc5, 0xc7, 0xea, 0xa0, 0xf3, 0xdf, 0xf6, 0xc4, 0xf0, 0x00, 0x00, 0xf0,
+    0xa3, 0xd1, 0xb1, 0x48, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xff, 0xf6, 0xd0, 0xc5,
+    0xee, 0xc4, 0x40, 0xbd, 0x88, 0x72, 0xa9, 0xee, 0xc2, 0x4a, 0x82, 0xc7, 0xa9, 0x82, 0x48, 0x00,
+    0x00, 0x88, 0x5e, 0x1b, 0xc2, 0xc2, 0xc2, 0x2e, 0xf9, 0x2b, 0xf9, 0x71, 0x8c, 0xa3, 0x82, 0xf2,
+    0xf9, 0x2e, 0xf7, 0xa1, 0x44, 0x49, 0xd3, 0x3e, 0xd4, 0x21, 0x00, 0xc6, 0x3c, 0x55, 0x1a, 0xd5,
+    0x3b, 0x43, 0xea, 0x3b, 0xaa, 0x55, 0xa6, 0x43, 0xd5, 0x35, 0xcf, 0xb0, 0x1b, 0x72, 0xf7, 0x8b,
+    0x15, 0x35, 0xc7, 0xa3, 0xc4, 0x36, 0xf1, 0x00, 0x00, 0x00, 0x97, 0x6c, 0xde, 0xde, 0x81, 0xac,
+    0x3b, 0xd2, 0xf3, 0xd2, 0xd3, 0x44, 0x58, 0x58, 0x85, 0x57, 0xfe, 0xbe, 0xce, 0xce, 0x3c, 0xb5,
+    0x6b, 0xac, 0xe7, 0x55, 0xda, 0x85, 0x00, 0xa1, 0x00, 0xb0, 0x98, 0xa0, 0x32, 0x33, 0x3d, 0xc9,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 39
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030101,
-    0x0021100d,
-    0x00532a20,
-    0x0050291f,
-    0x0020100d,
-    0x000c0705,
-    0x00412119,
-    0x00994d3c,
-    0x009e513e,
-    0x00582d23,
-    0x002e1812,
-    0x0023110e,
-    0x00130a08,
-    0x00050202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000d0905,
-    0x00261b0f,
-    0x00281c10,
-    0x000d0905,
-    0x00010100,
-    0x00000000,
-    0x000d0905,
-    0x00432e1a,
-    0x008b6137,
-    0x0079542f,
-    0x006f4d2b,
-    0x00422d19,
-    0x00160f08,
-    0x00010101,
-    0x00010101,
-    0x00070503,
-    0x00090503,
-    0x00030201,
-    0x00000000,
-    0x00060402,
-    0x00342214,
-    0x007f5132,
-    0x00815232,
-    0x003a2517,
-    0x00110b07,
-    0x003d2618,
-    0x006e452b,
-    0x00180f09,
-    0x00080503,
-    0x00875535,
-    0x00372316,
-    0x000f0a06,
-    0x00110a07,
-    0x0027170f,
-    0x002c1911,
-    0x001b0f0b,
-    0x00110907,
-    0x00120b07,
-    0x002b1a11,
-    0x00432b1a,
-    0x005a3e23,
-    0x0071502c,
-    0x007a5630,
-    0x00694a29,
-    0x00392816,
-    0x00181009,
-    0x00190f09,
-    0x004d331e,
-    0x00825933,
-    0x00875e35,
-    0x003c2a18,
-    0x00070503,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000d0905,
-    0x00261a0f,
-    0x00271c0f,
-    0x000d0905,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030201,
-    0x00261b0f,
-    0x006f4e2b,
-    0x006f4f2b,
-    0x00271b10,
-    0x00030201,
-    0x00020101,
-    0x00160f08,
-    0x00382816,
-    0x0047331c,
-    0x004c371e,
-    0x00664a28,
-    0x00634727,
-    0x003a2a17,
-    0x0045321b,
-    0x00604526,
-    0x00060402,
-    0x00040301,
-    0x00080603,
-    0x00080603,
-    0x005d4324,
-    0x0078562f,
-    0x004d381e,
-    0x0045311b,
-    0x00402d19,
-    0x003a2816,
-    0x00472e1c,
-    0x00432c1a,
-    0x0020150d,
-    0x000f0a05,
-    0x000f0a05,
-    0x000c0805,
-    0x00060402,
-    0x00030201,
-    0x00010100,
-    0x00170f09,
-    0x00523520,
-    0x00724a2d,
-    0x006b462a,
-    0x00573922,
-    0x00472c1c,
-    0x007c4a31,
-    0x00864f34,
-    0x0076462e,
-    0x00573422,
-    0x001b100a,
-    0x00000000,
-    0x00000000,
-    0x00050202,
-    0x00140a08,
-    0x00351d15,
-    0x005c3424,
-    0x00683b29,
-    0x0046281b,
-    0x00130b07,
-    0x00010100,
-    0x00180e09,
-    0x0048291c,
-    0x007a4630,
-    0x007a4630,
-    0x00492a1c,
-    0x00180e09,
-    0x000c0805,
-    0x00382616,
-    0x006d482b,
-    0x00674428,
-    0x006d482b,
-    0x00563922,
-    0x001a110a,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000d0805,
-    0x0025170e,
-    0x0027180f,
-    0x000c0805,
-    0x00010101,
-    0x00080503,
-    0x00160e09,
-    0x0023160e,
-    0x00482c1d,
-    0x00824f33,
-    0x0046291c,
-    0x003c2218,
-    0x00673728,
-    0x00562e22,
-    0x001d100b,
-    0x00050302,
-    0x00060302,
-    0x000f0806,
-    0x000f0806,
-    0x00130b07,
-    0x00512d20,
-    0x00583023,
-    0x00512d20,
-    0x00593123,
-    0x001f110c,
-    0x00150b08,
-    0x004d2d1e,
-    0x00503020,
-    0x00140c08,
-    0x00170e09,
-    0x0073492d,
-    0x002b1b11,
-    0x003d2118,
-    0x009b553d,
-    0x00a45a40,
-    0x0049281d,
-    0x000b0605,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xbe, 0x58, 0x58, 0x5d, 0xa8, 0xce, 0x33, 0x33, 0xec,
+    0x6b, 0xbe, 0x35, 0x96, 0x00, 0x00, 0x00, 0x00, 0x21, 0xac, 0x48, 0x48, 0xac, 0x21, 0x00, 0xac,
+    0x71, 0x7c, 0xc3, 0xb1, 0x71, 0xeb, 0x21, 0x21, 0x1a, 0xc8, 0xf0, 0x00, 0x97, 0x82, 0x86, 0x86,
+    0xa1, 0xc7, 0xcf, 0xf2, 0xd4, 0x1a, 0x86, 0x88, 0x68, 0xc6, 0x47, 0x99, 0xd6, 0xc6, 0x35, 0x99,
+    0x71, 0x40, 0xb1, 0xc3, 0xd0, 0x8b, 0xee, 0xd4, 0x52, 0x7b, 0x7c, 0x8c, 0x1a, 0x00, 0x00, 0x21,
+    0xac, 0x48, 0x48, 0xac, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x48, 0xb1, 0xb1, 0x48,
+    0xf0, 0x21, 0xeb, 0x8b, 0xf8, 0x52, 0xd0, 0xf6, 0x8c, 0x72, 0x4a, 0x97, 0x96, 0x1a, 0x1a, 0xbd,
+    0xc3, 0x52, 0x72, 0x1b, 0x8b, 0x3e, 0x71, 0x5e, 0x68, 0x68, 0xa9, 0x97, 0xf0, 0x21, 0xee, 0x2e,
+    0xb0, 0xf2, 0x3f, 0x3e, 0xdf, 0x86, 0xa7, 0x2b, 0xd6, 0x00, 0x00, 0x96, 0x35, 0x3c, 0xaa, 0xdd,
+    0x44, 0x35, 0x21, 0xd4, 0x3d, 0x55, 0x55, 0x3e, 0xd4, 0xa9, 0x8b, 0xf2, 0xf7, 0xf2, 0x3f, 0xef,
+    0x00, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0x00, 0x00, 0x00, 0x00, 0x21, 0xa9, 0xa3, 0x47, 0xa9, 0x21,
+    0x1a, 0xea, 0xfe, 0x3e, 0x86, 0x44, 0xa0, 0xdb, 0xec, 0xd7, 0x96, 0x97, 0xad, 0xad, 0x35, 0x58,
+    0xed, 0x58, 0xed, 0x15, 0x35, 0x57, 0x2e, 0x36, 0xd4, 0xb0, 0xc4, 0xa0, 0x33, 0x94, 0x3d, 0x1d,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 40
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030101,
-    0x000b0504,
-    0x000c0605,
-    0x00030202,
-    0x00080403,
-    0x0044221a,
-    0x00a35240,
-    0x009f513f,
-    0x0043221a,
-    0x000a0504,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00070402,
-    0x0022180d,
-    0x004f361f,
-    0x0076522f,
-    0x008f6338,
-    0x008d6238,
-    0x003c2a18,
-    0x00070503,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x00392416,
-    0x008a5836,
-    0x008b5937,
-    0x003d2618,
-    0x000a0604,
-    0x000e0a05,
-    0x00372315,
-    0x00633d26,
-    0x005d3824,
-    0x002d1c12,
-    0x000a0604,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00010100,
-    0x00040201,
-    0x000a0704,
-    0x00322314,
-    0x0077542f,
-    0x00382716,
-    0x003c2a18,
-    0x006b4c2a,
-    0x0022180e,
-    0x00060402,
-    0x00372716,
-    0x00865e34,
-    0x00886036,
-    0x003b2a18,
-    0x00090604,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x000e0a05,
-    0x00291d10,
-    0x002a1d10,
-    0x000d0a05,
-    0x00010100,
-    0x00000000,
-    0x00020101,
-    0x00080503,
-    0x000f0b06,
-    0x00171009,
-    0x0022180d,
-    0x0022180d,
-    0x00140f08,
-    0x001f160c,
-    0x00634726,
-    0x004b351e,
-    0x001b130a,
-    0x00060502,
-    0x002b1f11,
-    0x0074542e,
-    0x00302213,
-    0x00060502,
-    0x00010100,
-    0x00010100,
-    0x00060402,
-    0x00100a06,
-    0x00100a06,
-    0x00060402,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000d0905,
-    0x00312013,
-    0x00593a23,
-    0x005a3b23,
-    0x00352215,
-    0x00442a1b,
-    0x00865034,
-    0x008e5537,
-    0x007c4930,
-    0x005c3724,
-    0x001b100a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00090504,
-    0x000c0805,
-    0x00060402,
-    0x00010100,
-    0x00000000,
-    0x0022140e,
-    0x006b3f2a,
-    0x003b2318,
-    0x003b2318,
-    0x006c402a,
-    0x0024160e,
-    0x0026190f,
-    0x00795130,
-    0x00916039,
-    0x00774f2f,
-    0x005e3e25,
-    0x00342214,
-    0x00100b06,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x0021140d,
-    0x00523120,
-    0x007d4731,
-    0x00743d2d,
-    0x008d4837,
-    0x0048241c,
-    0x00100806,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00030101,
-    0x001e110c,
-    0x0049281c,
-    0x0049281c,
-    0x001f110c,
-    0x00040201,
-    0x00060402,
-    0x004a2a1d,
-    0x00693c29,
-    0x00301c13,
-    0x009d5e3d,
-    0x004b2e1d,
-    0x00190f09,
-    0x001b0e0a,
-    0x0047271c,
-    0x0049281d,
-    0x0021120d,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xc9, 0xa8, 0xf0, 0x1a, 0x43, 0x94, 0x33, 0x43,
+    0xc9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0x00, 0x00, 0x97,
+    0xff, 0x2f, 0xc2, 0xe4, 0xe4, 0x8c, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x97, 0xa1, 0xca, 0xca,
+    0xcf, 0xc9, 0xac, 0x88, 0xdc, 0xab, 0x6c, 0xc9, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0x00, 0x21, 0xf1,
+    0x1d, 0x82, 0xc2, 0x8b, 0x8c, 0xd1, 0xff, 0x97, 0x8b, 0x7c, 0x7c, 0x8c, 0xc9, 0x00, 0x00, 0x00,
+    0x21, 0xf0, 0xf0, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xac, 0xc4, 0xc4, 0xac,
+    0x21, 0x00, 0x21, 0x1a, 0x68, 0xee, 0xff, 0xff, 0x36, 0x5e, 0xf6, 0x52, 0xe1, 0x97, 0xc5, 0xc2,
+    0x81, 0x97, 0x21, 0x21, 0x97, 0x68, 0x68, 0x97, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0xac, 0x81,
+    0x3f, 0x3f, 0x87, 0x44, 0x86, 0xca, 0xdf, 0xab, 0xd6, 0x00, 0x00, 0x00, 0x00, 0x21, 0xc8, 0xa9,
+    0x97, 0x21, 0x00, 0xbf, 0xd3, 0xa1, 0xa1, 0xd3, 0xfe, 0xa3, 0xc2, 0xe4, 0xc2, 0xbc, 0x82, 0x68,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0x00,
+    0x00, 0x00, 0x97, 0xbf, 0x2e, 0xdf, 0xa6, 0x32, 0x3d, 0xad, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x15,
+    0x3d, 0x3d, 0x15, 0xf1, 0x97, 0x3e, 0xdd, 0x3b, 0xcb, 0xf9, 0xd4, 0xd5, 0x3d, 0x3d, 0xbe, 0x96,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 41
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x001e0f0b,
-    0x004b261d,
-    0x0049251c,
-    0x001e0f0c,
-    0x00030101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00070503,
-    0x0019110a,
-    0x004c341e,
-    0x0097693c,
-    0x0097693c,
-    0x00412d1a,
-    0x000a0603,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x0019100a,
-    0x00412919,
-    0x00412919,
-    0x001b110b,
-    0x00030201,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00251a0e,
-    0x0073512d,
-    0x00402d19,
-    0x00402d19,
-    0x0073512d,
-    0x00251a0f,
-    0x00020101,
-    0x0018110a,
-    0x003f2d18,
-    0x003f2d18,
-    0x001a130b,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00030201,
-    0x00030201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070603,
-    0x00261b0f,
-    0x005e4224,
-    0x007f5a31,
-    0x00896336,
-    0x0076552f,
-    0x00402e19,
-    0x00150f08,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x00100a06,
-    0x001d130c,
-    0x001d130c,
-    0x00120b07,
-    0x0020130c,
-    0x0050301f,
-    0x0071432c,
-    0x00663c28,
-    0x00372116,
-    0x00110907,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0025150f,
-    0x0073442d,
-    0x00402619,
-    0x00402619,
-    0x0073442d,
-    0x0027180f,
-    0x002a1b10,
-    0x007e5332,
-    0x00885a35,
-    0x00472f1c,
-    0x0021150d,
-    0x00100b06,
-    0x00040302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00060403,
-    0x00180e09,
-    0x00321b13,
-    0x00522a20,
-    0x004e281f,
-    0x0024120e,
-    0x00070303,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00080403,
-    0x00090504,
-    0x00030101,
-    0x00000000,
-    0x00070403,
-    0x0042251a,
-    0x009f593e,
-    0x00925239,
-    0x00633927,
-    0x0020140c,
-    0x00060402,
-    0x00020101,
-    0x000a0504,
-    0x000b0605,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xd7, 0x3d, 0x3d, 0xd7,
+    0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21,
+    0x1a, 0xef, 0x52, 0xe5, 0xe5, 0x1b, 0xc9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xef, 0xcf, 0xcf,
+    0xd6, 0xf0, 0x00, 0x21, 0xf0, 0xf0, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xa3, 0xb1, 0x1b, 0x1b, 0xb1, 0x48, 0x21, 0xef, 0x1b, 0x1b, 0xe1, 0xf0, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xf0, 0xf0, 0x21,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1a, 0x48, 0xbd, 0x7b, 0x7c, 0xc2, 0x1b,
+    0xeb, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0x68,
+    0x15, 0x15, 0x35, 0x5d, 0x2e, 0xf3, 0xdd, 0x87, 0xc6, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x46, 0xa7, 0xcf, 0xcf, 0xa7, 0x47, 0xc4, 0xc3, 0x7c, 0x3e, 0xbf, 0x68, 0x96,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x21, 0x97, 0xd4, 0x3b, 0x58, 0x57, 0xbe, 0x97, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21,
+    0x1a, 0xc8, 0xf0, 0x00, 0x1a, 0x43, 0xcb, 0xca, 0x49, 0x5d, 0x97, 0x21, 0xc9, 0x1d, 0x96, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 42
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020201,
-    0x000a0504,
-    0x000b0605,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x001a130a,
-    0x0045301c,
-    0x0045301c,
-    0x001e150c,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x00090603,
-    0x000a0704,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00161009,
-    0x0045311c,
-    0x007b5731,
-    0x007b5731,
-    0x0045311b,
-    0x00160f09,
-    0x00000000,
-    0x00020101,
-    0x00090603,
-    0x000a0704,
-    0x00030201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00070503,
-    0x0019110a,
-    0x00271b0f,
-    0x002d2112,
-    0x00281d0f,
-    0x00161009,
-    0x00060502,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00040201,
-    0x00140c08,
-    0x0022140d,
-    0x0020130d,
-    0x00120b07,
-    0x00050302,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00160d09,
-    0x0045291b,
-    0x007b4930,
-    0x007b4930,
-    0x0045291b,
-    0x00160d09,
-    0x000f0a06,
-    0x002e1e12,
-    0x002f1f12,
-    0x00100a06,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00010100,
-    0x00070403,
-    0x00110907,
-    0x00110907,
-    0x00070403,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x001b0e0a,
-    0x0045261c,
-    0x0046271c,
-    0x001f100c,
-    0x00030101,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf0, 0xc9, 0x1d, 0xf1,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x21, 0xe1, 0x72, 0x72, 0x5e, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xc8, 0x1d,
+    0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0xee, 0x72, 0xc3, 0xc3, 0x72, 0xeb, 0x00, 0x21, 0xc8, 0x1d, 0xf0, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0xef, 0x48, 0x81, 0x48, 0xee,
+    0x97, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xf1, 0x36, 0xbf, 0x5d, 0x35, 0x96, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0xea, 0x44, 0xdf, 0xdf, 0x44, 0xea, 0x68, 0x6c, 0x6c, 0x68, 0x21, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x21, 0x1a, 0xc6, 0xc6, 0x1a, 0x21, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x21, 0xd5, 0x44, 0x44, 0x15, 0xf0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 43
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x000a0704,
-    0x000a0704,
-    0x00040201,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00070402,
-    0x00181109,
-    0x002a1e11,
-    0x002a1e11,
-    0x00181109,
-    0x00060402,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00060402,
-    0x00180e09,
-    0x002a1911,
-    0x002a1911,
-    0x00180e09,
-    0x00070402,
-    0x00010100,
-    0x00040201,
-    0x00040201,
-    0x00010100,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00020101,
-    0x000a0504,
-    0x000a0604,
-    0x00040202,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x21, 0x1d, 0x1d, 0xf1, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x97, 0xee, 0xc5, 0xc5, 0xee, 0x97, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x97, 0xd4, 0x99, 0x99, 0xd4, 0x97, 0x21, 0xf1, 0xf1, 0x21, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0xc9, 0xc9, 0x96, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 44
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 45
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 46
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00463838,
-    0x008d7171,
-    0x008d7171,
-    0x008e7272,
-    0x008e7272,
-    0x008e7272,
-    0x006a5555,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00856b6b,
-    0x00846969,
-    0x00826868,
-    0x00806767,
-    0x007f6666,
-    0x00564545,
-    0x00000000,
-    0x005d4b4b,
-    0x007d6464,
-    0x007d6464,
-    0x007d6464,
-    0x007e6565,
-    0x004f3e3e,
-    0x00000000,
-    0x00604c4c,
-    0x007f6666,
-    0x00806767,
-    0x00816767,
-    0x00816868,
-    0x00493b3b,
-    0x00000000,
-    0x00624f4f,
-    0x00846a6a,
-    0x00846969,
-    0x00846969,
-    0x00846a6a,
-    0x00423434,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00352a2a,
-    0x007a6262,
-    0x003e3131,
-    0x00362b2b,
-    0x007e6464,
-    0x00382d2d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x005f4b4b,
-    0x00896e6e,
-    0x00221a1a,
-    0x00645050,
-    0x00856a6a,
-    0x00211a1a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00665151,
-    0x00896d6d,
-    0x00000000,
-    0x00896d6d,
-    0x00886d6d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007e6565,
-    0x005d4b4b,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00594848,
-    0x00796060,
-    0x007a6262,
-    0x007c6363,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00231d1d,
-    0x00917474,
-    0x00241d1d,
-    0x00000000,
-    0x00000000,
-    0x006b5555,
-    0x008d7171,
-    0x00231b1b,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0xfb, 0x8f, 0x8f, 0x8f, 0x8f, 0x8f, 0x9e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x37, 0x37,
+    0x6e, 0x6e, 0x6e, 0xf5, 0x00, 0x5f, 0x8a, 0x8a, 0x8a, 0x6e, 0xf4, 0x00, 0x5f, 0x6e, 0x6e, 0x6e,
+    0x6e, 0x24, 0x00, 0x17, 0x37, 0x37, 0x37, 0x37, 0xfa, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe2, 0x8a, 0xfa, 0x23, 0x8a, 0x23, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x5f, 0x38, 0x6f, 0x17, 0x37, 0x6f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x38, 0x00, 0x38, 0x38, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6e, 0x5f,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2a, 0x8a, 0x8a, 0x8a, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x78, 0xa5, 0x00, 0x00, 0x9e, 0x8f, 0x6f, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 47
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00876c6c,
-    0x00312727,
-    0x00453737,
-    0x004f3f3f,
-    0x004f3f3f,
-    0x00131010,
-    0x00806666,
-    0x001d1717,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00947777,
-    0x00927575,
-    0x00907373,
-    0x008f7272,
-    0x008d7171,
-    0x008b6f6f,
-    0x00120e0e,
-    0x008b6f6f,
-    0x008b6f6f,
-    0x008b6f6f,
-    0x008b6f6f,
-    0x008b6f6f,
-    0x008b6f6f,
-    0x00231b1b,
-    0x008e7171,
-    0x008e7272,
-    0x008f7373,
-    0x00907373,
-    0x00917474,
-    0x00917474,
-    0x00241d1d,
-    0x00937676,
-    0x00927575,
-    0x00937575,
-    0x00937575,
-    0x00937575,
-    0x00927575,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00191414,
-    0x00443636,
-    0x00191414,
-    0x00191515,
-    0x00463838,
-    0x001a1515,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00261e1e,
-    0x004c3d3d,
-    0x00090707,
-    0x006f5a5a,
-    0x00947676,
-    0x00251d1d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00715a5a,
-    0x00987979,
-    0x00000000,
-    0x00987979,
-    0x00987979,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x008c7070,
-    0x00685454,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00191414,
-    0x00856b6b,
-    0x00866b6b,
-    0x00886c6c,
-    0x00896e6e,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00271f1f,
-    0x00a18181,
-    0x00967979,
-    0x000a0808,
-    0x00000000,
-    0x00775f5f,
-    0x009d7d7d,
-    0x00261f1f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x37, 0x7f, 0xfb, 0xf4, 0xf4, 0x0f, 0x6e, 0x6a, 0x00, 0x00, 0x00, 0x00, 0x45, 0x91,
+    0x78, 0x8f, 0x8f, 0x38, 0x0f, 0x38, 0x38, 0x38, 0x38, 0x38, 0x38, 0x6f, 0x8f, 0x8f, 0x8f, 0x78,
+    0x78, 0x78, 0xa5, 0x45, 0x91, 0x91, 0x91, 0x91, 0x91, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x69, 0xfb, 0x69, 0x69, 0xfb, 0x69, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0xa5, 0x24, 0xc9, 0x9f, 0x45, 0xa5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9f, 0xe8, 0x00, 0xe8, 0xe8, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x9e,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x69, 0x37, 0x37, 0x38, 0x38, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x12, 0xe8, 0x67, 0x00, 0x89, 0x66, 0xa5, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 48
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ab8989,
-    0x00554545,
-    0x00ac8989,
-    0x00ad8a8a,
-    0x00ad8a8a,
-    0x002b2222,
-    0x00826868,
-    0x002a2222,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00282020,
-    0x00282020,
-    0x00271f1f,
-    0x00271f1f,
-    0x00896d6d,
-    0x009b7c7c,
-    0x00261e1e,
-    0x009a7b7b,
-    0x00866a6a,
-    0x00261e1e,
-    0x00261e1e,
-    0x009b7c7c,
-    0x009b7c7c,
-    0x00261f1f,
-    0x009d7e7e,
-    0x00806767,
-    0x00271f1f,
-    0x00271f1f,
-    0x00a08080,
-    0x00a18181,
-    0x00282020,
-    0x00a28282,
-    0x00846a6a,
-    0x00282020,
-    0x00282020,
-    0x00a28282,
-    0x00a28282,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x004b3c3c,
-    0x00977979,
-    0x004c3c3c,
-    0x004d3d3d,
-    0x009b7c7c,
-    0x004e3f3f,
-    0x00141010,
-    0x008e7171,
-    0x00a58484,
-    0x00a78585,
-    0x00a88787,
-    0x00ab8888,
-    0x00ac8989,
-    0x00af8c8c,
-    0x009a7a7a,
-    0x000b0909,
-    0x00211a1a,
-    0x00a68585,
-    0x00b18d8d,
-    0x00af8d8d,
-    0x00af8d8d,
-    0x00af8c8c,
-    0x00ae8b8b,
-    0x00ac8989,
-    0x008b7070,
-    0x000b0909,
-    0x007f6565,
-    0x00a88787,
-    0x00292020,
-    0x007c6363,
-    0x00a48484,
-    0x00281f1f,
-    0x00796161,
-    0x00a18080,
-    0x00594747,
-    0x004f4040,
-    0x009e7f7f,
-    0x009e7f7f,
-    0x009d7e7e,
-    0x009d7e7e,
-    0x00806767,
-    0x000a0808,
-    0x00463838,
-    0x00a18080,
-    0x00a28181,
-    0x00a38383,
-    0x00a48383,
-    0x00866c6c,
-    0x00000000,
-    0x007d6565,
-    0x00a88787,
-    0x00000000,
-    0x00a88787,
-    0x00a78686,
-    0x000b0808,
-    0x009a7c7c,
-    0x00a48383,
-    0x003d3030,
-    0x007a6262,
-    0x00a28181,
-    0x00a18080,
-    0x00a08080,
-    0x009f8080,
-    0x006d5757,
-    0x00000000,
-    0x00624e4e,
-    0x009d7e7e,
-    0x009d7e7e,
-    0x009d7e7e,
-    0x009d7e7e,
-    0x00584646,
-    0x00000000,
-    0x009b7c7c,
-    0x00735d5d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00241d1d,
-    0x00947676,
-    0x00786161,
-    0x00251e1e,
-    0x00261e1e,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002b2222,
-    0x00b08d8d,
-    0x00b18d8d,
-    0x00846a6a,
-    0x00000000,
-    0x00826868,
-    0x00ad8b8b,
-    0x003a2f2f,
-    0x00947676,
-    0x00a78585,
-    0x00a58484,
-    0x00a48484,
-    0x00987a7a,
-    0x00332929,
-    0x000a0808,
-    0x008c7070,
-    0x009f7f7f,
-    0x009f7f7f,
-    0x009f7f7f,
-    0x009f7f7f,
-    0x009e7e7e,
-    0x009f7f7f,
-    0x008b6f6f,
-    0x00141010,
-    0x00272020,
-    0x00937676,
-    0x009c7d7d,
-    0x009b7c7c,
-    0x009a7b7b,
-    0x00907373,
-    0x00130f0f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0xf5, 0x05, 0x05, 0x05, 0x9c, 0x6e, 0x9c, 0x00, 0x00, 0x00, 0x00, 0x9c, 0x9c,
+    0xa5, 0xa5, 0x38, 0xe9, 0xa5, 0xe9, 0x37, 0xa5, 0xa5, 0xe9, 0xe9, 0xa5, 0x66, 0x6e, 0xa5, 0xa5,
+    0x12, 0x12, 0x9c, 0x12, 0x37, 0x9c, 0x9c, 0x12, 0x12, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x24, 0xe8, 0x24, 0x24, 0xe9, 0xf4, 0x0f, 0x8f, 0x12, 0x10,
+    0x10, 0x10, 0x05, 0x05, 0xe9, 0x67, 0x6f, 0x10, 0x06, 0x05, 0x05, 0x05, 0x05, 0x05, 0x38, 0x67,
+    0x6e, 0x10, 0x9c, 0x8a, 0x12, 0xa5, 0x8a, 0x12, 0xf5, 0xf4, 0x66, 0x66, 0x66, 0x66, 0x6e, 0x67,
+    0xfb, 0x12, 0x12, 0x12, 0x12, 0x37, 0x00, 0x6e, 0x10, 0x00, 0x10, 0x10, 0x67, 0xe9, 0x12, 0xfa,
+    0x8a, 0x12, 0x12, 0x12, 0x66, 0x9e, 0x00, 0x5f, 0x66, 0x66, 0x66, 0x66, 0xf5, 0x00, 0xe9, 0x89,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xa5, 0x45, 0x8a, 0xa5, 0xa5, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9c, 0x06, 0x06, 0x37, 0x00, 0x6e, 0x05, 0x23, 0x45,
+    0x10, 0x12, 0x12, 0xe8, 0xe2, 0x67, 0x38, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x38, 0x0f, 0x9c,
+    0x45, 0x66, 0xe9, 0xe9, 0x78, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 49
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00b99595,
-    0x005d4a4a,
-    0x00bb9595,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x008d7070,
-    0x002e2525,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00382d2d,
-    0x007a6161,
-    0x00836969,
-    0x00826969,
-    0x00ac8989,
-    0x00ab8989,
-    0x002a2121,
-    0x00aa8888,
-    0x007f6666,
-    0x00000000,
-    0x00000000,
-    0x00ab8989,
-    0x00ab8989,
-    0x002a2222,
-    0x00ac8a8a,
-    0x00826969,
-    0x00000000,
-    0x00000000,
-    0x00af8c8c,
-    0x00b08d8d,
-    0x00151212,
-    0x00b28f8f,
-    0x00a78686,
-    0x00876c6c,
-    0x00876c6c,
-    0x00b28f8f,
-    0x009c7d7d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00534242,
-    0x00a68585,
-    0x00544343,
-    0x00554444,
-    0x00ab8989,
-    0x00564545,
-    0x00574646,
-    0x00b28e8e,
-    0x00b38f8f,
-    0x00b69292,
-    0x00b89393,
-    0x00ba9494,
-    0x00bb9696,
-    0x00bc9797,
-    0x00bd9898,
-    0x00524343,
-    0x005f4c4c,
-    0x00c09999,
-    0x00bf9898,
-    0x00bf9898,
-    0x00bd9898,
-    0x00bd9898,
-    0x00bc9797,
-    0x00bb9696,
-    0x00ba9494,
-    0x002e2424,
-    0x008a6f6f,
-    0x00b79393,
-    0x002d2323,
-    0x00886d6d,
-    0x00b48f8f,
-    0x007a6161,
-    0x00b18e8e,
-    0x008f7373,
-    0x00000000,
-    0x00413434,
-    0x00826969,
-    0x00826969,
-    0x00826868,
-    0x00ad8b8b,
-    0x00ae8b8b,
-    0x002b2222,
-    0x00836969,
-    0x00b08d8d,
-    0x00b28f8f,
-    0x00b38f8f,
-    0x00b48f8f,
-    0x00b59191,
-    0x00221b1b,
-    0x00896d6d,
-    0x00b79292,
-    0x00000000,
-    0x00b79292,
-    0x00b79292,
-    0x007d6464,
-    0x00b59191,
-    0x00655151,
-    0x00000000,
-    0x00645050,
-    0x00846a6a,
-    0x00836a6a,
-    0x008f7373,
-    0x00af8c8c,
-    0x00ae8b8b,
-    0x00000000,
-    0x00ad8b8b,
-    0x00ad8b8b,
-    0x00ad8b8b,
-    0x00ad8b8b,
-    0x00ad8b8b,
-    0x00ac8a8a,
-    0x00000000,
-    0x00aa8888,
-    0x007f6666,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001e1818,
-    0x00a38282,
-    0x00997b7b,
-    0x007d6363,
-    0x007e6565,
-    0x007f6666,
-    0x00211a1a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2525,
-    0x00bf9999,
-    0x00bf9999,
-    0x00bf9898,
-    0x005f4c4c,
-    0x008d7171,
-    0x00bb9696,
-    0x00504040,
-    0x00b89393,
-    0x00b69292,
-    0x00b59191,
-    0x00b38f8f,
-    0x00b28f8f,
-    0x00584747,
-    0x004c3d3d,
-    0x00b08c8c,
-    0x00af8b8b,
-    0x00af8b8b,
-    0x00af8b8b,
-    0x00af8b8b,
-    0x00ae8b8b,
-    0x00ae8b8b,
-    0x00ae8b8b,
-    0x00564545,
-    0x00564545,
-    0x00ac8a8a,
-    0x00ab8989,
-    0x00aa8888,
-    0x00a98888,
-    0x00aa8888,
-    0x00554444,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x1e, 0x5f, 0x1e, 0x00, 0x00, 0x00, 0x8f, 0x9d, 0x00, 0x00, 0x00, 0x00, 0x23, 0x8a,
+    0x37, 0x37, 0x05, 0x10, 0x9c, 0x10, 0x6e, 0x00, 0x00, 0x10, 0x10, 0x9c, 0x05, 0x37, 0x00, 0x00,
+    0x05, 0x06, 0x69, 0x06, 0x10, 0x37, 0x37, 0x06, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xf4, 0x10, 0xf5, 0xf5, 0x10, 0xf5, 0xf5, 0x06, 0x06, 0x63,
+    0x63, 0x1e, 0x1e, 0x1e, 0x1e, 0xf4, 0x5f, 0x1f, 0x1f, 0x1f, 0x1e, 0x1e, 0x1e, 0x1e, 0x1e, 0x9d,
+    0x38, 0x63, 0x9d, 0x38, 0x06, 0x8a, 0x06, 0x8f, 0x00, 0xfa, 0x37, 0x37, 0x6e, 0x05, 0x05, 0x9c,
+    0x37, 0x06, 0x06, 0x06, 0x06, 0x63, 0x6f, 0x38, 0x63, 0x00, 0x63, 0x63, 0x8a, 0x63, 0x17, 0x00,
+    0x17, 0x37, 0x37, 0x8f, 0x05, 0x05, 0x00, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x00, 0x10, 0x6e,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6a, 0x12, 0xe9, 0x8a, 0x6e, 0x6e, 0x6f, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x1f, 0x1f, 0x1f, 0x5f, 0x8f, 0x1e, 0xf4, 0x63,
+    0x63, 0x63, 0x06, 0x06, 0xf5, 0x24, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0x05, 0xf5, 0xf5,
+    0x05, 0x10, 0x10, 0x10, 0x10, 0xf5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 50
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00c69f9f,
-    0x00644f4f,
-    0x00c8a0a0,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00967979,
-    0x00322727,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00c09a9a,
-    0x00be9898,
-    0x00bd9797,
-    0x00bb9696,
-    0x00b99494,
-    0x00ac8a8a,
-    0x002e2424,
-    0x00b79393,
-    0x008a6f6f,
-    0x00000000,
-    0x00000000,
-    0x00b89393,
-    0x00b99494,
-    0x002e2424,
-    0x00ba9595,
-    0x008d7070,
-    0x00000000,
-    0x00000000,
-    0x00be9898,
-    0x00bf9898,
-    0x00000000,
-    0x00907373,
-    0x00c09a9a,
-    0x00c09a9a,
-    0x00c19a9a,
-    0x00c19a9a,
-    0x00604d4d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x005b4848,
-    0x00b59191,
-    0x005b4949,
-    0x005b4949,
-    0x00b99494,
-    0x005d4b4b,
-    0x005e4c4c,
-    0x00c09999,
-    0x00604d4d,
-    0x00000000,
-    0x00c59e9e,
-    0x00c79f9f,
-    0x00000000,
-    0x00705a5a,
-    0x00cba3a3,
-    0x00655151,
-    0x00655151,
-    0x00cca3a3,
-    0x00655151,
-    0x00000000,
-    0x00cba3a3,
-    0x00987a7a,
-    0x00000000,
-    0x007d6464,
-    0x00c79f9f,
-    0x00322727,
-    0x00957777,
-    0x00c59e9e,
-    0x00312626,
-    0x00927575,
-    0x00c29b9b,
-    0x00c19a9a,
-    0x00b38f8f,
-    0x000b0909,
-    0x00000000,
-    0x000b0909,
-    0x005f4c4c,
-    0x005f4c4c,
-    0x005e4b4b,
-    0x00a48383,
-    0x00bd9797,
-    0x002f2525,
-    0x008e7272,
-    0x00bf9999,
-    0x00796060,
-    0x00614e4e,
-    0x00ab8989,
-    0x00c39d9d,
-    0x00241d1d,
-    0x00947777,
-    0x00c59e9e,
-    0x00000000,
-    0x00c59e9e,
-    0x00c59e9e,
-    0x00c49e9e,
-    0x009e7f7f,
-    0x00000000,
-    0x00000000,
-    0x00241c1c,
-    0x00604d4d,
-    0x00604c4c,
-    0x005f4c4c,
-    0x00be9898,
-    0x00bd9797,
-    0x00000000,
-    0x00bd9797,
-    0x00bc9696,
-    0x005e4b4b,
-    0x005e4b4b,
-    0x00bc9696,
-    0x00bb9696,
-    0x00000000,
-    0x00ba9595,
-    0x008a6e6e,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x009c7d7d,
-    0x00b38f8f,
-    0x00b59191,
-    0x00b79393,
-    0x00b99494,
-    0x002e2424,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00332828,
-    0x00cda4a4,
-    0x00b28f8f,
-    0x00c09898,
-    0x00cca3a3,
-    0x00be9898,
-    0x00c9a1a1,
-    0x00574545,
-    0x00c69e9e,
-    0x00947676,
-    0x00624e4e,
-    0x00796161,
-    0x00c09a9a,
-    0x005f4c4c,
-    0x005f4c4c,
-    0x00be9898,
-    0x005e4c4c,
-    0x00000000,
-    0x00be9898,
-    0x00be9898,
-    0x00000000,
-    0x005e4b4b,
-    0x00bd9797,
-    0x005d4b4b,
-    0x005d4a4a,
-    0x00bb9696,
-    0x008c7070,
-    0x005c4a4a,
-    0x008b6f6f,
-    0x00b89393,
-    0x005b4949,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x27, 0x17, 0x27, 0x00, 0x00, 0x00, 0xe8, 0x7f, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x1e,
+    0x1e, 0x1e, 0x1e, 0x05, 0x9d, 0x63, 0x38, 0x00, 0x00, 0x63, 0x1e, 0x9d, 0x1e, 0x8f, 0x00, 0x00,
+    0x1e, 0x1f, 0x00, 0x78, 0x1f, 0x1f, 0x1f, 0x1f, 0x5f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2a, 0x63, 0x2a, 0x2a, 0x1e, 0x5f, 0x5f, 0x1f, 0x5f, 0x00,
+    0x27, 0x27, 0x00, 0x9f, 0x28, 0x17, 0x17, 0x28, 0x17, 0x00, 0x28, 0xe8, 0x00, 0x8a, 0x27, 0x7f,
+    0x45, 0x27, 0x7f, 0x91, 0x1f, 0x1f, 0x06, 0x67, 0x00, 0x67, 0x5f, 0x5f, 0x5f, 0x12, 0x1e, 0x9d,
+    0x8f, 0x1f, 0x8a, 0x5f, 0x10, 0x1f, 0xa5, 0x45, 0x27, 0x00, 0x27, 0x27, 0x27, 0x66, 0x00, 0x00,
+    0xa5, 0x5f, 0x5f, 0x5f, 0x1e, 0x1e, 0x00, 0x1e, 0x1e, 0x5f, 0x5f, 0x1e, 0x1e, 0x00, 0x1e, 0x38,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x06, 0x63, 0x63, 0x1e, 0x9d, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe2, 0x28, 0x06, 0x1f, 0x28, 0x1e, 0x27, 0xf5, 0x27,
+    0x45, 0x5f, 0x8a, 0x1f, 0x5f, 0x5f, 0x1e, 0x5f, 0x00, 0x1e, 0x1e, 0x00, 0x5f, 0x1e, 0x5f, 0x5f,
+    0x1e, 0x38, 0x2a, 0x38, 0x63, 0x2a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 51
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00d3a9a9,
-    0x00695555,
-    0x00d4a9a9,
-    0x00433535,
-    0x00352b2b,
-    0x000e0b0b,
-    0x009f8080,
-    0x00352a2a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00cda4a4,
-    0x00bf9999,
-    0x00322828,
-    0x00322727,
-    0x00322727,
-    0x000c0a0a,
-    0x00312727,
-    0x00c59e9e,
-    0x00957878,
-    0x00000000,
-    0x00000000,
-    0x00c69f9f,
-    0x00c69f9f,
-    0x00322727,
-    0x00c8a0a0,
-    0x00977979,
-    0x00000000,
-    0x00000000,
-    0x00caa2a2,
-    0x00cba3a3,
-    0x00322828,
-    0x00cca4a4,
-    0x00b38f8f,
-    0x00322929,
-    0x00403232,
-    0x00cda4a4,
-    0x00cda4a4,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00604d4d,
-    0x00c39c9c,
-    0x00614e4e,
-    0x00624f4f,
-    0x00c69e9e,
-    0x00635050,
-    0x00645151,
-    0x00cca3a3,
-    0x00675252,
-    0x00000000,
-    0x00d1a8a8,
-    0x00d3a9a9,
-    0x00000000,
-    0x006b5656,
-    0x00d7acac,
-    0x006b5656,
-    0x006c5757,
-    0x00d8adad,
-    0x006c5757,
-    0x00000000,
-    0x00d7acac,
-    0x00a08080,
-    0x00000000,
-    0x006a5555,
-    0x00d3a9a9,
-    0x00342a2a,
-    0x009e7e7e,
-    0x00d1a8a8,
-    0x00332929,
-    0x009b7c7c,
-    0x00cea5a5,
-    0x00cda4a4,
-    0x008c7070,
-    0x00000000,
-    0x00000000,
-    0x007d6464,
-    0x00caa1a1,
-    0x00caa1a1,
-    0x00c9a0a0,
-    0x00c9a0a0,
-    0x00caa1a1,
-    0x00322828,
-    0x00977a7a,
-    0x00cca3a3,
-    0x00cda4a4,
-    0x00cda4a4,
-    0x00cea5a5,
-    0x00a98787,
-    0x00000000,
-    0x009d7d7d,
-    0x00d1a8a8,
-    0x00000000,
-    0x00d1a8a8,
-    0x00d1a8a8,
-    0x00d0a7a7,
-    0x005b4848,
-    0x00000000,
-    0x00000000,
-    0x00b39090,
-    0x00cda4a4,
-    0x00cca3a3,
-    0x00cba2a2,
-    0x00cba2a2,
-    0x00caa1a1,
-    0x00000000,
-    0x00caa1a1,
-    0x00c9a0a0,
-    0x00c9a0a0,
-    0x00c9a0a0,
-    0x00c9a0a0,
-    0x00705a5a,
-    0x00000000,
-    0x00c79f9f,
-    0x00957777,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2626,
-    0x00c09999,
-    0x00a98787,
-    0x002f2626,
-    0x00c39c9c,
-    0x007b6262,
-    0x000c0a0a,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00352a2a,
-    0x00d7acac,
-    0x00a28282,
-    0x00433535,
-    0x00d7acac,
-    0x00d6abab,
-    0x00d5aaaa,
-    0x005b4848,
-    0x00d1a8a8,
-    0x00d0a7a7,
-    0x00cea5a5,
-    0x00cda4a4,
-    0x00cda4a4,
-    0x003f3232,
-    0x00655151,
-    0x00cba2a2,
-    0x00645151,
-    0x00000000,
-    0x00caa1a1,
-    0x00caa1a1,
-    0x00000000,
-    0x00655050,
-    0x00c9a1a1,
-    0x00645050,
-    0x00645050,
-    0x00c8a0a0,
-    0x00c8a0a0,
-    0x00c79f9f,
-    0x00c69e9e,
-    0x00b99494,
-    0x00181313,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x0d, 0x9e, 0x0d, 0xfa, 0x23, 0x67, 0x66, 0xe2, 0x00, 0x00, 0x00, 0x00, 0x28, 0x1f,
+    0x7f, 0x7f, 0x7f, 0x67, 0x7f, 0x27, 0xe8, 0x00, 0x00, 0x27, 0x27, 0x7f, 0x27, 0xe8, 0x00, 0x00,
+    0x27, 0x28, 0x7f, 0x28, 0x06, 0xe2, 0xfa, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5f, 0x1f, 0x5f, 0x17, 0x27, 0x17, 0x17, 0x28, 0x17, 0x00,
+    0x28, 0x0d, 0x00, 0x9e, 0x0d, 0x9e, 0x9e, 0x0d, 0x9e, 0x00, 0x0d, 0x12, 0x00, 0x9e, 0x0d, 0xe2,
+    0x66, 0x28, 0xe2, 0xe9, 0x28, 0x28, 0x38, 0x00, 0x00, 0x8a, 0x27, 0x27, 0x27, 0x27, 0x27, 0x7f,
+    0xe8, 0x28, 0x28, 0x28, 0x28, 0x10, 0x00, 0x66, 0x28, 0x00, 0x28, 0x28, 0x28, 0x2a, 0x00, 0x00,
+    0x06, 0x28, 0x28, 0x27, 0x27, 0x27, 0x00, 0x27, 0x27, 0x27, 0x27, 0x27, 0x9f, 0x00, 0x27, 0x45,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x1f, 0x10, 0x7f, 0x1f, 0x8a, 0x67, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe2, 0x0d, 0x12, 0xfa, 0x0d, 0x0d, 0x0d, 0x2a, 0x28,
+    0x28, 0x28, 0x28, 0x28, 0xfa, 0x17, 0x27, 0x17, 0x00, 0x27, 0x27, 0x00, 0x17, 0x27, 0x17, 0x17,
+    0x27, 0x27, 0x27, 0x27, 0x1e, 0x69, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 52
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ddb1b1,
-    0x00534242,
-    0x00d1a6a6,
-    0x00dfb3b3,
-    0x00dfb3b3,
-    0x00372c2c,
-    0x00a78686,
-    0x00372b2b,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00d9adad,
-    0x00bc9696,
-    0x006b5656,
-    0x006a5555,
-    0x00695555,
-    0x00695454,
-    0x00342929,
-    0x00d1a7a7,
-    0x00d1a7a7,
-    0x00685454,
-    0x00765e5e,
-    0x00d2a7a7,
-    0x00d3a8a8,
-    0x00342929,
-    0x00d4a9a9,
-    0x00c8a0a0,
-    0x006a5555,
-    0x00796060,
-    0x00d7abab,
-    0x00d8acac,
-    0x00352a2a,
-    0x00d8adad,
-    0x00cca3a3,
-    0x006d5656,
-    0x007b6262,
-    0x00d9aeae,
-    0x00d9aeae,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00675252,
-    0x00cfa6a6,
-    0x00685353,
-    0x00685353,
-    0x00d3a9a9,
-    0x006a5454,
-    0x006b5555,
-    0x00d8adad,
-    0x006d5757,
-    0x00000000,
-    0x00ddb1b1,
-    0x00deb2b2,
-    0x00000000,
-    0x00705a5a,
-    0x00e0b3b3,
-    0x00705b5b,
-    0x00705b5b,
-    0x00e1b4b4,
-    0x00705b5b,
-    0x00000000,
-    0x00e0b3b3,
-    0x00a88787,
-    0x00000000,
-    0x006f5a5a,
-    0x00deb2b2,
-    0x00372b2b,
-    0x00a68484,
-    0x00ddb0b0,
-    0x00362b2b,
-    0x00a48383,
-    0x00daafaf,
-    0x00cba3a3,
-    0x00d8adad,
-    0x00514141,
-    0x00000000,
-    0x00a08080,
-    0x00d6abab,
-    0x005e4b4b,
-    0x00362b2b,
-    0x00af8b8b,
-    0x00d6abab,
-    0x00352a2a,
-    0x00a18080,
-    0x00d8adad,
-    0x005e4b4b,
-    0x00372b2b,
-    0x00372c2c,
-    0x00372c2c,
-    0x00000000,
-    0x00a68484,
-    0x00ddb0b0,
-    0x00000000,
-    0x00ddb0b0,
-    0x00ddb0b0,
-    0x00cea5a5,
-    0x00dcafaf,
-    0x00292020,
-    0x00000000,
-    0x00d9aeae,
-    0x00d8adad,
-    0x00362b2b,
-    0x00362b2b,
-    0x00d7acac,
-    0x00d6abab,
-    0x00000000,
-    0x00d6abab,
-    0x00d5abab,
-    0x00352a2a,
-    0x00352a2a,
-    0x00352a2a,
-    0x00281f1f,
-    0x00000000,
-    0x00d3a9a9,
-    0x009d7d7d,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00322828,
-    0x00cca3a3,
-    0x00c19a9a,
-    0x00675252,
-    0x00d0a7a7,
-    0x009d7d7d,
-    0x004f4040,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00382c2c,
-    0x00e2b5b5,
-    0x00aa8888,
-    0x00000000,
-    0x007e6565,
-    0x00e1b3b3,
-    0x00e0b2b2,
-    0x005f4c4c,
-    0x00ddb0b0,
-    0x00977979,
-    0x00372c2c,
-    0x00372b2b,
-    0x00362b2b,
-    0x000e0b0b,
-    0x006b5656,
-    0x00d7acac,
-    0x006b5555,
-    0x00000000,
-    0x00d6abab,
-    0x00d6abab,
-    0x00000000,
-    0x006a5555,
-    0x00d5abab,
-    0x006a5454,
-    0x006a5454,
-    0x00d3a9a9,
-    0x00836969,
-    0x00352a2a,
-    0x00352a2a,
-    0x00342a2a,
-    0x000d0b0b,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x2c, 0xf4, 0x28, 0x2d, 0x2d, 0x23, 0x10, 0x23, 0x00, 0x00, 0x00, 0x00, 0x0d, 0x1e,
+    0x9e, 0x9e, 0x9e, 0x9e, 0xe2, 0x28, 0x28, 0x9e, 0x89, 0x28, 0x0d, 0xe2, 0x0d, 0x27, 0x9e, 0x8a,
+    0x0d, 0x0d, 0xe2, 0x0d, 0x28, 0x9e, 0x8a, 0x0d, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x17, 0x28, 0x17, 0x17, 0x0d, 0x9e, 0x9e, 0x0d, 0x9e, 0x00,
+    0x2c, 0x2c, 0x00, 0x9f, 0x2d, 0x9f, 0x9f, 0x2d, 0x9f, 0x00, 0x2d, 0x10, 0x00, 0x9f, 0x2c, 0x23,
+    0x12, 0x2c, 0x23, 0x12, 0x2c, 0x28, 0x0d, 0xf4, 0x00, 0x12, 0x0d, 0x5f, 0x23, 0x05, 0x0d, 0xe2,
+    0x12, 0x0d, 0x5f, 0x23, 0x23, 0x23, 0x00, 0x12, 0x2c, 0x00, 0x2c, 0x2c, 0x28, 0x2c, 0x9c, 0x00,
+    0x0d, 0x0d, 0x23, 0x23, 0x0d, 0x0d, 0x00, 0x0d, 0x0d, 0xe2, 0xe2, 0xe2, 0xa5, 0x00, 0x0d, 0x66,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7f, 0x28, 0x1f, 0x17, 0x28, 0x66, 0xf4, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x23, 0x2d, 0x10, 0x00, 0x6e, 0x2d, 0x2d, 0x5f, 0x2c,
+    0xe8, 0x23, 0x23, 0x23, 0x67, 0x9e, 0x0d, 0x9e, 0x00, 0x0d, 0x0d, 0x00, 0x9e, 0x0d, 0x9e, 0x9e,
+    0x0d, 0x37, 0xe2, 0xe2, 0xe2, 0x67, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 53
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bb9696,
-    0x00917474,
-    0x00755d5d,
-    0x00755e5e,
-    0x00755e5e,
-    0x00755e5e,
-    0x00dbafaf,
-    0x001c1717,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00e3b6b6,
-    0x00e2b5b5,
-    0x00e0b3b3,
-    0x00dfb2b2,
-    0x00deb1b1,
-    0x00dcb1b1,
-    0x000d0a0a,
-    0x00dbb0b0,
-    0x00dbb0b0,
-    0x00dbb0b0,
-    0x00dbb0b0,
-    0x00deb2b2,
-    0x00deb2b2,
-    0x001b1616,
-    0x00dfb2b2,
-    0x00e0b3b3,
-    0x00e1b4b4,
-    0x00e0b3b3,
-    0x00e0b4b4,
-    0x00d3a9a9,
-    0x002a2222,
-    0x00e2b5b5,
-    0x00e2b5b5,
-    0x00e3b6b6,
-    0x00e3b6b6,
-    0x00e3b6b6,
-    0x00d4aaaa,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x006d5757,
-    0x00daafaf,
-    0x006d5757,
-    0x006e5858,
-    0x00ddb1b1,
-    0x006f5959,
-    0x00705959,
-    0x00e2b5b5,
-    0x00715b5b,
-    0x00000000,
-    0x00e6b9b9,
-    0x00e7b9b9,
-    0x00000000,
-    0x00745d5d,
-    0x00ebbcbc,
-    0x00765e5e,
-    0x00765e5e,
-    0x00ecbdbd,
-    0x00765e5e,
-    0x00000000,
-    0x00ebbcbc,
-    0x00b08d8d,
-    0x00000000,
-    0x00745d5d,
-    0x00e7b9b9,
-    0x003a2e2e,
-    0x00ad8a8a,
-    0x00e6b9b9,
-    0x00392d2d,
-    0x00ab8989,
-    0x00e4b7b7,
-    0x00624e4e,
-    0x00e2b5b5,
-    0x00d4aaaa,
-    0x002b2222,
-    0x009a7b7b,
-    0x00e0b4b4,
-    0x00e0b4b4,
-    0x00e0b4b4,
-    0x00e0b4b4,
-    0x00e0b4b4,
-    0x002a2222,
-    0x00a98787,
-    0x00e2b5b5,
-    0x00e2b5b5,
-    0x00e3b6b6,
-    0x00e4b7b7,
-    0x00e5b8b8,
-    0x00000000,
-    0x00ad8a8a,
-    0x00e6b9b9,
-    0x00000000,
-    0x00e7b9b9,
-    0x00e6b9b9,
-    0x00645050,
-    0x00e5b8b8,
-    0x00c7a0a0,
-    0x000e0c0c,
-    0x00c69f9f,
-    0x00e2b5b5,
-    0x00e2b5b5,
-    0x00e1b5b5,
-    0x00e1b5b5,
-    0x00d2a8a8,
-    0x00000000,
-    0x00d2a8a8,
-    0x00e0b4b4,
-    0x00dfb3b3,
-    0x00dfb3b3,
-    0x00dfb3b3,
-    0x00a88686,
-    0x00000000,
-    0x00deb2b2,
-    0x00a68585,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001a1515,
-    0x00d8adad,
-    0x00d8adad,
-    0x00d9aeae,
-    0x00daafaf,
-    0x00dcb1b1,
-    0x00a78585,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x003b2e2e,
-    0x00ebbdbd,
-    0x00b18d8d,
-    0x00000000,
-    0x00000000,
-    0x00be9898,
-    0x00e8baba,
-    0x00644f4f,
-    0x00e6b9b9,
-    0x00e5b8b8,
-    0x00e4b7b7,
-    0x00e3b6b6,
-    0x00e2b5b5,
-    0x00382d2d,
-    0x00705a5a,
-    0x00e1b5b5,
-    0x00705959,
-    0x00000000,
-    0x00e0b4b4,
-    0x00e0b4b4,
-    0x00000000,
-    0x006f5959,
-    0x00e0b3b3,
-    0x00705a5a,
-    0x00624e4e,
-    0x00deb2b2,
-    0x00ddb1b1,
-    0x00ddb1b1,
-    0x00dcb1b1,
-    0x00dcb1b1,
-    0x00372c2c,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x1e, 0x78, 0x89, 0x89, 0x89, 0x89, 0x2c, 0x6a, 0x00, 0x00, 0x00, 0x00, 0x2d, 0x2d,
+    0x2d, 0x2c, 0x2c, 0x2c, 0x67, 0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x6a, 0x2c, 0x2d, 0x2d, 0x2d,
+    0x2d, 0x0d, 0x9c, 0x2d, 0x2d, 0x2d, 0x2d, 0x2d, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9e, 0x2c, 0x9e, 0x9f, 0x2c, 0x9f, 0x9f, 0x2d, 0x9f, 0x00,
+    0x11, 0x11, 0x00, 0x89, 0x11, 0x89, 0x89, 0x11, 0x89, 0x00, 0x11, 0x06, 0x00, 0x89, 0x11, 0x23,
+    0x05, 0x11, 0x23, 0x10, 0x2d, 0x5f, 0x2d, 0x0d, 0x9c, 0xe9, 0x2d, 0x2d, 0x2d, 0x2d, 0x2d, 0x9c,
+    0x10, 0x2d, 0x2d, 0x2d, 0x2d, 0x11, 0x00, 0x05, 0x11, 0x00, 0x11, 0x11, 0x17, 0x11, 0x27, 0x67,
+    0x27, 0x2d, 0x2d, 0x2d, 0x2d, 0x0d, 0x00, 0x0d, 0x2d, 0x2d, 0x2d, 0x2d, 0x10, 0x00, 0x2c, 0x10,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x69, 0x0d, 0x0d, 0x0d, 0x2c, 0x2c, 0x10, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x23, 0x11, 0x06, 0x00, 0x00, 0x1e, 0x11, 0x17, 0x11,
+    0x11, 0x2d, 0x2d, 0x2d, 0x23, 0x9f, 0x2d, 0x9f, 0x00, 0x2d, 0x2d, 0x00, 0x9f, 0x2d, 0x9f, 0x5f,
+    0x2c, 0x2c, 0x2c, 0x2c, 0x2c, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 54
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002c2323,
-    0x00866b6b,
-    0x00b38f8f,
-    0x00b38f8f,
-    0x00b49090,
-    0x00a58484,
-    0x00594747,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00af8c8c,
-    0x00af8c8c,
-    0x00ae8b8b,
-    0x00ad8b8b,
-    0x00ac8a8a,
-    0x00ac8989,
-    0x00000000,
-    0x00473939,
-    0x008f7272,
-    0x00ac8989,
-    0x00ac8989,
-    0x008f7272,
-    0x00473939,
-    0x00000000,
-    0x00564545,
-    0x009f7f7f,
-    0x00ae8b8b,
-    0x00af8c8c,
-    0x00917474,
-    0x00483a3a,
-    0x00000000,
-    0x00584646,
-    0x00a18181,
-    0x00b08d8d,
-    0x00b08d8d,
-    0x00937575,
-    0x003a2e2e,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00715b5b,
-    0x00e4b6b6,
-    0x00725c5c,
-    0x00554444,
-    0x00ad8b8b,
-    0x00564545,
-    0x00574545,
-    0x00af8c8c,
-    0x00584646,
-    0x00000000,
-    0x00b28f8f,
-    0x00b38f8f,
-    0x00000000,
-    0x00594848,
-    0x00b59191,
-    0x005a4848,
-    0x005a4848,
-    0x00b59191,
-    0x005a4848,
-    0x00000000,
-    0x00b59191,
-    0x00876c6c,
-    0x00000000,
-    0x00594848,
-    0x00b38f8f,
-    0x002c2424,
-    0x00866b6b,
-    0x00b28f8f,
-    0x002c2323,
-    0x00856a6a,
-    0x00b18e8e,
-    0x002b2323,
-    0x00665252,
-    0x00af8c8c,
-    0x00836969,
-    0x002b2323,
-    0x00836868,
-    0x00af8c8c,
-    0x00af8c8c,
-    0x00a08080,
-    0x00574545,
-    0x00000000,
-    0x002b2323,
-    0x00836969,
-    0x00b08d8d,
-    0x00b18e8e,
-    0x00b28e8e,
-    0x00b28e8e,
-    0x00000000,
-    0x00856a6a,
-    0x00b38f8f,
-    0x00000000,
-    0x00b38f8f,
-    0x00b28f8f,
-    0x00000000,
-    0x00947676,
-    0x00b28e8e,
-    0x00675252,
-    0x003a2e2e,
-    0x00937575,
-    0x00af8c8c,
-    0x00af8c8c,
-    0x00927575,
-    0x00483a3a,
-    0x00000000,
-    0x00483a3a,
-    0x00917474,
-    0x00af8c8c,
-    0x00ae8b8b,
-    0x00ae8b8b,
-    0x00826868,
-    0x00000000,
-    0x00ad8b8b,
-    0x00816767,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00463838,
-    0x009b7c7c,
-    0x00aa8888,
-    0x00ab8989,
-    0x00ac8989,
-    0x00826767,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002d2424,
-    0x00b69292,
-    0x00886d6d,
-    0x00000000,
-    0x00000000,
-    0x001d1818,
-    0x00b49090,
-    0x002c2424,
-    0x00685353,
-    0x00a38383,
-    0x00b28e8e,
-    0x00b18e8e,
-    0x00b08d8d,
-    0x002b2323,
-    0x00574646,
-    0x00af8c8c,
-    0x00574545,
-    0x00000000,
-    0x00af8c8c,
-    0x00af8c8c,
-    0x00000000,
-    0x00564545,
-    0x00ae8b8b,
-    0x00564545,
-    0x000e0b0b,
-    0x00735c5c,
-    0x00ad8b8b,
-    0x00ac8a8a,
-    0x00ac8a8a,
-    0x00ac8a8a,
-    0x002a2222,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x9d, 0x37, 0x06, 0x06, 0x06, 0x12, 0xf5, 0x00, 0x00, 0x00, 0x00, 0x00, 0x05, 0x05,
+    0x05, 0x05, 0x05, 0x05, 0x00, 0xfb, 0x8f, 0x05, 0x05, 0x8f, 0xfb, 0x00, 0xf5, 0x66, 0x05, 0x05,
+    0x78, 0x24, 0x00, 0xf5, 0x12, 0x06, 0x06, 0x91, 0x23, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9f, 0x2d, 0x9f, 0xf5, 0x05, 0xf5, 0xf5, 0x05, 0xf5, 0x00,
+    0x06, 0x06, 0x00, 0x2a, 0x63, 0x2a, 0x2a, 0x63, 0x2a, 0x00, 0x63, 0x37, 0x00, 0x2a, 0x06, 0x9d,
+    0x37, 0x06, 0x9d, 0x37, 0x06, 0x9d, 0x17, 0x05, 0x37, 0x9d, 0x37, 0x05, 0x05, 0x12, 0xf5, 0x00,
+    0x9d, 0x37, 0x06, 0x06, 0x06, 0x06, 0x00, 0x37, 0x06, 0x00, 0x06, 0x06, 0x00, 0x45, 0x06, 0x17,
+    0x23, 0x91, 0x05, 0x05, 0x91, 0x24, 0x00, 0x24, 0x78, 0x05, 0x05, 0x05, 0x6e, 0x00, 0x05, 0x6e,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfb, 0xe9, 0x10, 0x10, 0x05, 0x6e, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9d, 0x63, 0x38, 0x00, 0x00, 0x6a, 0x06, 0x9d, 0x17,
+    0x12, 0x06, 0x06, 0x06, 0x9d, 0xf5, 0x05, 0xf5, 0x00, 0x05, 0x05, 0x00, 0xf5, 0x05, 0xf5, 0x67,
+    0x89, 0x05, 0x05, 0x05, 0x05, 0x9c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 55
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00584747,
-    0x00dbafaf,
-    0x00ebbcbc,
-    0x00755e5e,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xf5, 0x2c, 0x11, 0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 56
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00786060,
-    0x00f0c0c0,
-    0x00e2b5b5,
-    0x001d1818,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x89, 0x11, 0x2d, 0x6a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 57
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 58
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 59
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 60
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 61
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 62
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00404040,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00606060,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00202020,
-    0x00404040,
-    0x00101010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00303030,
-    0x00808080,
-    0x00101010,
-    0x00202020,
-    0x00404040,
-    0x00101010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00404040,
-    0x00404040,
-    0x00404040,
-    0x00101010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00303030,
-    0x00404040,
-    0x00101010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3a, 0x61, 0x61, 0x61, 0x61, 0x22, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x3a, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x61, 0x0f,
+    0x70, 0x3a, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3a, 0x3a, 0x3a, 0x0f, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x3a, 0x0f, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 63
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x14, 0x14, 0x14, 0x14, 0x14, 0x08, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x14, 0x14, 0x14, 0x3a, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 64
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00dfdfdf,
-    0x00bfbfbf,
-    0x00bfbfbf,
-    0x00bfbfbf,
-    0x008f8f8f,
-    0x00000000,
-    0x00505050,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00505050,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x009f9f9f,
-    0x00808080,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00404040,
-    0x00808080,
-    0x00202020,
-    0x007f7f7f,
-    0x00ffffff,
-    0x009f9f9f,
-    0x00808080,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x007f7f7f,
-    0x001f1f1f,
-    0x00000000,
-    0x00505050,
-    0x00808080,
-    0x00808080,
-    0x00000000,
-    0x00000000,
-    0x00606060,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00404040,
-    0x00000000,
-    0x00000000,
-    0x00606060,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00303030,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00404040,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00808080,
-    0x00303030,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x009f9f9f,
-    0x00606060,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x004d6060,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x00617979,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x00617979,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00668080,
-    0x00668080,
-    0x000d1010,
-    0x00000000,
-    0x00000000,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00263030,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00000000,
-    0x00405050,
-    0x00668080,
-    0x004d6060,
-    0x00000000,
-    0x000d1010,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x005a7070,
-    0x001a2020,
-    0x00000000,
-    0x000d1010,
-    0x005a7070,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x001a2020,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001a2020,
-    0x005a7070,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00000000,
-    0x001a2020,
-    0x005a7070,
-    0x00668080,
-    0x00668080,
-    0x005a7070,
-    0x001a2020,
-    0x00000000,
-    0x000d1010,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x00668080,
-    0x004d6060,
-    0x000d1010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x41, 0x08, 0x08, 0x08, 0x30, 0x00, 0xcd,
+    0x61, 0x61, 0x61, 0xcd, 0x00, 0x0b, 0x14, 0x50, 0x61, 0x00, 0x00, 0x00, 0x00, 0x3a, 0x61, 0x70,
+    0x0b, 0x14, 0x50, 0x61, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x20, 0x0b, 0x70, 0x00, 0xcd, 0x61,
+    0x61, 0x00, 0x00, 0x22, 0x61, 0x61, 0x61, 0x3a, 0x00, 0x00, 0x22, 0x61, 0x61, 0x61, 0xe3, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x3a, 0x61, 0x61, 0x61, 0x61, 0xe3, 0x00, 0x08, 0x14, 0x50, 0x22, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9a, 0x0a, 0xa4, 0x00, 0x0a, 0x0a,
+    0xa4, 0x00, 0x0a, 0x0a, 0x7d, 0x0a, 0xa4, 0x00, 0x0a, 0x0a, 0xa4, 0x00, 0x0a, 0x0a, 0x7d, 0x0a,
+    0xa4, 0x00, 0x0a, 0x0a, 0xa4, 0x00, 0x0a, 0x0a, 0x0f, 0x00, 0x00, 0x9a, 0x0a, 0x0a, 0x0a, 0x0a,
+    0x1c, 0x00, 0x0f, 0x9a, 0x0a, 0x0a, 0x0a, 0x0a, 0x00, 0xcc, 0x0a, 0x9a, 0x00, 0x0f, 0x0a, 0x0a,
+    0xa4, 0x00, 0x00, 0x00, 0x00, 0x0f, 0x9a, 0x0a, 0x0a, 0x0a, 0x0a, 0x00, 0x0f, 0x9a, 0x0a, 0x0a,
+    0x0a, 0x00, 0x0f, 0x9a, 0x0a, 0x0a, 0x0a, 0xa4, 0x00, 0x0f, 0x9a, 0x0a, 0x0a, 0x9b, 0xa4, 0x00,
+    0x0f, 0x9b, 0x0a, 0x0a, 0x0a, 0xa4, 0x00, 0x00, 0x00, 0x00, 0xa4, 0x9b, 0x0a, 0x0a, 0x0a, 0x00,
+    0xa4, 0x9b, 0x0a, 0x0a, 0x9b, 0xa4, 0x00, 0x0f, 0x9a, 0x0a, 0x0a, 0x0a, 0x0a, 0x0a, 0x9a, 0x0f,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 65
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x007f7f7f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x004f4f4f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00606060,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00303030,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00303030,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00303030,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00101010,
-    0x00303030,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00596f6f,
-    0x001a2020,
-    0x00ccffff,
-    0x00ccffff,
-    0x00596f6f,
-    0x001a2020,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00596f6f,
-    0x00263030,
-    0x00ccffff,
-    0x00ccffff,
-    0x00596f6f,
-    0x00263030,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x007f9f9f,
-    0x00ccffff,
-    0x004c5f5f,
-    0x00263030,
-    0x00ccffff,
-    0x00ccffff,
-    0x004c5f5f,
-    0x00263030,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x001a2020,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00262f2f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00263030,
-    0x008cafaf,
-    0x00ccffff,
-    0x008cafaf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x09, 0x14,
+    0x14, 0x14, 0x14, 0x14, 0xcd, 0x0b, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x20, 0x22, 0x00, 0x09, 0x14, 0x14,
+    0x14, 0x00, 0x09, 0x14, 0x14, 0x14, 0x14, 0x14, 0xe3, 0x0b, 0x14, 0x14, 0x14, 0x14, 0x14, 0xe3,
+    0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x14, 0x14, 0x14, 0x14, 0xe3, 0x08, 0x14, 0x14, 0x08, 0x00,
+    0x00, 0x00, 0x00, 0x0f, 0xe3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0x02, 0x9b, 0xa4, 0x02, 0x02,
+    0x9b, 0xa4, 0x02, 0x7a, 0x76, 0x02, 0x9b, 0x1c, 0x02, 0x02, 0x9b, 0x1c, 0x02, 0x7a, 0x76, 0x02,
+    0x9a, 0x1c, 0x02, 0x02, 0x9a, 0x1c, 0x02, 0x7a, 0x00, 0x00, 0x00, 0x04, 0x02, 0x02, 0x02, 0x02,
+    0x02, 0xa4, 0x31, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x1c, 0x02, 0x02, 0x1c, 0x31, 0x02, 0x31,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x31, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x31, 0x02, 0x02, 0x02,
+    0x02, 0x00, 0x31, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x00, 0x31, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x00,
+    0x31, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x00, 0x00, 0x00, 0x00, 0x79, 0x02, 0x02, 0x02, 0x02, 0x00,
+    0x79, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x00, 0x04, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x7a,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 66
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x007f7f7f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x007f7f7f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x009f9f9f,
-    0x007f7f7f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x009f9f9f,
-    0x007f7f7f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x009f9f9f,
-    0x003f3f3f,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00afafaf,
-    0x007f7f7f,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x009f9f9f,
-    0x007f7f7f,
-    0x00cfcfcf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x009f9f9f,
-    0x007f7f7f,
-    0x00cfcfcf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x007f7f7f,
-    0x007f7f7f,
-    0x00dfdfdf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x009f9f9f,
-    0x005f5f5f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x003f4f4f,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00596f6f,
-    0x00ccffff,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00596f6f,
-    0x00ccffff,
-    0x00728f8f,
-    0x003f4f4f,
-    0x00ccffff,
-    0x008cafaf,
-    0x00596f6f,
-    0x00ccffff,
-    0x00ccffff,
-    0x008cafaf,
-    0x00596f6f,
-    0x00ccffff,
-    0x00728f8f,
-    0x003f4f4f,
-    0x00ccffff,
-    0x008cafaf,
-    0x00667f7f,
-    0x00ccffff,
-    0x00ccffff,
-    0x008cafaf,
-    0x00596f6f,
-    0x00ccffff,
-    0x00728f8f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x007f9f9f,
-    0x00667f7f,
-    0x00bfefef,
-    0x00ccffff,
-    0x00323f3f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x007f9f9f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00000000,
-    0x00000000,
-    0x00596f6f,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x000c0f0f,
-    0x00000000,
-    0x004d6060,
-    0x00668080,
-    0x00668080,
-    0x00334040,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00667f7f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x007f9f9f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00667f7f,
-    0x00667f7f,
-    0x00b2dfdf,
-    0x00ccffff,
-    0x00323f3f,
-    0x00ccffff,
-    0x00ccffff,
-    0x007f9f9f,
-    0x00667f7f,
-    0x00bfefef,
-    0x00ccffff,
-    0x00263030,
-    0x00ccffff,
-    0x00ccffff,
-    0x00667f7f,
-    0x00667f7f,
-    0x00bfefef,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x00728f8f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00728f8f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x0b, 0x08, 0x14, 0x14, 0x08, 0x0b, 0x14,
+    0x08, 0x0b, 0x08, 0x14, 0x0b, 0x0b, 0x14, 0x50, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x50, 0x0b, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x50, 0x3a, 0x00, 0x08, 0x14, 0xfd,
+    0x0b, 0x00, 0x08, 0x14, 0x50, 0x0b, 0x20, 0x14, 0x3a, 0x08, 0x14, 0x50, 0x0b, 0x20, 0x14, 0x3a,
+    0x00, 0x00, 0x00, 0x00, 0x3a, 0x0b, 0x0b, 0x0b, 0x41, 0x14, 0x3a, 0x08, 0x14, 0x50, 0x22, 0x00,
+    0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0xcc, 0x02, 0x04, 0x9b, 0x02, 0x02,
+    0x04, 0x9b, 0x02, 0x75, 0xcc, 0x02, 0x31, 0x9b, 0x02, 0x02, 0x31, 0x9b, 0x02, 0x75, 0xcc, 0x02,
+    0x31, 0x7e, 0x02, 0x02, 0x31, 0x9b, 0x02, 0x75, 0x00, 0x00, 0x00, 0x04, 0x02, 0x76, 0x7e, 0x0c,
+    0x02, 0x18, 0x04, 0x02, 0x76, 0x7e, 0x7e, 0x7e, 0x00, 0x00, 0x9b, 0x02, 0x7a, 0x02, 0x7a, 0x0f,
+    0x00, 0x9a, 0x0a, 0x0a, 0x18, 0x04, 0x02, 0x7e, 0x7e, 0x7e, 0x7e, 0x00, 0x04, 0x02, 0x76, 0x7e,
+    0x7e, 0x00, 0x02, 0x02, 0x7e, 0x7e, 0x7a, 0x02, 0x18, 0x02, 0x02, 0x76, 0x7e, 0x0c, 0x02, 0x1c,
+    0x02, 0x02, 0x7e, 0x7e, 0x0c, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x75, 0x7e, 0x7e, 0x00,
+    0x02, 0x02, 0x75, 0x75, 0x02, 0x02, 0x00, 0x02, 0x02, 0x75, 0x04, 0x02, 0x04, 0x75, 0x02, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 67
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x007f7f7f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00e0e0e0,
-    0x00c0c0c0,
-    0x00f0f0f0,
-    0x00ffffff,
-    0x005f5f5f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00e0e0e0,
-    0x00c0c0c0,
-    0x00f0f0f0,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00e0e0e0,
-    0x00c0c0c0,
-    0x00f0f0f0,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00303030,
-    0x00dfdfdf,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00bfefef,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00bfefef,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00bfefef,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00334040,
-    0x00000000,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00323f3f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x004c5f5f,
-    0x00667f7f,
-    0x00667f7f,
-    0x00323f3f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6d0d0,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6d0d0,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00667f7f,
-    0x00ccffff,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x0b, 0x08, 0x14, 0x14, 0x08, 0x0b, 0x14,
+    0x41, 0xb6, 0x01, 0x14, 0x22, 0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x08, 0x14, 0x3a,
+    0x00, 0x00, 0x08, 0x14, 0x41, 0xb6, 0x01, 0x14, 0x3a, 0x08, 0x14, 0x41, 0xb6, 0x01, 0x14, 0x3a,
+    0x00, 0x00, 0x00, 0x00, 0xe3, 0x41, 0x14, 0x14, 0x14, 0x14, 0x3a, 0x08, 0x14, 0x3a, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x02, 0x79, 0x02, 0x0c,
+    0x02, 0x04, 0x02, 0x1c, 0x00, 0x0c, 0x02, 0x04, 0x02, 0x0c, 0x02, 0x04, 0x02, 0x1c, 0x00, 0x0c,
+    0x02, 0x79, 0x02, 0x0c, 0x02, 0x79, 0x02, 0x1c, 0x00, 0x00, 0x00, 0x04, 0x02, 0x18, 0x00, 0x07,
+    0x02, 0x18, 0x04, 0x02, 0x02, 0x02, 0x02, 0x79, 0x00, 0x00, 0x00, 0x31, 0x02, 0x02, 0x18, 0x00,
+    0x00, 0x9a, 0x7e, 0x7e, 0x18, 0x04, 0x02, 0x02, 0x02, 0x02, 0x79, 0x00, 0x04, 0x02, 0x00, 0x00,
+    0x00, 0x00, 0x02, 0x02, 0x79, 0x07, 0x02, 0x02, 0x00, 0x02, 0x02, 0x00, 0x00, 0x04, 0x02, 0x18,
+    0x02, 0x02, 0x79, 0x07, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x02, 0x00, 0x00, 0x07, 0x02, 0x00, 0x02, 0x02, 0x00, 0x7e, 0x02, 0x7e, 0x00, 0x02, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 68
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x007f7f7f,
-    0x00000000,
-    0x003f3f3f,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00dfdfdf,
-    0x00bfbfbf,
-    0x00bfbfbf,
-    0x008f8f8f,
-    0x000f0f0f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00bfbfbf,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00bfbfbf,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00afafaf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00bfbfbf,
-    0x00efefef,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00334040,
-    0x00000000,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00323f3f,
-    0x003f4f4f,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x00bfefef,
-    0x00ccffff,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00ccffff,
-    0x004d6060,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x004c5f5f,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x00bfefef,
-    0x00ccffff,
-    0x00263030,
-    0x0099bfbf,
-    0x00ccffff,
-    0x000d1010,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x003f4f4f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x00ccffff,
-    0x00ccffff,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x0099bfbf,
-    0x003f4f4f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00a6d0d0,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00667f7f,
-    0x00ccffff,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x0b, 0x00, 0x3a, 0x14, 0x08, 0x0b, 0x14,
+    0x41, 0x08, 0x08, 0x30, 0x0f, 0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x08, 0x14, 0x3a,
+    0x00, 0x00, 0x08, 0x14, 0x20, 0x08, 0x08, 0x0b, 0x00, 0x08, 0x14, 0x20, 0x08, 0x08, 0x0b, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xfd, 0x14, 0x20, 0x08, 0x42, 0x14, 0x3a, 0x08, 0x14, 0x3a, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x76, 0x02, 0x02, 0x7a, 0x76,
+    0x02, 0x02, 0x7a, 0x00, 0x00, 0x76, 0x02, 0x02, 0x7a, 0x76, 0x02, 0x02, 0x7a, 0x00, 0x00, 0x76,
+    0x02, 0x02, 0x7a, 0x76, 0x02, 0x02, 0x7a, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0x18, 0x00, 0x07,
+    0x02, 0x18, 0xcc, 0x04, 0x04, 0x04, 0x0c, 0x02, 0x18, 0x00, 0x00, 0x79, 0x02, 0x02, 0x9a, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x9a, 0x04, 0x04, 0x04, 0x0c, 0x02, 0x1c, 0x04, 0x02, 0x0f, 0x00,
+    0x00, 0x00, 0x02, 0x02, 0x04, 0x04, 0x04, 0xcc, 0x00, 0x02, 0x02, 0x00, 0x00, 0x04, 0x02, 0x18,
+    0x02, 0x02, 0x04, 0x04, 0x04, 0xcc, 0x00, 0x00, 0x00, 0x00, 0x02, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x02, 0x02, 0x00, 0x00, 0x79, 0x02, 0x00, 0x02, 0x02, 0x00, 0x7e, 0x02, 0x7e, 0x00, 0x02, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 69
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00dfdfdf,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00303030,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00dfdfdf,
-    0x00c0c0c0,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00dfdfdf,
-    0x00c0c0c0,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00c0c0c0,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00d0d0d0,
-    0x00c0c0c0,
-    0x00f0f0f0,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x00cfcfcf,
-    0x00909090,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00afafaf,
-    0x00ffffff,
-    0x00303030,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x00000000,
-    0x00000000,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x00000000,
-    0x00000000,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x003f4f4f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00728f8f,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x001a2020,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00a6d0d0,
-    0x009ac0c0,
-    0x00c0f0f0,
-    0x00ccffff,
-    0x00323f3f,
-    0x00739090,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00bfefef,
-    0x00ccffff,
-    0x00323f3f,
-    0x00000000,
-    0x00728f8f,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00ccffff,
-    0x00bfefef,
-    0x001a2020,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00739090,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00bfefef,
-    0x00ccffff,
-    0x00323f3f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x00ccffff,
-    0x00ccffff,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00739090,
-    0x00000000,
-    0x00b2dfdf,
-    0x00bfefef,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x009ac0c0,
-    0x009ac0c0,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00a6d0d0,
-    0x009ac0c0,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00667f7f,
-    0x00ccffff,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x14, 0x14, 0x14, 0x14, 0x08, 0x0b, 0x14,
+    0x41, 0xb6, 0xb6, 0xb6, 0xe3, 0x0b, 0x14, 0x41, 0xb6, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x0b, 0x14, 0x41, 0xb6, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x08, 0x14, 0x3a,
+    0x00, 0x00, 0x08, 0x14, 0x20, 0xb6, 0xb6, 0xb6, 0x00, 0x08, 0x14, 0x20, 0xb6, 0xb6, 0xb6, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x20, 0xb6, 0x01, 0x14, 0x3a, 0x08, 0x14, 0x20, 0x30, 0x00,
+    0x00, 0x00, 0x00, 0xfd, 0x14, 0xe3, 0x00, 0x00, 0x00, 0x00, 0x00, 0xcc, 0x02, 0x02, 0x75, 0xcc,
+    0x02, 0x02, 0x75, 0x00, 0x00, 0xcc, 0x02, 0x02, 0x75, 0xcc, 0x02, 0x02, 0x75, 0x00, 0x00, 0xcc,
+    0x02, 0x02, 0x75, 0xcc, 0x02, 0x02, 0x75, 0x00, 0x31, 0x02, 0xa4, 0x04, 0x02, 0x79, 0x07, 0x0c,
+    0x02, 0x18, 0x75, 0x07, 0x07, 0x07, 0x0c, 0x02, 0x18, 0x00, 0x75, 0x02, 0x79, 0x02, 0x0c, 0xa4,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x75, 0x07, 0x07, 0x07, 0x0c, 0x02, 0x18, 0x04, 0x02, 0x79, 0x07,
+    0x07, 0x00, 0x0c, 0x02, 0x79, 0x07, 0x07, 0x07, 0x00, 0x02, 0x02, 0x00, 0x00, 0x04, 0x02, 0x18,
+    0x02, 0x02, 0x07, 0x07, 0x07, 0x75, 0x00, 0x7a, 0x0c, 0x00, 0x02, 0x02, 0x79, 0x07, 0x07, 0x00,
+    0x02, 0x02, 0x79, 0x07, 0x02, 0x02, 0x00, 0x02, 0x02, 0x00, 0x7e, 0x02, 0x7e, 0x00, 0x02, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 70
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x004f4f4f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x005f5f5f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x003f3f3f,
-    0x005f5f5f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x003f3f3f,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x006f6f6f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x00ffffff,
-    0x001f1f1f,
-    0x007f7f7f,
-    0x00ffffff,
-    0x00ffffff,
-    0x00bfbfbf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfbfbf,
-    0x00ffffff,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x00bfefef,
-    0x00ccffff,
-    0x00262f2f,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x000c0f0f,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x000c0f0f,
-    0x00405050,
-    0x00ccffff,
-    0x00bfefef,
-    0x00191f1f,
-    0x00728f8f,
-    0x00ccffff,
-    0x00a6cfcf,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00bfefef,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x007f9f9f,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x0099bfbf,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x008cafaf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00ccffff,
-    0x00b2dfdf,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00667f7f,
-    0x00ccffff,
-    0x00667f7f,
-    0x00000000,
-    0x00ccffff,
-    0x00ccffff,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xcd, 0x14, 0x14, 0x14, 0x14, 0x14, 0x08, 0x22, 0x14,
+    0x14, 0x14, 0x14, 0x14, 0x3a, 0x22, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x3a,
+    0x09, 0x14, 0x14, 0x14, 0x00, 0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x08, 0x14, 0x3a,
+    0x00, 0x00, 0x09, 0x14, 0x14, 0x14, 0x14, 0x14, 0x00, 0x09, 0x14, 0x14, 0x14, 0x14, 0x14, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x0b, 0x14, 0x14, 0x14, 0x14, 0x14, 0x70, 0x0b, 0x14, 0x14, 0x08, 0x00,
+    0x00, 0x00, 0x00, 0x08, 0x14, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x02, 0x1c, 0x00,
+    0x0c, 0x02, 0x18, 0x00, 0x00, 0x00, 0x0c, 0x02, 0x1c, 0x00, 0x0c, 0x02, 0x1c, 0x00, 0x00, 0x00,
+    0x0c, 0x02, 0x1c, 0x00, 0x0c, 0x02, 0x1c, 0x00, 0x04, 0x02, 0x18, 0x04, 0x02, 0x02, 0x02, 0x02,
+    0x0c, 0x0f, 0x04, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x0f, 0xcc, 0x02, 0x0c, 0xa4, 0x75, 0x02, 0x79,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0x02, 0x02, 0x02, 0x0c, 0x00, 0x76, 0x02, 0x02, 0x02,
+    0x02, 0x00, 0x76, 0x02, 0x02, 0x02, 0x02, 0x02, 0x00, 0x02, 0x02, 0x00, 0x00, 0x04, 0x02, 0x18,
+    0x31, 0x02, 0x02, 0x02, 0x02, 0x04, 0x00, 0x02, 0x02, 0x00, 0x31, 0x02, 0x02, 0x02, 0x02, 0x00,
+    0x04, 0x02, 0x02, 0x02, 0x02, 0x7a, 0x00, 0x02, 0x02, 0x00, 0x7e, 0x02, 0x7e, 0x00, 0x02, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 71
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x002f2f2f,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x000f0f0f,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001f1f1f,
-    0x003f3f3f,
-    0x000f0f0f,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x000f0f0f,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x000f0f0f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x003f3f3f,
-    0x001f1f1f,
-    0x00000000,
-    0x00000000,
-    0x002f2f2f,
-    0x003f3f3f,
-    0x002f2f2f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x001f1f1f,
-    0x003f3f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00596f6f,
-    0x00323f3f,
-    0x00323f3f,
-    0x000c0f0f,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00191f1f,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00262f2f,
-    0x00000000,
-    0x000c0f0f,
-    0x00323f3f,
-    0x00323f3f,
-    0x000c0f0f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00191f1f,
-    0x00000000,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x000c0f0f,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00262f2f,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x00323f3f,
-    0x000c0f0f,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00191f1f,
-    0x00323f3f,
-    0x00191f1f,
-    0x00000000,
-    0x00323f3f,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x3a, 0x3a, 0x3a, 0x3a, 0xe3, 0x00, 0xe3,
+    0x3a, 0x3a, 0x3a, 0x3a, 0x0f, 0x00, 0xe3, 0x3a, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x70, 0x3a, 0x0f,
+    0x00, 0xe3, 0x3a, 0x3a, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x3a, 0x0f, 0x00, 0x00, 0xe3, 0x3a, 0x0f,
+    0x00, 0x00, 0x00, 0xe3, 0x3a, 0x3a, 0x3a, 0x3a, 0x00, 0x00, 0xe3, 0x3a, 0x3a, 0x3a, 0x3a, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xe3, 0x3a, 0x3a, 0x3a, 0x70, 0x00, 0x00, 0xe3, 0x3a, 0xe3, 0x00,
+    0x00, 0x00, 0x00, 0x70, 0x3a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1c, 0x18, 0x00, 0x00,
+    0x1c, 0x18, 0x00, 0x00, 0x00, 0x00, 0x1c, 0x18, 0x00, 0x00, 0x1c, 0x18, 0x00, 0x00, 0x00, 0x00,
+    0x1c, 0x18, 0x00, 0x00, 0x1c, 0x18, 0x00, 0x00, 0x1c, 0x18, 0x00, 0x04, 0x02, 0x9b, 0x18, 0x18,
+    0x0f, 0x00, 0x1c, 0x18, 0x18, 0x18, 0x18, 0xa4, 0x00, 0x1c, 0x18, 0x1c, 0x00, 0x0f, 0x18, 0x18,
+    0x0f, 0x00, 0x00, 0x00, 0x00, 0x1c, 0x18, 0x18, 0x18, 0x18, 0xa4, 0x00, 0x00, 0x18, 0x18, 0x18,
+    0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x1c, 0x18, 0x0f,
+    0x00, 0x18, 0x18, 0x18, 0x18, 0x1c, 0x00, 0x1c, 0x18, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0x00,
+    0x00, 0x18, 0x18, 0x18, 0x18, 0x0f, 0x00, 0x18, 0x18, 0x00, 0xa4, 0x18, 0xa4, 0x00, 0x18, 0x18,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 72
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x0099bfbf,
-    0x00ccffff,
-    0x00323f3f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x02, 0x18, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 73
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00262f2f,
-    0x00323f3f,
-    0x000c0f0f,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1c, 0x18, 0x0f, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 74
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 75
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
     // row 76
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
-    0x00000000,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
 };
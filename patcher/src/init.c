@@ -25,14 +25,20 @@ void resetModules() {
   fioInit();
 }
 
+// Starts the IOP reboot without waiting for it to complete.
+// The EE is free to do other work until initModules() waits for the IOP
+void startIOPReset() {
+  sceSifInitRpc(0);
+  while (!SifIopReset("", 0)) {
+  };
+}
+
 #ifndef HOSD
 // OSDMenu
 
-// Loads IOP modules
+// Waits for the IOP reboot and loads IOP modules
 int initModules() {
-  sceSifInitRpc(0);
-  while (!SifIopReset("", 0)) {
-  };
+  // Wait for the IOP reboot started by startIOPReset()
   while (!SifIopSync()) {
   };
 
@@ -102,11 +108,9 @@ char ps2fsArguments[] = "-m"
                         "\0"
                         "40";
 
-// Loads IOP modules
+// Waits for the IOP reboot and loads IOP modules
 int initModules() {
-  sceSifInitRpc(0);
-  while (!SifIopReset("", 0)) {
-  };
+  // Wait for the IOP reboot started by startIOPReset()
   while (!SifIopSync()) {
   };
 
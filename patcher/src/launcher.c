@@ -4,6 +4,7 @@
 #include "init.h"
 #include "patches_common.h"
 #include "patches_osdmenu.h"
+#include "qmem.h"
 #include "settings.h"
 #include <kernel.h>
 #include <loadfile.h>
@@ -185,14 +186,14 @@ int LoadELFFromFile(int argc, char *argv[]) {
       continue;
 
     pdata = (void *)(launcher_elf_addr + eph[i].offset);
-    memcpy(eph[i].vaddr, pdata, eph[i].filesz);
+    qmemcpy(eph[i].vaddr, pdata, eph[i].filesz);
   }
 
 #ifdef HOSD
   // Clear the region of memory used by the launcher
   // for HDD OSD
   // This is important.
-  memset((void *)0x100000 + size_launcher_elf, 0, 0x200000);
+  qmemset((void *)0x100000 + size_launcher_elf, 0, 0x200000);
 #endif
 
   FlushCache(0);
@@ -1,12 +1,16 @@
+#include "boottrace.h"
 #include "defaults.h"
+#include "history.h"
 #include "init.h"
 #include "launcher.h"
 #include "osdr.h"
 #include "patches_common.h"
 #include "patches_osdmenu.h"
 #include "psx.h"
+#include "qmem.h"
 #include "settings.h"
 #include "splash.h"
+#include <io_common.h>
 #include <kernel.h>
 #include <libcdvd-common.h>
 #include <osd_config.h>
@@ -28,9 +32,21 @@ PS2_DISABLE_AUTOSTART_PTHREAD();
 
 #ifndef HOSD
 // OSDMenu
+
+// Returns 1 if the launch history journal exists on any memory card
+static int hasHistoryJournal() {
+  io_stat_t stat;
+  return (fioGetstat("mc0:" HISTORY_JOURNAL_PATH, &stat) >= 0) || (fioGetstat("mc1:" HISTORY_JOURNAL_PATH, &stat) >= 0);
+}
+
 int main(int argc, char *argv[]) {
-  // Load needed modules
-  initModules();
+  // The boot sequence is pipelined to overlap the EE and IOP work:
+  // the splash screen is drawn while the IOP reboots and the config file is read as soon as the memory card modules are loaded
+
+  BOOT_TRACE_START("patcher");
+
+  // Start the IOP reboot
+  startIOPReset();
   // Set OSDMenu & OSDSYS default settings for configurable items
   initConfig();
 
@@ -42,11 +58,21 @@ int main(int argc, char *argv[]) {
   else if (!strncmp(argv[0], "xfrom", 5))
     settings.mcSlot = 2;
 
+  // Initialize the screen in the console region video mode and start the splash screen upload
+  showSplash();
+
+  // Wait for the IOP and load needed modules
+  initModules();
+  initROMVERFallback();
+  BOOT_TRACE("patcher:iop");
+
   // Check for PSX
   int isPSX = initPSX();
   if (!isPSX) {
     // If not, read config file
     loadConfig();
+    BOOT_TRACE("patcher:cnf");
+    // Apply the video mode and visual game ID settings from the config file
     showSplash();
     // Try to load OSDR
     loadOSDR();
@@ -58,6 +84,16 @@ int main(int argc, char *argv[]) {
     // Critical error for PSX
     Exit(-1);
 
+  // Make sure the splash screen transfer is complete before OSDSYS takes over the GS
+  gsWaitTransfer();
+  BOOT_TRACE("patcher:osdr");
+
+  // Merge the launch history recorded by the launcher into history files.
+  // Most boots have no journal, so check for it first instead of initializing libmc
+  if (hasHistoryJournal()) {
+    flushHistoryJournal(settings.romver[4]);
+    BOOT_TRACE("patcher:hist");
+  }
 
   // MBROWS exists only on protokernel systems
   int fd = fioOpen("rom0:MBROWS", FIO_O_RDONLY);
@@ -93,17 +129,30 @@ int checkFile(char *path);
 
 int main(int argc, char *argv[]) {
   // Clear memory while avoiding the embedded data in the OSD memory region
-  memset((void *)EXTRA_SECTION_END, 0, USER_MEM_END_ADDR - EXTRA_SECTION_END);
+  qmemset((void *)EXTRA_SECTION_END, 0, USER_MEM_END_ADDR - EXTRA_SECTION_END);
   // Relocate the embedded launcher and the legacy ps2atad module to the memory unused by the OSD code
-  memcpy((void *)EXTRA_RELOC_ADDR, (void *)launcher_elf, size_launcher_elf);
+  qmemcpy((void *)EXTRA_RELOC_ADDR, (void *)launcher_elf, size_launcher_elf);
   launcher_elf_addr = (void *)EXTRA_RELOC_ADDR;
-  memcpy((void *)(EXTRA_RELOC_ADDR + size_launcher_elf), (void *)legacy_ps2atad_irx, size_legacy_ps2atad_irx);
+  qmemcpy((void *)(EXTRA_RELOC_ADDR + size_launcher_elf), (void *)legacy_ps2atad_irx, size_legacy_ps2atad_irx);
   legacy_ps2atad_irx_addr = (void *)(EXTRA_RELOC_ADDR + size_launcher_elf);
 
+  int isMBRBoot = (argc > 1) && !strcmp(argv[argc - 1], "-mbrboot");
+  if (!isMBRBoot) {
+    BOOT_TRACE_START("hosdmenu");
+    // Start the IOP reboot
+    startIOPReset();
+  } else
+    // Continue the trace started by the MBR
+    BOOT_TRACE("hosdmenu");
+
   // Set FMCB & OSDSYS default settings for configurable items
   initConfig();
 
-  if ((argc > 1) && !strcmp(argv[argc - 1], "-mbrboot")) {
+  // Initialize the screen in the console region video mode and start the splash screen upload
+  // while the IOP is initializing the HDD
+  showSplash();
+
+  if (isMBRBoot) {
     // Skip the full init and just initialize fileXio if the last argument is -mbrboot
     shortInit();
     argc--;
@@ -112,6 +161,8 @@ int main(int argc, char *argv[]) {
       // Launch recovery payload on fail
       launchPayload(RECOVERY_PAYLOAD_PATH);
   }
+  initROMVERFallback();
+  BOOT_TRACE("hosdmenu:iop");
 
   int fd = checkFile("rom0:PSXVER");
   if (fd >= 0)
@@ -123,12 +174,14 @@ int main(int argc, char *argv[]) {
 
   // Read config file
   loadConfig();
+  BOOT_TRACE("hosdmenu:cnf");
 
   fileXioUmount("pfs0:");
 
   if (fileXioMount("pfs0:", HOSD_SYS_PARTITION, 0))
     launchPayload(RECOVERY_PAYLOAD_PATH);
 
+  // Apply the video mode and visual game ID settings from the config file
   showSplash();
 
   // Check if HDD OSD executable exists
@@ -136,6 +189,10 @@ int main(int argc, char *argv[]) {
   if (haveOSD < 0)
     haveOSD = checkFile("pfs0:/osd100/OSDSYS_A.XLF");
 
+  // Make sure the splash screen transfer is complete before HDD-OSD takes over the GS
+  gsWaitTransfer();
+
+  BOOT_TRACE("hosdmenu:osd");
   if (haveOSD >= 0)
     launchOSDSYS(argc, argv);
 
@@ -1,6 +1,8 @@
 #include "settings.h"
 #include "defaults.h"
+#include "dprintf.h"
 #include "gs.h"
+#include <kernel.h>
 #include <stdlib.h>
 #include <string.h>
 #define NEWLIB_PORT_AWARE
@@ -8,6 +10,18 @@
 
 PatcherSettings settings;
 
+// Boot ROM address in KSEG1
+#define ROM_BASE 0xbfc00000
+// Maximum offset of ROMDIR in the boot ROM
+#define ROMDIR_SEARCH_LIMIT 0x40000
+
+// Boot ROM directory entry
+typedef struct {
+  char name[10];
+  uint16_t extInfoSize;
+  uint32_t size;
+} romdirEntry;
+
 // Defined in common/defaults.h
 char xfromConfigPath[] = "xfrom:" HOSD_CONF_PATH;
 #ifndef HOSD
@@ -336,13 +350,47 @@ int loadConfig(void) {
 
 // Initializes static variables
 void initVariables() {
-  // Init ROMVER
+  // Read ROMVER directly from the boot ROM so this doesn't depend on the IOP.
+  // Allows the defaults to be initialized while the IOP is being rebooted
+  ee_kmode_enter();
+
+  // ROMDIR begins with the RESET entry and is located at the 16-byte boundary
+  romdirEntry *entry = NULL;
+  for (uint32_t offset = 0; offset < ROMDIR_SEARCH_LIMIT; offset += 16) {
+    if (!memcmp((void *)(ROM_BASE + offset), "RESET\0\0\0\0\0", 10)) {
+      entry = (romdirEntry *)(ROM_BASE + offset);
+      break;
+    }
+  }
+
+  // Files are stored back-to-back in ROMDIR order, each aligned to 16 bytes
+  uint32_t fileOffset = 0;
+  for (; entry && entry->name[0]; entry++) {
+    if (!strncmp(entry->name, "ROMVER", sizeof(entry->name))) {
+      memcpy(settings.romver, (void *)(ROM_BASE + fileOffset), 14);
+      settings.romver[14] = '\0';
+      break;
+    }
+    fileOffset += (entry->size + 0xf) & ~0xf;
+  }
+
+  ee_kmode_exit();
+}
+
+// Reads ROMVER through the IOP if initVariables couldn't find it in the boot ROM.
+// Must be called after the IOP modules are loaded
+void initROMVERFallback(void) {
+  if (settings.romver[0])
+    return;
+
+  DPRINTF("Failed to find ROMVER in ROMDIR, reading rom0:ROMVER\n");
   int fdn = 0;
   if ((fdn = fioOpen("rom0:ROMVER", FIO_O_RDONLY)) > 0) {
     fioRead(fdn, settings.romver, 14);
     settings.romver[14] = '\0';
     fioClose(fdn);
-  }
+  } else
+    DPRINTF("Failed to open rom0:ROMVER\n");
 }
 
 // Loads defaults
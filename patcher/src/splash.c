@@ -3,7 +3,11 @@
 #include "settings.h"
 #include "splash_bmp.h"
 
-// Initializes the screen according to config options and shows the splash screen
+// Video mode the screen was initialized with by the last showSplash() call, -1 if GS wasn't initialized yet
+static int splashMode = -1;
+
+// Initializes the screen according to config options and shows the splash screen.
+// Can be called again after loading the config file: the screen is only reinitialized if the video mode changes
 void showSplash() {
   GSVideoMode vmode = GS_MODE_NTSC; // Use NTSC by default
 
@@ -15,44 +19,33 @@ void showSplash() {
   } else if (settings.videoMode == GS_MODE_PAL)
     vmode = GS_MODE_PAL;
 
+  if (vmode != splashMode) {
+    splashMode = vmode;
 #ifdef ENABLE_SPLASH
-  gsDisplaySplash(vmode);
+    gsDisplaySplash(vmode);
 #else
-  gsInit(vmode);
-  gsClearScreen();
+    gsInit(vmode);
 #endif
-}
-
-// Initializes GS and displays FMCB splash screen
-void gsDisplaySplash(GSVideoMode mode) {
-  int splashY = 185;
-  if (mode == GS_MODE_PAL) {
-    splashY = 247;
   }
 
-  gsInit(mode);
-  gsClearScreen();
-  gsPrintBitmap((640 - splashWidth) / 2, splashY, splashWidth, splashHeight, splash);
-
+#ifdef ENABLE_SPLASH
   if (!(settings.patcherFlags & FLAG_APP_GAMEID))
     return;
 
   // Draw OSDMenu visual game ID
   uint8_t data[] = {0xA5, 0x00, 0xA9, 0x07, 'O', 'S', 'D', 'M', 'e', 'n', 'u', 0x00, 0xD5, 0x00};
 
-  int xstart = (gsGetMaxX() / 2) - (sizeof(data) * 8);
-  int ystart = gsGetMaxY() - (((gsGetMaxY() / 8) * 2) + 20);
-
-  for (int i = 0; i < sizeof(data); i++) {
-    for (int j = 7; j >= 0; j--) {
-      int x = xstart + (i * 16 + ((7 - j) * 2));
-      int x1 = x + 1;
-      gsDrawSprite(x, ystart, x1, ystart + 2, 0, GS_RGBAQ(0xFF, 0x00, 0xFF, 0, 0));
+  gsDrawBarcode(data, sizeof(data));
+#endif
+}
 
-      if ((data[i] >> j) & 1)
-        gsDrawSprite(x1, ystart, x1 + 1, ystart + 2, 0, GS_RGBAQ(0x00, 0xFF, 0xFF, 0, 0));
-      else
-        gsDrawSprite(x1, ystart, x1 + 1, ystart + 2, 0, GS_RGBAQ(0xFF, 0xFF, 0x00, 0, 0));
-    }
+// Initializes GS and displays FMCB splash screen
+void gsDisplaySplash(GSVideoMode mode) {
+  int splashY = 185;
+  if (mode == GS_MODE_PAL) {
+    splashY = 247;
   }
+
+  gsInit(mode);
+  gsPrintBitmap((640 - splashWidth) / 2, splashY, splashWidth, splashHeight, splash, splashCLUT);
 }
@@ -0,0 +1,309 @@
+// Checks the mass?: path handling in launcher/src/handler_bdm.c and the optional device types in launcher/src/init.c.
+// The IOP is simulated: BDM drivers fail to load when their hardware is missing, and every attached device
+// shows up as the next massN mountpoint after its own arrival latency. The ELF must be launched from the first
+// device that has it, all drivers must be loaded in one IOP configuration, and missing hardware must not
+// delay or break the launch
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USB
+#define ATA
+#define ILINK
+#define MX4SIO
+#define MMCE
+#define MASS_ALL_BDM
+
+#include "../launcher/src/init.c"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+// Simulated time in milliseconds
+static clock_t simTime;
+
+// Block device behind a BDM driver
+typedef struct {
+  const char *driver; // Module that adds the block device
+  const char *probe;  // Module that fails to load when the hardware is missing
+  int present;        // Set if the hardware is present
+  int arrival;        // Milliseconds between loading the driver and the device showing up, -1 if nothing is attached
+  int hasFile;        // Set if the device has the ELF
+  clock_t loadedAt;   // Time the driver was loaded at, -1 if it isn't loaded
+} SimDevice;
+
+enum { Sim_USB, Sim_ATA, Sim_iLink, Sim_MX4SIO, Sim_Count };
+static SimDevice devices[Sim_Count];
+
+static int iopResets;
+static char loadLog[512]; // Names of the modules SifExecModuleBuffer was called for
+static char launchedPath[64];
+static clock_t launchedAt;
+
+#define MODULE(mod)                                                                                                                                  \
+  unsigned char mod##_irx[16] __attribute__((aligned(16)));                                                                                          \
+  uint32_t size_##mod##_irx = sizeof(mod##_irx)
+MODULE(iomanX);
+MODULE(fileXio);
+MODULE(sio2man);
+MODULE(mcman);
+MODULE(mcserv);
+MODULE(mmceman);
+MODULE(ps2dev9);
+MODULE(bdm);
+MODULE(bdmfs_fatfs);
+MODULE(ata_bd);
+MODULE(usbd_mini);
+MODULE(usbmass_bd_mini);
+MODULE(mx4sio_bd_mini);
+MODULE(iLinkman);
+MODULE(IEEE1394_bd_mini);
+
+// Returns the moduleList name for the embedded module
+static const char *moduleName(void *irx) {
+  for (int i = 0; i < MODULE_COUNT; i++)
+    if (moduleList[i].irx == irx)
+      return moduleList[i].name;
+  return "unknown";
+}
+
+int SifIopReset(const char *arg, int mode) {
+  iopResets++;
+  for (int i = 0; i < Sim_Count; i++)
+    devices[i].loadedAt = -1;
+  return 1;
+}
+int SifIopSync(void) { return 1; }
+void sceSifInitRpc(int mode) {}
+void sceSifExitRpc(void) {}
+int SifLoadFileInit(void) { return 0; }
+int SifLoadModule(const char *path, int argLength, const char *args) { return 0; }
+int sbv_patch_enable_lmb(void) { return 0; }
+int sbv_patch_disable_prefix_check(void) { return 0; }
+int sbv_patch_fileio(void) { return 0; }
+int fileXioInit(void) { return 0; }
+int LoadExecPS2(const char *filename, int argc, char *argv[]) { return -1; }
+void shutdownDEV9() {}
+void releasePFS() {}
+
+int SifExecModuleBuffer(void *ptr, uint32_t size, uint32_t argLength, const char *args, int *result) {
+  const char *name = moduleName(ptr);
+  strcat(loadLog, name);
+  strcat(loadLog, " ");
+  // Missing hardware makes the driver return MODULE_NO_RESIDENT_END
+  *result = 0;
+  for (int i = 0; i < Sim_Count; i++) {
+    if (!devices[i].present && !strcmp(devices[i].probe, name))
+      *result = 1;
+    else if (!strcmp(devices[i].driver, name))
+      devices[i].loadedAt = simTime;
+  }
+  return 0;
+}
+
+void msg(const char *str, ...) {
+  va_list args;
+  va_start(args, str);
+  vprintf(str, args);
+  va_end(args);
+}
+
+// Returns the device behind the massN mountpoint. BDM numbers the devices in the order they show up
+static SimDevice *mountedDevice(int index) {
+  SimDevice *order[Sim_Count];
+  int count = 0;
+  for (int i = 0; i < Sim_Count; i++) {
+    if ((devices[i].loadedAt < 0) || (devices[i].arrival < 0) || (devices[i].loadedAt + devices[i].arrival > simTime))
+      continue;
+    int j = count++;
+    for (; (j > 0) && (order[j - 1]->loadedAt + order[j - 1]->arrival > devices[i].loadedAt + devices[i].arrival); j--)
+      order[j] = order[j - 1];
+    order[j] = &devices[i];
+  }
+  return (index < count) ? order[index] : NULL;
+}
+
+static int tryFileCalls;
+
+static int simOpen(const char *path, int flags, ...) {
+  if (strncmp(path, "mass", 4) || !mountedDevice(path[4] - '0'))
+    return -ENODEV;
+  return 3;
+}
+static int simClose(int fd) { return 0; }
+static int simUsleep(useconds_t usec) {
+  simTime += usec / 1000;
+  return 0;
+}
+
+int tryFile(char *filepath) {
+  tryFileCalls++;
+  SimDevice *device = mountedDevice(filepath[4] - '0');
+  return (device && device->hasFile) ? 0 : -ENOENT;
+}
+
+clock_t getPollDeadline() { return simTime + DELAY_ATTEMPTS * 1000; }
+int pollDeadlinePassed(clock_t deadline) { return simTime > deadline; }
+
+char *normalizePath(char *path, DeviceType type) {
+  static char normalized[64];
+  strncpy(normalized, path, sizeof(normalized) - 1);
+  return normalized;
+}
+
+int LoadELFFromFile(int argc, char *argv[]) {
+  strncpy(launchedPath, argv[0], sizeof(launchedPath) - 1);
+  launchedAt = simTime;
+  return 0;
+}
+
+#define open simOpen
+#define close simClose
+#define usleep simUsleep
+#include "../launcher/src/handler_bdm.c"
+
+// Resets the simulated IOP and the devices. Every device has the hardware present and nothing attached
+static void resetSim() {
+  clearModuleState();
+  failedDevices = Device_None;
+  simTime = 0;
+  iopResets = 0;
+  tryFileCalls = 0;
+  loadLog[0] = '\0';
+  launchedPath[0] = '\0';
+  launchedAt = -1;
+  devices[Sim_USB] = (SimDevice){"usbmass_bd_mini", "usbd_mini", 1, -1, 0, -1};
+  devices[Sim_ATA] = (SimDevice){"ata_bd", "ps2dev9", 1, -1, 0, -1};
+  devices[Sim_iLink] = (SimDevice){"IEEE1394_bd_mini", "iLinkman", 1, -1, 0, -1};
+  devices[Sim_MX4SIO] = (SimDevice){"mx4sio_bd_mini", "mx4sio_bd_mini", 1, -1, 0, -1};
+}
+
+static int launch(const char *path) {
+  char pathBuf[64] = {0};
+  strncpy(pathBuf, path, sizeof(pathBuf) - 1);
+  char *argv[] = {pathBuf};
+  return handleBDM(Device_USB, 1, argv);
+}
+
+static int loaded(const char *module) { return strstr(loadLog, module) != NULL; }
+
+// A slow USB drive doesn't lose to the HDD that shows up first but doesn't have the file
+static void testSlowUSB() {
+  resetSim();
+  devices[Sim_USB].arrival = 1500;
+  devices[Sim_USB].hasFile = 1;
+  devices[Sim_ATA].arrival = 100;
+  devices[Sim_iLink].present = 0;
+
+  int res = launch("mass?:/APPS/APP.ELF");
+  CHECK(!res, "slow USB: handleBDM returned %d", res);
+  CHECK(!strcmp(launchedPath, "mass1:/APPS/APP.ELF"), "slow USB: launched %s", launchedPath);
+  CHECK((launchedAt >= 1500) && (launchedAt < 1500 + POLL_INTERVAL_MS), "slow USB: launched at %ld ms", (long)launchedAt);
+  CHECK(iopResets == 1, "slow USB: %d IOP resets", iopResets);
+  CHECK(loaded("usbmass_bd_mini") && loaded("ata_bd") && loaded("iLinkman") && !loaded("IEEE1394_bd_mini"), "slow USB: loaded %s", loadLog);
+  CHECK(!loaded("mx4sio_bd_mini") && !loaded("mmceman"), "slow USB: loaded %s", loadLog);
+  CHECK((getLoadedDevices() & Device_BDM) == (Device_USB | Device_ATA), "slow USB: loaded device types %x", getLoadedDevices());
+  CHECK(tryFileCalls == 2, "slow USB: %d file checks", tryFileCalls);
+}
+
+// The first device that has the file wins
+static void testFirstMatch() {
+  resetSim();
+  devices[Sim_USB].arrival = 800;
+  devices[Sim_USB].hasFile = 1;
+  devices[Sim_ATA].arrival = 300;
+  devices[Sim_ATA].hasFile = 1;
+  devices[Sim_iLink].arrival = 1200;
+  devices[Sim_iLink].hasFile = 1;
+
+  int res = launch("mass?:/APP.ELF");
+  CHECK(!res, "first match: handleBDM returned %d", res);
+  CHECK(!strcmp(launchedPath, "mass0:/APP.ELF"), "first match: launched %s", launchedPath);
+  CHECK((launchedAt >= 300) && (launchedAt < 300 + POLL_INTERVAL_MS), "first match: launched at %ld ms", (long)launchedAt);
+  CHECK(loaded("IEEE1394_bd_mini"), "first match: loaded %s", loadLog);
+}
+
+// Consoles without the network adapter fail to load DEV9, the HDD driver is skipped and iLink still works
+static void testNoDEV9() {
+  resetSim();
+  devices[Sim_ATA].present = 0;
+  devices[Sim_iLink].arrival = 200;
+  devices[Sim_iLink].hasFile = 1;
+
+  int res = launch("mass?:/APP.ELF");
+  CHECK(!res, "no DEV9: handleBDM returned %d", res);
+  CHECK(!strcmp(launchedPath, "mass0:/APP.ELF"), "no DEV9: launched %s", launchedPath);
+  CHECK(loaded("ps2dev9") && !loaded("ata_bd"), "no DEV9: loaded %s", loadLog);
+  CHECK((getLoadedDevices() & Device_BDM) == (Device_USB | Device_iLink), "no DEV9: loaded device types %x", getLoadedDevices());
+
+  // Missing hardware is not retried by the next mass?: path
+  loadLog[0] = '\0';
+  res = launch("mass?:/APP.ELF");
+  CHECK(!res && (iopResets == 1) && !loadLog[0], "no DEV9: second launch returned %d after %d IOP resets, loaded %s", res, iopResets, loadLog);
+}
+
+// More devices can show up after the ones without the file, so a missing file ends the wait only at the deadline
+static void testNotFound() {
+  resetSim();
+  devices[Sim_USB].arrival = 100;
+  devices[Sim_ATA].arrival = 400;
+  devices[Sim_iLink].present = 0;
+  int res = launch("mass?:/APP.ELF");
+  CHECK(res == -ENODEV, "missing file: handleBDM returned %d", res);
+  CHECK(simTime >= DELAY_ATTEMPTS * 1000, "missing file: gave up at %ld ms", (long)simTime);
+
+  resetSim();
+  res = launch("mass?:/APP.ELF");
+  CHECK(res == -ENODEV, "no devices: handleBDM returned %d", res);
+  CHECK((simTime > DELAY_ATTEMPTS * 1000) && (simTime <= DELAY_ATTEMPTS * 1000 + POLL_INTERVAL_MS), "no devices: gave up at %ld ms", (long)simTime);
+  CHECK(!tryFileCalls, "no devices: %d file checks", tryFileCalls);
+}
+
+// Numbered mass paths and failed required drivers don't use the optional device types
+static void testSingleDevice() {
+  resetSim();
+  devices[Sim_USB].arrival = 100;
+  devices[Sim_USB].hasFile = 1;
+  devices[Sim_ATA].arrival = 50;
+  int res = launch("mass0:/APP.ELF");
+  CHECK(!res && !strcmp(launchedPath, "mass0:/APP.ELF"), "mass0: handleBDM returned %d, launched %s", res, launchedPath);
+  CHECK(loaded("usbmass_bd_mini") && !loaded("ps2dev9") && !loaded("iLinkman"), "mass0: loaded %s", loadLog);
+
+  resetSim();
+  devices[Sim_USB].present = 0;
+  devices[Sim_ATA].arrival = 50;
+  devices[Sim_ATA].hasFile = 1;
+  res = launch("mass?:/APP.ELF");
+  CHECK(res == 1, "failed USB driver: handleBDM returned %d", res);
+  CHECK(!launchedPath[0], "failed USB driver: launched %s", launchedPath);
+}
+
+int main() {
+  testSlowUSB();
+  testFirstMatch();
+  testNoDEV9();
+  testNotFound();
+  testSingleDevice();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
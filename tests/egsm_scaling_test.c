@@ -0,0 +1,160 @@
+// Checks the eGSM DISPLAY register translation in utils/loader/src/egsm/scaling.c
+// against the translation eGSM used before the per-mode tables and the translation cache were added.
+// Every supported game video mode is combined with every eGSM mode flag, and DISPLAY values are translated
+// in orders that hit, miss and evict cache entries, including after the scaling state changes
+#include "egsm_api.h"
+#include "egsm_scaling.h"
+#include <gs_privileged.h>
+#include <stdio.h>
+#include <string.h>
+
+// Translation before the per-mode tables and the cache were added
+static uint64_t ref_mod_DISPLAY(struct gsm_state *pstate, uint64_t r) {
+  int magh = (r >> 23) & 0x00f;
+  int magv = (r >> 27) & 0x003;
+  int dw = (r >> 32) & 0xfff;
+  int dh = (r >> 44) & 0x7ff;
+
+  // Normalize values
+  magh += 1;
+  magv += 1;
+  dw += 1;
+  dh += 1;
+
+  // Change width
+  int magh_new = magh * pstate->MAGHMul / pstate->VCKDiv;
+  int dw_new = dw * magh_new / magh;
+  int dx_new = pstate->gsm.x_center_vck - (dw_new / 2);
+
+  // Change height
+  int magv_new = magv * pstate->FBMul / pstate->FBDiv;
+  int dh_new = dh * pstate->DPMul / pstate->DPDiv;
+  int dy_new = pstate->gsm.y_center - (dh_new / 2);
+
+  // Registers are zero-based
+  magh_new -= 1;
+  magv_new -= 1;
+  dw_new -= 1;
+  dh_new -= 1;
+
+  return GS_SET_DISPLAY(dx_new, dy_new, magh_new, magv_new, dw_new, dh_new);
+}
+
+// Sets up the eGSM video mode for the game video mode the same way hook_SetGsCrt does.
+// Returns 0 if eGSM doesn't change the mode
+static int set_mode(struct gsm_state *pstate, uint32_t flags, int mode, int interlace, int ffmd) {
+  memset(pstate, 0, sizeof(*pstate));
+  pstate->flags = flags;
+  pstate->game.mode = mode;
+  pstate->game.interlace = interlace;
+  pstate->game.ffmd = ffmd;
+  pstate->gsm = pstate->game;
+
+  if (flags & EGSM_FLAG_VMODE_FP1) {
+    if (interlace == 1 && ffmd == 1) {
+      pstate->gsm.interlace = 0;
+      pstate->gsm.ffmd = 1;
+    }
+  } else if (flags & EGSM_FLAG_VMODE_FP2) {
+    pstate->gsm.interlace = 0;
+    pstate->gsm.ffmd = 1;
+    pstate->gsm.mode = (mode == 2) ? 0x50 : 0x53;
+  } else if (flags & (EGSM_FLAG_VMODE_1080I_X1 | EGSM_FLAG_VMODE_1080I_X2 | EGSM_FLAG_VMODE_1080I_X3)) {
+    pstate->gsm.interlace = 1;
+    pstate->gsm.ffmd = ffmd;
+    pstate->gsm.mode = 0x51;
+  } else
+    return 0;
+
+  update_scaling(pstate);
+  return 1;
+}
+
+// Simple LCG so the test is reproducible
+static uint32_t rng_state = 12345;
+static uint32_t rng() {
+  rng_state = rng_state * 1103515245 + 12345;
+  return rng_state >> 8;
+}
+
+// Builds a DISPLAY register value
+static uint64_t display_value(int dx, int dy, int magh, int magv, int dw, int dh) { return GS_SET_DISPLAY(dx, dy, magh, magv, dw, dh); }
+
+static int failures = 0;
+static int checks = 0;
+
+// Translates the value and compares it with the reference translation
+static void check(struct gsm_state *pstate, uint64_t r, const char *what) {
+  uint64_t expected = ref_mod_DISPLAY(pstate, r);
+  uint64_t actual = mod_DISPLAY(pstate, r);
+  checks++;
+  if (actual == expected)
+    return;
+
+  if (failures++ < 20)
+    printf("FAIL %s: flags=0x%x game=0x%x/%d/%d value=0x%016llx expected=0x%016llx got=0x%016llx\n", what, pstate->flags, pstate->game.mode,
+           pstate->game.interlace, pstate->game.ffmd, (unsigned long long)r, (unsigned long long)expected, (unsigned long long)actual);
+}
+
+int main() {
+  static const uint32_t modeFlags[] = {
+      EGSM_FLAG_VMODE_FP1, EGSM_FLAG_VMODE_FP2, EGSM_FLAG_VMODE_1080I_X1, EGSM_FLAG_VMODE_1080I_X2, EGSM_FLAG_VMODE_1080I_X3,
+  };
+  // Display widths and heights used by games (minus one) plus the field limits
+  static const int widths[] = {255, 319, 383, 511, 639, 1279, 2559, 2879, 4095};
+  static const int heights[] = {0, 223, 239, 255, 447, 479, 511, 2047};
+
+  struct gsm_state state;
+  for (int f = 0; f < sizeof(modeFlags) / sizeof(modeFlags[0]); f++) {
+    for (int mode = 2; mode <= 3; mode++) {
+      for (int interlace = 0; interlace <= 1; interlace++) {
+        for (int ffmd = 0; ffmd <= 1; ffmd++) {
+          if (!set_mode(&state, modeFlags[f], mode, interlace, ffmd))
+            continue;
+
+          // Every MAGH/MAGV combination with every width and height, translated twice to hit the cache
+          for (int magh = 0; magh < 16; magh++)
+            for (int magv = 0; magv < 4; magv++)
+              for (int w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+                for (int h = 0; h < sizeof(heights) / sizeof(heights[0]); h++) {
+                  uint64_t r = display_value(rng() & 0xfff, rng() & 0x7ff, magh, magv, widths[w], heights[h]);
+                  check(&state, r, "miss");
+                  check(&state, r, "hit");
+                }
+
+          // Games alternate between a few values every frame: cycle through more values than the cache holds
+          uint64_t values[DISPLAY_CACHE_SIZE + 2];
+          for (int i = 0; i < DISPLAY_CACHE_SIZE + 2; i++)
+            values[i] = display_value(rng() & 0xfff, rng() & 0x7ff, rng() & 0xf, rng() & 0x3, rng() & 0xfff, rng() & 0x7ff);
+          for (int n = 1; n <= DISPLAY_CACHE_SIZE + 2; n++)
+            for (int i = 0; i < 8 * n; i++)
+              check(&state, values[i % n], "cycle");
+
+          // Unused upper bits must not affect the translation but are part of the cached value
+          check(&state, values[0] | (1ULL << 60), "upper bits");
+
+          // Field flipping via SMODE2 changes the game mode and recalculates the scaling.
+          // Cached translations from the previous state must not be returned
+          for (int i = 0; i < DISPLAY_CACHE_SIZE; i++)
+            check(&state, values[i], "before SMODE2");
+          state.game.interlace ^= 1;
+          if (state.game.interlace == 1)
+            state.gsm.ffmd = state.game.ffmd;
+          update_scaling(&state);
+          for (int i = 0; i < DISPLAY_CACHE_SIZE; i++)
+            check(&state, values[i], "after SMODE2");
+
+          // Random values
+          for (int i = 0; i < 4096; i++) {
+            uint64_t r = ((uint64_t)rng() << 40) ^ ((uint64_t)rng() << 20) ^ rng();
+            check(&state, r, "random");
+            check(&state, r, "random hit");
+          }
+        }
+      }
+    }
+  }
+
+  printf("%d checks, %d failures\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+// Checks the packed PS1 game ID table generated by cmake/game_id_table.cmake and the lookup in common/src/cnf.c.
+// Every entry of common/res/game_id_table.txt must resolve to its title ID through getPS1GenericTitleID,
+// and timestamps next to the table entries must not match anything
+#include "game_id_table.h"
+#include <libcdvd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+const char *getPS1GenericTitleID();
+
+#define MAX_ENTRIES 1024
+
+static struct {
+  char timestamp[17];
+  char titleID[12];
+} entries[MAX_ENTRIES];
+static int entryCount = 0;
+
+// Primary Volume Descriptor returned by sceCdRead
+static char pvd[2048];
+static int readFails = 0;
+
+int sceCdReadClock(sceCdCLOCK *clock) { return 0; }
+
+int sceCdRead(uint32_t lbn, uint32_t sectors, void *buffer, sceCdRMode *mode) {
+  if (readFails || (lbn != 16) || (sectors != 1))
+    return 0;
+  memcpy(buffer, pvd, sizeof(pvd));
+  return 1;
+}
+
+int sceCdSync(int mode) { return 0; }
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+// Sets up a valid PVD with the volume creation date
+static void setVolumeTimestamp(const char *timestamp) {
+  memset(pvd, 0, sizeof(pvd));
+  pvd[0] = 1;
+  memcpy(&pvd[1], "CD001", 5);
+  memcpy(&pvd[0x32D], timestamp, 16);
+}
+
+// Reads the table source the same way cmake/game_id_table.cmake does
+static int loadTable(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    printf("FAIL: can't open %s\n", path);
+    return -1;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] != '{')
+      continue;
+    if ((entryCount >= MAX_ENTRIES) ||
+        (sscanf(line, "{\"%16[0-9]\", \"%11[A-Z_.0-9]\"}", entries[entryCount].timestamp, entries[entryCount].titleID) != 2)) {
+      printf("FAIL: can't parse %s", line);
+      fclose(f);
+      return -1;
+    }
+    entryCount++;
+  }
+  fclose(f);
+  return 0;
+}
+
+// Returns 1 if the timestamp is in the table source
+static int hasTimestamp(const char *timestamp) {
+  for (int i = 0; i < entryCount; i++)
+    if (!strcmp(entries[i].timestamp, timestamp))
+      return 1;
+  return 0;
+}
+
+// Every entry resolves to its title ID
+static void testRoundTrip() {
+  CHECK(entryCount == GAME_ID_TABLE_SIZE, "table source has %d entries, generated table has %d", entryCount, GAME_ID_TABLE_SIZE);
+
+  // Binary search needs strictly ascending timestamps
+  for (int i = 1; i < GAME_ID_TABLE_SIZE; i++)
+    CHECK(gameIDTimestamps[i - 1] < gameIDTimestamps[i], "timestamps %d and %d are not sorted", i - 1, i);
+
+  for (int i = 0; i < entryCount; i++) {
+    setVolumeTimestamp(entries[i].timestamp);
+    const char *titleID = getPS1GenericTitleID();
+    CHECK(titleID && !strcmp(titleID, entries[i].titleID), "%s resolves to %s instead of %s", entries[i].timestamp, titleID ? titleID : "NULL",
+          entries[i].titleID);
+  }
+}
+
+// Timestamps around every entry and past both ends of the table don't match
+static void testMisses() {
+  char timestamp[17];
+  for (int i = 0; i < entryCount; i++) {
+    for (int delta = -1; delta <= 1; delta += 2) {
+      unsigned long long value = 0;
+      sscanf(entries[i].timestamp, "%16llu", &value);
+      snprintf(timestamp, sizeof(timestamp), "%016llu", value + delta);
+      if (hasTimestamp(timestamp))
+        continue;
+      setVolumeTimestamp(timestamp);
+      const char *titleID = getPS1GenericTitleID();
+      CHECK(!titleID, "%s resolves to %s", timestamp, titleID);
+    }
+  }
+
+  const char *misses[] = {"0000000000000000", "9999999999999999", "1995030218052O00", "                "};
+  for (int i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+    setVolumeTimestamp(misses[i]);
+    const char *titleID = getPS1GenericTitleID();
+    CHECK(!titleID, "\"%s\" resolves to %s", misses[i], titleID);
+  }
+
+  // Invalid PVD and read errors
+  setVolumeTimestamp(entries[0].timestamp);
+  pvd[1] = 'X';
+  CHECK(!getPS1GenericTitleID(), "invalid PVD resolves to a title ID");
+  setVolumeTimestamp(entries[0].timestamp);
+  readFails = 1;
+  CHECK(!getPS1GenericTitleID(), "failed PVD read resolves to a title ID");
+  readFails = 0;
+}
+
+int main() {
+  if (loadTable(GAME_ID_TABLE_SOURCE))
+    return 1;
+
+  testRoundTrip();
+  testMisses();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("%d entries, all checks passed\n", entryCount);
+  return 0;
+}
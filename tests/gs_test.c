@@ -0,0 +1,550 @@
+// Checks the GIF packet builder in common/src/gs.c and the GS drawing built on top of it.
+// GS registers and GIF DMA transfers are redirected to the test, the transfers are decoded tag by tag
+// and rasterized into a frame buffer, with a simplified GS memory model for CLUT textures.
+// Every transfer must consist of valid tags that cover exactly the sent qwords, the drawing must match
+// reference renderings, and the visual game ID barcode must be sent as one transfer
+#include "gs.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// GS privileged registers
+static struct {
+  uint64_t pmode;
+  uint64_t smode2;
+  uint64_t dispfb2;
+  uint64_t display2;
+  uint64_t bgcolor;
+  uint64_t csr;
+} gsPrivRegs;
+
+#undef GS_REG_PMODE
+#undef GS_REG_SMODE2
+#undef GS_REG_DISPFB2
+#undef GS_REG_DISPLAY2
+#undef GS_REG_BGCOLOR
+#undef GS_REG_CSR
+#define GS_REG_PMODE (&gsPrivRegs.pmode)
+#define GS_REG_SMODE2 (&gsPrivRegs.smode2)
+#define GS_REG_DISPFB2 (&gsPrivRegs.dispfb2)
+#define GS_REG_DISPLAY2 (&gsPrivRegs.display2)
+#define GS_REG_BGCOLOR (&gsPrivRegs.bgcolor)
+#define GS_REG_CSR (&gsPrivRegs.csr)
+
+// GIF DMA channel. Starting the channel in normal mode captures the transfer right away,
+// source chains are kept pending until the channel is waited on
+static void *gifMadr;
+static void *gifTadr;
+static uint32_t gifQwc;
+static void *pendingChain;
+static void startTransfer(int mode);
+static void waitTransfer();
+
+#undef SET_QWC
+#undef SET_MADR
+#undef SET_TADR
+#undef SET_CHCR
+#undef DMA_WAIT
+#define SET_QWC(WHICH, SIZE) gifQwc = (SIZE)
+#define SET_MADR(WHICH, ADDR, SPR) gifMadr = (ADDR)
+#define SET_TADR(WHICH, ADDR, SPR) gifTadr = (ADDR)
+#define SET_CHCR(WHICH, DIR, MOD, ASP, TTE, TIE, STR, TAG) startTransfer(MOD)
+#define DMA_WAIT(WHICH) waitTransfer()
+
+#include "game_id.c"
+#include "gs.c"
+#include "splash_bmp.h"
+
+#define FB_WIDTH 640
+#define FB_HEIGHT 512
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+// Kernel, libdma and OSDMenu functions used by the code under test
+void FlushCache(int operation) {}
+uint64_t GsPutIMR(uint64_t imr) { return 0; }
+void SetGsCrt(int interlace, int mode, int field) {}
+int dma_reset(void) { return 0; }
+int updateHistoryFile(const char *titleID) { return 0; }
+int sceCdInit(int mode) { return 1; }
+
+// GS state the decoder keeps between transfers
+static struct {
+  uint64_t regs[0x100];
+  uint64_t xyz[2];
+  uint64_t uv[2];
+  int vertexCount;
+  uint32_t imageRemaining; // Qwords left in the current IMAGE tag
+  uint32_t trxPixel;       // Pixels transferred since TRXDIR
+} gs;
+
+static uint32_t frameBuffer[FB_HEIGHT][FB_WIDTH];
+
+// Transfer statistics
+static int transfers = 0;
+static int lastTransferTags = 0;
+static uint32_t lastTransferQwc = 0;
+static uint32_t maxTransferQwc = 0;
+
+// GS local memory outside of the frame buffer. Pixels are stored linearly with the buffer width as the row pitch
+// instead of the GS block layout, which is enough to check that uploads and texture reads use matching parameters
+static uint8_t gsMemory[4 * 1024 * 1024];
+
+static void writeMemory8(uint32_t bp, uint32_t bw, uint32_t x, uint32_t y, uint8_t value) { gsMemory[(bp * 256 + y * bw * 64 + x) % sizeof(gsMemory)] = value; }
+static uint8_t readMemory8(uint32_t bp, uint32_t bw, uint32_t x, uint32_t y) { return gsMemory[(bp * 256 + y * bw * 64 + x) % sizeof(gsMemory)]; }
+static void writeMemory32(uint32_t bp, uint32_t bw, uint32_t x, uint32_t y, uint32_t value) {
+  memcpy(&gsMemory[(bp * 256 + (y * bw * 64 + x) * 4) % sizeof(gsMemory)], &value, 4);
+}
+static uint32_t readMemory32(uint32_t bp, uint32_t bw, uint32_t x, uint32_t y) {
+  uint32_t value;
+  memcpy(&value, &gsMemory[(bp * 256 + (y * bw * 64 + x) * 4) % sizeof(gsMemory)], 4);
+  return value;
+}
+
+static void drawTexturedSprite();
+
+// Fills the pixels covered by the sprite, the bottom right edge is exclusive
+static void fillSprite(uint32_t (*fb)[FB_WIDTH], int x0, int y0, int x1, int y1, uint32_t color) {
+  for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++)
+      if ((x >= 0) && (x < FB_WIDTH) && (y >= 0) && (y < FB_HEIGHT))
+        fb[y][x] = color;
+}
+
+// Applies a register write to the decoder state
+static void writeRegister(int reg, uint64_t value) {
+  gs.regs[reg & 0xFF] = value;
+  switch (reg) {
+  case GS_REG_PRIM:
+    gs.vertexCount = 0;
+    break;
+  case GS_REG_XYZ2:
+    gs.uv[gs.vertexCount] = gs.regs[GS_REG_UV];
+    gs.xyz[gs.vertexCount++] = value;
+    if (gs.vertexCount < 2)
+      break;
+    gs.vertexCount = 0;
+    CHECK((gs.regs[GS_REG_PRIM] & 7) == PRIM_SPRITE, "vertex kick for primitive %d", (int)(gs.regs[GS_REG_PRIM] & 7));
+    if ((gs.regs[GS_REG_PRIM] >> 4) & 1) {
+      drawTexturedSprite();
+      break;
+    }
+    // Flat shading uses the color of the last vertex
+    fillSprite(frameBuffer, (gs.xyz[0] & 0xFFFF) >> 4, ((gs.xyz[0] >> 16) & 0xFFFF) >> 4, (gs.xyz[1] & 0xFFFF) >> 4,
+               ((gs.xyz[1] >> 16) & 0xFFFF) >> 4, gs.regs[GS_REG_RGBAQ] & 0xFFFFFFFF);
+    break;
+  case GS_REG_TRXDIR:
+    gs.trxPixel = 0;
+    break;
+  }
+}
+
+// Writes IMAGE data to the rectangle set up by BITBLTBUF, TRXPOS and TRXREG
+static void writeImage(const uint64_t *data, uint32_t qwords) {
+  uint32_t dbp = (gs.regs[GS_REG_BITBLTBUF] >> 32) & 0x3FFF;
+  uint32_t dbw = (gs.regs[GS_REG_BITBLTBUF] >> 48) & 0x3F;
+  uint32_t dpsm = (gs.regs[GS_REG_BITBLTBUF] >> 56) & 0x3F;
+  uint32_t dsax = (gs.regs[GS_REG_TRXPOS] >> 32) & 0x7FF;
+  uint32_t dsay = (gs.regs[GS_REG_TRXPOS] >> 48) & 0x7FF;
+  uint32_t rrw = gs.regs[GS_REG_TRXREG] & 0xFFF;
+  uint32_t rrh = (gs.regs[GS_REG_TRXREG] >> 32) & 0xFFF;
+  CHECK((dpsm == GS_PSM_CT32) || (dpsm == GS_PSM_T8), "image transfer to PSM %#x", dpsm);
+  CHECK(!dbp || (dbp * 256 >= sizeof(frameBuffer)), "image transfer to %#x overwrites the frame buffer", dbp);
+
+  uint32_t count = qwords * ((dpsm == GS_PSM_T8) ? 16 : 4);
+  for (uint32_t i = 0; i < count; i++, gs.trxPixel++) {
+    CHECK(gs.trxPixel < rrw * rrh, "image data past the %ux%u transfer area", rrw, rrh);
+    if (gs.trxPixel >= rrw * rrh)
+      return;
+    uint32_t x = dsax + gs.trxPixel % rrw;
+    uint32_t y = dsay + gs.trxPixel / rrw;
+    CHECK(x < dbw * 64, "image transfer wider than the buffer width %u", dbw * 64);
+    if (dpsm == GS_PSM_T8)
+      writeMemory8(dbp, dbw, x, y, ((const uint8_t *)data)[i]);
+    else if (!dbp)
+      fillSprite(frameBuffer, x, y, x + 1, y + 1, ((const uint32_t *)data)[i]);
+    else
+      writeMemory32(dbp, dbw, x, y, ((const uint32_t *)data)[i]);
+  }
+}
+
+// Draws the sprite with the texture set up in TEX0_1, nearest neighbor sampling with UV coordinates only
+static void drawTexturedSprite() {
+  uint64_t tex0 = gs.regs[GS_REG_TEX0_1];
+  uint32_t tbp = tex0 & 0x3FFF;
+  uint32_t tbw = (tex0 >> 14) & 0x3F;
+  uint32_t psm = (tex0 >> 20) & 0x3F;
+  uint32_t tw = 1 << ((tex0 >> 26) & 0xF);
+  uint32_t th = 1 << ((tex0 >> 30) & 0xF);
+  uint32_t cbp = (tex0 >> 37) & 0x3FFF;
+  CHECK(psm == GS_PSM_T8, "texture PSM %#x", psm);
+  CHECK(((tex0 >> 35) & 3) == 1, "texture function is not DECAL");
+  CHECK(!((tex0 >> 55) & 1), "CLUT is not in CSM1 order");
+  CHECK((gs.regs[GS_REG_PRIM] >> 8) & 1, "textured sprite doesn't use UV coordinates");
+
+  int x0 = (gs.xyz[0] & 0xFFFF) >> 4, y0 = ((gs.xyz[0] >> 16) & 0xFFFF) >> 4;
+  int x1 = (gs.xyz[1] & 0xFFFF) >> 4, y1 = ((gs.xyz[1] >> 16) & 0xFFFF) >> 4;
+  int u0 = (gs.uv[0] & 0x3FFF) >> 4, v0 = ((gs.uv[0] >> 16) & 0x3FFF) >> 4;
+  int u1 = (gs.uv[1] & 0x3FFF) >> 4, v1 = ((gs.uv[1] >> 16) & 0x3FFF) >> 4;
+  CHECK((u1 - u0 == x1 - x0) && (v1 - v0 == y1 - y0), "textured sprite is scaled");
+  CHECK((u1 <= tw) && (v1 <= th), "%dx%d texels don't fit the %ux%u texture", u1, v1, tw, th);
+
+  for (int y = y0; y < y1; y++)
+    for (int x = x0; x < x1; x++) {
+      uint8_t index = readMemory8(tbp, tbw, u0 + x - x0, v0 + y - y0);
+      // CSM1 stores the entries 8-15 of every 32 after the entries 16-23
+      uint32_t entry = (index & 0xE7) | ((index & 0x08) << 1) | ((index & 0x10) >> 1);
+      fillSprite(frameBuffer, x, y, x + 1, y + 1, readMemory32(cbp, 1, entry % 16, entry / 16));
+    }
+}
+
+static void captureTransfer(uint64_t *data, uint32_t qwc);
+
+static int kicks = 0;
+
+static void startTransfer(int mode) {
+  CHECK(!pendingChain, "transfer started while the previous chain is still running");
+  kicks++;
+  if (mode)
+    pendingChain = gifTadr;
+  else
+    captureTransfer(gifMadr, gifQwc);
+}
+
+// Runs the pending source chain, every CNT, REF and END tag is captured as a separate transfer
+static void waitTransfer() {
+  uint64_t *tag = pendingChain;
+  pendingChain = NULL;
+  for (int i = 0; tag && (i < 1024); i++) {
+    uint32_t qwc = tag[0] & 0xFFFF;
+    uint32_t id = (tag[0] >> 28) & 7;
+    // Tags hold 32-bit addresses, the data is in the same image as the chain
+    uint64_t *addr = (uint64_t *)(((uintptr_t)tag & ~(uintptr_t)0xFFFFFFFF) | (uint32_t)(tag[0] >> 32));
+    switch (id) {
+    case DMA_TAG_CNT:
+      captureTransfer(tag + 2, qwc);
+      tag += (qwc + 1) * 2;
+      break;
+    case DMA_TAG_REF:
+      captureTransfer(addr, qwc);
+      tag += 2;
+      break;
+    case DMA_TAG_END:
+      captureTransfer(tag + 2, qwc);
+      return;
+    default:
+      CHECK(0, "unexpected DMA tag %u", id);
+      return;
+    }
+  }
+  CHECK(!tag, "DMA chain is not terminated");
+}
+
+// Decodes the GIF tags of the transfer and executes the register writes
+static void captureTransfer(uint64_t *packet, uint32_t qwc) {
+  transfers++;
+  lastTransferTags = 0;
+  lastTransferQwc = qwc;
+  if (qwc > maxTransferQwc)
+    maxTransferQwc = qwc;
+
+  uint32_t pos = 0; // Position in qwords
+  // Image data for the IMAGE tag sent in the previous transfer
+  if (gs.imageRemaining) {
+    pos = (qwc < gs.imageRemaining) ? qwc : gs.imageRemaining;
+    writeImage(packet, pos);
+    gs.imageRemaining -= pos;
+    if (pos == qwc)
+      return;
+  }
+
+  int eop = 0;
+  while (!eop) {
+    CHECK(pos < qwc, "transfer %d: GIF tag at qword %u is past the transfer size %u", transfers, pos, qwc);
+    if (failures)
+      return;
+
+    uint64_t tag = packet[pos * 2];
+    uint64_t regs = packet[pos * 2 + 1];
+    uint32_t nloop = tag & 0x7FFF;
+    uint32_t nreg = (tag >> 60) ? (tag >> 60) : 16;
+    int flg = (tag >> 58) & 3;
+    eop = (tag >> 15) & 1;
+    lastTransferTags++;
+    pos++;
+
+    if ((tag >> 46) & 1)
+      writeRegister(GS_REG_PRIM, (tag >> 47) & 0x7FF);
+
+    switch (flg) {
+    case GIF_FLG_PACKED: // Only A+D is used by OSDMenu
+      CHECK(pos + nloop * nreg <= qwc, "transfer %d: PACKED data past the transfer size", transfers);
+      for (uint32_t i = 0; i < nloop * nreg; i++) {
+        CHECK(((regs >> ((i % nreg) * 4)) & 0xF) == GIF_REG_AD, "transfer %d: unsupported PACKED register descriptor", transfers);
+        writeRegister(packet[(pos + i) * 2 + 1] & 0xFF, packet[(pos + i) * 2]);
+      }
+      pos += nloop * nreg;
+      break;
+    case GIF_FLG_REGLIST: // Two registers per qword
+      CHECK(pos + (nloop * nreg + 1) / 2 <= qwc, "transfer %d: REGLIST data past the transfer size", transfers);
+      for (uint32_t i = 0; i < nloop * nreg; i++)
+        writeRegister((regs >> ((i % nreg) * 4)) & 0xF, packet[pos * 2 + i]);
+      pos += (nloop * nreg + 1) / 2;
+      break;
+    case GIF_FLG_IMAGE: {
+      // Image data may follow in the next transfers
+      uint32_t qwords = (qwc - pos < nloop) ? qwc - pos : nloop;
+      writeImage(&packet[pos * 2], qwords);
+      gs.imageRemaining = nloop - qwords;
+      pos += qwords;
+      CHECK(!gs.imageRemaining || eop, "transfer %d: IMAGE data is split before the last tag", transfers);
+      break;
+    }
+    default:
+      CHECK(0, "transfer %d: unexpected GIF tag format %d", transfers, flg);
+      return;
+    }
+  }
+  CHECK(pos == qwc, "transfer %d: %u qwords sent, GIF tags cover %u", transfers, qwc, pos);
+}
+
+// Writes ROMVER for the region game_id.c picks the video mode from
+static int setRegion(char region) {
+  FILE *romver = fopen("rom0:ROMVER", "wb");
+  if (!romver) {
+    printf("FAIL: can't create rom0:ROMVER\n");
+    return -1;
+  }
+  fprintf(romver, "0220%cC20060210", region);
+  fclose(romver);
+  return 0;
+}
+
+// Resets GS and fills the frame buffer with garbage
+static void resetGS(GSVideoMode mode) {
+  memset(&gs, 0, sizeof(gs));
+  memset(frameBuffer, 0xA5, sizeof(frameBuffer));
+  transfers = 0;
+  gsInit(mode);
+}
+
+// gsInit sets up the drawing environment and clears the screen with one transfer
+static void testInit() {
+  GSVideoMode modes[] = {GS_MODE_NTSC, GS_MODE_PAL};
+  for (int m = 0; m < 2; m++) {
+    int height = (modes[m] == GS_MODE_PAL) ? 512 : 448;
+    resetGS(modes[m]);
+    CHECK(transfers == 1, "gsInit: %d transfers", transfers);
+    CHECK(gs.regs[GS_REG_FRAME_1] == GS_FRAME(0, FB_WIDTH / 64, 0, 0), "gsInit: FRAME_1 is %llx", (unsigned long long)gs.regs[GS_REG_FRAME_1]);
+    CHECK(gs.regs[GS_REG_SCISSOR_1] == GS_SCISSOR(0, FB_WIDTH - 1, 0, height - 1), "gsInit: SCISSOR_1 is %llx",
+          (unsigned long long)gs.regs[GS_REG_SCISSOR_1]);
+    CHECK((gsGetMaxX() == FB_WIDTH) && (gsGetMaxY() == height), "gsInit: screen size %dx%d", gsGetMaxX(), gsGetMaxY());
+
+    int cleared = 1;
+    for (int y = 0; y < height; y++)
+      for (int x = 0; x < FB_WIDTH; x++)
+        cleared &= !frameBuffer[y][x];
+    CHECK(cleared, "gsInit: screen was not cleared");
+  }
+}
+
+// Draws the barcode the way gsKit did: a magenta separator and a colored bit sprite for every bit
+static void drawReferenceBarcode(uint32_t (*fb)[FB_WIDTH], const char *gameID, int screenHeight) {
+  uint8_t data[64] = {0};
+  int gidlen = strnlen(gameID, 11);
+  int dpos = 0;
+  data[dpos++] = 0xA5;
+  data[dpos++] = 0x00;
+  dpos++;
+  data[dpos++] = gidlen;
+  memcpy(&data[dpos], gameID, gidlen);
+  dpos += gidlen;
+  data[dpos++] = 0x00;
+  data[dpos++] = 0xD5;
+  data[dpos++] = 0x00;
+  int data_len = dpos;
+  data[2] = calculateCRC(&data[3], data_len - 3);
+
+  int xstart = (FB_WIDTH / 2) - (data_len * 8);
+  int ystart = screenHeight - (((screenHeight / 8) * 2) + 20);
+  int height = 2;
+  for (int i = 0; i < data_len; i++) {
+    for (int j = 7; j >= 0; j--) {
+      int x = xstart + (i * 16 + ((7 - j) * 2));
+      int x1 = x + 1;
+      fillSprite(fb, x, ystart, x1, ystart + height, 0xFF00FF);
+      fillSprite(fb, x1, ystart, x1 + 1, ystart + height, ((data[i] >> j) & 1) ? 0xFFFF00 : 0x00FFFF);
+    }
+  }
+}
+
+// The visual game ID is drawn with one transfer after the gsInit transfer
+static void testBarcode() {
+  static uint32_t expected[FB_HEIGHT][FB_WIDTH];
+  const char *gameIDs[] = {"", "A", "SLES_123.45", "SCUS_973.28", "SLPM_123.456789", "HDDOSD", "ZZZZ_999.99"};
+  const char regions[] = {'A', 'E'};
+
+  for (int r = 0; r < 2; r++) {
+    if (setRegion(regions[r]))
+      return;
+    int height = (regions[r] == 'E') ? 512 : 448;
+
+    for (int i = 0; i < sizeof(gameIDs) / sizeof(gameIDs[0]); i++) {
+      memset(&gs, 0, sizeof(gs));
+      memset(frameBuffer, 0, sizeof(frameBuffer));
+      transfers = 0;
+      gsDisplayGameID(gameIDs[i]);
+      CHECK(transfers == 2, "%s: %d transfers for gsInit and the barcode", gameIDs[i], transfers);
+      CHECK(gsGetMaxY() == height, "ROMVER region %c: wrong video mode", regions[r]);
+
+      memset(expected, 0, sizeof(expected));
+      drawReferenceBarcode(expected, gameIDs[i], height);
+      CHECK(!memcmp(expected, frameBuffer, sizeof(expected)), "%s: barcode pixels don't match the reference", gameIDs[i]);
+    }
+  }
+
+  // Nothing is drawn without a title ID
+  transfers = 0;
+  gsDisplayGameID(NULL);
+  CHECK(transfers == 1, "%d transfers without a title ID", transfers);
+}
+
+// Draws the 8-bit bitmap through the CLUT in CSM1 order
+static void drawReferenceBitmap(uint32_t (*fb)[FB_WIDTH], int x, int y, int w, int h, const uint8_t *data, const uint32_t *clut) {
+  int stride = (w + 15) & ~15;
+  for (int yy = 0; yy < h; yy++)
+    for (int xx = 0; xx < w; xx++) {
+      uint8_t index = data[yy * stride + xx];
+      fb[y + yy][x + xx] = clut[(index & 0xE7) | ((index & 0x08) << 1) | ((index & 0x10) >> 1)];
+    }
+}
+
+// 8-bit bitmaps are uploaded with their CLUT and drawn with one textured sprite
+static void testBitmap() {
+  static uint8_t bitmap[512 * 256];
+  static uint32_t clut[256];
+  static uint32_t expected[FB_HEIGHT][FB_WIDTH];
+  struct {
+    uint16_t x, y, w, h;
+  } cases[] = {
+      {10, 20, 64, 32},    // Single transfer
+      {3, 7, 37, 21},      // Rows padded to 16 pixels
+      {64, 100, 512, 128}, // Partial transfer followed by a full one
+      {64, 100, 512, 256}, // Two full transfers
+  };
+
+  for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    int stride = (cases[c].w + 15) & ~15;
+    for (int i = 0; i < stride * cases[c].h; i++)
+      bitmap[i] = rand();
+    for (int i = 0; i < 256; i++)
+      clut[i] = rand() & 0xFFFFFF;
+
+    resetGS(GS_MODE_PAL);
+    memcpy(expected, frameBuffer, sizeof(expected));
+    drawReferenceBitmap(expected, cases[c].x, cases[c].y, cases[c].w, cases[c].h, bitmap, clut);
+
+    transfers = 0;
+    kicks = 0;
+    gsPrintBitmap(cases[c].x, cases[c].y, cases[c].w, cases[c].h, bitmap, clut);
+    CHECK(pendingChain && !transfers, "%ux%u bitmap: upload is not deferred", cases[c].w, cases[c].h);
+    gsWaitTransfer();
+    // One chain: the CLUT and every texture chunk take a CNT packet with the tags and a REF to the data, the sprite is the END packet
+    int chunks = (stride * cases[c].h / 16 + MAX_TRANSFER - 1) / MAX_TRANSFER;
+    CHECK(kicks == 1, "%ux%u bitmap: %d DMA kicks", cases[c].w, cases[c].h, kicks);
+    CHECK(transfers == 2 + chunks * 2 + 1, "%ux%u bitmap: %d transfers for %d chunks", cases[c].w, cases[c].h, transfers, chunks);
+    CHECK(!gs.imageRemaining, "%ux%u bitmap: %u image qwords missing", cases[c].w, cases[c].h, gs.imageRemaining);
+    CHECK(!memcmp(expected, frameBuffer, sizeof(expected)), "%ux%u bitmap pixels don't match", cases[c].w, cases[c].h);
+  }
+
+  // OSDMenu splash screen
+  resetGS(GS_MODE_NTSC);
+  memcpy(expected, frameBuffer, sizeof(expected));
+  drawReferenceBitmap(expected, (640 - splashWidth) / 2, 185, splashWidth, splashHeight, splash, splashCLUT);
+  gsPrintBitmap((640 - splashWidth) / 2, 185, splashWidth, splashHeight, splash, splashCLUT);
+  // Drawing after the splash waits for the chain first
+  gsClearScreen();
+  CHECK(!pendingChain, "screen cleared while the splash chain is pending");
+  gsPrintBitmap((640 - splashWidth) / 2, 185, splashWidth, splashHeight, splash, splashCLUT);
+  gsWaitTransfer();
+  CHECK(!memcmp(expected, frameBuffer, sizeof(expected)), "splash pixels don't match the palette decode");
+}
+
+// Consecutive items of the same kind share one tag and full buffers are sent early
+static void testPacketBuilder() {
+  static uint32_t expected[FB_HEIGHT][FB_WIDTH];
+  DECLARE_GS_PACKET_BUFFER(buffer, 64);
+  GSPacket packet;
+
+  // Register writes followed by sprites: one A+D tag that also selects the primitive and one REGLIST tag
+  resetGS(GS_MODE_NTSC);
+  transfers = 0;
+  gsPacketInit(&packet, buffer, 64);
+  gsPacketAddAD(&packet, GS_REG_XYOFFSET_1, GS_XYOFFSET(0, 0));
+  gsPacketAddAD(&packet, GS_REG_SCISSOR_1, GS_SCISSOR(0, 639, 0, 447));
+  for (int i = 0; i < 10; i++)
+    gsPacketAddSprite(&packet, i * 10, 0, i * 10 + 5, 5, 0, GS_RGBAQ(i, 0, 0, 0, 0));
+  gsPacketSend(&packet);
+  CHECK(transfers == 1, "grouping: %d transfers", transfers);
+  CHECK(lastTransferTags == 2, "grouping: %d tags", lastTransferTags);
+  CHECK(lastTransferQwc == (1 + 3) + (1 + 15), "grouping: %u qwords", lastTransferQwc);
+
+  // An odd number of sprites pads the register list to the qword boundary before the next tag
+  transfers = 0;
+  gsPacketAddSprite(&packet, 0, 10, 5, 15, 0, GS_RGBAQ(1, 2, 3, 0, 0));
+  gsPacketAddAD(&packet, GS_REG_XYOFFSET_1, GS_XYOFFSET(0, 0));
+  gsPacketAddSprite(&packet, 10, 10, 15, 15, 0, GS_RGBAQ(4, 5, 6, 0, 0));
+  gsPacketSend(&packet);
+  CHECK((transfers == 1) && (lastTransferTags == 4), "padding: %d transfers, %d tags", transfers, lastTransferTags);
+  CHECK((frameBuffer[12][2] == 0x030201) && (frameBuffer[12][12] == 0x060504), "padding: sprites were not drawn");
+
+  // Mixed items in an 8-qword buffer are split into several valid transfers
+  resetGS(GS_MODE_NTSC);
+  memcpy(expected, frameBuffer, sizeof(expected));
+  transfers = 0;
+  maxTransferQwc = 0;
+  gsPacketInit(&packet, buffer, 8);
+  for (int i = 0; i < 100; i++) {
+    int x = (i % 20) * 30;
+    int y = (i / 20) * 30;
+    uint64_t color = GS_RGBAQ(i, 255 - i, i * 2, 0, 0);
+    if (i % 7 == 0)
+      gsPacketAddAD(&packet, GS_REG_XYOFFSET_1, GS_XYOFFSET(0, 0));
+    gsPacketAddSprite(&packet, x, y, x + 20, y + 20, 0, color);
+    fillSprite(expected, x, y, x + 20, y + 20, color & 0xFFFFFFFF);
+  }
+  gsPacketSend(&packet);
+  CHECK(transfers > 1, "overflow: packet was not split");
+  CHECK(maxTransferQwc <= 8, "overflow: %u qwords sent from the 8-qword buffer", maxTransferQwc);
+  CHECK(!memcmp(expected, frameBuffer, sizeof(expected)), "overflow: sprite pixels don't match");
+
+  // Empty packets are not sent
+  transfers = 0;
+  gsPacketSend(&packet);
+  CHECK(!transfers, "empty packet was sent");
+}
+
+int main() {
+  testInit();
+  testBarcode();
+  testBitmap();
+  testPacketBuilder();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
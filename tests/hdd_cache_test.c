@@ -0,0 +1,134 @@
+// Checks the ps2hdd and ps2fs cache sizing in launcher/src/init.c.
+// The buffer counts must follow the free IOP memory above the reserve and stay within 20-64 buffers for ps2hdd
+// and 40-127 buffers for ps2fs, and the module arguments must be built from them
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APA
+
+#include "../launcher/src/init.c"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+#define MODULE(mod)                                                                                                                                  \
+  unsigned char mod##_irx[16] __attribute__((aligned(16)));                                                                                          \
+  uint32_t size_##mod##_irx = sizeof(mod##_irx)
+MODULE(iomanX);
+MODULE(fileXio);
+MODULE(sio2man);
+MODULE(mcman);
+MODULE(mcserv);
+MODULE(ps2dev9);
+MODULE(bdm);
+MODULE(bdmfs_fatfs);
+MODULE(ata_bd);
+MODULE(ps2hdd_osd);
+MODULE(ps2fs);
+MODULE(secrsif);
+
+int SifIopReset(const char *arg, int mode) { return 1; }
+int SifIopSync(void) { return 1; }
+void sceSifInitRpc(int mode) {}
+void sceSifExitRpc(void) {}
+int SifLoadFileInit(void) { return 0; }
+int SifLoadModule(const char *path, int argLength, const char *args) { return 0; }
+int SifExecModuleBuffer(void *ptr, uint32_t size, uint32_t argLength, const char *args, int *result) { return 0; }
+int sbv_patch_enable_lmb(void) { return 0; }
+int sbv_patch_disable_prefix_check(void) { return 0; }
+int sbv_patch_fileio(void) { return 0; }
+int fileXioInit(void) { return 0; }
+int LoadExecPS2(const char *filename, int argc, char *argv[]) { return -1; }
+void shutdownDEV9() {}
+void releasePFS() {}
+void msg(const char *str, ...) {}
+
+// Simulated IOP heap
+static int heapAvailable;
+static int totalFree;
+static int maxBlock;
+
+int SifInitIopHeap(void) { return heapAvailable ? 0 : -1; }
+int SifQueryTotalFreeMemSize(void) { return totalFree; }
+int SifQueryMaxFreeMemSize(void) { return maxBlock; }
+
+// Buffer counts around the clamps
+static void testClamp() {
+  struct {
+    int freeMem;
+    int hddBuffers;
+    int fsBuffers;
+  } cases[] = {
+      {0, 20, 40},                                       // No heap RPC
+      {100 * 1024, 20, 40},                              // Less than the reserve
+      {HDD_CACHE_IOP_RESERVE, 20, 40},                   // Nothing above the reserve
+      {HDD_CACHE_IOP_RESERVE + 78 * 1024, 20, 40},       // ps2fs just below its floor
+      {HDD_CACHE_IOP_RESERVE + 80 * 1024, 20, 40},       // Both at the floor
+      {HDD_CACHE_IOP_RESERVE + 84 * 1024, 21, 42},       // Both above the floor
+      {HDD_CACHE_IOP_RESERVE + 84 * 1024 - 1, 20, 41},   // Partial buffers are dropped
+      {HDD_CACHE_IOP_RESERVE + 252 * 1024, 63, 126},     // Both below the ceiling
+      {HDD_CACHE_IOP_RESERVE + 254 * 1024, 63, 127},     // ps2fs at the ceiling
+      {HDD_CACHE_IOP_RESERVE + 256 * 1024, 64, 127},     // Both at the ceiling, ps2fs clamped from 128
+      {2 * 1024 * 1024, 64, 127},                        // All of the IOP memory
+  };
+
+  for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    int hdd = calcHDDCacheBuffers(cases[i].freeMem, PS2HDD_MEM_SHARE, PS2HDD_MIN_BUFFERS, PS2HDD_MAX_BUFFERS);
+    int fs = calcHDDCacheBuffers(cases[i].freeMem, PS2FS_MEM_SHARE, PS2FS_MIN_BUFFERS, PS2FS_MAX_BUFFERS);
+    CHECK(hdd == cases[i].hddBuffers, "%d bytes free: %d ps2hdd buffers instead of %d", cases[i].freeMem, hdd, cases[i].hddBuffers);
+    CHECK(fs == cases[i].fsBuffers, "%d bytes free: %d ps2fs buffers instead of %d", cases[i].freeMem, fs, cases[i].fsBuffers);
+  }
+}
+
+// Checks that the argument list built by the argument function is "-o <descriptors> -n <buffers>"
+static void checkArguments(const char *name, moduleArgFunc argumentFunction, int descriptors, int buffers) {
+  uint32_t argLength = 0;
+  char *argStr = argumentFunction(&argLength);
+  char expected[16];
+  int expectedLength = sprintf(expected, "-o%c%d%c-n%c%d", '\0', descriptors, '\0', '\0', buffers) + 1;
+  CHECK(argStr && (argLength == expectedLength) && !memcmp(argStr, expected, expectedLength), "%s: expected -o %d -n %d, got %u bytes", name,
+        descriptors, buffers, argLength);
+  free(argStr);
+}
+
+// Module arguments are built from the free memory the IOP heap reports
+static void testArguments() {
+  heapAvailable = 1;
+  totalFree = 1024 * 1024;
+  maxBlock = 1024 * 1024;
+  checkArguments("ps2hdd", initPS2HDDArguments, 4, 64);
+  checkArguments("ps2fs", initPS2FSArguments, 10, 127);
+
+  // The cache is allocated as one block, so a fragmented heap limits the buffers
+  maxBlock = HDD_CACHE_IOP_RESERVE + 120 * 1024;
+  checkArguments("fragmented ps2hdd", initPS2HDDArguments, 4, 30);
+  checkArguments("fragmented ps2fs", initPS2FSArguments, 10, 60);
+
+  heapAvailable = 0;
+  checkArguments("no heap ps2hdd", initPS2HDDArguments, 4, 20);
+  checkArguments("no heap ps2fs", initPS2FSArguments, 10, 40);
+}
+
+int main() {
+  testClamp();
+  testArguments();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
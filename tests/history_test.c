@@ -0,0 +1,415 @@
+// Checks the history file updates in common/src/history.c against in-memory memory cards (tests/mc_stub.c).
+// The history files written through the interleaved per-card state machine are compared with the list
+// produced by processHistoryList for the same update, and updates must only write the changed slot.
+// Evicted entries must end up in the history.old ring buffer, which is also migrated from older layouts.
+// Launches recorded in the history journal must be merged as if the history files were updated on every launch.
+// The modelled memory card time is printed for the command latencies of a first-party and a slow memory card
+#include "defaults.h"
+#include "history.h"
+#include <errno.h>
+#include <libcdvd.h>
+#include <libmc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_HISTORY_ENTRIES 21
+#define HISTORY_PATH "/BEDATA-SYSTEM/history"
+#define HISTORY_OLD_PATH "/BEDATA-SYSTEM/history.old"
+#define ICON_SYS_SIZE 1776
+#define HISTORY_OLD_MAX_ENTRIES 128
+#define HISTORY_JOURNAL_MAX_RECORDS 16
+#define HISTORY_OLD_MAGIC "\0OSDMHISTRING\0\0"
+
+// Same layout as in history.c
+struct historyListEntry {
+  char titleID[16];
+  uint8_t launchCount;
+  uint8_t bitmask;
+  uint8_t shiftAmount;
+  uint8_t padding;
+  uint16_t timestamp;
+};
+
+// history.old ring buffer header, same layout as in history.c
+struct historyOldHeader {
+  char magic[16];
+  uint16_t head;
+  uint16_t capacity;
+  uint8_t padding[2];
+};
+
+int processHistoryList(const char *titleID, uint16_t timestamp, struct historyListEntry *historyList, struct historyListEntry *evictedEntry);
+
+// Same layout as in history.c
+struct historyJournalRecord {
+  char titleID[16];
+  uint16_t timestamp;
+  uint16_t padding;
+};
+
+unsigned char icon_J_sys[ICON_SYS_SIZE];
+unsigned char icon_C_sys[ICON_SYS_SIZE];
+unsigned char icon_A_sys[ICON_SYS_SIZE];
+
+static sceCdCLOCK testClock = {.day = 0x01, .month = 0x01, .year = 0x25};
+
+int sceCdReadClock(sceCdCLOCK *clock) {
+  *clock = testClock;
+  return 1;
+}
+
+// Timestamp history.c derives from testClock
+static uint16_t testTimestamp() { return (btoi(testClock.year) << 9) | ((btoi(testClock.month) & 0xF) << 5) | (btoi(testClock.day) & 0x1F); }
+
+// Moves the clock to the day
+static void setTestDay(int day) {
+  day %= 28 * 12;
+  testClock.day = ((day % 28 + 1) / 10) << 4 | (day % 28 + 1) % 10;
+  testClock.month = ((day / 28 + 1) / 10) << 4 | (day / 28 + 1) % 10;
+}
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+static void makeTitleID(char *buf, int n) { sprintf(buf, "SLES_%03d.%02d", n / 100, n % 100); }
+
+// Reads the history file, returns the file size or -1
+static int readHistory(int port, struct historyListEntry *list) {
+  memset(list, 0, sizeof(struct historyListEntry) * MAX_HISTORY_ENTRIES);
+  return mcStubReadFile(port, HISTORY_PATH, list, sizeof(struct historyListEntry) * MAX_HISTORY_ENTRIES);
+}
+
+// Returns the slot that has the title or -1
+static int findTitle(struct historyListEntry *list, const char *titleID) {
+  for (int i = 0; i < MAX_HISTORY_ENTRIES; i++)
+    if (!strncmp(list[i].titleID, titleID, sizeof(list[i].titleID)))
+      return i;
+  return -1;
+}
+
+// Inserts a formatted PS2 memory card with a history file that has count entries
+static void setupCard(int port, int count) {
+  struct historyListEntry list[MAX_HISTORY_ENTRIES] = {0};
+  for (int i = 0; i < count; i++) {
+    makeTitleID(list[i].titleID, 9000 + i);
+    list[i].launchCount = 1 + i % 5;
+    list[i].bitmask = 1;
+    list[i].timestamp = testTimestamp() - i;
+  }
+  mcStubSetCard(port, sceMcTypePS2, MC_FORMATTED);
+  mcStubWriteFile(port, HISTORY_PATH, list, sizeof(list));
+}
+
+// Checks that history.old is a full-size ring buffer that has the newest of the evicted entries
+static void checkHistoryOld(int port, struct historyListEntry *evictedList, int evictions) {
+  static uint8_t file[sizeof(struct historyOldHeader) + sizeof(struct historyListEntry) * (HISTORY_OLD_MAX_ENTRIES + 1)];
+  struct historyOldHeader *header = (struct historyOldHeader *)file;
+  struct historyListEntry *ring = (struct historyListEntry *)(file + sizeof(struct historyOldHeader));
+
+  int count = (evictions < HISTORY_OLD_MAX_ENTRIES) ? evictions : HISTORY_OLD_MAX_ENTRIES;
+  int size = mcStubReadFile(port, HISTORY_OLD_PATH, file, sizeof(file));
+  CHECK(size == sizeof(struct historyOldHeader) + count * sizeof(struct historyListEntry), "history.old has %d bytes for %d evictions", size,
+        evictions);
+  CHECK(!memcmp(header->magic, HISTORY_OLD_MAGIC, sizeof(header->magic)), "history.old has no ring header");
+  CHECK(header->capacity == HISTORY_OLD_MAX_ENTRIES, "history.old capacity is %d", header->capacity);
+  CHECK((header->head == count % HISTORY_OLD_MAX_ENTRIES) || (count == HISTORY_OLD_MAX_ENTRIES), "history.old head is %d after %d evictions",
+        header->head, evictions);
+  if (failures)
+    return;
+
+  // The oldest entry is at the head once the ring is full
+  int start = (evictions < HISTORY_OLD_MAX_ENTRIES) ? 0 : header->head;
+  for (int i = 0; i < count; i++)
+    CHECK(!memcmp(&ring[(start + i) % HISTORY_OLD_MAX_ENTRIES], &evictedList[evictions - count + i], sizeof(struct historyListEntry)),
+          "history.old entry %d doesn't match evicted entry %d", (start + i) % HISTORY_OLD_MAX_ENTRIES, evictions - count + i);
+}
+
+// Launches random titles with only mc0 inserted and checks every history file against processHistoryList
+static void testSingleCard() {
+  mcStubReset();
+  setupCard(0, 15);
+
+  struct historyListEntry expected[MAX_HISTORY_ENTRIES], actual[MAX_HISTORY_ENTRIES], evicted;
+  static struct historyListEntry evictedList[2000];
+  char titleID[16];
+  int evictions = 0;
+  srand(1);
+  for (int i = 0; i < 2000; i++) {
+    setTestDay(i / 3);
+    makeTitleID(titleID, rand() % 40);
+
+    // processHistoryList uses rand(), so both runs start from the same seed
+    readHistory(0, expected);
+    int written = mcStubStats.bytesWritten[0];
+    srand(i);
+    updateHistoryFile(titleID);
+    srand(i);
+    processHistoryList(titleID, testTimestamp(), expected, &evicted);
+
+    CHECK(readHistory(0, actual) == sizeof(actual), "launch %d: history file size", i);
+    CHECK(!memcmp(expected, actual, sizeof(actual)), "launch %d: %s: history file doesn't match processHistoryList", i, titleID);
+
+    // Only the updated slot is written. Evictions write the entry and the header into history.old,
+    // the first one also creates the ring header
+    written = mcStubStats.bytesWritten[0] - written;
+    if (evicted.titleID[0] != '\0') {
+      evictedList[evictions++] = evicted;
+      written -= ((evictions == 1) ? 3 : 2) * sizeof(struct historyListEntry);
+    }
+    CHECK(written == sizeof(struct historyListEntry), "launch %d: %d bytes written to the history file", i, written);
+    if (failures)
+      return;
+  }
+
+  // history.old keeps the newest evicted entries
+  checkHistoryOld(0, evictedList, evictions);
+  CHECK(!mcStubStats.overlappingCommand, "overlapping libmc commands");
+  printf("single card: 2000 launches, %d evictions\n", evictions);
+}
+
+// Updates both cards at once: mc0 has a history file, mc1 has no system directory yet
+static void testBothCards() {
+  mcStubReset();
+  setupCard(0, 10);
+  mcStubSetCard(1, sceMcTypePS2, MC_FORMATTED);
+
+  updateHistoryFile("SCES_123.45");
+  CHECK(!mcStubStats.overlappingCommand, "overlapping libmc commands");
+
+  // Commands for the cards are issued in turns until the first card runs out of commands
+  CHECK(mcStubStats.traceCount >= 6, "only %d commands", mcStubStats.traceCount);
+  for (int i = 0; i < 6; i++)
+    CHECK(mcStubStats.trace[i] == (i & 1), "command %d was issued for mc%d", i, mcStubStats.trace[i]);
+
+  struct historyListEntry list[MAX_HISTORY_ENTRIES];
+  for (int port = 0; port < 2; port++) {
+    CHECK(readHistory(port, list) == sizeof(list), "mc%d: history file size", port);
+    int slot = findTitle(list, "SCES_123.45");
+    CHECK((slot >= 0) && (list[slot].launchCount == 1) && (list[slot].timestamp == testTimestamp()), "mc%d: title not added", port);
+  }
+  CHECK(findTitle(list, "SLES_090.00") < 0, "mc1: unexpected entries");
+
+  static uint8_t icon[ICON_SYS_SIZE * 2];
+  CHECK(mcStubReadFile(1, "/BEDATA-SYSTEM/icon.sys", icon, sizeof(icon)) == ICON_SYS_SIZE, "mc1: icon.sys was not created");
+}
+
+// History files that can't be read are rewritten
+static void testShortFile() {
+  mcStubReset();
+  setupCard(0, 21);
+  struct historyListEntry list[MAX_HISTORY_ENTRIES];
+  readHistory(0, list);
+  mcStubWriteFile(0, HISTORY_PATH, list, sizeof(list) - 1);
+
+  updateHistoryFile("SCES_123.45");
+  CHECK(readHistory(0, list) == sizeof(list), "short history file was not rewritten");
+  CHECK(findTitle(list, "SCES_123.45") >= 0, "title not added");
+  CHECK(findTitle(list, "SLES_090.00") < 0, "entries of the short file were kept");
+}
+
+// Evicts a title into history.old files with older layouts and checks that they are converted into the ring buffer
+static void testHistoryOldMigration() {
+  struct {
+    const char *name;
+    int entries;  // Entries in the file
+    int capacity; // Ring capacity or 0 for append-only files
+    int head;     // Ring head
+    int reads;    // Expected history.old reads: the header and the entries
+  } cases[] = {
+      {"missing", 0, 0, 0, 1},
+      {"append-only", 50, 0, 0, 2},
+      {"append-only, larger than the ring", 500, 0, 0, 2},
+      {"ring with 16 entries", 16, 16, 5, 2},
+      {"partially filled ring with 16 entries", 10, 16, 10, 2},
+      {"ring with 300 entries", 300, 300, 250, 2},
+      {"ring with 300 entries, wrapped", 300, 300, 50, 3},
+  };
+
+  static struct historyListEntry entries[512];
+  static uint8_t file[sizeof(struct historyOldHeader) + sizeof(entries)];
+  for (int c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    mcStubReset();
+    setupCard(0, MAX_HISTORY_ENTRIES);
+
+    // Entries in chronological order, and one more for the evicted title
+    memset(entries, 0, sizeof(entries));
+    for (int i = 0; i < cases[c].entries; i++) {
+      makeTitleID(entries[i].titleID, 10000 + i);
+      entries[i].launchCount = 1;
+      entries[i].timestamp = i;
+    }
+
+    int size = 0;
+    if (cases[c].capacity) {
+      struct historyOldHeader *header = (struct historyOldHeader *)file;
+      struct historyListEntry *ring = (struct historyListEntry *)(file + sizeof(struct historyOldHeader));
+      memset(file, 0, sizeof(file));
+      memcpy(header->magic, HISTORY_OLD_MAGIC, sizeof(header->magic));
+      header->capacity = cases[c].capacity;
+      header->head = cases[c].head;
+      // The oldest entry is at the head once the ring is full
+      int start = (cases[c].entries < cases[c].capacity) ? 0 : cases[c].head;
+      for (int i = 0; i < cases[c].entries; i++)
+        ring[(start + i) % cases[c].capacity] = entries[i];
+      size = sizeof(struct historyOldHeader) + cases[c].entries * sizeof(struct historyListEntry);
+    } else {
+      memcpy(file, entries, cases[c].entries * sizeof(struct historyListEntry));
+      size = cases[c].entries * sizeof(struct historyListEntry);
+    }
+    if (cases[c].entries)
+      mcStubWriteFile(0, HISTORY_OLD_PATH, file, size);
+
+    // Adding a title to the full history file evicts an entry
+    struct historyListEntry list[MAX_HISTORY_ENTRIES];
+    readHistory(0, list);
+    int reads = mcStubStats.ops[McStubOp_Read];
+    updateHistoryFile("SCES_123.45");
+    struct historyListEntry updated[MAX_HISTORY_ENTRIES];
+    readHistory(0, updated);
+    int slot = findTitle(updated, "SCES_123.45");
+    CHECK(slot >= 0, "%s: title not added", cases[c].name);
+    if (slot < 0)
+      continue;
+    entries[cases[c].entries] = list[slot];
+
+    // The history file is read once before the eviction
+    reads = mcStubStats.ops[McStubOp_Read] - reads - 1;
+    CHECK(reads == cases[c].reads, "%s: history.old was read with %d commands", cases[c].name, reads);
+    int failed = failures;
+    checkHistoryOld(0, entries, cases[c].entries + 1);
+    if (failures != failed)
+      printf("history.old migration failed: %s\n", cases[c].name);
+  }
+}
+
+// Merges the journal into the history file and checks the result against processHistoryList applied to every record
+static void checkJournalMerge(const char *name, struct historyJournalRecord *records, int count) {
+  struct historyListEntry expected[MAX_HISTORY_ENTRIES], actual[MAX_HISTORY_ENTRIES], evicted;
+  readHistory(0, expected);
+
+  // processHistoryList uses rand(), so both runs start from the same seed
+  srand(count);
+  CHECK(!flushHistoryJournal('E'), "%s: flushHistoryJournal failed", name);
+  srand(count);
+  for (int i = 0; i < count; i++)
+    processHistoryList(records[i].titleID, records[i].timestamp, expected, &evicted);
+
+  CHECK(readHistory(0, actual) == sizeof(actual), "%s: history file size", name);
+  CHECK(!memcmp(expected, actual, sizeof(actual)), "%s: history file doesn't match processHistoryList", name);
+  struct historyJournalRecord record;
+  CHECK(mcStubReadFile(0, HISTORY_JOURNAL_PATH, &record, sizeof(record)) < 0, "%s: journal was not deleted", name);
+}
+
+// Records launches in the history journal and merges it into the history file
+static void testJournal() {
+  static struct historyJournalRecord records[HISTORY_JOURNAL_MAX_RECORDS * 3];
+  int count = HISTORY_JOURNAL_MAX_RECORDS + 4;
+
+  // The journal refuses records past the limit
+  mcStubReset();
+  setupCard(0, 15);
+  mcStubMkDir(0, "SYS-CONF");
+  for (int i = 0; i < count; i++) {
+    setTestDay(i);
+    makeTitleID(records[i].titleID, 9010 + i);
+    records[i].timestamp = testTimestamp();
+    int res = writeHistoryJournal(0, records[i].titleID);
+    if (i < HISTORY_JOURNAL_MAX_RECORDS)
+      CHECK(!res, "record %d: writeHistoryJournal returned %d", i, res);
+    else
+      CHECK(res == -ENOSPC, "record %d: writeHistoryJournal returned %d for the full journal", i, res);
+  }
+  CHECK(mcStubReadFile(0, HISTORY_JOURNAL_PATH, records, sizeof(records)) == HISTORY_JOURNAL_MAX_RECORDS * sizeof(struct historyJournalRecord),
+        "journal size");
+  checkJournalMerge("full journal", records, HISTORY_JOURNAL_MAX_RECORDS);
+
+  // Journals larger than the limit are merged completely
+  mcStubReset();
+  setupCard(0, 21);
+  count = sizeof(records) / sizeof(records[0]) - 3;
+  memset(records, 0, sizeof(records));
+  for (int i = 0; i < count; i++) {
+    makeTitleID(records[i].titleID, 9000 + i % 30);
+    records[i].timestamp = testTimestamp() + i;
+  }
+  mcStubWriteFile(0, HISTORY_JOURNAL_PATH, records, count * sizeof(struct historyJournalRecord));
+  checkJournalMerge("oversized journal", records, count);
+}
+
+// Cards that are missing, unformatted or not PS2 memory cards are left alone
+static void testUnusableCards() {
+  mcStubReset();
+  mcStubSetCard(0, sceMcTypePS2, MC_UNFORMATTED);
+  mcStubSetCard(1, sceMcTypePS1, MC_FORMATTED);
+
+  updateHistoryFile("SCES_123.45");
+  CHECK((mcStubStats.commands[0] == 1) && (mcStubStats.commands[1] == 1), "%d/%d commands for unusable cards", mcStubStats.commands[0],
+        mcStubStats.commands[1]);
+  CHECK(!mcStubStats.bytesWritten[0] && !mcStubStats.bytesWritten[1], "unusable cards were written to");
+}
+
+// Prints the modelled memory card time of the common history updates
+static void printTimings(const char *profile) {
+  struct {
+    const char *name;
+    int entries;    // Entries in the history files
+    const char *id; // Launched title
+  } cases[] = {
+      {"update existing title", 21, "SLES_090.03"},
+      {"add title", 15, "SCES_123.45"},
+      {"add title with eviction", 21, "SCES_123.45"},
+  };
+
+  for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    mcStubReset();
+    setupCard(0, cases[i].entries);
+    setupCard(1, cases[i].entries);
+    updateHistoryFile(cases[i].id);
+    printf("%-12s %-26s %3d commands %8.1f ms\n", profile, cases[i].name, mcStubStats.commands[0] + mcStubStats.commands[1],
+           mcStubStats.time / 1000.0);
+  }
+}
+
+int main() {
+  // history.c reads the region from ROMVER
+  FILE *romver = fopen("rom0:ROMVER", "wb");
+  if (!romver) {
+    printf("FAIL: can't create rom0:ROMVER\n");
+    return 1;
+  }
+  fputs("0220EC20060210", romver);
+  fclose(romver);
+
+  testSingleCard();
+  testBothCards();
+  testShortFile();
+  testHistoryOldMigration();
+  testJournal();
+  testUnusableCards();
+
+  printTimings("first-party");
+  // Slow third-party card
+  mcStubSetLatency(McStubOp_Open, 20000, 0);
+  mcStubSetLatency(McStubOp_Close, 15000, 0);
+  mcStubSetLatency(McStubOp_Read, 10000, 8000);
+  mcStubSetLatency(McStubOp_Write, 30000, 40000);
+  printTimings("slow");
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
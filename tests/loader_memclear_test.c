@@ -0,0 +1,188 @@
+// Checks the user memory clearing in utils/loader/src/memclear.c.
+// addELFRegions must keep only the file data of PT_LOAD segments and clearUserMemory must clear exactly
+// the gaps between the kept regions within the user memory
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "qmem.h"
+
+// Record the cleared ranges instead of writing to the EE memory
+static void recordClear(void *ptr, uint8_t value, size_t n);
+#define qmemset recordClear
+#include "../utils/loader/src/memclear.c"
+#undef qmemset
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+#define MAX_GAPS (MAX_KEEP_REGIONS + 1)
+
+static MemRegion gaps[MAX_GAPS + 1];
+static int gapCount;
+static int flushed;
+
+static void recordClear(void *ptr, uint8_t value, size_t n) {
+  if (gapCount < MAX_GAPS + 1) {
+    gaps[gapCount].start = (uint32_t)(uintptr_t)ptr;
+    gaps[gapCount].end = (uint32_t)(uintptr_t)ptr + n;
+  }
+  gapCount++;
+}
+
+void FlushCache(int operation) { flushed = 1; }
+
+// Clears the memory and checks the cleared ranges against the expected gap list
+static void checkGaps(const char *name, MemRegion *keep, int count, const MemRegion *expected, int expectedCount) {
+  gapCount = 0;
+  flushed = 0;
+  clearUserMemory(keep, count);
+
+  CHECK(flushed, "%s: cache was not flushed", name);
+  CHECK(gapCount == expectedCount, "%s: %d gaps cleared instead of %d", name, gapCount, expectedCount);
+  for (int i = 0; (i < gapCount) && (i < expectedCount); i++)
+    CHECK((gaps[i].start == expected[i].start) && (gaps[i].end == expected[i].end), "%s: gap %d is [0x%x, 0x%x) instead of [0x%x, 0x%x)", name, i,
+          gaps[i].start, gaps[i].end, expected[i].start, expected[i].end);
+}
+
+// Builds an ELF header with count program headers
+static Elf32_Ehdr makeELF(int count) {
+  Elf32_Ehdr eh = {0};
+  memcpy(eh.e_ident, ELFMAG, SELFMAG);
+  eh.e_phnum = count;
+  return eh;
+}
+
+static Elf32_Phdr segment(uint32_t type, uint32_t vaddr, uint32_t filesz, uint32_t memsz) {
+  Elf32_Phdr ph = {0};
+  ph.p_type = type;
+  ph.p_vaddr = vaddr;
+  ph.p_filesz = filesz;
+  ph.p_memsz = memsz;
+  return ph;
+}
+
+// No regions to keep clears all of the user memory
+static void testEmpty() {
+  MemRegion expected[] = {{USER_MEM_START_ADDR, USER_MEM_END_ADDR}};
+  checkGaps("empty", NULL, 0, expected, 1);
+}
+
+// Unsorted regions are cleared around in address order
+static void testUnsorted() {
+  MemRegion keep[] = {{0x800000, 0x900000}, {0x200000, 0x280000}, {0x1000000, 0x1000100}};
+  MemRegion expected[] = {{USER_MEM_START_ADDR, 0x200000}, {0x280000, 0x800000}, {0x900000, 0x1000000}, {0x1000100, USER_MEM_END_ADDR}};
+  checkGaps("unsorted", keep, 3, expected, 4);
+}
+
+// Overlapping, nested and adjacent regions leave no gap between them
+static void testOverlapping() {
+  MemRegion keep[] = {{0x300000, 0x500000}, {0x200000, 0x400000}, {0x380000, 0x3C0000}, {0x500000, 0x600000}};
+  MemRegion expected[] = {{USER_MEM_START_ADDR, 0x200000}, {0x600000, USER_MEM_END_ADDR}};
+  checkGaps("overlapping", keep, 4, expected, 2);
+
+  // Nested region that starts after the outer one
+  MemRegion nested[] = {{0x200000, 0x800000}, {0x300000, 0x400000}};
+  MemRegion nestedExpected[] = {{USER_MEM_START_ADDR, 0x200000}, {0x800000, USER_MEM_END_ADDR}};
+  checkGaps("nested", nested, 2, nestedExpected, 2);
+}
+
+// Regions starting at or before the user memory start and ending beyond the user memory end
+static void testBounds() {
+  MemRegion keep[] = {{0x80000, 0x180000}, {0x1F00000, 0x2100000}};
+  MemRegion expected[] = {{0x180000, 0x1F00000}};
+  checkGaps("edges", keep, 2, expected, 1);
+
+  // Region entirely above the user memory
+  MemRegion above[] = {{0x2000000, 0x2100000}, {0x400000, 0x500000}};
+  MemRegion aboveExpected[] = {{USER_MEM_START_ADDR, 0x400000}, {0x500000, USER_MEM_END_ADDR}};
+  checkGaps("above", above, 2, aboveExpected, 2);
+
+  // Region covering all of the user memory
+  MemRegion all[] = {{0, 0x3000000}};
+  checkGaps("all", all, 1, NULL, 0);
+}
+
+// Only the file data of PT_LOAD segments is kept
+static void testELFRegions() {
+  Elf32_Phdr eph[] = {
+      segment(PT_LOAD, 0x200000, 0x1000, 0x1000), // Text
+      segment(PT_NOTE, 0x300000, 0x100, 0x100),   // Not loaded
+      segment(PT_LOAD, 0x210000, 0x800, 0x4000),  // Data followed by BSS
+      segment(PT_LOAD, 0x220000, 0, 0x10000),     // BSS only
+  };
+  Elf32_Ehdr eh = makeELF(4);
+  MemRegion keep[MAX_KEEP_REGIONS] = {{0x1800000, 0x1900000}};
+  int count = addELFRegions(&eh, eph, keep, 1);
+  CHECK(count == 3, "%d regions instead of 3", count);
+
+  MemRegion expected[] = {{USER_MEM_START_ADDR, 0x200000}, {0x201000, 0x210000}, {0x210800, 0x1800000}, {0x1900000, USER_MEM_END_ADDR}};
+  checkGaps("ELF", keep, count, expected, 4);
+}
+
+// Segments beyond the user memory end don't extend the cleared range
+static void testELFBeyondEnd() {
+  Elf32_Phdr eph[] = {
+      segment(PT_LOAD, 0x1FFF000, 0x2000, 0x2000),
+      segment(PT_LOAD, 0x2100000, 0x1000, 0x1000),
+  };
+  Elf32_Ehdr eh = makeELF(2);
+  MemRegion keep[MAX_KEEP_REGIONS];
+  int count = addELFRegions(&eh, eph, keep, 0);
+  CHECK(count == 2, "%d regions instead of 2", count);
+
+  MemRegion expected[] = {{USER_MEM_START_ADDR, 0x1FFF000}};
+  checkGaps("beyond end", keep, count, expected, 1);
+}
+
+// More PT_LOAD segments than the region list can hold clears everything but the base regions
+static void testTooManySegments() {
+  Elf32_Phdr eph[MAX_KEEP_REGIONS + 1];
+  for (int i = 0; i < MAX_KEEP_REGIONS + 1; i++)
+    eph[i] = segment(PT_LOAD, 0x200000 + i * 0x10000, 0x1000, 0x1000);
+
+  // The segments fit without the base region
+  Elf32_Ehdr eh = makeELF(MAX_KEEP_REGIONS);
+  MemRegion keep[MAX_KEEP_REGIONS];
+  int count = addELFRegions(&eh, eph, keep, 0);
+  CHECK(count == MAX_KEEP_REGIONS, "%d regions instead of %d", count, MAX_KEEP_REGIONS);
+
+  // One segment over the limit
+  keep[0] = (MemRegion){0x1800000, 0x1900000};
+  count = addELFRegions(&eh, eph, keep, 1);
+  CHECK(count == 1, "%d regions instead of the base region", count);
+  eh = makeELF(MAX_KEEP_REGIONS + 1);
+  count = addELFRegions(&eh, eph, keep, 0);
+  CHECK(count == 0, "%d regions instead of none", count);
+
+  keep[0] = (MemRegion){0x1800000, 0x1900000};
+  count = addELFRegions(&eh, eph, keep, 1);
+  MemRegion expected[] = {{USER_MEM_START_ADDR, 0x1800000}, {0x1900000, USER_MEM_END_ADDR}};
+  checkGaps("too many segments", keep, count, expected, 2);
+}
+
+int main() {
+  testEmpty();
+  testUnsorted();
+  testOverlapping();
+  testBounds();
+  testELFRegions();
+  testELFBeyondEnd();
+  testTooManySegments();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
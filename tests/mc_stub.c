@@ -0,0 +1,375 @@
+// In-memory memory cards behind the libmc stub (tests/stubs/libmc.h).
+// Commands are only recorded when they are issued and are executed by mcSync, so code that reads
+// the results before the command completes or issues a second command while one is in flight is caught
+#include <io_common.h>
+#include <libmc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MC_STUB_MAX_FILES 32
+#define MC_STUB_MAX_FDS 8
+#define MC_STUB_PATH_MAX 64
+
+// libmc error codes used by the stub
+#define MC_RES_NO_ENTRY -4
+#define MC_RES_DENIED -5
+#define MC_RES_NO_FORMAT -2
+
+typedef struct {
+  int used;
+  int isDir;
+  char path[MC_STUB_PATH_MAX];
+  uint8_t *data;
+  int size;
+} McStubFile;
+
+typedef struct {
+  int type;
+  int format;
+  McStubFile files[MC_STUB_MAX_FILES];
+} McStubCard;
+
+typedef struct {
+  int used;
+  int port;
+  int file;
+  int pos;
+  int mode;
+} McStubFd;
+
+// Command waiting for mcSync
+typedef struct {
+  int pending;
+  McStubOp op;
+  int port;
+  int fd;
+  char path[MC_STUB_PATH_MAX];
+  int mode;
+  int offset;
+  int origin;
+  void *buffer;
+  const void *src;
+  int size;
+  int *type;
+  int *format;
+} McStubCommand;
+
+McStubStats mcStubStats;
+
+static McStubCard cards[2];
+static McStubFd fds[MC_STUB_MAX_FDS];
+static McStubCommand command;
+
+// Default latencies, roughly what a first-party PS2 memory card takes
+static uint32_t latencyBase[McStubOp_Count] = {2000, 4000, 3000, 500, 3000, 8000, 10000, 10000};
+static uint32_t latencyPerKiB[McStubOp_Count] = {0, 0, 0, 0, 2000, 8000, 0, 0};
+
+void mcStubReset(void) {
+  for (int port = 0; port < 2; port++) {
+    for (int i = 0; i < MC_STUB_MAX_FILES; i++)
+      free(cards[port].files[i].data);
+    memset(&cards[port], 0, sizeof(McStubCard));
+  }
+  memset(fds, 0, sizeof(fds));
+  memset(&command, 0, sizeof(command));
+  memset(&mcStubStats, 0, sizeof(mcStubStats));
+}
+
+void mcStubSetCard(int port, int type, int format) {
+  cards[port].type = type;
+  cards[port].format = format;
+}
+
+void mcStubSetLatency(McStubOp op, uint32_t base, uint32_t perKiB) {
+  latencyBase[op] = base;
+  latencyPerKiB[op] = perKiB;
+}
+
+// Strips the leading slash so "/dir/file" and "dir/file" are the same path
+static const char *normalizeStubPath(const char *path) {
+  while (*path == '/')
+    path++;
+  return path;
+}
+
+static int findFile(int port, const char *path) {
+  path = normalizeStubPath(path);
+  for (int i = 0; i < MC_STUB_MAX_FILES; i++)
+    if (cards[port].files[i].used && !strcmp(cards[port].files[i].path, path))
+      return i;
+  return -1;
+}
+
+// Returns 1 if the parent directory of the path exists
+static int parentExists(int port, const char *path) {
+  path = normalizeStubPath(path);
+  const char *slash = strrchr(path, '/');
+  if (!slash)
+    return 1;
+
+  char parent[MC_STUB_PATH_MAX];
+  snprintf(parent, sizeof(parent), "%.*s", (int)(slash - path), path);
+  int idx = findFile(port, parent);
+  return (idx >= 0) && cards[port].files[idx].isDir;
+}
+
+static int createEntry(int port, const char *path, int isDir) {
+  for (int i = 0; i < MC_STUB_MAX_FILES; i++) {
+    McStubFile *file = &cards[port].files[i];
+    if (file->used)
+      continue;
+    memset(file, 0, sizeof(McStubFile));
+    file->used = 1;
+    file->isDir = isDir;
+    snprintf(file->path, sizeof(file->path), "%s", normalizeStubPath(path));
+    return i;
+  }
+  fprintf(stderr, "mc_stub: too many files\n");
+  exit(1);
+}
+
+void mcStubMkDir(int port, const char *path) {
+  if (findFile(port, path) < 0)
+    createEntry(port, path, 1);
+}
+
+int mcStubWriteFile(int port, const char *path, const void *data, int size) {
+  // Create the parent directories
+  char dir[MC_STUB_PATH_MAX];
+  snprintf(dir, sizeof(dir), "%s", normalizeStubPath(path));
+  for (char *slash = strchr(dir, '/'); slash; slash = strchr(slash + 1, '/')) {
+    *slash = '\0';
+    mcStubMkDir(port, dir);
+    *slash = '/';
+  }
+
+  int idx = findFile(port, path);
+  if (idx < 0)
+    idx = createEntry(port, path, 0);
+  McStubFile *file = &cards[port].files[idx];
+  file->data = realloc(file->data, size ? size : 1);
+  memcpy(file->data, data, size);
+  file->size = size;
+  return 0;
+}
+
+int mcStubReadFile(int port, const char *path, void *data, int maxSize) {
+  int idx = findFile(port, path);
+  if ((idx < 0) || cards[port].files[idx].isDir)
+    return -1;
+  McStubFile *file = &cards[port].files[idx];
+  memcpy(data, file->data, (file->size < maxSize) ? file->size : maxSize);
+  return file->size;
+}
+
+// Records the command. Returns 0 if the command was issued
+static int issueCommand(McStubOp op, int port) {
+  if (command.pending) {
+    fprintf(stderr, "mc_stub: command %d for mc%d issued while command %d for mc%d is in flight\n", op, port, command.op, command.port);
+    mcStubStats.overlappingCommand = 1;
+    return -1;
+  }
+  memset(&command, 0, sizeof(command));
+  command.pending = 1;
+  command.op = op;
+  command.port = port;
+
+  mcStubStats.commands[port]++;
+  mcStubStats.ops[op]++;
+  if (mcStubStats.traceCount < sizeof(mcStubStats.trace) / sizeof(mcStubStats.trace[0]))
+    mcStubStats.trace[mcStubStats.traceCount++] = port;
+  return 0;
+}
+
+static McStubFd *getFd(int fd) {
+  if ((fd < 0) || (fd >= MC_STUB_MAX_FDS) || !fds[fd].used)
+    return NULL;
+  return &fds[fd];
+}
+
+static int portOf(int fd) { return getFd(fd) ? getFd(fd)->port : 0; }
+
+int mcInit(int type) { return 0; }
+
+int mcReset(void) { return 0; }
+
+int mcGetInfo(int port, int slot, int *type, int *free, int *format) {
+  if (issueCommand(McStubOp_GetInfo, port))
+    return -1;
+  command.type = type;
+  command.format = format;
+  return 0;
+}
+
+int mcOpen(int port, int slot, const char *name, int mode) {
+  if (issueCommand(McStubOp_Open, port))
+    return -1;
+  snprintf(command.path, sizeof(command.path), "%s", name);
+  command.mode = mode;
+  return 0;
+}
+
+int mcClose(int fd) {
+  if (issueCommand(McStubOp_Close, portOf(fd)))
+    return -1;
+  command.fd = fd;
+  return 0;
+}
+
+int mcSeek(int fd, int offset, int origin) {
+  if (issueCommand(McStubOp_Seek, portOf(fd)))
+    return -1;
+  command.fd = fd;
+  command.offset = offset;
+  command.origin = origin;
+  return 0;
+}
+
+int mcRead(int fd, void *buffer, int size) {
+  if (issueCommand(McStubOp_Read, portOf(fd)))
+    return -1;
+  command.fd = fd;
+  command.buffer = buffer;
+  command.size = size;
+  return 0;
+}
+
+int mcWrite(int fd, const void *buffer, int size) {
+  if (issueCommand(McStubOp_Write, portOf(fd)))
+    return -1;
+  command.fd = fd;
+  command.src = buffer;
+  command.size = size;
+  return 0;
+}
+
+int mcMkDir(int port, int slot, const char *name) {
+  if (issueCommand(McStubOp_MkDir, port))
+    return -1;
+  snprintf(command.path, sizeof(command.path), "%s", name);
+  return 0;
+}
+
+int mcDelete(int port, int slot, const char *name) {
+  if (issueCommand(McStubOp_Delete, port))
+    return -1;
+  snprintf(command.path, sizeof(command.path), "%s", name);
+  return 0;
+}
+
+static int executeOpen(void) {
+  McStubCard *card = &cards[command.port];
+  if ((card->type != sceMcTypePS2) || (card->format != MC_FORMATTED))
+    return MC_RES_NO_FORMAT;
+
+  int idx = findFile(command.port, command.path);
+  if ((idx >= 0) && card->files[idx].isDir)
+    return MC_RES_DENIED;
+  if (idx < 0) {
+    if (!(command.mode & FIO_O_CREAT) || !parentExists(command.port, command.path))
+      return MC_RES_NO_ENTRY;
+    idx = createEntry(command.port, command.path, 0);
+  }
+  if (command.mode & FIO_O_TRUNC)
+    card->files[idx].size = 0;
+
+  for (int fd = 0; fd < MC_STUB_MAX_FDS; fd++) {
+    if (fds[fd].used)
+      continue;
+    fds[fd].used = 1;
+    fds[fd].port = command.port;
+    fds[fd].file = idx;
+    fds[fd].pos = 0;
+    fds[fd].mode = command.mode;
+    return fd;
+  }
+  return MC_RES_DENIED;
+}
+
+// Executes the recorded command and returns its result
+static int executeCommand(void) {
+  McStubCard *card = &cards[command.port];
+  McStubFd *fd = getFd(command.fd);
+  McStubFile *file = fd ? &cards[fd->port].files[fd->file] : NULL;
+  int idx;
+
+  switch (command.op) {
+  case McStubOp_GetInfo:
+    *command.type = card->type;
+    if (command.format)
+      *command.format = card->format;
+    return 0;
+  case McStubOp_Open:
+    return executeOpen();
+  case McStubOp_Close:
+    if (!fd)
+      return MC_RES_DENIED;
+    fd->used = 0;
+    return 0;
+  case McStubOp_Seek:
+    if (!fd)
+      return MC_RES_DENIED;
+    if (command.origin == SEEK_SET)
+      fd->pos = command.offset;
+    else if (command.origin == SEEK_CUR)
+      fd->pos += command.offset;
+    else
+      fd->pos = file->size + command.offset;
+    if (fd->pos < 0)
+      fd->pos = 0;
+    return fd->pos;
+  case McStubOp_Read:
+    if (!fd || !(fd->mode & FIO_O_RDONLY))
+      return MC_RES_DENIED;
+    if (fd->pos >= file->size)
+      return 0;
+    if (command.size > file->size - fd->pos)
+      command.size = file->size - fd->pos;
+    memcpy(command.buffer, file->data + fd->pos, command.size);
+    fd->pos += command.size;
+    return command.size;
+  case McStubOp_Write:
+    if (!fd || !(fd->mode & FIO_O_WRONLY))
+      return MC_RES_DENIED;
+    if (fd->pos + command.size > file->size) {
+      file->data = realloc(file->data, fd->pos + command.size);
+      // Seeking past the end and writing leaves a zero-filled hole
+      if (fd->pos > file->size)
+        memset(file->data + file->size, 0, fd->pos - file->size);
+      file->size = fd->pos + command.size;
+    }
+    memcpy(file->data + fd->pos, command.src, command.size);
+    fd->pos += command.size;
+    mcStubStats.bytesWritten[command.port] += command.size;
+    return command.size;
+  case McStubOp_MkDir:
+    if ((findFile(command.port, command.path) >= 0) || !parentExists(command.port, command.path))
+      return MC_RES_NO_ENTRY;
+    createEntry(command.port, command.path, 1);
+    return 0;
+  case McStubOp_Delete:
+    if ((idx = findFile(command.port, command.path)) < 0)
+      return MC_RES_NO_ENTRY;
+    free(card->files[idx].data);
+    memset(&card->files[idx], 0, sizeof(McStubFile));
+    return 0;
+  default:
+    return -1;
+  }
+}
+
+int mcSync(int mode, int *cmd, int *result) {
+  if (!command.pending)
+    return -1;
+
+  // Transfer sizes are only known for reads and writes
+  uint32_t size = ((command.op == McStubOp_Read) || (command.op == McStubOp_Write)) ? command.size : 0;
+  mcStubStats.time += latencyBase[command.op] + latencyPerKiB[command.op] * size / 1024;
+
+  int res = executeCommand();
+  command.pending = 0;
+  if (result)
+    *result = res;
+  return 1;
+}
@@ -0,0 +1,229 @@
+// Checks the quadword memory routines in common/include/qmem.h.
+// qmemset and qmemcpy must split buffers into an unaligned head, whole 64-byte quadword blocks and a tail
+// for every alignment and size, and qmemXorRotate must match the byte-wise PS2LOGO transform for every rotation.
+// qmemcpySPR runs against simulated scratchpad DMA channels that only move data when they are waited on,
+// so a scratchpad buffer reused before it is drained or drained before it is staged corrupts the output
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define QMEM_HOST_MODEL
+#include "qmem.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                                             \
+  do {                                                                                                                                             \
+    if (!(cond)) {                                                                                                                                 \
+      printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                                                  \
+      printf(__VA_ARGS__);                                                                                                                         \
+      printf("\n");                                                                                                                                \
+      failures++;                                                                                                                                  \
+    }                                                                                                                                              \
+  } while (0)
+
+#define BUF_SIZE 512
+#define GUARD 0xA5
+
+// Bytes processed by the simulated quadword loops and the number of misaligned calls
+static size_t blockBytes;
+static int blockErrors;
+
+// Simulated sq loop
+void qmemsetBlocks(uint8_t *d, uint8_t *end, uint64_t dw) {
+  if (((uintptr_t)d & 15) || ((end - d) & 63) || (end <= d))
+    blockErrors++;
+  blockBytes += end - d;
+  for (; d < end; d += 8)
+    memcpy(d, &dw, 8);
+}
+
+// Simulated lq/sq loop
+void qmemcpyBlocks(uint8_t *d, const uint8_t *s, size_t size) {
+  if (((uintptr_t)d & 15) || ((uintptr_t)s & 15) || (size & 63) || !size)
+    blockErrors++;
+  blockBytes += size;
+  memcpy(d, s, size);
+}
+
+// Simulated scratchpad and the toSPR/fromSPR channels
+static uint8_t scratchpad[2 * QMEM_SPR_CHUNK_SIZE];
+static struct {
+  int busy;
+  uint8_t *mem;
+  uint32_t sprOffset;
+  uint32_t size;
+} channels[2];
+static int flushed;
+static int dmaTransfers;
+static int dmaErrors;
+
+void FlushCache(int operation) { flushed = 1; }
+
+// Returns 1 if the scratchpad ranges overlap
+static int sprOverlaps(uint32_t a, uint32_t aSize, uint32_t b, uint32_t bSize) { return (a < b + bSize) && (b < a + aSize); }
+
+// Moves the data of the pending transfer
+void qmemDMAWait(uint32_t ch) {
+  int c = ch - QMEM_DMA_FROMSPR;
+  if (!channels[c].busy)
+    return;
+  if (ch == QMEM_DMA_TOSPR)
+    memcpy(&scratchpad[channels[c].sprOffset], channels[c].mem, channels[c].size);
+  else
+    memcpy(channels[c].mem, &scratchpad[channels[c].sprOffset], channels[c].size);
+  channels[c].busy = 0;
+}
+
+void qmemDMAStart(uint32_t ch, const void *mem, uint32_t sprOffset, uint32_t size) {
+  int c = ch - QMEM_DMA_FROMSPR;
+  int other = !c;
+  dmaTransfers++;
+  if (channels[c].busy || !flushed || ((uintptr_t)mem & 15) || (sprOffset & 15) || (size & 15) || !size || (size >> 4 > 0xffff) ||
+      (sprOffset + size > sizeof(scratchpad)))
+    dmaErrors++;
+  // The channels must never work on the same scratchpad buffer at the same time
+  if (channels[other].busy && sprOverlaps(sprOffset, size, channels[other].sprOffset, channels[other].size))
+    dmaErrors++;
+
+  channels[c].busy = 1;
+  channels[c].mem = (uint8_t *)mem;
+  channels[c].sprOffset = sprOffset;
+  channels[c].size = size;
+}
+
+#define SPR_BUF_SIZE (6 * QMEM_SPR_CHUNK_SIZE)
+static uint8_t sprDst[SPR_BUF_SIZE] __attribute__((aligned(16)));
+static uint8_t sprSrc[SPR_BUF_SIZE] __attribute__((aligned(16)));
+static uint8_t sprRef[SPR_BUF_SIZE] __attribute__((aligned(16)));
+
+static uint8_t dstBuf[BUF_SIZE] __attribute__((aligned(16)));
+static uint8_t srcBuf[BUF_SIZE] __attribute__((aligned(16)));
+static uint8_t refBuf[BUF_SIZE] __attribute__((aligned(16)));
+
+// Returns the number of bytes the quadword loop is expected to handle
+static size_t expectedBlockBytes(uintptr_t dst, uintptr_t src, size_t size) {
+  size_t head = -dst & 15;
+  if (((dst ^ src) & 15) || (size < head + 64))
+    return 0;
+  return (size - head) & ~63;
+}
+
+// Fills at every offset within two quadwords with sizes around the 64-byte block boundaries
+static void testSet() {
+  for (int offset = 0; offset < 32; offset++) {
+    for (size_t size = 0; size <= 300; size++) {
+      memset(dstBuf, GUARD, BUF_SIZE);
+      memset(refBuf, GUARD, BUF_SIZE);
+      memset(&refBuf[offset], 0x3C, size);
+      blockBytes = 0;
+      blockErrors = 0;
+      qmemset(&dstBuf[offset], 0x3C, size);
+
+      size_t expected = expectedBlockBytes((uintptr_t)&dstBuf[offset], (uintptr_t)&dstBuf[offset], size);
+      CHECK(!memcmp(dstBuf, refBuf, BUF_SIZE), "qmemset offset %d size %zu: buffer mismatch", offset, size);
+      CHECK(!blockErrors, "qmemset offset %d size %zu: misaligned quadword loop", offset, size);
+      CHECK(blockBytes == expected, "qmemset offset %d size %zu: %zu bytes in the quadword loop instead of %zu", offset, size, blockBytes, expected);
+    }
+  }
+}
+
+// Copies between every pair of offsets, with matching and different alignments
+static void testCopy() {
+  for (int i = 0; i < BUF_SIZE; i++)
+    srcBuf[i] = i * 7 + 1;
+
+  for (int dstOffset = 0; dstOffset < 32; dstOffset++) {
+    for (int srcOffset = 0; srcOffset < 32; srcOffset++) {
+      for (size_t size = 0; size <= 300; size++) {
+        memset(dstBuf, GUARD, BUF_SIZE);
+        memset(refBuf, GUARD, BUF_SIZE);
+        memcpy(&refBuf[dstOffset], &srcBuf[srcOffset], size);
+        blockBytes = 0;
+        blockErrors = 0;
+        qmemcpy(&dstBuf[dstOffset], &srcBuf[srcOffset], size);
+
+        size_t expected = expectedBlockBytes((uintptr_t)&dstBuf[dstOffset], (uintptr_t)&srcBuf[srcOffset], size);
+        CHECK(!memcmp(dstBuf, refBuf, BUF_SIZE), "qmemcpy %d -> %d size %zu: buffer mismatch", srcOffset, dstOffset, size);
+        CHECK(!blockErrors, "qmemcpy %d -> %d size %zu: misaligned quadword loop", srcOffset, dstOffset, size);
+        CHECK(blockBytes == expected, "qmemcpy %d -> %d size %zu: %zu bytes in the quadword loop instead of %zu", srcOffset, dstOffset, size,
+              blockBytes, expected);
+      }
+    }
+  }
+}
+
+// Every rotation including 0, at every offset within a 64-bit word and with partial words at both ends
+static void testXorRotate() {
+  const uint8_t keys[] = {0x00, 0x01, 0x5A, 0x80, 0xFF};
+  for (int k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+    for (int rot = 0; rot < 8; rot++) {
+      for (int offset = 0; offset < 16; offset++) {
+        for (size_t size = 0; size <= 40; size++) {
+          for (int i = 0; i < BUF_SIZE; i++)
+            dstBuf[i] = refBuf[i] = i * 13 + 5;
+          for (size_t i = offset; i < offset + size; i++) {
+            uint8_t x = refBuf[i] ^ keys[k];
+            refBuf[i] = (uint8_t)((x << rot) | (x >> (8 - rot)));
+          }
+          qmemXorRotate(&dstBuf[offset], keys[k], rot, size);
+          CHECK(!memcmp(dstBuf, refBuf, BUF_SIZE), "qmemXorRotate key 0x%02x rot %d offset %d size %zu: buffer mismatch", keys[k], rot, offset,
+                size);
+        }
+      }
+    }
+  }
+}
+
+// Runs qmemcpySPR and checks the output, the DMA transfers and the bytes left to qmemcpy
+static void checkSPRCopy(int dstOffset, int srcOffset, size_t size) {
+  memset(sprDst, GUARD, SPR_BUF_SIZE);
+  memset(sprRef, GUARD, SPR_BUF_SIZE);
+  memset(scratchpad, 0, sizeof(scratchpad));
+  memcpy(&sprRef[dstOffset], &sprSrc[srcOffset], size);
+  flushed = 0;
+  dmaTransfers = 0;
+  dmaErrors = 0;
+  qmemcpySPR(&sprDst[dstOffset], &sprSrc[srcOffset], size);
+
+  int useDMA = (size >= QMEM_SPR_MIN_SIZE) && !((dstOffset | srcOffset) & 15);
+  size_t chunks = useDMA ? ((size & ~15) + QMEM_SPR_CHUNK_SIZE - 1) / QMEM_SPR_CHUNK_SIZE : 0;
+  CHECK(!channels[0].busy && !channels[1].busy, "qmemcpySPR %d -> %d size %zu: DMA still running", srcOffset, dstOffset, size);
+  CHECK(!memcmp(sprDst, sprRef, SPR_BUF_SIZE), "qmemcpySPR %d -> %d size %zu: buffer mismatch", srcOffset, dstOffset, size);
+  CHECK(!dmaErrors, "qmemcpySPR %d -> %d size %zu: invalid DMA transfer", srcOffset, dstOffset, size);
+  CHECK(dmaTransfers == chunks * 2, "qmemcpySPR %d -> %d size %zu: %d DMA transfers instead of %zu", srcOffset, dstOffset, size, dmaTransfers,
+        chunks * 2);
+}
+
+// Sizes around the chunk size multiples, with and without 16-byte tails, and unaligned buffers
+static void testCopySPR() {
+  for (int i = 0; i < SPR_BUF_SIZE; i++)
+    sprSrc[i] = i * 31 + i / 251;
+
+  const int deltas[] = {-17, -16, -15, -1, 0, 1, 15, 16, 17};
+  for (int chunks = 1; chunks <= 5; chunks++)
+    for (int i = 0; i < sizeof(deltas) / sizeof(deltas[0]); i++) {
+      size_t size = chunks * QMEM_SPR_CHUNK_SIZE + deltas[i];
+      checkSPRCopy(0, 0, size);
+      checkSPRCopy(16, 32, size);
+      checkSPRCopy(1, 1, size);
+      checkSPRCopy(16, 8, size);
+    }
+
+  checkSPRCopy(0, 0, QMEM_SPR_MIN_SIZE - 16);
+  checkSPRCopy(0, 0, 100);
+}
+
+int main() {
+  testSet();
+  testCopy();
+  testXorRotate();
+  testCopySPR();
+
+  if (failures) {
+    printf("%d checks failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,5 @@
+#ifndef _DEBUG_H_
+#define _DEBUG_H_
+// Host stub for the PS2SDK header, the code under test uses nothing from it
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef _DMA_H_
+#define _DMA_H_
+// Host stub for the PS2SDK header, dma_reset is provided by the test
+
+int dma_reset(void);
+
+#endif
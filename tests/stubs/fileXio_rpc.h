@@ -0,0 +1,7 @@
+#ifndef _FILEXIO_RPC_H_
+#define _FILEXIO_RPC_H_
+// Host stub for the PS2SDK header, fileXio initialization is provided by the test
+
+int fileXioInit(void);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef _GS_PRIVILEGED_H_
+#define _GS_PRIVILEGED_H_
+// Host stub for the PS2SDK header, only has the macros used by the code under test
+#include <stdint.h>
+
+#define GS_SET_DISPLAY(DX, DY, MAGH, MAGV, DW, DH)                                                                                                  \
+  ((uint64_t)((DX) & 0x00000FFF) << 0 | (uint64_t)((DY) & 0x000007FF) << 12 | (uint64_t)((MAGH) & 0x0000000F) << 23 |                               \
+   (uint64_t)((MAGV) & 0x00000003) << 27 | (uint64_t)((DW) & 0x00000FFF) << 32 | (uint64_t)((DH) & 0x000007FF) << 44)
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef _IO_COMMON_H_
+#define _IO_COMMON_H_
+// Host stub for the PS2SDK header, only has the definitions used by the code under test
+
+#define FIO_O_RDONLY 0x0001
+#define FIO_O_WRONLY 0x0002
+#define FIO_O_RDWR 0x0003
+#define FIO_O_APPEND 0x0100
+#define FIO_O_CREAT 0x0200
+#define FIO_O_TRUNC 0x0400
+
+#endif
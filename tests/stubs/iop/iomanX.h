@@ -0,0 +1,23 @@
+// Host stub for the IOP I/O manager types used by the UDPFS core
+#ifndef IOMANX_H
+#define IOMANX_H
+
+#include <stdio.h>
+
+typedef struct {
+  unsigned int mode;
+  unsigned int attr;
+  unsigned int size;
+  unsigned char ctime[8];
+  unsigned char atime[8];
+  unsigned char mtime[8];
+  unsigned int hisize;
+  unsigned int private_0;
+  unsigned int private_1;
+  unsigned int private_2;
+  unsigned int private_3;
+  unsigned int private_4;
+  unsigned int private_5;
+} iox_stat_t;
+
+#endif
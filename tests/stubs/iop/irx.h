@@ -0,0 +1,9 @@
+// Host stub for the IOP module import/export macros
+#ifndef IRX_H
+#define IRX_H
+
+#define DECLARE_IMPORT_TABLE(lib, major, minor)
+#define END_IMPORT_TABLE
+#define DECLARE_IMPORT(ord, name)
+
+#endif
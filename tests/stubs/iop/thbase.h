@@ -0,0 +1,16 @@
+// Host stub for the IOP thread manager: alarms are scheduled as simulation events
+#ifndef THBASE_H
+#define THBASE_H
+
+#include <stdint.h>
+
+typedef struct {
+  uint32_t lo;
+  uint32_t hi;
+} iop_sys_clock_t;
+
+void USec2SysClock(uint32_t usec, iop_sys_clock_t *clock);
+int SetAlarm(iop_sys_clock_t *clock, unsigned int (*handler)(void *), void *arg);
+int CancelAlarm(unsigned int (*handler)(void *), void *arg);
+
+#endif
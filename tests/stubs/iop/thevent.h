@@ -0,0 +1,24 @@
+// Host stub for the IOP event flags: waiting runs the simulation until the flags are set
+#ifndef THEVENT_H
+#define THEVENT_H
+
+#include <stdint.h>
+
+#define WEF_AND 0
+#define WEF_OR 1
+#define WEF_CLEAR 0x10
+
+typedef struct {
+  uint32_t attr;
+  uint32_t option;
+  uint32_t bits;
+} iop_event_t;
+
+int CreateEventFlag(iop_event_t *event);
+int DeleteEventFlag(int ef);
+int SetEventFlag(int ef, uint32_t bits);
+int iSetEventFlag(int ef, uint32_t bits);
+int ClearEventFlag(int ef, uint32_t bits);
+int WaitEventFlag(int ef, uint32_t bits, int mode, uint32_t *resbits);
+
+#endif
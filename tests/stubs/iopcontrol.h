@@ -0,0 +1,8 @@
+#ifndef _IOPCONTROL_H_
+#define _IOPCONTROL_H_
+// Host stub for the PS2SDK header, the IOP reset is provided by the test
+
+int SifIopReset(const char *arg, int mode);
+int SifIopSync(void);
+
+#endif
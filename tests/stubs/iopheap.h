@@ -0,0 +1,9 @@
+#ifndef _IOPHEAP_H_
+#define _IOPHEAP_H_
+// Host stub for the PS2SDK header, the IOP heap queries are provided by the test
+
+int SifInitIopHeap(void);
+int SifQueryTotalFreeMemSize(void);
+int SifQueryMaxFreeMemSize(void);
+
+#endif
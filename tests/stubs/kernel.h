@@ -0,0 +1,11 @@
+#ifndef _KERNEL_H_
+#define _KERNEL_H_
+// Host stub for the PS2SDK header, the kernel calls are provided by the test
+#include <stdint.h>
+
+void FlushCache(int operation);
+uint64_t GsPutIMR(uint64_t imr);
+void SetGsCrt(int interlace, int mode, int field);
+int LoadExecPS2(const char *filename, int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _LIBCDVD_H_
+#define _LIBCDVD_H_
+// Host stub for the PS2SDK header, the clock and the disc sectors are provided by the test
+#include <stdint.h>
+
+typedef struct {
+  uint8_t stat;
+  uint8_t second;
+  uint8_t minute;
+  uint8_t hour;
+  uint8_t pad;
+  uint8_t day;
+  uint8_t month;
+  uint8_t year;
+} sceCdCLOCK;
+
+#define btoi(b) ((b) / 16 * 10 + (b) % 16)
+
+typedef struct {
+  uint8_t trycount;
+  uint8_t spindlctrl;
+  uint8_t datapattern;
+  uint8_t pad;
+} sceCdRMode;
+
+#define SCECdINoD 0x00
+#define SCECdEXIT 0x05
+
+#define SCECdSpinNom 0x01
+#define SCECdSecS2048 0
+
+int sceCdInit(int mode);
+int sceCdReadClock(sceCdCLOCK *clock);
+int sceCdRead(uint32_t lbn, uint32_t sectors, void *buffer, sceCdRMode *mode);
+int sceCdSync(int mode);
+
+#endif
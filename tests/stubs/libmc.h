@@ -0,0 +1,74 @@
+#ifndef _LIBMC_H_
+#define _LIBMC_H_
+// Host stub for the PS2SDK libmc header, backed by the in-memory memory cards in tests/mc_stub.c.
+// Like libmc, only one command can be in flight: every command is executed when mcSync collects its result
+#include <stdint.h>
+
+#define MC_WAIT 0
+#define MC_NOWAIT 1
+
+#define MC_TYPE_MC 0
+#define MC_TYPE_XMC 1
+
+#define MC_FORMATTED 1
+#define MC_UNFORMATTED 0
+
+#define sceMcTypeNoCard 0
+#define sceMcTypePS1 1
+#define sceMcTypePS2 2
+
+int mcInit(int type);
+int mcGetInfo(int port, int slot, int *type, int *free, int *format);
+int mcOpen(int port, int slot, const char *name, int mode);
+int mcClose(int fd);
+int mcSeek(int fd, int offset, int origin);
+int mcRead(int fd, void *buffer, int size);
+int mcWrite(int fd, const void *buffer, int size);
+int mcMkDir(int port, int slot, const char *name);
+int mcDelete(int port, int slot, const char *name);
+int mcSync(int mode, int *cmd, int *result);
+int mcReset(void);
+
+//
+// Memory card stub control
+//
+
+// Commands that have a configurable latency
+typedef enum {
+  McStubOp_GetInfo,
+  McStubOp_Open,
+  McStubOp_Close,
+  McStubOp_Seek,
+  McStubOp_Read,
+  McStubOp_Write,
+  McStubOp_MkDir,
+  McStubOp_Delete,
+  McStubOp_Count,
+} McStubOp;
+
+typedef struct {
+  uint32_t time;           // Modelled time in microseconds, advanced by mcSync
+  int commands[2];         // Number of commands per port
+  int ops[McStubOp_Count]; // Number of commands per operation
+  int bytesWritten[2];     // Number of bytes written per port
+  int trace[64];           // Ports of the first commands in the order they were issued
+  int traceCount;          // Number of commands in trace
+  int overlappingCommand;  // Set when a command was issued while another one was in flight
+} McStubStats;
+
+extern McStubStats mcStubStats;
+
+// Removes all cards and files and resets the statistics. Keeps the latencies
+void mcStubReset(void);
+// Inserts a card into the port
+void mcStubSetCard(int port, int type, int format);
+// Sets the command latency: base microseconds plus microseconds per KiB transferred
+void mcStubSetLatency(McStubOp op, uint32_t base, uint32_t perKiB);
+// Creates or replaces the file, creating missing directories. Returns 0 on success
+int mcStubWriteFile(int port, const char *path, const void *data, int size);
+// Copies up to maxSize bytes of the file into data. Returns the file size or -1 if the file doesn't exist
+int mcStubReadFile(int port, const char *path, void *data, int maxSize);
+// Creates the directory
+void mcStubMkDir(int port, const char *path);
+
+#endif
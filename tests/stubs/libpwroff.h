@@ -0,0 +1,5 @@
+#ifndef _LIBPWROFF_H_
+#define _LIBPWROFF_H_
+// Host stub for the PS2SDK header, the code under test uses nothing from it
+
+#endif
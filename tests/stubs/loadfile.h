@@ -0,0 +1,10 @@
+#ifndef _LOADFILE_H_
+#define _LOADFILE_H_
+// Host stub for the PS2SDK header, module loading is provided by the test
+#include <stdint.h>
+
+int SifLoadFileInit(void);
+int SifLoadModule(const char *path, int argLength, const char *args);
+int SifExecModuleBuffer(void *ptr, uint32_t size, uint32_t argLength, const char *args, int *result);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _PS2SDKAPI_H_
+#define _PS2SDKAPI_H_
+// Host stub for the PS2SDK header, pulls in the definitions the EE toolchain headers provide implicitly
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#endif
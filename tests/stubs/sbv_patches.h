@@ -0,0 +1,9 @@
+#ifndef _SBV_PATCHES_H_
+#define _SBV_PATCHES_H_
+// Host stub for the PS2SDK header, the patches are provided by the test
+
+int sbv_patch_enable_lmb(void);
+int sbv_patch_disable_prefix_check(void);
+int sbv_patch_fileio(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _SIFRPC_H_
+#define _SIFRPC_H_
+// Host stub for the PS2SDK header, the SIF RPC calls are provided by the test
+
+void sceSifInitRpc(int mode);
+void sceSifExitRpc(void);
+
+#endif
@@ -0,0 +1,883 @@
+// Runs the UDPFS client against a simulated UDPFS server on a simulated 100 Mbit/s link.
+// launcher/iop/udpfs/udpfs/src/udprdma.c and udpfs_core.c are built for the host with the IOP kernel, SMAP and UDP calls
+// replaced by a discrete-event simulation: the client runs until it waits for an event flag, then the simulated time
+// advances to the next packet arrival or alarm.
+// IOP processing time is not simulated, so the results are the upper bound of what the protocol allows on real hardware.
+// Set SIM_TRACE to print every frame
+#include "udpfs_core.h"
+#include "udpfs_packet.h"
+#include "udprdma.h"
+#include <smap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thbase.h>
+#include <thevent.h>
+
+#define US 1000ULL
+#define MS (1000 * US)
+
+#define LINK_RATE 100000000ULL // bits per second
+#define SECTOR_SIZE 512
+
+// Server parameters
+#define SERVER_IP IP_ADDR(192, 168, 1, 10)
+#define SERVER_WINDOW 8        // Maximum number of unacknowledged packets
+#define SERVER_CHUNK 1024      // Data bytes per packet
+#define SERVER_DELAY (50 * US) // Time to process a request
+
+//
+// Simulation
+//
+
+struct frame {
+  uint16_t len;
+  uint8_t data[1536];
+};
+
+enum event_type {
+  EV_CLIENT_RX,    // Frame arrives at the client
+  EV_SERVER_RX,    // Frame arrives at the server
+  EV_ALARM,        // Client alarm expires
+  EV_SERVER_READY, // Server finished processing a request
+  EV_SERVER_TIMER, // Server retransmit timer
+};
+
+struct event {
+  uint64_t time;
+  uint64_t order;
+  enum event_type type;
+  struct frame *frame;
+  unsigned int (*handler)(void *);
+  void *arg;
+  struct event *next;
+};
+
+struct link {
+  uint64_t latency;    // One-way latency in ns
+  double loss;         // Random loss probability
+  uint64_t busy_until; // Time the last frame leaves the sender
+  uint64_t busy_time;  // Total transmit time
+  uint32_t frames;
+  uint32_t dropped;
+};
+
+struct sim_config {
+  const char *name;
+  uint64_t latency; // One-way latency in ns
+  double loss_down; // Random loss from server to client
+  double loss_up;   // Random loss from client to server
+  int selective_repeat; // Server supports selective repeat
+  uint32_t seed;        // Added to the random loss seed
+  // Returns 1 if the frame must be dropped
+  int (*drop)(int to_client, const struct frame *frame);
+};
+
+static struct event *events;
+static uint64_t now;
+static uint64_t event_order;
+static uint64_t time_limit;
+static struct link link_down; // Server to client
+static struct link link_up;   // Client to server
+static const struct sim_config *config;
+static uint32_t rng_state;
+
+static uint32_t rng() {
+  rng_state = rng_state * 1103515245 + 12345;
+  return rng_state >> 8;
+}
+
+static void schedule(struct event *ev) {
+  if (ev->time < now)
+    ev->time = now;
+  ev->order = event_order++;
+  struct event **p = &events;
+  while (*p && (*p)->time <= ev->time)
+    p = &(*p)->next;
+  ev->next = *p;
+  *p = ev;
+}
+
+static struct event *new_event(uint64_t time, enum event_type type) {
+  struct event *ev = calloc(1, sizeof(*ev));
+  ev->time = time;
+  ev->type = type;
+  return ev;
+}
+
+// Sends the frame over the link. Frames are serialized at LINK_RATE and arrive after the link latency
+static void link_send(struct link *l, const struct frame *frame) {
+  uint32_t wire = (frame->len < 60 ? 60 : frame->len) + 4 + 8 + 12; // FCS, preamble and inter-frame gap
+  uint64_t tx_time = wire * 8ULL * 1000000000ULL / LINK_RATE;
+  uint64_t start = (l->busy_until > now) ? l->busy_until : now;
+  l->busy_until = start + tx_time;
+  l->busy_time += tx_time;
+  l->frames++;
+
+  int to_client = (l == &link_down);
+  if (getenv("SIM_TRACE")) {
+    udprdma_hdr_t hdr;
+    udprdma_hdr_data_t data;
+    memcpy(&hdr, frame->data + 42, sizeof(hdr));
+    memcpy(&data, frame->data + 44, sizeof(data));
+    printf("%10.3f %s type=%d seq=%4d ack=%4d flags=%d hwc=%d bytes=%d\n", now / 1e6, to_client ? "S->C" : "C->S", hdr.packet_type,
+           hdr.seq_nr, data.seq_nr_ack, data.flags, data.hdr_word_count, data.data_byte_count);
+  }
+  if ((config->drop && config->drop(to_client, frame)) || ((rng() & 0xffff) < l->loss * 0x10000)) {
+    l->dropped++;
+    return;
+  }
+
+  struct event *ev = new_event(l->busy_until + l->latency, to_client ? EV_CLIENT_RX : EV_SERVER_RX);
+  ev->frame = malloc(sizeof(*frame));
+  memcpy(ev->frame, frame, sizeof(*frame));
+  schedule(ev);
+}
+
+static void server_receive(struct frame *frame);
+static void server_ready();
+static void server_timer();
+static void client_receive(struct frame *frame);
+
+// Runs the next event. Returns 0 if there are no events left
+static int run_event() {
+  struct event *ev = events;
+  if (!ev)
+    return 0;
+  events = ev->next;
+  now = ev->time;
+  if (now > time_limit) {
+    printf("FAIL %s: simulation time limit reached\n", config->name);
+    exit(1);
+  }
+
+  switch (ev->type) {
+  case EV_CLIENT_RX:
+    client_receive(ev->frame);
+    break;
+  case EV_SERVER_RX:
+    server_receive(ev->frame);
+    break;
+  case EV_ALARM: {
+    // The handler returns the time until it's called again, 0 to stop
+    unsigned int repeat = ev->handler(ev->arg);
+    if (repeat) {
+      struct event *again = new_event(now + repeat * US, EV_ALARM);
+      again->handler = ev->handler;
+      again->arg = ev->arg;
+      schedule(again);
+    }
+    break;
+  }
+  case EV_SERVER_READY:
+    server_ready();
+    break;
+  case EV_SERVER_TIMER:
+    server_timer();
+    break;
+  }
+  free(ev->frame);
+  free(ev);
+  return 1;
+}
+
+//
+// IOP kernel, SMAP and UDP replacements used by the client
+//
+
+static uint32_t event_flag_bits;
+static udp_socket_t client_socket;
+static struct frame *client_frame;
+
+int CreateEventFlag(iop_event_t *event) {
+  event_flag_bits = event->bits;
+  return 1;
+}
+
+int DeleteEventFlag(int ef) { return 0; }
+
+int SetEventFlag(int ef, uint32_t bits) {
+  event_flag_bits |= bits;
+  return 0;
+}
+
+int iSetEventFlag(int ef, uint32_t bits) { return SetEventFlag(ef, bits); }
+
+int ClearEventFlag(int ef, uint32_t bits) {
+  event_flag_bits &= bits;
+  return 0;
+}
+
+int WaitEventFlag(int ef, uint32_t bits, int mode, uint32_t *resbits) {
+  while (!(event_flag_bits & bits)) {
+    if (!run_event()) {
+      printf("FAIL %s: client waits for 0x%x, but nothing is pending\n", config->name, bits);
+      exit(1);
+    }
+  }
+  if (resbits)
+    *resbits = event_flag_bits;
+  if (mode & WEF_CLEAR)
+    event_flag_bits = 0;
+  return 0;
+}
+
+void USec2SysClock(uint32_t usec, iop_sys_clock_t *clock) {
+  clock->lo = usec;
+  clock->hi = 0;
+}
+
+int SetAlarm(iop_sys_clock_t *clock, unsigned int (*handler)(void *), void *arg) {
+  struct event *ev = new_event(now + clock->lo * US, EV_ALARM);
+  ev->handler = handler;
+  ev->arg = arg;
+  schedule(ev);
+  return 0;
+}
+
+int CancelAlarm(unsigned int (*handler)(void *), void *arg) {
+  for (struct event **p = &events; *p;) {
+    struct event *ev = *p;
+    if (ev->type == EV_ALARM && ev->handler == handler && ev->arg == arg) {
+      *p = ev->next;
+      free(ev);
+      return 0;
+    }
+    p = &ev->next;
+  }
+  return -1;
+}
+
+udp_socket_t *udp_bind(uint16_t port_src, udp_port_handler handler, void *handler_arg) {
+  client_socket.port_src = port_src;
+  client_socket.handler = handler;
+  client_socket.handler_arg = handler_arg;
+  return &client_socket;
+}
+
+void udp_packet_init(udp_packet_t *pkt, uint32_t ip_dst, uint16_t port_dst) {
+  memset(pkt, 0, sizeof(*pkt));
+  pkt->udp.port_src = htons(client_socket.port_src);
+  pkt->udp.port_dst = htons(port_dst);
+}
+
+int udp_packet_send_ll(udp_socket_t *socket, udp_packet_t *pkt, uint16_t pktdatasize, const void *data, uint16_t datasize) {
+  struct frame frame;
+  uint16_t hdr_size = sizeof(eth_header_t) + sizeof(ip_header_t) + sizeof(udp_header_t) + pktdatasize;
+  memcpy(frame.data, pkt, hdr_size);
+  if (datasize)
+    memcpy(frame.data + hdr_size, data, datasize);
+  frame.len = hdr_size + datasize;
+  link_send(&link_up, &frame);
+  return 0;
+}
+
+void smap_fifo_read(uint16_t offset, void *dst, uint32_t bytes) {
+  if (offset + bytes > client_frame->len) {
+    printf("FAIL %s: client reads %u bytes at %u from a %u byte frame\n", config->name, bytes, offset, client_frame->len);
+    exit(1);
+  }
+  memcpy(dst, client_frame->data + offset, bytes);
+}
+
+static void client_receive(struct frame *frame) {
+  client_frame = frame;
+  client_socket.handler(&client_socket, client_socket.handler_arg, frame->data, 44);
+  client_frame = NULL;
+}
+
+//
+// UDPFS server
+//
+// Answers BREAD requests in the order they were received, while it keeps receiving new requests.
+// Sends at most SERVER_WINDOW unacknowledged packets and goes back to the first missing packet on NACK
+// or after UDPRDMA_RETX_TIMEOUT_US without progress.
+// With selective repeat, only the packets the NACK bitmap reports missing are resent
+
+#define SEQ(n) ((n) & 0xfff)
+#define SEQ_DIFF(a, b) SEQ((a) - (b))
+#define FRAME_HDR_SIZE (sizeof(eth_header_t) + sizeof(ip_header_t) + sizeof(udp_header_t))
+
+struct server_packet {
+  struct frame frame;
+  uint64_t last_sent;
+  uint32_t send_order; // Transmission count when the packet was last sent
+  int sacked;          // Reported received by the last selective NACK
+};
+
+struct server_request {
+  uint64_t ready;
+  uint32_t sector;
+  uint16_t count;
+};
+
+static struct {
+  uint16_t rx_expected; // Next expected sequence number from the client
+  uint16_t base;        // Oldest unacknowledged packet
+  uint16_t next;        // Next packet to send
+  uint16_t end;         // Next sequence number of a new packet
+  int selective_repeat;
+  uint64_t last_progress;
+  int timer_armed;
+  struct server_request requests[64];
+  uint32_t requests_received;
+  uint32_t requests_answered;
+  uint32_t gobacks;
+  uint32_t resends; // Packets resent selectively
+  uint32_t transmissions;
+  uint32_t timeouts;
+  uint16_t discovery_flags; // Flags of the last DISCOVERY answered
+  uint32_t sr_nacks;        // NACKs received with the selective repeat bitmap
+} server;
+static struct server_packet server_packets[4096];
+
+// Minimum time between two transmissions of the same packet on NACK.
+// The packets in flight when the packet was resent and the NACKs for them still ask for it
+static uint64_t server_resend_guard() {
+  uint64_t packet_time = (FRAME_HDR_SIZE + 6 + 8 + SERVER_CHUNK + 24) * 8ULL * 1000000000ULL / LINK_RATE;
+  return 2 * config->latency + SERVER_WINDOW * packet_time;
+}
+
+static void server_build(struct frame *frame, uint8_t type, uint16_t seq_nr) {
+  memset(frame->data, 0, FRAME_HDR_SIZE + 6);
+  ip_header_t *ip = (ip_header_t *)(frame->data + sizeof(eth_header_t));
+  uint32_t addr = SERVER_IP;
+  for (int i = 0; i < 4; i++)
+    ip->addr_src.addr[i] = addr >> (24 - i * 8);
+  udp_header_t *udp = (udp_header_t *)(frame->data + sizeof(eth_header_t) + sizeof(ip_header_t));
+  udp->port_src = htons(UDPFS_PORT);
+  udp->port_dst = htons(UDPFS_PORT);
+
+  udprdma_hdr_t hdr = {0};
+  hdr.packet_type = type;
+  hdr.seq_nr = seq_nr;
+  memcpy(frame->data + FRAME_HDR_SIZE, &hdr, sizeof(hdr));
+  frame->len = FRAME_HDR_SIZE + sizeof(hdr);
+}
+
+static void server_send_ack() {
+  struct frame frame;
+  udprdma_hdr_data_t data = {0};
+  server_build(&frame, UDPRDMA_PT_DATA, server.end);
+  data.seq_nr_ack = SEQ(server.rx_expected - 1);
+  data.flags = UDPRDMA_DF_ACK;
+  memcpy(frame.data + frame.len, &data, sizeof(data));
+  frame.len += sizeof(data);
+  link_send(&link_down, &frame);
+}
+
+static void server_transmit(uint16_t seq_nr) {
+  struct server_packet *p = &server_packets[seq_nr];
+  // Piggyback the current ACK
+  udprdma_hdr_data_t data;
+  memcpy(&data, p->frame.data + FRAME_HDR_SIZE + 2, sizeof(data));
+  data.seq_nr_ack = SEQ(server.rx_expected - 1);
+  memcpy(p->frame.data + FRAME_HDR_SIZE + 2, &data, sizeof(data));
+  p->last_sent = now;
+  p->send_order = ++server.transmissions;
+  link_send(&link_down, &p->frame);
+}
+
+static void server_arm_timer() {
+  if (server.timer_armed || server.base == server.next)
+    return;
+  server.timer_armed = 1;
+  schedule(new_event(server.last_progress + UDPRDMA_RETX_TIMEOUT_US * US, EV_SERVER_TIMER));
+}
+
+// Sends new packets while the window allows it
+static void server_pump() {
+  // The retransmit timer starts with the first packet after the link was idle
+  if (server.base == server.next)
+    server.last_progress = now;
+  while (server.next != server.end && SEQ_DIFF(server.next, server.base) < SERVER_WINDOW) {
+    server_transmit(server.next);
+    server.next = SEQ(server.next + 1);
+  }
+  server_arm_timer();
+}
+
+// Builds the reply packets for the request
+static void server_append_reply(struct server_request *req) {
+  udpfs_msg_result_reply_t result = {.msg_type = UDPFS_MSG_RESULT_REPLY, .result = req->count * SECTOR_SIZE};
+  uint32_t size = req->count * SECTOR_SIZE;
+  for (uint32_t offset = 0; offset < size; offset += SERVER_CHUNK) {
+    struct server_packet *p = &server_packets[server.end];
+    uint32_t chunk = (size - offset < SERVER_CHUNK) ? size - offset : SERVER_CHUNK;
+    udprdma_hdr_data_t data = {0};
+    uint32_t hdr_size = (offset == 0) ? sizeof(result) : 0;
+
+    server_build(&p->frame, UDPRDMA_PT_DATA, server.end);
+    data.flags = UDPRDMA_DF_ACK | ((offset + chunk == size) ? UDPRDMA_DF_FIN : 0);
+    data.hdr_word_count = hdr_size / 4;
+    data.data_byte_count = chunk;
+    memcpy(p->frame.data + p->frame.len, &data, sizeof(data));
+    p->frame.len += sizeof(data);
+    memcpy(p->frame.data + p->frame.len, &result, hdr_size);
+    p->frame.len += hdr_size;
+
+    // Every word holds its byte address on the disk
+    uint32_t *words = (uint32_t *)(p->frame.data + p->frame.len);
+    for (uint32_t i = 0; i < chunk / 4; i++)
+      words[i] = req->sector * SECTOR_SIZE + offset + i * 4;
+    p->frame.len += chunk;
+    p->last_sent = 0;
+    p->sacked = 0;
+
+    server.end = SEQ(server.end + 1);
+  }
+}
+
+// Appends the replies to the requests that have been processed, in request order
+static void server_ready() {
+  while (server.requests_answered != server.requests_received &&
+         server.requests[server.requests_answered % 64].ready <= now) {
+    server_append_reply(&server.requests[server.requests_answered % 64]);
+    server.requests_answered++;
+  }
+  server_pump();
+}
+
+static void server_timer() {
+  server.timer_armed = 0;
+  if (server.base == server.next)
+    return;
+
+  if (now - server.last_progress >= UDPRDMA_RETX_TIMEOUT_US * US) {
+    server.timeouts++;
+    server.last_progress = now;
+    server.next = server.base;
+    server_pump();
+    return;
+  }
+  server_arm_timer();
+}
+
+// Moves the window start to seq_nr if it's within the packets that have been sent
+static void server_advance(uint16_t seq_nr) {
+  if (seq_nr == server.base || SEQ_DIFF(seq_nr, server.base) > SEQ_DIFF(server.next, server.base))
+    return;
+  server.base = seq_nr;
+  server.last_progress = now;
+}
+
+// Handles NACK: packets from seq_nr on are resent.
+// A selective NACK replaces the previous bitmap: packets that were reported received and aren't anymore
+// were dropped by the client and are resent right away
+static void server_nack(uint16_t seq_nr, const struct frame *frame, const udprdma_hdr_data_t *data) {
+  server_advance(seq_nr);
+  if (seq_nr != server.base || server.base == server.next)
+    return;
+
+  uint32_t bitmap = 0;
+  int dropped = 0;
+  if (data->hdr_word_count == 1)
+    server.sr_nacks++;
+  if (server.selective_repeat && data->hdr_word_count == 1) {
+    memcpy(&bitmap, frame->data + FRAME_HDR_SIZE + 6, sizeof(bitmap));
+    uint32_t in_flight = SEQ_DIFF(server.next, server.base);
+    for (uint32_t i = 0; i < in_flight; i++) {
+      struct server_packet *p = &server_packets[SEQ(seq_nr + i)];
+      int sacked = (i < UDPRDMA_SR_WINDOW) && (bitmap & (1u << i));
+      if (p->sacked && !sacked) {
+        dropped = 1;
+        p->last_sent = 0;
+      }
+      p->sacked = sacked;
+    }
+  }
+
+  if (bitmap == 0) {
+    if (!dropped && now - server_packets[seq_nr].last_sent < server_resend_guard())
+      return;
+    server.gobacks++;
+    server.next = seq_nr;
+    return;
+  }
+
+  // Resend the missing packets up to the last packet the client has.
+  // The link keeps the packet order, so a missing packet is lost if a packet sent after it has arrived
+  uint32_t latest_sacked = 0;
+  for (int i = 31 - __builtin_clz(bitmap); i >= 0; i--) {
+    struct server_packet *p = &server_packets[SEQ(seq_nr + i)];
+    if (bitmap & (1u << i)) {
+      if (p->send_order > latest_sacked)
+        latest_sacked = p->send_order;
+      continue;
+    }
+    if (latest_sacked < p->send_order && now - p->last_sent < server_resend_guard())
+      continue;
+    server.resends++;
+    server_transmit(SEQ(seq_nr + i));
+  }
+}
+
+static void server_receive(struct frame *frame) {
+  udprdma_hdr_t hdr;
+  memcpy(&hdr, frame->data + FRAME_HDR_SIZE, sizeof(hdr));
+
+  if (hdr.packet_type == UDPRDMA_PT_DISCOVERY) {
+    udprdma_hdr_disc_t disc;
+    memcpy(&disc, frame->data + FRAME_HDR_SIZE + 2, sizeof(disc));
+    if (disc.service_id != UDPRDMA_SVC_UDPFS)
+      return;
+
+    server.discovery_flags = disc.flags;
+    struct frame reply;
+    server_build(&reply, UDPRDMA_PT_INFORM, 1);
+    // Servers without selective repeat ignore the flag
+    disc.flags = server.selective_repeat ? (disc.flags & UDPRDMA_CF_SR) : 0;
+    memcpy(reply.data + reply.len, &disc, sizeof(disc));
+    reply.len += sizeof(disc);
+    link_send(&link_down, &reply);
+    return;
+  }
+
+  if (hdr.packet_type != UDPRDMA_PT_DATA)
+    return;
+
+  udprdma_hdr_data_t data;
+  memcpy(&data, frame->data + FRAME_HDR_SIZE + 2, sizeof(data));
+  if (data.flags & UDPRDMA_DF_ACK)
+    server_advance(SEQ(data.seq_nr_ack + 1));
+  else
+    server_nack(data.seq_nr_ack, frame, &data);
+
+  if (data.data_byte_count != 0) {
+    if (hdr.seq_nr == server.rx_expected) {
+      udpfs_msg_bread_req_t req;
+      memcpy(&req, frame->data + FRAME_HDR_SIZE + 6 + data.hdr_word_count * 4, sizeof(req));
+      if (req.msg_type != UDPFS_MSG_BREAD_REQ) {
+        printf("FAIL %s: server got unexpected request 0x%02x\n", config->name, req.msg_type);
+        exit(1);
+      }
+
+      struct server_request *r = &server.requests[server.requests_received++ % 64];
+      r->sector = req.sector_nr_lo;
+      r->count = req.sector_count;
+      r->ready = now + SERVER_DELAY;
+      schedule(new_event(r->ready, EV_SERVER_READY));
+      server.rx_expected = SEQ(server.rx_expected + 1);
+    }
+    // Immediate ACK, also for duplicates
+    server_send_ack();
+  }
+  server_pump();
+}
+
+//
+// Scenarios
+//
+
+static uint8_t read_buffer[1024 * 1024] __attribute__((aligned(4)));
+
+struct sim_result {
+  uint64_t discovery; // Time to find the server in ns
+  uint64_t elapsed;   // Time to read all data in ns
+  uint64_t bytes;     // Bytes read
+  double goodput;     // Mbit/s
+  double utilization; // Share of the time the server to client link is busy
+  uint32_t sent;      // Packets sent by the server
+  uint32_t lost;      // Packets sent by the server and lost
+  uint32_t gobacks;
+  uint32_t resends;
+  uint32_t timeouts;
+};
+
+static void sim_collect(struct sim_result *res, uint64_t busy_time) {
+  res->goodput = (double)res->bytes * 8 * 1000 / res->elapsed;
+  res->utilization = (double)busy_time / res->elapsed;
+  res->sent = link_down.frames;
+  res->lost = link_down.dropped;
+  res->gobacks = server.gobacks;
+  res->resends = server.resends;
+  res->timeouts = server.timeouts;
+}
+
+static void sim_reset(const struct sim_config *cfg) {
+  while (events) {
+    struct event *ev = events;
+    events = ev->next;
+    free(ev->frame);
+    free(ev);
+  }
+  config = cfg;
+  now = 0;
+  time_limit = 120000 * MS;
+  rng_state = 12345 + cfg->seed;
+  event_flag_bits = 0;
+  memset(&link_down, 0, sizeof(link_down));
+  memset(&link_up, 0, sizeof(link_up));
+  link_down.latency = link_up.latency = cfg->latency;
+  link_down.loss = cfg->loss_down;
+  link_up.loss = cfg->loss_up;
+  memset(&server, 0, sizeof(server));
+  server.selective_repeat = cfg->selective_repeat;
+}
+
+// Reads total_size bytes with block reads of read_size bytes and checks the data
+static int sim_run(const struct sim_config *cfg, uint32_t total_size, uint32_t read_size, struct sim_result *res) {
+  sim_reset(cfg);
+  if (udpfs_core_init()) {
+    printf("FAIL %s: server not found\n", cfg->name);
+    return 1;
+  }
+
+  res->discovery = now;
+  uint64_t start = now;
+  uint64_t busy_start = link_down.busy_time;
+  int failed = 0;
+  for (uint32_t offset = 0; offset < total_size && !failed; offset += read_size) {
+    uint32_t sector = offset / SECTOR_SIZE;
+    uint32_t count = read_size / SECTOR_SIZE;
+    memset(read_buffer, 0xAA, read_size);
+    int ret = udpfs_core_bread(0, sector, read_buffer, count, SECTOR_SIZE);
+    if (ret != count) {
+      printf("FAIL %s: bread(%u, %u) returned %d\n", cfg->name, sector, count, ret);
+      failed = 1;
+      break;
+    }
+    uint32_t *words = (uint32_t *)read_buffer;
+    for (uint32_t i = 0; i < read_size / 4; i++) {
+      if (words[i] != offset + i * 4) {
+        printf("FAIL %s: wrong data at 0x%x: 0x%08x\n", cfg->name, offset + i * 4, words[i]);
+        failed = 1;
+        break;
+      }
+    }
+  }
+
+  res->elapsed = now - start;
+  res->bytes = total_size;
+  sim_collect(res, link_down.busy_time - busy_start);
+  udpfs_core_exit();
+  return failed;
+}
+
+static void print_result(const struct sim_config *cfg, const struct sim_result *res) {
+  printf("%-28s %8.2f ms %7.2f Mbit/s %5.1f%% link   sent %5u lost %4u  go-back %3u resent %4u timeout %u\n", cfg->name,
+         res->elapsed / 1e6, res->goodput, res->utilization * 100, res->sent, res->lost, res->gobacks, res->resends,
+         res->timeouts);
+}
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+// Reads two 8 KiB replies into 64 KiB buffers queued in advance with udprdma_queue_rx,
+// so packets of the second reply fit in the first buffer
+static int sim_run_queued(const struct sim_config *cfg, struct sim_result *res) {
+  static udpfs_msg_result_reply_t results[2] __attribute__((aligned(4)));
+  const uint32_t reply_size = 8 * 1024;
+  const uint32_t buffer_size = 64 * 1024;
+  int transfers[2];
+
+  sim_reset(cfg);
+  udprdma_socket_t *socket = udprdma_create(UDPFS_PORT, UDPRDMA_SVC_UDPFS);
+  if (!socket || udprdma_discover(socket, 5000) != UDPRDMA_OK) {
+    printf("FAIL %s: server not found\n", cfg->name);
+    return 1;
+  }
+
+  uint64_t start = now;
+  int failed = 0;
+  memset(read_buffer, 0xAA, 2 * buffer_size);
+  for (int i = 0; i < 2; i++) {
+    udpfs_msg_bread_req_t req = {.msg_type = UDPFS_MSG_BREAD_REQ, .sector_count = reply_size / SECTOR_SIZE,
+                                 .sector_nr_lo = i * reply_size / SECTOR_SIZE};
+    transfers[i] = udprdma_queue_rx(socket, &results[i], sizeof(results[i]), read_buffer + i * buffer_size, buffer_size);
+    if (transfers[i] < 0 || udprdma_send(socket, &req, sizeof(req)) != UDPRDMA_OK) {
+      printf("FAIL %s: request %d not sent\n", cfg->name, i);
+      failed = 1;
+      break;
+    }
+  }
+
+  for (int i = 0; i < 2 && !failed; i++) {
+    int ret = udprdma_wait_rx(socket, transfers[i], 5000);
+    if (ret != reply_size || results[i].result != reply_size) {
+      printf("FAIL %s: reply %d returned %d\n", cfg->name, i, ret);
+      failed = 1;
+      break;
+    }
+    uint32_t *words = (uint32_t *)(read_buffer + i * buffer_size);
+    for (uint32_t j = 0; j < reply_size / 4; j++) {
+      if (words[j] != i * reply_size + j * 4) {
+        printf("FAIL %s: wrong data in reply %d at 0x%x: 0x%08x\n", cfg->name, i, j * 4, words[j]);
+        failed = 1;
+        break;
+      }
+    }
+  }
+
+  res->elapsed = now - start;
+  res->bytes = 2 * reply_size;
+  sim_collect(res, link_down.busy_time);
+  udprdma_destroy(socket);
+  return failed;
+}
+#endif
+
+// Drops the first transmission of the second read request
+static int drop_second_request(int to_client, const struct frame *frame) {
+  static uint32_t requests;
+  udprdma_hdr_data_t data;
+  if (to_client)
+    return 0;
+  memcpy(&data, frame->data + FRAME_HDR_SIZE + 2, sizeof(data));
+  if (data.data_byte_count == 0)
+    return 0;
+  return ++requests == 2;
+}
+
+// Drops the first transmission of the 20th packet and the first time it's resent
+static int drop_resend(int to_client, const struct frame *frame) {
+  static uint32_t drops;
+  udprdma_hdr_t hdr;
+  if (!to_client)
+    return 0;
+  memcpy(&hdr, frame->data + FRAME_HDR_SIZE, sizeof(hdr));
+  if (hdr.packet_type != UDPRDMA_PT_DATA || hdr.seq_nr != 20)
+    return 0;
+  return drops++ < 2;
+}
+
+// Drops DISCOVERY packets with flags, as servers from before selective repeat do
+static int drop_flagged_discovery(int to_client, const struct frame *frame) {
+  udprdma_hdr_t hdr;
+  udprdma_hdr_disc_t disc;
+  if (to_client)
+    return 0;
+  memcpy(&hdr, frame->data + FRAME_HDR_SIZE, sizeof(hdr));
+  memcpy(&disc, frame->data + FRAME_HDR_SIZE + 2, sizeof(disc));
+  return hdr.packet_type == UDPRDMA_PT_DISCOVERY && disc.flags != 0;
+}
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+// Drops the first FIN packet
+static int drop_fin(int to_client, const struct frame *frame) {
+  static uint32_t drops;
+  udprdma_hdr_t hdr;
+  udprdma_hdr_data_t data;
+  if (!to_client)
+    return 0;
+  memcpy(&hdr, frame->data + FRAME_HDR_SIZE, sizeof(hdr));
+  memcpy(&data, frame->data + FRAME_HDR_SIZE + 2, sizeof(data));
+  if (hdr.packet_type != UDPRDMA_PT_DATA || !(data.flags & UDPRDMA_DF_FIN))
+    return 0;
+  return drops++ < 1;
+}
+#endif
+
+int main() {
+  int failures = 0;
+  struct sim_result res;
+  printf("UDPFS_READ_DEPTH=%d\n", UDPFS_READ_DEPTH);
+
+  // Throughput at typical LAN round trip times: 8 MiB in 1 MiB reads
+  static const uint64_t latencies[] = {50 * US, 100 * US, 250 * US, 500 * US};
+  for (int i = 0; i < sizeof(latencies) / sizeof(latencies[0]); i++) {
+    char name[64];
+    snprintf(name, sizeof(name), "rtt %.1f ms", 2 * latencies[i] / 1e6);
+    struct sim_config cfg = {.name = name, .latency = latencies[i]};
+    failures += sim_run(&cfg, 8 * 1024 * 1024, 1024 * 1024, &res);
+    print_result(&cfg, &res);
+#if UDPFS_READ_DEPTH > 1
+    // With requests in flight the server doesn't wait for the next request, so the link stays busy
+    // as long as the server send window covers the round trip. Above that, the window limits the throughput
+    if (i == 0 && res.utilization < 0.99) {
+      printf("FAIL %s: link is busy only %.1f%% of the time\n", name, res.utilization * 100);
+      failures++;
+    }
+#endif
+  }
+
+  // A lost request must be resent without waiting for the retransmit timeout
+  // while the reply to the previous request is received
+  struct sim_config lost_request = {.name = "lost request", .latency = 100 * US, .drop = drop_second_request};
+  failures += sim_run(&lost_request, 1024 * 1024, 1024 * 1024, &res);
+  print_result(&lost_request, &res);
+#if UDPFS_READ_DEPTH > 1
+  if (res.elapsed >= UDPRDMA_RETX_TIMEOUT_US * US) {
+    printf("FAIL lost request: took %.2f ms, the request was resent after the timeout\n", res.elapsed / 1e6);
+    failures++;
+  }
+#endif
+
+  // Selective repeat is offered in the first discovery attempt and servers without it still answer that attempt
+  for (int sr = 0; sr <= 1; sr++) {
+    struct sim_config cfg = {.name = sr ? "discovery, selective repeat" : "discovery, go-back-n", .latency = 100 * US,
+                             .selective_repeat = sr};
+    failures += sim_run(&cfg, 64 * 1024, 64 * 1024, &res);
+    if (res.discovery >= 10 * MS) {
+      printf("FAIL %s: server found after %.2f ms\n", cfg.name, res.discovery / 1e6);
+      failures++;
+    }
+  }
+
+  // Servers that drop DISCOVERY with flags are found by the attempts without them, and the client stays with go-back-n
+  struct sim_config legacy = {.name = "discovery, flags dropped", .latency = 100 * US, .loss_down = 0.02,
+                              .drop = drop_flagged_discovery};
+  failures += sim_run(&legacy, 1024 * 1024, 1024 * 1024, &res);
+  print_result(&legacy, &res);
+  if (server.discovery_flags != 0 || server.sr_nacks != 0 || server.gobacks == 0) {
+    printf("FAIL %s: DISCOVERY flags 0x%x, %u selective NACKs, %u go-backs\n", legacy.name, server.discovery_flags,
+           server.sr_nacks, server.gobacks);
+    failures++;
+  }
+
+  // Random loss from the server to the client: selective repeat resends only the lost packets.
+  // Each case reads 4 MiB with different loss patterns and the results are added up
+  static const double losses[] = {0.01, 0.02, 0.03, 0.05};
+  for (int i = 0; i < sizeof(losses) / sizeof(losses[0]); i++) {
+    struct sim_result total[2];
+    for (int sr = 0; sr <= 1; sr++) {
+      char name[64];
+      snprintf(name, sizeof(name), "loss %.0f%% %s", losses[i] * 100, sr ? "selective repeat" : "go-back-n");
+      struct sim_config cfg = {
+          .name = name, .latency = 100 * US, .loss_down = losses[i], .selective_repeat = sr};
+      memset(&total[sr], 0, sizeof(total[sr]));
+      for (cfg.seed = 0; cfg.seed < 8; cfg.seed++) {
+        failures += sim_run(&cfg, 4 * 1024 * 1024, 1024 * 1024, &res);
+        total[sr].elapsed += res.elapsed;
+        total[sr].bytes += res.bytes;
+        total[sr].utilization += res.utilization * res.elapsed;
+        total[sr].sent += res.sent;
+        total[sr].lost += res.lost;
+        total[sr].gobacks += res.gobacks;
+        total[sr].resends += res.resends;
+        total[sr].timeouts += res.timeouts;
+      }
+      total[sr].goodput = (double)total[sr].bytes * 8 * 1000 / total[sr].elapsed;
+      total[sr].utilization /= total[sr].elapsed;
+      print_result(&cfg, &total[sr]);
+    }
+    if (total[1].resends == 0 || total[1].sent >= total[0].sent || total[1].goodput < total[0].goodput) {
+      printf("FAIL loss %.0f%%: selective repeat %.2f Mbit/s with %u packets, go-back-n %.2f Mbit/s with %u packets\n",
+             losses[i] * 100, total[1].goodput, total[1].sent, total[0].goodput, total[0].sent);
+      failures++;
+    }
+  }
+
+  // A resent packet that is lost again is asked for again without waiting for the server timeout
+  struct sim_config lost_resend = {.name = "lost resend", .latency = 100 * US, .selective_repeat = 1, .drop = drop_resend};
+  failures += sim_run(&lost_resend, 1024 * 1024, 1024 * 1024, &res);
+  print_result(&lost_resend, &res);
+  if (server.timeouts != 0) {
+    printf("FAIL lost resend: the packet was resent after the timeout\n");
+    failures++;
+  }
+
+#ifdef UDPRDMA_RX_QUEUE_SIZE
+  // Packets of the next reply kept before the lost FIN are dropped when the FIN arrives.
+  // The client must tell the server to resend them
+  struct sim_config lost_fin = {.name = "lost fin, next reply queued", .latency = 100 * US, .selective_repeat = 1,
+                                .drop = drop_fin};
+  failures += sim_run_queued(&lost_fin, &res);
+  print_result(&lost_fin, &res);
+  if (server.timeouts != 0) {
+    printf("FAIL lost fin: the next reply was resent after the timeout\n");
+    failures++;
+  }
+#endif
+
+  printf("%d failures\n", failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+#ifndef _EGSM_SCALING_H_
+#define _EGSM_SCALING_H_
+// eGSM video mode and DISPLAY register scaling.
+// Has no dependencies on the exception handler, so it can be built and checked separately from the rest of eGSM
+#include <stdint.h>
+
+typedef void (*fp_SetGsCrt)(short int interlace, short int mode, short int ffmd);
+
+// Number of translated DISPLAY register values kept in the cache
+#define DISPLAY_CACHE_SIZE 4
+
+struct display_cache_entry {
+  uint64_t in;  // Value written by the game
+  uint64_t out; // Translated value
+};
+
+struct video_mode {
+  uint32_t mode : 7;
+  uint32_t interlace : 1; // 0 = non-interlaced, 1 = interlaced
+  uint32_t ffmd : 1;      // 0 = field, 1 = frame
+  uint32_t vck : 3;
+  uint32_t reserved : 20;
+
+  uint16_t FBHeight; // 240/480/960 = 1/2/4
+  uint16_t DPHeight; // 240/480/960 = 1/2/4
+
+  int x_center_vck;
+  int y_center;
+};
+
+// GSM state
+struct gsm_state {
+  fp_SetGsCrt org_SetGsCrt;
+
+  uint32_t flags;
+
+  struct video_mode game;
+  struct video_mode gsm;
+
+  uint32_t VSINTCount : 4;
+  uint32_t VSINTPrev : 1;
+  uint32_t VCKDiv : 3;  // VCK    devide   (1x, 2x     or 4x)
+  uint32_t MAGHMul : 3; // Width  multiply (1x, 2x, 3x or 4x)
+
+  uint32_t FBMul : 3; // Height multiply (1x, 2x     or 4x)
+  uint32_t FBDiv : 3; // Height devide   (1x or 2x)
+
+  uint32_t DPMul : 3; // Height multiply (1x, 2x     or 4x)
+  uint32_t DPDiv : 3; // Height devide   (1x or 2x)
+
+  uint64_t last_display1;
+  uint64_t last_display2;
+
+  // Translated MAGH and MAGV values for the current mode, indexed by the register field value
+  uint8_t magh_new[16];
+  uint8_t magv_new[4];
+
+  // Last DISPLAY register translations. Games usually write the same few values every frame
+  struct display_cache_entry display_cache[DISPLAY_CACHE_SIZE];
+  uint32_t display_cache_count;
+  uint32_t display_cache_next;
+};
+
+// Translates the DISPLAY1/DISPLAY2 register value written by the game into the value for the eGSM video mode
+uint64_t mod_DISPLAY(struct gsm_state *pstate, uint64_t r);
+
+// Drops all cached DISPLAY register translations. Must be called every time the scaling state changes
+void reset_display_cache(struct gsm_state *pstate);
+
+// Recalculates the scaling factors from the game and eGSM video modes. Resets the DISPLAY translation cache
+void update_scaling(struct gsm_state *pstate);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef MEMCLEAR_H
+#define MEMCLEAR_H
+
+#include <elf.h>
+#include <stdint.h>
+
+#define USER_MEM_START_ADDR 0x100000
+#define USER_MEM_END_ADDR 0x2000000
+// Max number of memory regions that are kept when clearing the user memory
+#define MAX_KEEP_REGIONS 16
+
+// Memory region [start, end)
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+} MemRegion;
+
+// Adds the file data of all PT_LOAD segments to the list of regions to keep. Returns the new region count
+int addELFRegions(Elf32_Ehdr *eh, Elf32_Phdr *eph, MemRegion *keep, int count);
+
+// Clears user memory except for the regions in keep
+void clearUserMemory(MemRegion *keep, int count);
+
+#endif
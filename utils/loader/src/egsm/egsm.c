@@ -1,6 +1,7 @@
 #include "ee_asm.h"
 #include "ee_exception_l2.h"
 #include "egsm_api.h"
+#include "egsm_scaling.h"
 #include <ee_debug.h>
 #include <ee_regs.h>
 #include <gs_privileged.h>
@@ -21,45 +22,7 @@ uint8_t el2_stack[256] __attribute__((aligned(128)));
 // Registers from interrupted program
 ee_registers_t el2_regs __attribute__((aligned(128)));
 
-typedef void (*fp_SetGsCrt)(short int interlace, short int mode, short int ffmd);
-
-struct video_mode {
-  uint32_t mode : 7;
-  uint32_t interlace : 1; // 0 = non-interlaced, 1 = interlaced
-  uint32_t ffmd : 1;      // 0 = field, 1 = frame
-  uint32_t vck : 3;
-  uint32_t reserved : 20;
-
-  uint16_t FBHeight; // 240/480/960 = 1/2/4
-  uint16_t DPHeight; // 240/480/960 = 1/2/4
-
-  int x_center_vck;
-  int y_center;
-};
-
 // GSM state
-struct gsm_state {
-  fp_SetGsCrt org_SetGsCrt;
-
-  uint32_t flags;
-
-  struct video_mode game;
-  struct video_mode gsm;
-
-  uint32_t VSINTCount : 4;
-  uint32_t VSINTPrev : 1;
-  uint32_t VCKDiv : 3;  // VCK    devide   (1x, 2x     or 4x)
-  uint32_t MAGHMul : 3; // Width  multiply (1x, 2x, 3x or 4x)
-
-  uint32_t FBMul : 3; // Height multiply (1x, 2x     or 4x)
-  uint32_t FBDiv : 3; // Height devide   (1x or 2x)
-
-  uint32_t DPMul : 3; // Height multiply (1x, 2x     or 4x)
-  uint32_t DPDiv : 3; // Height devide   (1x or 2x)
-
-  uint64_t last_display1;
-  uint64_t last_display2;
-};
 static struct gsm_state state = {NULL};
 
 enum MIPS_OP {
@@ -94,191 +57,6 @@ enum MIPS_OP_IMM {
   MOPI_BGEZALL = 0x13,
 };
 
-/*
- * MAGH is 2x smaller for 480p/576p
- *
- * BufferWidth  MAGH+1 (old)      MAGH+1 (new)
- * --------------------------------------------
- * 256          * 10 / 4 = 640    * 5 / 2 = 640    ->    perfect
- * 320          *  8 / 4 = 640    * 4 / 2 = 640    ->    perfect
- * 384          *  7 / 4 = 640    * 3 / 2 = 576    ->    too small, perhaps not bad when stretched on a modern 16:9 TV
- * 512          *  5 / 4 = 640    * 2 / 2 = 512    ->    too small, perhaps not bad when stretched on a modern 16:9 TV
- * 640          *  4 / 4 = 640    * 2 / 2 = 640    ->    perfect
- *
- *
- * MAGH is 4x smaller for 1080i, but twice as wide, so effectively 2x smaller
- * More stretch options available
- *
- * Also the Pixel Aspect Ratio has to be taken into account:
- *      4:3   16:9
- * ---------------
- * PAL  1,09  1,45
- * NTSC 0,91  1,21
- *
- * Resulting in ideal widths of:
- *      4:3   16:9
- * ---------------
- * PAL  1396  1862
- * NTSC 1164  1552
- *
- * BufferWidth  MAGH+1 (old)      MAGH+1 (new) x1.6  x2    x2.4  x3
- * ------------------------------------------------------------------
- * 512          *  5 / 4 = 640    * 2 =        1024,       1536
- * 640          *  4 / 4 = 640    * 2 =              1280,       1920
- *
- */
-static uint64_t mod_DISPLAY(struct gsm_state *pstate, uint64_t r) {
-  int dx = (r) & 0xfff;
-  int dy = (r >> 12) & 0x7ff;
-  int magh = (r >> 23) & 0x00f;
-  int magv = (r >> 27) & 0x003;
-  int dw = (r >> 32) & 0xfff;
-  int dh = (r >> 44) & 0x7ff;
-
-  // Normalize values
-  magh += 1;
-  magv += 1;
-  dw += 1;
-  dh += 1;
-
-  // Change width
-  int magh_new = magh * pstate->MAGHMul / pstate->VCKDiv;
-  int dw_new = dw * magh_new / magh;
-  int dx_new = pstate->gsm.x_center_vck - (dw_new / 2);
-
-  // Change height
-  int magv_new = magv * pstate->FBMul / pstate->FBDiv;
-  int dh_new = dh * pstate->DPMul / pstate->DPDiv;
-  int dy_new = pstate->gsm.y_center - (dh_new / 2);
-
-  (void)dx; // Unused
-  (void)dy; // Unused
-
-  // Add game offset
-  // int dx_off_vck = dx - (pstate->game.x_center_vck - (dw / 2));
-  // int dy_off     = dy - (pstate->game.y_center     - (dh / 2));
-  // dx_new += dx_off_vck * magh_new / magh;
-  // dy_new += dy_off     * magv_new / magv;
-
-  // Do not change even/odd order
-  // dy_new = (dy_new & ~1) | (dy & 1);
-
-  // Registers are zero-based
-  magh_new -= 1;
-  magv_new -= 1;
-  dw_new -= 1;
-  dh_new -= 1;
-
-  return GS_SET_DISPLAY(dx_new, dy_new, magh_new, magv_new, dw_new, dh_new);
-}
-
-// mode, interlace and ffmd must be set before calling this function
-static void update_scaling_center(struct video_mode *mode) {
-  int display_width;  // pixel units
-  int display_height; // pixel units
-  int display_xoff;   // pixel units
-  int display_yoff;   // pixel units
-
-  switch (mode->mode) {
-  case 0x02: // 480i
-  case 0x50: // 480p
-    display_width = 720;
-    display_height = 480;
-    display_xoff = 123;
-    display_yoff = 34;
-    mode->vck = (mode->mode == 0x02) ? 4 : 2;
-    mode->FBHeight = 2; // 480
-    mode->DPHeight = 2; // 480
-    break;
-  case 0x03: // 576i
-  case 0x53: // 576p
-    display_width = 720;
-    display_height = 576;
-    display_xoff = 130;
-    display_yoff = 40;
-    mode->vck = (mode->mode == 0x03) ? 4 : 2;
-    mode->FBHeight = 2; // 480
-    mode->DPHeight = 2; // 480
-    break;
-  case 0x51: // 1080i
-    display_width = 1920;
-    display_height = 1080;
-    display_xoff = 236;
-    display_yoff = 38;
-    mode->vck = 1;
-    mode->FBHeight = 4; // 960
-    mode->DPHeight = 4; // 960
-    break;
-  default:
-    // Unsupported mode
-    return;
-  }
-
-  if (mode->interlace == 1 && mode->ffmd == 1) {
-    // interlaced FRAME mode uses half height framebuffer
-    // 960 -> 480
-    // 480 -> 240
-    mode->FBHeight /= 2;
-  }
-
-  if ((mode->mode == 0x02 || mode->mode == 0x03) && mode->interlace == 0) {
-    // non-interlaced PAL/NTSC video mode is only half the height
-    mode->FBHeight /= 2; // 480 -> 240
-    mode->DPHeight /= 2; // 480 -> 240
-    display_height /= 2; // 480 -> 240
-    display_yoff /= 2;
-  }
-
-  mode->x_center_vck = (display_xoff + (display_width / 2)) * mode->vck;
-  mode->y_center = display_yoff + (display_height / 2);
-}
-
-static void update_scaling(struct gsm_state *pstate) {
-  // Get center positions
-  update_scaling_center(&pstate->game);
-  update_scaling_center(&pstate->gsm);
-
-  // Multiplication factors assume the mimimum video mode of 240p/288p or 480i/576i FRAME mode:
-  //   WidthMul  x1 = 640
-  //   HeightMul x1 = 224 (240p) / 256 (288p)
-  if (pstate->flags & EGSM_FLAG_VMODE_FP1) {
-    // 240p/288p mode
-    pstate->MAGHMul = 1; // 640 * 1 = 640
-  } else if (pstate->flags & EGSM_FLAG_VMODE_FP2) {
-    // 480p/576p mode
-    pstate->MAGHMul = 1; // 640 * 1 = 640
-  } else if (pstate->flags & EGSM_FLAG_VMODE_1080I_X1) {
-    // 1080i mode
-    pstate->MAGHMul = 1; // 640 * 1 = 640
-    pstate->gsm.FBHeight /= 2;
-    pstate->gsm.DPHeight /= 2;
-  } else if (pstate->flags & EGSM_FLAG_VMODE_1080I_X2) {
-    // 1080i mode
-    pstate->MAGHMul = 2; // 640 * 2 = 1280
-  } else if (pstate->flags & EGSM_FLAG_VMODE_1080I_X3) {
-    // 1080i mode
-    pstate->MAGHMul = 3; // 640 * 3 = 1920
-  }
-
-  // How much larger/smaller is the framebuffer
-  if (pstate->game.FBHeight > pstate->gsm.FBHeight) {
-    pstate->FBMul = 1;
-    pstate->FBDiv = pstate->game.FBHeight / pstate->gsm.FBHeight;
-  } else {
-    pstate->FBMul = pstate->gsm.FBHeight / pstate->game.FBHeight;
-    pstate->FBDiv = 1;
-  }
-  // How much larger/smaller is the display
-  if (pstate->game.DPHeight > pstate->gsm.DPHeight) {
-    pstate->DPMul = 1;
-    pstate->DPDiv = pstate->game.DPHeight / pstate->gsm.DPHeight;
-  } else {
-    pstate->DPMul = pstate->gsm.DPHeight / pstate->game.DPHeight;
-    pstate->DPDiv = 1;
-  }
-  pstate->VCKDiv = pstate->game.vck / pstate->gsm.vck;
-}
-
 /*
  * Exception Level 2 handler
  *   Status.ERL = 1
@@ -558,6 +336,9 @@ static void hook_SetGsCrt(short int interlace, short int mode, short int ffmd) {
 
   // printf("%s(%d, 0x%x, %d)\n", __FUNCTION__, interlace, mode, ffmd);
 
+  // Display centers change even if the mode is not supported
+  reset_display_cache(pstate);
+
   // Set game state
   pstate->game.interlace = interlace;
   pstate->game.ffmd = ffmd;
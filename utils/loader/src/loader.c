@@ -10,8 +10,11 @@
 # Rewritten to support loading ELFs from memory, handle IOPRP images and handle DEV9 shutdown
 */
 
+#include "boottrace.h"
 #include "egsm_api.h"
+#include "memclear.h"
 #include "ps2logo.h"
+#include "qmem.h"
 #include <elf.h>
 #include <iopcontrol.h>
 #include <iopcontrol_special.h>
@@ -36,8 +39,6 @@ DISABLE_PATCHED_FUNCTIONS();
 DISABLE_EXTRA_TIMERS_FUNCTIONS();
 PS2_DISABLE_AUTOSTART_PTHREAD();
 
-#define USER_MEM_START_ADDR 0x100000
-#define USER_MEM_END_ADDR 0x2000000
 
 typedef enum { ShutdownType_None, ShutdownType_HDD, ShutdownType_All } ShutdownType;
 
@@ -54,6 +55,8 @@ static char *elfPath = NULL;
 static uint32_t eGSMFlags = 0;
 // Whether app argv should start with argv[1]
 static uint32_t skipArgv0 = 0;
+// Whether all user memory should be cleared instead of just the parts not overwritten by the ELF
+static uint32_t fullMemoryWipe = 0;
 
 // Resets IOP
 void resetIOP();
@@ -77,6 +80,10 @@ int loadELFFromFile(int argc, char *argv[]);
 // Parses the loader eGSM argument into eGSM flags
 uint32_t parseGSMFlags(char *gsmArg);
 
+// Reads the ELF program headers from file and adds the file data of all PT_LOAD segments to the list of regions to keep.
+// Returns the new region count or -1 if the program headers can't be read
+int addELFFileRegions(char *path, MemRegion *keep, int count);
+
 // Loads an ELF file from the path specified in argv[0].
 // The loader's behavior can be altered by an optional last command-line argument (argv[argc-1]).
 // This argument should begin with "-la=", followed by one or more letters that modify the loader's behavior:
@@ -86,6 +93,7 @@ uint32_t parseGSMFlags(char *gsmArg);
 //   - 'I': The argv[argc-2] argument contains IOPRP image path (for HDD, the path must be a pfs: path on the same partition as the ELF file)
 //   - 'E': The argv[argc-2] argument contains ELF memory location to use instead of argv[0]
 //   - 'A': Do not pass argv[0] to the target ELF and start with argv[1]
+//   - 'W': Clear all user memory before loading the ELF instead of only the parts the ELF doesn't overwrite
 //   - 'G': Force video mode via eGSM. The argv[argc-2] argument contains eGSM arguments:
 //          The argument format is inherited from Neutrino GSM and defined as `x:y:z`, where
 //          x — Interlaced field mode, when a full height buffer is used by the game for displaying. Force video output to:
@@ -113,6 +121,8 @@ int main(int argc, char *argv[]) {
   if (argc < 1)
     return -EINVAL;
 
+  BOOT_TRACE("loader");
+
   // Init SIF RPC
   sceSifInitRpc(0);
   fileXioInit();
@@ -150,6 +160,9 @@ int main(int argc, char *argv[]) {
       case 'A':
         skipArgv0 = 1;
         break;
+      case 'W':
+        fullMemoryWipe = 1;
+        break;
       default:
       }
     }
@@ -206,7 +219,7 @@ int loadELF(int elfMem) {
       continue;
 
     pdata = (void *)(elfMem + eph[i].p_offset);
-    memcpy((void *)eph[i].p_vaddr, pdata, eph[i].p_filesz);
+    qmemcpySPR((void *)eph[i].p_vaddr, pdata, eph[i].p_filesz);
   }
 
   FlushCache(0);
@@ -237,18 +250,22 @@ int loadEmbeddedELF(int argc, char *argv[]) {
   if (sscanf(elfPath, "mem:%08X:%08X", &elfMem, &elfSize) < 2)
     return -ENOENT;
 
-  // Clear the memory
+  // Clear the memory without touching the ELF image and the segments that will be copied from it
   if (elfMem >= USER_MEM_START_ADDR) {
-    memset((void *)USER_MEM_START_ADDR, 0, elfMem - USER_MEM_START_ADDR);
-    memset((void *)(elfMem + elfSize), 0, USER_MEM_END_ADDR - (elfMem + elfSize));
-    FlushCache(0);
+    MemRegion keep[MAX_KEEP_REGIONS] = {{elfMem, elfMem + elfSize}};
+    int count = 1;
+    Elf32_Ehdr *eh = (Elf32_Ehdr *)elfMem;
+    if (!fullMemoryWipe && !memcmp(&eh->e_ident[0], ELFMAG, SELFMAG))
+      count = addELFRegions(eh, (Elf32_Phdr *)(elfMem + eh->e_phoff), keep, count);
+
+    clearUserMemory(keep, count);
   }
 
   int entry = loadELF(elfMem);
   if (entry < 0) {
     // Assume the ELF is a raw payload with entrypoint at 0x100000
     entry = 0x100000;
-    memcpy((void *)entry, (void *)elfMem, elfSize);
+    qmemcpy((void *)entry, (void *)elfMem, elfSize);
     FlushCache(0);
     FlushCache(2);
   }
@@ -256,14 +273,16 @@ int loadEmbeddedELF(int argc, char *argv[]) {
   if (eGSMFlags)
     enableGSM(eGSMFlags);
 
+  BOOT_TRACE("loader:exec");
   return ExecPS2((void *)entry, NULL, argc, argv);
 }
 
 // Loads and executes the ELF elfPath points to.
 int loadELFFromFile(int argc, char *argv[]) {
-  // Handle ELF files
+  MemRegion keep[MAX_KEEP_REGIONS];
+  int count = 0;
   if (ioprpPath && !strncmp(ioprpPath, "mem:", 4)) {
-    // Clear the memory without touching the loaded IOPRP
+    // Don't touch the loaded IOPRP
     int mem = 0;
     int size = 0;
     // Parse the address
@@ -272,15 +291,18 @@ int loadELFFromFile(int argc, char *argv[]) {
       return -EINVAL;
     }
 
-    if (mem >= USER_MEM_START_ADDR) {
-      memset((void *)USER_MEM_START_ADDR, 0, mem - USER_MEM_START_ADDR);
-      memset((void *)(mem + size), 0, USER_MEM_END_ADDR - (mem + size));
-    }
-  } else
-    // Clear all user memory
-    memset((void *)USER_MEM_START_ADDR, 0, USER_MEM_END_ADDR - USER_MEM_START_ADDR);
+    keep[count].start = mem;
+    keep[count++].end = mem + size;
+  }
 
-  FlushCache(0);
+  // Clear only the memory the ELF won't overwrite.
+  // Fall back to clearing everything if the ELF headers can't be read (e.g. for KELFs)
+  if (!fullMemoryWipe) {
+    int res = addELFFileRegions(elfPath, keep, count);
+    if (res >= 0)
+      count = res;
+  }
+  clearUserMemory(keep, count);
 
   // Load ELF into memory
   static t_ExecData elfdata;
@@ -295,6 +317,7 @@ int loadELFFromFile(int argc, char *argv[]) {
   if (ret && (ret = SifLoadElfEncrypted(elfPath, &elfdata)))
     return ret;
   SifLoadFileExit();
+  BOOT_TRACE("loader:elf");
 
   FlushCache(0);
   FlushCache(2);
@@ -328,9 +351,34 @@ int loadELFFromFile(int argc, char *argv[]) {
   if (eGSMFlags)
     enableGSM(eGSMFlags);
 
+  BOOT_TRACE("loader:exec");
   return ExecPS2((void *)elfdata.epc, (void *)elfdata.gp, argc, argv);
 }
 
+// Reads the ELF program headers from file and adds the file data of all PT_LOAD segments to the list of regions to keep.
+// Returns the new region count or -1 if the program headers can't be read
+int addELFFileRegions(char *path, MemRegion *keep, int count) {
+  int fd = fileXioOpen(path, FIO_O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  int res = -1;
+  Elf32_Ehdr eh;
+  Elf32_Phdr eph[MAX_KEEP_REGIONS];
+  if ((fileXioRead(fd, &eh, sizeof(eh)) != sizeof(eh)) || memcmp(&eh.e_ident[0], ELFMAG, SELFMAG) || (eh.e_phnum > MAX_KEEP_REGIONS))
+    goto out;
+
+  int phSize = eh.e_phnum * sizeof(Elf32_Phdr);
+  if ((fileXioLseek(fd, eh.e_phoff, FIO_SEEK_SET) != eh.e_phoff) || (fileXioRead(fd, eph, phSize) != phSize))
+    goto out;
+
+  res = addELFRegions(&eh, eph, keep, count);
+
+out:
+  fileXioClose(fd);
+  return res;
+}
+
 // Attempts to reboot IOP with IOPRP image
 int loadIOPRP(char *ioprpPath) {
 #ifdef DISABLE_IOPRP
@@ -0,0 +1,47 @@
+#include "memclear.h"
+#include "qmem.h"
+#include <kernel.h>
+#include <string.h>
+
+// Adds the file data of all PT_LOAD segments to the list of regions to keep. Returns the new region count
+int addELFRegions(Elf32_Ehdr *eh, Elf32_Phdr *eph, MemRegion *keep, int count) {
+  int baseCount = count;
+  for (int i = 0; i < eh->e_phnum; i++) {
+    if ((eph[i].p_type != PT_LOAD) || !eph[i].p_filesz)
+      continue;
+
+    if (count == MAX_KEEP_REGIONS)
+      // Too many segments, clear everything the ELF might use
+      return baseCount;
+
+    // BSS is not a part of the region and gets cleared
+    keep[count].start = eph[i].p_vaddr;
+    keep[count++].end = eph[i].p_vaddr + eph[i].p_filesz;
+  }
+  return count;
+}
+
+// Clears user memory except for the regions in keep
+void clearUserMemory(MemRegion *keep, int count) {
+  // Sort the regions by start address
+  for (int i = 1; i < count; i++) {
+    MemRegion r = keep[i];
+    int j = i - 1;
+    for (; (j >= 0) && (keep[j].start > r.start); j--)
+      keep[j + 1] = keep[j];
+    keep[j + 1] = r;
+  }
+
+  // Clear the gaps between regions
+  uint32_t addr = USER_MEM_START_ADDR;
+  for (int i = 0; i <= count; i++) {
+    uint32_t end = (i < count) ? keep[i].start : USER_MEM_END_ADDR;
+    if (end > USER_MEM_END_ADDR)
+      end = USER_MEM_END_ADDR;
+    if (end > addr)
+      qmemset((void *)addr, 0, end - addr);
+    if ((i < count) && (keep[i].end > addr))
+      addr = keep[i].end;
+  }
+  FlushCache(0);
+}
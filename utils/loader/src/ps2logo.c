@@ -1,3 +1,4 @@
+#include "qmem.h"
 #include <kernel.h>
 #include <stdint.h>
 #include <string.h>
@@ -14,11 +15,7 @@ int unscrambleLogo(char *whatever, void *logoBuffer, int bufSize) {
   uint8_t *logo = 0;
   asm volatile("move %0, $s1" : "=r"(logo)::); // Get logo buffer address from $s1
 
-  int key = logo[0];
-  for (int i = 0; i < 0x6000; i++) {
-    logo[i] ^= key;
-    logo[i] = (logo[i] << 3) | (logo[i] >> 5);
-  }
+  qmemXorRotate(logo, logo[0], 3, 0x6000);
   return 0;
 }
 
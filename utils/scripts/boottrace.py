@@ -0,0 +1,82 @@
+# Converts the boot phase timing trace recorded with ENABLE_BOOT_TRACE into a per-phase breakdown
+#
+# Accepts either a full EE RAM dump (e.g. from PCSX2 or ps2client dumpmem starting at address 0)
+# or a dump of just the trace record (1024 bytes at 0x84000). See common/include/boottrace.h for the record layout.
+import argparse
+import struct
+import sys
+
+BOOT_TRACE_ADDR = 0x84000
+BOOT_TRACE_MAGIC = 0x43525442
+BOOT_TRACE_MAX_ENTRIES = 63
+HEADER_SIZE = 16
+ENTRY_SIZE = 16
+
+# EE COP0 Count increments at the CPU clock
+EE_CLOCK = 294912000
+
+
+def read_trace(data, offset):
+    magic, count = struct.unpack_from('<II', data, offset)
+    if magic != BOOT_TRACE_MAGIC:
+        raise ValueError('no boot trace record at offset 0x{:x}'.format(offset))
+    if count > BOOT_TRACE_MAX_ENTRIES:
+        raise ValueError('invalid entry count {}'.format(count))
+
+    entries = []
+    for i in range(count):
+        tag, value = struct.unpack_from('<12sI', data, offset + HEADER_SIZE + i * ENTRY_SIZE)
+        entries.append((tag.split(b'\0')[0].decode('ascii', 'replace'), value))
+    return entries
+
+
+def unwrap(entries):
+    # Count is 32-bit and wraps every ~14.5 seconds. Assume no gap between two phases is longer than that
+    result = []
+    total = 0
+    prev = None
+    for tag, value in entries:
+        if prev is not None:
+            total += (value - prev) & 0xffffffff
+        else:
+            total = value
+        prev = value
+        result.append((tag, total))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Print the per-phase breakdown of an OSDMenu boot trace.')
+    parser.add_argument('dump', help='EE RAM dump or boot trace record dump')
+    parser.add_argument('--offset', type=lambda v: int(v, 0), default=None,
+                        help='record offset in the dump file (default: 0x{:x} for full RAM dumps, 0 otherwise)'.format(BOOT_TRACE_ADDR))
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as f:
+        data = f.read()
+
+    offset = args.offset
+    if offset is None:
+        offset = BOOT_TRACE_ADDR if len(data) >= BOOT_TRACE_ADDR + HEADER_SIZE else 0
+
+    try:
+        entries = unwrap(read_trace(data, offset))
+    except (ValueError, struct.error) as e:
+        print('Failed to read the boot trace: {}'.format(e))
+        sys.exit(1)
+
+    if not entries:
+        print('The boot trace is empty')
+        return
+
+    print('{:<14}{:>12}{:>12}'.format('Phase', 'Time, ms', 'Delta, ms'))
+    prev = entries[0][1]
+    for tag, value in entries:
+        print('{:<14}{:>12.2f}{:>12.2f}'.format(tag, value * 1000 / EE_CLOCK, (value - prev) * 1000 / EE_CLOCK))
+        prev = value
+
+    print('Total: {:.2f} ms from {} to {}'.format((entries[-1][1] - entries[0][1]) * 1000 / EE_CLOCK, entries[0][0], entries[-1][0]))
+
+
+if __name__ == '__main__':
+    main()
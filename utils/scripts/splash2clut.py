@@ -0,0 +1,177 @@
+# Converts a 24-bit BMP image into an 8-bit palettized C header for the GS (PSMT8 texture + PSMCT32 CLUT)
+#
+# The palette is built with median cut followed by a few k-means passes and is stored in the CSM1 CLUT order
+# expected by the GS. Rows are padded to 16 pixels so every row is transferred in whole qwords.
+# After writing the header, the image is decoded back through the stored palette and compared against the source.
+import argparse
+import math
+import struct
+import sys
+
+PALETTE_SIZE = 256
+
+
+def read_bmp(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:2] != b'BM':
+        raise ValueError('not a BMP file')
+    offset = struct.unpack_from('<I', data, 10)[0]
+    width, height, _, bpp, compression = struct.unpack_from('<iiHHI', data, 18)
+    if bpp != 24 or compression != 0:
+        raise ValueError('only uncompressed 24-bit BMP files are supported')
+
+    bottom_up = height > 0
+    height = abs(height)
+    row_size = (width * 3 + 3) & ~3
+    pixels = []
+    for y in range(height):
+        row = offset + ((height - 1 - y) if bottom_up else y) * row_size
+        for x in range(width):
+            b, g, r = data[row + x * 3:row + x * 3 + 3]
+            pixels.append((r, g, b))
+    return width, height, pixels
+
+
+def distance(a, b):
+    return (a[0] - b[0]) ** 2 + (a[1] - b[1]) ** 2 + (a[2] - b[2]) ** 2
+
+
+def weighted_mean(colors, counts):
+    total = sum(counts[c] for c in colors)
+    return tuple(round(sum(c[i] * counts[c] for c in colors) / total) for i in range(3))
+
+
+def median_cut(counts, palette_size):
+    boxes = [list(counts)]
+    while len(boxes) < palette_size:
+        # Split the box with the largest weighted channel range
+        best, best_score, best_channel = None, 0, 0
+        for i, box in enumerate(boxes):
+            if len(box) < 2:
+                continue
+            for channel in range(3):
+                values = [c[channel] for c in box]
+                score = (max(values) - min(values)) * sum(counts[c] for c in box)
+                if score > best_score:
+                    best, best_score, best_channel = i, score, channel
+        if best is None:
+            break
+
+        box = sorted(boxes.pop(best), key=lambda c: c[best_channel])
+        total = sum(counts[c] for c in box)
+        acc = 0
+        for split, c in enumerate(box):
+            acc += counts[c]
+            if acc * 2 >= total:
+                break
+        split = min(max(split, 0), len(box) - 2) + 1
+        boxes += [box[:split], box[split:]]
+
+    return [weighted_mean(box, counts) for box in boxes]
+
+
+def nearest(palette, color):
+    return min(range(len(palette)), key=lambda i: distance(palette[i], color))
+
+
+def quantize(pixels, palette_size, iterations):
+    counts = {}
+    for p in pixels:
+        counts[p] = counts.get(p, 0) + 1
+
+    # Index 0 is reserved for black: it's the background color and is also used for row padding
+    black = (0, 0, 0)
+    rest = {c: n for c, n in counts.items() if c != black}
+    if len(rest) < palette_size:
+        palette = [black] + list(rest)
+    else:
+        palette = [black] + median_cut(rest, palette_size - 1)
+        for _ in range(iterations):
+            clusters = [[] for _ in palette]
+            for c in rest:
+                clusters[nearest(palette, c)].append(c)
+            palette = [black] + [weighted_mean(cl, counts) if cl else palette[i + 1] for i, cl in enumerate(clusters[1:])]
+
+    palette += [black] * (palette_size - len(palette))
+    mapping = {c: nearest(palette, c) for c in counts}
+    return palette, [mapping[p] for p in pixels]
+
+
+def clut_index(i):
+    # CSM1 stores entries 8-15 and 16-23 of every 32-entry block swapped
+    return (i & ~0x18) | ((i & 0x08) << 1) | ((i & 0x10) >> 1)
+
+
+def write_header(path, source, width, height, stride, palette, indices):
+    clut = [0] * PALETTE_SIZE
+    for i, (r, g, b) in enumerate(palette):
+        clut[clut_index(i)] = r | (g << 8) | (b << 16)
+
+    with open(path, 'w', newline='\n') as f:
+        f.write('// File Generated by splash2clut.py from {}\n'.format(source))
+        f.write('#include <stdint.h>\n\n')
+        f.write('uint32_t splashWidth = {};\n'.format(width))
+        f.write('uint32_t splashHeight = {};\n\n'.format(height))
+        f.write('// Palette in GS CLUT order (CSM1)\n')
+        f.write('uint32_t __attribute__((aligned(16))) splashCLUT[] = {\n')
+        for i in range(0, PALETTE_SIZE, 8):
+            f.write('    ' + ' '.join('0x{:08x},'.format(v) for v in clut[i:i + 8]) + '\n')
+        f.write('};\n\n')
+        f.write('// 8-bit palette indices, rows are padded to {} pixels\n'.format(stride))
+        f.write('uint8_t __attribute__((aligned(16))) splash[] = {\n')
+        for y in range(height):
+            row = indices[y * width:(y + 1) * width] + [0] * (stride - width)
+            f.write('    // row {}\n'.format(y))
+            for i in range(0, stride, 16):
+                f.write('    ' + ' '.join('0x{:02x},'.format(v) for v in row[i:i + 16]) + '\n')
+        f.write('};\n')
+    return clut
+
+
+def verify(pixels, width, height, stride, clut, path):
+    # Parse the generated header back and decode every pixel through the stored CLUT
+    with open(path) as f:
+        text = f.read()
+    data = text.split('splash[] = {')[1]
+    stored = [int(v, 16) for v in data.replace(',', ' ').split() if v.startswith('0x')]
+    if len(stored) != stride * height:
+        raise ValueError('unexpected index count in the generated header')
+
+    squared_error = 0
+    max_error = 0
+    for y in range(height):
+        for x in range(width):
+            v = clut[clut_index(stored[y * stride + x])]
+            decoded = (v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff)
+            err = distance(decoded, pixels[y * width + x])
+            squared_error += err
+            max_error = max(max_error, max(abs(decoded[i] - pixels[y * width + x][i]) for i in range(3)))
+
+    mse = squared_error / (width * height * 3)
+    psnr = float('inf') if mse == 0 else 10 * math.log10(255 * 255 / mse)
+    return psnr, max_error
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Convert a 24-bit BMP into an 8-bit palettized GS texture header.')
+    parser.add_argument('input', help='input BMP file')
+    parser.add_argument('output', help='output C header')
+    parser.add_argument('--iterations', type=int, default=4, help='k-means refinement passes (default: 4)')
+    parser.add_argument('--min-psnr', type=float, default=40.0, help='fail if the decoded image PSNR is lower (default: 40 dB)')
+    args = parser.parse_args()
+
+    width, height, pixels = read_bmp(args.input)
+    stride = (width + 15) & ~15
+    palette, indices = quantize(pixels, PALETTE_SIZE, args.iterations)
+    clut = write_header(args.output, args.input.replace('\\', '/').split('/')[-1], width, height, stride, palette, indices)
+
+    psnr, max_error = verify(pixels, width, height, stride, clut, args.output)
+    print('{}x{}, {} colors, PSNR {:.2f} dB, max channel error {}'.format(width, height, len(set(pixels)), psnr, max_error))
+    if psnr < args.min_psnr:
+        print('PSNR is below {} dB'.format(args.min_psnr))
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()